@@ -11,46 +11,10 @@ extern "C"
 
 #include <stdint.h>
 
-// aus cpu-miner.c
-extern int device_map[8];
-
-// Speicher fr Input/Output der verketteten Hashfunktionen
-static uint32_t *d_hash[8];
-
-extern void jackpot_keccak512_cpu_init(int thr_id, int threads);
-extern void jackpot_keccak512_cpu_setBlock(void *pdata, size_t inlen);
-extern void jackpot_keccak512_cpu_hash(int thr_id, int threads, uint32_t startNounce, uint32_t *d_hash, int order);
-
-extern void quark_blake512_cpu_init(int thr_id, int threads);
-extern void quark_blake512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_groestl512_cpu_init(int thr_id, int threads);
-extern void quark_groestl512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_jh512_cpu_init(int thr_id, int threads);
-extern void quark_jh512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_skein512_cpu_init(int thr_id, int threads);
-extern void quark_skein512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_check_cpu_init(int thr_id, int threads);
-extern void quark_check_cpu_setTarget(const void *ptarget);
-extern uint32_t quark_check_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_inputHash, int order);
-
-extern void jackpot_compactTest_cpu_init(int thr_id, int threads);
-extern void jackpot_compactTest_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *inpHashes, uint32_t *d_validNonceTable, 
-											uint32_t *d_nonces1, size_t *nrm1,
-											uint32_t *d_nonces2, size_t *nrm2,
-											int order);
-
-// Speicher zur Generierung der Noncevektoren fr die bedingten Hashes
-static uint32_t *d_jackpotNonces[8];
-static uint32_t *d_branch1Nonces[8];
-static uint32_t *d_branch2Nonces[8];
-static uint32_t *d_branch3Nonces[8];
+#include "device_backend.h"
 
 // Original jackpothash Funktion aus einem miner Quelltext
-inline unsigned int jackpothash(void *state, const void *input)
+extern "C" unsigned int jackpothash(void *state, const void *input)
 {
     sph_blake512_context     ctx_blake;
     sph_groestl512_context   ctx_groestl;
@@ -95,149 +59,141 @@ inline unsigned int jackpothash(void *state, const void *input)
 
 extern bool opt_benchmark;
 
-extern "C" int scanhash_jackpot(int thr_id, uint32_t *pdata,
+extern "C" int scanhash_jackpot(struct device_ctx *ctx, uint32_t *pdata,
     const uint32_t *ptarget, uint32_t max_nonce,
     unsigned long *hashes_done)
 {
+	const int thr_id = ctx->thr_id;
+	const struct device_backend *dev = ctx->backend;
 	const uint32_t first_nonce = pdata[19];
+	int found = 0;
 
 	if (opt_benchmark)
 		((uint32_t*)ptarget)[7] = 0x0000ff;
 
-	const uint32_t Htarg = ptarget[7];
-
-	const int throughput = 256*4096*4; // 100;
+	const int throughput = device_throughput(ctx, 256*4096*4); // 100;
 
-	static bool init[8] = {0,0,0,0,0,0,0,0};
-	if (!init[thr_id])
+	if (!ctx->init)
 	{
-		cudaSetDevice(device_map[thr_id]);
-
-		// Konstanten kopieren, Speicher belegen
-		cudaMalloc(&d_hash[thr_id], 16 * sizeof(uint32_t) * throughput);
-		jackpot_keccak512_cpu_init(thr_id, throughput);
-		jackpot_compactTest_cpu_init(thr_id, throughput);
-		quark_blake512_cpu_init(thr_id, throughput);
-		quark_groestl512_cpu_init(thr_id, throughput);
-		quark_jh512_cpu_init(thr_id, throughput);
-		quark_skein512_cpu_init(thr_id, throughput);
-		quark_check_cpu_init(thr_id, throughput);
-		cudaMalloc(&d_jackpotNonces[thr_id], sizeof(uint32_t)*throughput*2);
-		cudaMalloc(&d_branch1Nonces[thr_id], sizeof(uint32_t)*throughput*2);
-		cudaMalloc(&d_branch2Nonces[thr_id], sizeof(uint32_t)*throughput*2);
-		cudaMalloc(&d_branch3Nonces[thr_id], sizeof(uint32_t)*throughput*2);
-		init[thr_id] = true;
+		static const enum hash_stage stages[] = {
+			STAGE_JHA_KECCAK512_80, STAGE_BLAKE512, STAGE_GROESTL512, STAGE_JH512,
+			STAGE_SKEIN512, STAGE_CHECK, STAGE_COMPACT_JACKPOT
+		};
+
+		const size_t hashBytes = 16 * sizeof(uint32_t) * throughput;
+		const size_t nonceBytes = sizeof(uint32_t) * throughput * 2;
+
+		// Konstanten kopieren, Speicher einmal im Arena-Block belegen
+		if (!dev->init(ctx, throughput, stages, sizeof(stages) / sizeof(stages[0])) ||
+			!device_arena_reserve(ctx, device_arena_size(hashBytes) + 4 * device_arena_size(nonceBytes), 0))
+			return 0;
+		ctx->d_hash[0] = (uint32_t *)device_arena_alloc(ctx, ARENA_DEVICE, hashBytes);
+		for (int i = 0; i < 4; i++)
+			ctx->d_nonces[i] = (uint32_t *)device_arena_alloc(ctx, ARENA_DEVICE, nonceBytes);
+		ctx->throughput = throughput;
+		ctx->init = true;
 	}
 
+	uint32_t *d_hash = ctx->d_hash[0];
+	uint32_t *d_branch1Nonces = ctx->d_nonces[1];
+	uint32_t *d_branch2Nonces = ctx->d_nonces[2];
+	uint32_t *d_branch3Nonces = ctx->d_nonces[3];
+
 	uint32_t endiandata[22];
 	for (int k=0; k < 22; k++)
 		be32enc(&endiandata[k], ((uint32_t*)pdata)[k]);
 
-	jackpot_keccak512_cpu_setBlock((void*)endiandata, 80);
-	quark_check_cpu_setTarget(ptarget);
+	dev->set_block(ctx, STAGE_JHA_KECCAK512_80, endiandata, 80);
+	dev->set_target(ctx, ptarget);
 
 	do {
 		int order = 0;
 
 		// erstes Keccak512 Hash mit CUDA
-		jackpot_keccak512_cpu_hash(thr_id, throughput, pdata[19], d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_JHA_KECCAK512_80, throughput, pdata[19], NULL, d_hash, order++);
 
 		size_t nrm1, nrm2, nrm3;
 
 		// Runde 1 (ohne Grstl)
 
-		jackpot_compactTest_cpu_hash_64(thr_id, throughput, pdata[19], d_hash[thr_id], NULL,
-				d_branch1Nonces[thr_id], &nrm1,
-				d_branch3Nonces[thr_id], &nrm3,
+		dev->compact(ctx, BRANCH_JACKPOT, throughput, pdata[19], d_hash, NULL,
+				d_branch1Nonces, &nrm1,
+				d_branch3Nonces, &nrm3,
 				order++);
 
 		// verfolge den skein-pfad weiter
-		quark_skein512_cpu_hash_64(thr_id, nrm3, pdata[19], d_branch3Nonces[thr_id], d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_SKEIN512, nrm3, pdata[19], d_branch3Nonces, d_hash, order++);
 
 		// noch schnell Blake & JH
-		jackpot_compactTest_cpu_hash_64(thr_id, nrm3, pdata[19], d_hash[thr_id], d_branch3Nonces[thr_id],
-			d_branch1Nonces[thr_id], &nrm1,
-			d_branch2Nonces[thr_id], &nrm2,
+		dev->compact(ctx, BRANCH_JACKPOT, nrm3, pdata[19], d_hash, d_branch3Nonces,
+			d_branch1Nonces, &nrm1,
+			d_branch2Nonces, &nrm2,
 			order++);
 
 		if (nrm1+nrm2 == nrm3) {
-			quark_blake512_cpu_hash_64(thr_id, nrm1, pdata[19], d_branch1Nonces[thr_id], d_hash[thr_id], order++);
-			quark_jh512_cpu_hash_64(thr_id, nrm2, pdata[19], d_branch2Nonces[thr_id], d_hash[thr_id], order++);
+			dev->hash(ctx, STAGE_BLAKE512, nrm1, pdata[19], d_branch1Nonces, d_hash, order++);
+			dev->hash(ctx, STAGE_JH512, nrm2, pdata[19], d_branch2Nonces, d_hash, order++);
 		}
 
 		// Runde 3 (komplett)
 
 		// jackpotNonces in branch1/2 aufsplitten gemss if (hash[0] & 0x01)
-		jackpot_compactTest_cpu_hash_64(thr_id, nrm3, pdata[19], d_hash[thr_id], d_branch3Nonces[thr_id],
-			d_branch1Nonces[thr_id], &nrm1,
-			d_branch2Nonces[thr_id], &nrm2,
+		dev->compact(ctx, BRANCH_JACKPOT, nrm3, pdata[19], d_hash, d_branch3Nonces,
+			d_branch1Nonces, &nrm1,
+			d_branch2Nonces, &nrm2,
 			order++);
 
 		if (nrm1+nrm2 == nrm3) {
-			quark_groestl512_cpu_hash_64(thr_id, nrm1, pdata[19], d_branch1Nonces[thr_id], d_hash[thr_id], order++);
-			quark_skein512_cpu_hash_64(thr_id, nrm2, pdata[19], d_branch2Nonces[thr_id], d_hash[thr_id], order++);
+			dev->hash(ctx, STAGE_GROESTL512, nrm1, pdata[19], d_branch1Nonces, d_hash, order++);
+			dev->hash(ctx, STAGE_SKEIN512, nrm2, pdata[19], d_branch2Nonces, d_hash, order++);
 		}
 
 		// jackpotNonces in branch1/2 aufsplitten gemss if (hash[0] & 0x01)
-		jackpot_compactTest_cpu_hash_64(thr_id, nrm3, pdata[19], d_hash[thr_id], d_branch3Nonces[thr_id],
-			d_branch1Nonces[thr_id], &nrm1,
-			d_branch2Nonces[thr_id], &nrm2,
+		dev->compact(ctx, BRANCH_JACKPOT, nrm3, pdata[19], d_hash, d_branch3Nonces,
+			d_branch1Nonces, &nrm1,
+			d_branch2Nonces, &nrm2,
 			order++);
 
 		if (nrm1+nrm2 == nrm3) {
-			quark_blake512_cpu_hash_64(thr_id, nrm1, pdata[19], d_branch1Nonces[thr_id], d_hash[thr_id], order++);
-			quark_jh512_cpu_hash_64(thr_id, nrm2, pdata[19], d_branch2Nonces[thr_id], d_hash[thr_id], order++);
+			dev->hash(ctx, STAGE_BLAKE512, nrm1, pdata[19], d_branch1Nonces, d_hash, order++);
+			dev->hash(ctx, STAGE_JH512, nrm2, pdata[19], d_branch2Nonces, d_hash, order++);
 		}
 
 		// Runde 3 (komplett)
 
 		// jackpotNonces in branch1/2 aufsplitten gemss if (hash[0] & 0x01)
-		jackpot_compactTest_cpu_hash_64(thr_id, nrm3, pdata[19], d_hash[thr_id], d_branch3Nonces[thr_id],
-			d_branch1Nonces[thr_id], &nrm1,
-			d_branch2Nonces[thr_id], &nrm2,
+		dev->compact(ctx, BRANCH_JACKPOT, nrm3, pdata[19], d_hash, d_branch3Nonces,
+			d_branch1Nonces, &nrm1,
+			d_branch2Nonces, &nrm2,
 			order++);
 
 		if (nrm1+nrm2 == nrm3) {
-			quark_groestl512_cpu_hash_64(thr_id, nrm1, pdata[19], d_branch1Nonces[thr_id], d_hash[thr_id], order++);
-			quark_skein512_cpu_hash_64(thr_id, nrm2, pdata[19], d_branch2Nonces[thr_id], d_hash[thr_id], order++);
+			dev->hash(ctx, STAGE_GROESTL512, nrm1, pdata[19], d_branch1Nonces, d_hash, order++);
+			dev->hash(ctx, STAGE_SKEIN512, nrm2, pdata[19], d_branch2Nonces, d_hash, order++);
 		}
 
 		// jackpotNonces in branch1/2 aufsplitten gemss if (hash[0] & 0x01)
-		jackpot_compactTest_cpu_hash_64(thr_id, nrm3, pdata[19], d_hash[thr_id], d_branch3Nonces[thr_id],
-			d_branch1Nonces[thr_id], &nrm1,
-			d_branch2Nonces[thr_id], &nrm2,
+		dev->compact(ctx, BRANCH_JACKPOT, nrm3, pdata[19], d_hash, d_branch3Nonces,
+			d_branch1Nonces, &nrm1,
+			d_branch2Nonces, &nrm2,
 			order++);
 
 		if (nrm1+nrm2 == nrm3) {
-			quark_blake512_cpu_hash_64(thr_id, nrm1, pdata[19], d_branch1Nonces[thr_id], d_hash[thr_id], order++);
-			quark_jh512_cpu_hash_64(thr_id, nrm2, pdata[19], d_branch2Nonces[thr_id], d_hash[thr_id], order++);
+			dev->hash(ctx, STAGE_BLAKE512, nrm1, pdata[19], d_branch1Nonces, d_hash, order++);
+			dev->hash(ctx, STAGE_JH512, nrm2, pdata[19], d_branch2Nonces, d_hash, order++);
 		}
 
 		// Scan nach Gewinner Hashes auf der GPU
-		uint32_t foundNonce = quark_check_cpu_hash_64(thr_id, nrm3, pdata[19], d_branch3Nonces[thr_id], d_hash[thr_id], order++);
-		if  (foundNonce != 0xffffffff)
-		{
-			uint32_t vhash64[8];
-			be32enc(&endiandata[19], foundNonce);
-
-			// diese jackpothash Funktion gibt die Zahl der Runden zurck
-			unsigned int rounds = jackpothash(vhash64, endiandata);
-
-			if ((vhash64[7]<=Htarg) && fulltest(vhash64, ptarget)) {
-
-				pdata[19] = foundNonce;
-				*hashes_done = (foundNonce - first_nonce + 1)/2;
-				//applog(LOG_INFO, "GPU #%d: result for nonce $%08X does validate on CPU (%d rounds)!", thr_id, foundNonce, rounds);
-				return 1;
-			} else {
-				applog(LOG_INFO, "GPU #%d: result for nonce $%08X does not validate on CPU (%d rounds)!", thr_id, foundNonce, rounds);
-			}
-		}
+		uint32_t nonces[DEVICE_CANDIDATES];
+		int count = dev->check(ctx, nrm3, pdata[19], d_branch3Nonces, d_hash, nonces, order++);
+
+		// Verifikation und Submit laufen asynchron im CPU Verify-Pool
+		found += submit_candidates(ctx, nonces, count);
 
 		pdata[19] += throughput;
 
 	} while (pdata[19] < max_nonce && !work_restart[thr_id].restart);
 
 	*hashes_done = (pdata[19] - first_nonce + 1)/2;
-	return 0;
+	return found;
 }
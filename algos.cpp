@@ -0,0 +1,150 @@
+//
+// Tabelle der unterstuetzten Algorithmen
+//
+// Alles, was cpu-miner.c ueber einen Algorithmus wissen muss (Name, scanhash,
+// CPU Hash zur Verifikation, Stratum Difficulty, Merkle Hash, Headerformat),
+// steht hier. Neue Algorithmen werden nur in algos.h und dieser Tabelle
+// eingetragen.
+//
+
+#include <string.h>
+#include <openssl/sha.h>
+
+#include "algos.h"
+
+typedef int (*scanhash_std_t)(struct device_ctx *ctx, uint32_t *pdata,
+	const uint32_t *ptarget, uint32_t max_nonce, unsigned long *hashes_done);
+
+// scanhash mit der alten Signatur (pdata, ptarget) an die einheitliche anpassen
+template <scanhash_std_t fn>
+static int scanhash_std(struct device_ctx *ctx, struct work *work, uint32_t max_nonce,
+	unsigned long *hashes_done)
+{
+	return fn(ctx, work->data, work->target, max_nonce, hashes_done);
+}
+
+template <int blocklen, bool vote>
+static int scanhash_heavy_std(struct device_ctx *ctx, struct work *work, uint32_t max_nonce,
+	unsigned long *hashes_done)
+{
+	return scanhash_heavy(ctx, work->data, work->target, max_nonce,
+		hashes_done, vote ? work->maxvote : 0, blocklen);
+}
+
+// CPU Hashes mit abweichender Signatur
+template <int blocklen>
+static void heavy_cpu_hash(void *state, const void *input)
+{
+	heavycoin_hash((unsigned char *)state, (const unsigned char *)input, blocklen);
+}
+
+static void fugue256_cpu_hash(void *state, const void *input)
+{
+	fugue256_hash((unsigned char *)state, (const unsigned char *)input, 80);
+}
+
+static void jackpot_cpu_hash(void *state, const void *input)
+{
+	jackpothash(state, input);
+}
+
+const struct algo_traits algo_table[ALGO_COUNT] = {
+	/* name, scanhash, hash, diff_factor, merkle, blocklen, hdr_bits, swab_header, vote, min_scan, portable */
+	{ "heavy", scanhash_heavy_std<HEAVYCOIN_BLKHDR_SZ, true>, heavy_cpu_hash<HEAVYCOIN_BLKHDR_SZ>,
+		1.0, MERKLE_HEAVY, HEAVYCOIN_BLKHDR_SZ, 0x00000280, true, true, 0xfffffLL, false },
+	{ "mjollnir", scanhash_heavy_std<MNR_BLKHDR_SZ, false>, heavy_cpu_hash<MNR_BLKHDR_SZ>,
+		1.0, MERKLE_HEAVY, MNR_BLKHDR_SZ, 0x000002A0, true, false, 0xfffffLL, false },
+	{ "fugue256", scanhash_std<scanhash_fugue256>, fugue256_cpu_hash,
+		256.0, MERKLE_SHA256, 80, 0x00000280, false, false, 0xfffffLL, false },
+	{ "groestl", scanhash_std<scanhash_groestlcoin>, groestlhash,
+		256.0, MERKLE_SHA256, 80, 0x00000280, false, false, 0xfffffLL, false },
+	{ "myr-gr", scanhash_std<scanhash_myriad>, myriadhash,
+		1.0, MERKLE_SHA256D, 80, 0x00000280, false, false, 0xfffffLL, false },
+	{ "jackpot", scanhash_std<scanhash_jackpot>, jackpot_cpu_hash,
+		65536.0, MERKLE_SHA256D, 80, 0x00000280, false, false, 0x1fffLL, true },
+	{ "quark", scanhash_std<scanhash_quark>, quarkhash,
+		1.0, MERKLE_SHA256D, 80, 0x00000280, false, false, 0xfffffLL, true },
+	{ "anime", scanhash_std<scanhash_anime>, animehash,
+		1.0, MERKLE_SHA256D, 80, 0x00000280, false, false, 0xfffffLL, false },
+	{ "nist5", scanhash_std<scanhash_nist5>, nist5hash,
+		1.0, MERKLE_SHA256D, 80, 0x00000280, false, false, 0xfffffLL, true },
+	{ "x11", scanhash_std<scanhash_x11>, x11hash,
+		1.0, MERKLE_SHA256D, 80, 0x00000280, false, false, 0xfffffLL, true },
+	{ "x13", scanhash_std<scanhash_x13>, x13hash,
+		1.0, MERKLE_SHA256D, 80, 0x00000280, false, false, 0xfffffLL, false },
+	{ "dmd-gr", scanhash_std<scanhash_groestlcoin>, groestlhash,
+		256.0, MERKLE_SHA256D, 80, 0x00000280, false, false, 0xfffffLL, false },
+};
+
+sha256_algos algo_by_name(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ALGO_COUNT; i++)
+		if (!strcmp(name, algo_table[i].name))
+			break;
+	return (sha256_algos)i;
+}
+
+void algo_merkle_root(enum merkle_hash merkle, unsigned char *root,
+	const unsigned char *coinbase, size_t coinbase_size, unsigned char **branches, int count)
+{
+	if (merkle == MERKLE_HEAVY)
+		heavycoin_hash(root, coinbase, (int)coinbase_size);
+	else if (merkle == MERKLE_SHA256)
+		SHA256(coinbase, coinbase_size, root);
+	else
+		sha256d(root, coinbase, (int)coinbase_size);
+
+	for (int i = 0; i < count; i++)
+	{
+		memcpy(root + 32, branches[i], 32);
+		if (merkle == MERKLE_HEAVY)
+			heavycoin_hash(root, root, 64);
+		else
+			sha256d(root, root, 64);
+	}
+}
+
+void algo_stratum_header(const struct algo_traits *a, uint32_t *data,
+	const struct stratum_job *job, const unsigned char *merkle_root, uint16_t vote)
+{
+	int i;
+
+	memset(data, 0, 128);
+	data[0] = le32dec(job->version);
+	for (i = 0; i < 8; i++)
+		data[1 + i] = le32dec((const uint32_t *)job->prevhash + i);
+	for (i = 0; i < 8; i++)
+		data[9 + i] = be32dec((const uint32_t *)merkle_root + i);
+	data[17] = le32dec(job->ntime);
+	data[18] = le32dec(job->nbits);
+	if (a->swab_header)
+	{
+		for (i = 0; i < 20; i++)
+			data[i] = be32dec(&data[i]);
+	}
+
+	data[20] = 0x80000000;
+	data[31] = a->hdr_bits;
+
+	// HeavyCoin
+	if (a->vote) {
+		uint16_t *ext = (uint16_t *)&data[20];
+		ext[0] = vote;
+		ext[1] = be16dec(job->nreward);
+	}
+}
+
+void algo_hash_data(const struct algo_traits *a, uint32_t *hash, const uint32_t *data)
+{
+	uint32_t endiandata[20];
+
+	if (a->swab_header)
+		a->hash(hash, data);
+	else {
+		for (int i = 0; i < 20; i++)
+			be32enc(&endiandata[i], data[i]);
+		a->hash(hash, endiandata);
+	}
+}
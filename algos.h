@@ -0,0 +1,80 @@
+#ifndef __ALGOS_H__
+#define __ALGOS_H__
+
+#include "miner.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HEAVYCOIN_BLKHDR_SZ		84
+#define MNR_BLKHDR_SZ 80
+
+typedef enum {
+	ALGO_HEAVY,		/* Heavycoin hash */
+	ALGO_MJOLLNIR,		/* Mjollnir hash */
+	ALGO_FUGUE256,		/* Fugue256 */
+	ALGO_GROESTL,
+	ALGO_MYR_GR,
+	ALGO_JACKPOT,
+	ALGO_QUARK,
+	ALGO_ANIME,
+	ALGO_NIST5,
+	ALGO_X11,
+	ALGO_X13,
+	ALGO_DMD_GR,
+	ALGO_COUNT
+} sha256_algos;
+
+/* how the stratum coinbase and merkle branches are hashed */
+enum merkle_hash {
+	MERKLE_SHA256D,		/* sha256d everywhere */
+	MERKLE_SHA256,		/* single SHA256 coinbase, sha256d branches */
+	MERKLE_HEAVY		/* heavycoin_hash everywhere */
+};
+
+/* uniform scanhash, everything algo specific comes from the work */
+typedef int (*scanhash_fn)(struct device_ctx *ctx, struct work *work, uint32_t max_nonce,
+	unsigned long *hashes_done);
+
+/* CPU reference hash of the 80 byte header as handed to scanhash */
+typedef void (*cpuhash_fn)(void *state, const void *input);
+
+struct algo_traits {
+	const char *name;
+	scanhash_fn scanhash;
+	cpuhash_fn hash;
+	double diff_factor;	/* stratum difficulty divisor */
+	enum merkle_hash merkle;
+	int blocklen;		/* header length seen by the hash */
+	uint32_t hdr_bits;	/* work->data[31] of stratum work */
+	bool swab_header;	/* header words kept big endian (heavy style) */
+	bool vote;		/* block reward vote in header and submit */
+	int64_t min_scan;	/* nonces per scan when no hashrate is known yet */
+	bool portable;		/* scanhash only uses ctx->backend, runs on --backend=cpu */
+};
+
+extern const struct algo_traits algo_table[ALGO_COUNT];
+
+/* returns ALGO_COUNT for unknown names */
+extern sha256_algos algo_by_name(const char *name);
+
+/* merkle root of stratum work: the coinbase hashed, then each branch
+ * appended and the pair hashed again; root needs 64 bytes */
+extern void algo_merkle_root(enum merkle_hash merkle, unsigned char *root,
+	const unsigned char *coinbase, size_t coinbase_size, unsigned char **branches, int count);
+
+/* block header of stratum work as the miner threads scan it: data needs
+ * 32 words, version, prevhash, ntime, nbits and nreward are taken from
+ * the job as received, vote only counts for algorithms with a vote */
+extern void algo_stratum_header(const struct algo_traits *a, uint32_t *data,
+	const struct stratum_job *job, const unsigned char *merkle_root, uint16_t vote);
+
+/* CPU reference hash of work data with the nonce in data[19] */
+extern void algo_hash_data(const struct algo_traits *a, uint32_t *hash, const uint32_t *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ALGOS_H__ */
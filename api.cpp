@@ -0,0 +1,610 @@
+//
+// JSON API (--api-bind)
+//
+// Nur lesend, im Stil der cgminer API: der Client schickt einen Befehl,
+// entweder als Text ("summary") oder als JSON ({"command":"devs"}), und
+// bekommt eine JSON Antwort mit abschliessendem '\0', danach wird die
+// Verbindung geschlossen.
+//
+// Auf demselben Port beantwortet der Thread auch HTTP "GET /metrics" mit
+// den Prometheus Metriken (metrics.cpp), erkannt am "GET " am Anfang.
+//
+//   summary   Hashraten und Shares aller Devices
+//   devs      Hashraten und Sensoren pro Device
+//   pool      URL, Benutzer und Shares
+//   stats     Backend-Zahlen pro Device (Batches, Idle, Verify)
+//   jobs      die letzten Neustarts, ms bis Arbeit und erster Batch
+//   version   Programm- und API-Version
+//
+// Ein eigener Thread bedient alle Verbindungen mit select(), nichts
+// blockiert. Gelesen wird nur aus den Snapshots von hashmeter und
+// telemetry und den Device-Zaehlern von metrics_device_read() (Seqlocks);
+// kein Lock, den ein Miner-Thread braucht. Jede Antwort wird
+// API_CACHE_MS lang wiederverwendet, so kostet dauerndes Abfragen kaum
+// etwas. Mehr als opt_api_clients offene Verbindungen werden sofort
+// geschlossen, wer zu langsam sendet nach API_TIMEOUT_MS.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef WIN32
+#include <winsock2.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include "miner.h"
+#include "device_backend.h"
+#include "hashmeter.h"
+#include "telemetry.h"
+#include "thermal.h"
+#include "api.h"
+#include "metrics.h"
+
+#ifdef WIN32
+#define api_close(s) closesocket(s)
+#define socket_blocks() (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+#define api_close(s) close(s)
+#define socket_blocks() (errno == EAGAIN || errno == EWOULDBLOCK)
+#endif
+
+#define API_VERSION "1.0"
+#define API_DEFAULT_ADDR "127.0.0.1"
+#define API_MAX_CLIENTS 64
+#define API_REQUEST 512
+#define API_CACHE_MS 1000
+#define API_TIMEOUT_MS 2000
+
+char *opt_api_bind = NULL;
+int opt_api_clients = 8;
+
+struct api_client {
+	curl_socket_t sock;
+	char request[API_REQUEST];
+	int len;
+	bool http;
+	char *reply;		// ganze Antwort, bei JSON inklusive '\0'
+	size_t reply_len, sent;
+	double deadline;
+};
+
+struct api_cache {
+	char *reply;
+	double time;
+};
+
+static const struct api_info *api;
+static curl_socket_t api_sock = CURL_SOCKET_BAD;
+
+static double api_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+static void api_nonblocking(curl_socket_t sock)
+{
+#ifdef WIN32
+	u_long on = 1;
+	ioctlsocket(sock, FIONBIO, &on);
+#else
+	fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+// cgminer: Code 11 summary, 9 devs, 7 pools, 70 stats, 22 version, 14 unbekannt
+static json_t *api_status(int code, const char *msg, bool ok)
+{
+	json_t *status = json_object();
+	json_t *list = json_array();
+
+	json_object_set_new(status, "STATUS", json_string(ok ? "S" : "E"));
+	json_object_set_new(status, "When", json_integer((int)time(NULL)));
+	json_object_set_new(status, "Code", json_integer(code));
+	json_object_set_new(status, "Msg", json_string(msg));
+	json_object_set_new(status, "Description", json_string(api->version));
+	json_array_append_new(list, status);
+	return list;
+}
+
+static void api_rates(json_t *obj, const struct hash_rates *r)
+{
+	static const char *windows[HASHMETER_WINDOWS] = { "10s", "1m", "15m" };
+	char key[32];
+
+	for (int w = 0; w < HASHMETER_WINDOWS; w++)
+	{
+		sprintf(key, "KHS %s", windows[w]);
+		json_object_set_new(obj, key, json_real(1e-3 * r->window[w]));
+	}
+	for (int w = 0; w < HASHMETER_WINDOWS; w++)
+	{
+		sprintf(key, "KHS ewma %s", windows[w]);
+		json_object_set_new(obj, key, json_real(1e-3 * r->ewma[w]));
+	}
+	json_object_set_new(obj, "Total Hashes", json_real(r->hashes));
+}
+
+static json_t *api_summary(void)
+{
+	json_t *obj = json_object();
+	struct hash_rates r;
+
+	hashmeter_read(HASHMETER_TOTAL, &r);
+	json_object_set_new(obj, "Elapsed", json_integer((int)(time(NULL) - api->start)));
+	json_object_set_new(obj, "Algorithm", json_string(api->algo));
+	json_object_set_new(obj, "Devices", json_integer(api->n_devices));
+	api_rates(obj, &r);
+	json_object_set_new(obj, "Accepted", json_integer(*api->accepted));
+	json_object_set_new(obj, "Rejected", json_integer(*api->rejected));
+	return obj;
+}
+
+static json_t *api_dev(int i)
+{
+	const struct device_ctx *ctx = api->devices[i];
+	json_t *obj = json_object();
+	struct telemetry_sample hw;
+	struct thermal_state th;
+	struct device_stats st;
+	struct hash_rates r;
+
+	hashmeter_read(i, &r);
+	metrics_device_read(i, &st);
+	json_object_set_new(obj, "GPU", json_integer(i));
+	json_object_set_new(obj, "Device", json_integer(ctx->device_id));
+	json_object_set_new(obj, "Name", json_string(ctx->name ? ctx->name : ""));
+	json_object_set_new(obj, "Backend", json_string(ctx->backend->name));
+	api_rates(obj, &r);
+	json_object_set_new(obj, "Intensity", json_integer(st.intensity));
+	json_object_set_new(obj, "Batch", json_integer(st.batch));
+	if (telemetry_read(i, &hw)) {
+		json_object_set_new(obj, "Temperature", json_integer(hw.temp));
+		json_object_set_new(obj, "Temperature Max", json_integer(hw.temp_max));
+		json_object_set_new(obj, "Fan Speed", json_integer(hw.fan_rpm));
+		json_object_set_new(obj, "Fan Percent", json_integer(hw.fan));
+		json_object_set_new(obj, "GPU Clock", json_integer(hw.clock));
+		json_object_set_new(obj, "Memory Clock", json_integer(hw.clock_mem));
+		json_object_set_new(obj, "GPU Activity", json_integer(hw.load));
+		json_object_set_new(obj, "Memory Used", json_integer(hw.mem_used));
+		json_object_set_new(obj, "Power", json_integer(hw.power));
+		json_object_set_new(obj, "Sensor Age", json_integer((int)(time(NULL) - hw.time)));
+	}
+	if (thermal_read(i, &th)) {
+		json_object_set_new(obj, "Duty", json_real(th.duty));
+		json_object_set_new(obj, "Throttled", json_real(th.throttled));
+	}
+	return obj;
+}
+
+static json_t *api_devs(void)
+{
+	json_t *list = json_array();
+
+	for (int i = 0; i < api->n_devices; i++)
+		json_array_append_new(list, api_dev(i));
+	return list;
+}
+
+static json_t *api_pool(void)
+{
+	json_t *obj = json_object();
+
+	json_object_set_new(obj, "POOL", json_integer(0));
+	json_object_set_new(obj, "URL", json_string(api->url ? api->url : ""));
+	json_object_set_new(obj, "User", json_string(api->user ? api->user : ""));
+	json_object_set_new(obj, "Stratum Active", have_stratum ? json_true() : json_false());
+	json_object_set_new(obj, "Long Poll", have_longpoll ? json_true() : json_false());
+	json_object_set_new(obj, "Accepted", json_integer(*api->accepted));
+	json_object_set_new(obj, "Rejected", json_integer(*api->rejected));
+	return obj;
+}
+
+// Zaehler der Miner-Threads aus dem Snapshot, hoechstens einen Batch alt
+static json_t *api_stats(void)
+{
+	json_t *list = json_array();
+
+	for (int i = 0; i < api->n_devices; i++)
+	{
+		json_t *obj = json_object();
+		struct device_stats st;
+		char id[16];
+
+		metrics_device_read(i, &st);
+		sprintf(id, "GPU%d", i);
+		json_object_set_new(obj, "STATS", json_integer(i));
+		json_object_set_new(obj, "ID", json_string(id));
+		json_object_set_new(obj, "Batches", json_integer(st.batches));
+		json_object_set_new(obj, "GPU Idle", json_real(st.gpu_idle));
+		json_object_set_new(obj, "Checked Batches", json_integer(st.checked_batches));
+		json_object_set_new(obj, "Candidates", json_integer(st.candidates));
+		json_object_set_new(obj, "Dropped", json_integer(st.dropped));
+		json_object_set_new(obj, "CPU Load", json_real(st.cpu_load));
+		json_object_set_new(obj, "CPU Time", json_real(st.cpu_time));
+		json_object_set_new(obj, "Allocs", json_integer(st.allocs));
+		json_object_set_new(obj, "Verify Checked", json_integer(st.verify.checked));
+		json_object_set_new(obj, "Verify Invalid", json_integer(st.verify.invalid));
+		json_object_set_new(obj, "Verify Latency", json_real(st.verify.latency));
+		json_array_append_new(list, obj);
+	}
+	return list;
+}
+
+// ms von from bis to, null solange es nicht passiert ist
+static json_t *api_ms(long long from, long long to)
+{
+	return to ? json_real(1e-3 * (to - from)) : json_null();
+}
+
+// neuester Neustart zuerst, Zeiten ab der Meldung des Pools
+static json_t *api_jobs(void)
+{
+	json_t *list = json_array();
+	struct job_timing t;
+
+	for (int age = 0; age < METRICS_JOBS; age++)
+	{
+		json_t *obj, *devs;
+		long long last = 0;
+
+		if (!metrics_job_read(age, &t))
+			continue;
+		obj = json_object();
+		devs = json_array();
+		json_object_set_new(obj, "JOB", json_integer(t.seq));
+		json_object_set_new(obj, "When", json_integer((int)(t.built / 1000000)));
+		json_object_set_new(obj, "Build", api_ms(t.notify, t.built));
+		for (int i = 0; i < t.n_devices; i++)
+		{
+			json_t *dev = json_object();
+
+			json_object_set_new(dev, "GPU", json_integer(i));
+			json_object_set_new(dev, "Switch", api_ms(t.notify, t.took[i]));
+			json_object_set_new(dev, "First Batch", api_ms(t.notify, t.first[i]));
+			json_array_append_new(devs, dev);
+			if (last >= 0 && t.first[i])
+				last = (t.first[i] > last) ? t.first[i] : last;
+			else
+				last = -1;
+		}
+		json_object_set_new(obj, "All Devices", api_ms(t.notify, last > 0 ? last : 0));
+		json_object_set_new(obj, "GPUs", devs);
+		json_array_append_new(list, obj);
+	}
+	return list;
+}
+
+static json_t *api_version(void)
+{
+	json_t *obj = json_object();
+
+	json_object_set_new(obj, "ccminer", json_string(api->version));
+	json_object_set_new(obj, "API", json_string(API_VERSION));
+	return obj;
+}
+
+// Befehle in der Reihenfolge der Cache-Eintraege
+static const struct {
+	const char *name;
+	const char *section;
+	int code;
+	const char *msg;
+	json_t *(*build)(void);
+} api_commands[] = {
+	{ "summary", "SUMMARY", 11, "Summary", api_summary },
+	{ "devs", "DEVS", 9, "GPU count", api_devs },
+	{ "pool", "POOLS", 7, "1 Pool(s)", api_pool },
+	{ "stats", "STATS", 70, "ccminer stats", api_stats },
+	{ "jobs", "JOBS", 71, "Work restarts", api_jobs },
+	{ "version", "VERSION", 22, "ccminer versions", api_version },
+};
+
+#define API_COMMANDS (int)(sizeof(api_commands) / sizeof(api_commands[0]))
+
+static char *api_dump(json_t *root)
+{
+	char *s = json_dumps(root, JSON_COMPACT);
+
+	json_decref(root);
+	return s;
+}
+
+// Antwort auf einen Befehl, aus dem Cache wenn sie jung genug ist
+static char *api_reply(const char *command)
+{
+	static struct api_cache cache[API_COMMANDS];
+	double now = api_now();
+	json_t *root, *data;
+	int i;
+
+	for (i = 0; i < API_COMMANDS && strcmp(command, api_commands[i].name); i++)
+		;
+	if (i == API_COMMANDS) {
+		root = json_object();
+		json_object_set_new(root, "STATUS", api_status(14, "Invalid command", false));
+		json_object_set_new(root, "id", json_integer(1));
+		return api_dump(root);
+	}
+
+	if (cache[i].reply && now - cache[i].time < 1e-3 * API_CACHE_MS)
+		return strdup(cache[i].reply);
+
+	data = api_commands[i].build();
+	if (!json_is_array(data)) {
+		json_t *list = json_array();
+		json_array_append_new(list, data);
+		data = list;
+	}
+	root = json_object();
+	json_object_set_new(root, "STATUS", api_status(api_commands[i].code, api_commands[i].msg, true));
+	json_object_set_new(root, api_commands[i].section, data);
+	json_object_set_new(root, "id", json_integer(1));
+
+	free(cache[i].reply);
+	cache[i].reply = api_dump(root);
+	cache[i].time = now;
+	return cache[i].reply ? strdup(cache[i].reply) : NULL;
+}
+
+// Prometheus Text, gerendert in einen Puffer, der fuer alle Abfragen bleibt
+static char *api_metrics(void)
+{
+	static struct api_cache cache;
+	static char *text;
+	static size_t size;
+	double now = api_now();
+	size_t len;
+	char *reply;
+
+	if (cache.reply && now - cache.time < 1e-3 * API_CACHE_MS)
+		return strdup(cache.reply);
+
+	len = metrics_render(api, &text, &size);
+	if (!len)
+		return NULL;
+	reply = (char *)realloc(cache.reply, len + 128);
+	if (!reply)
+		return NULL;
+	sprintf(reply, "HTTP/1.0 200 OK\r\n"
+		"Content-Type: text/plain; version=0.0.4\r\n"
+		"Content-Length: %lu\r\n"
+		"Connection: close\r\n\r\n", (unsigned long)len);
+	strcat(reply, text);
+	cache.reply = reply;
+	cache.time = now;
+	return strdup(reply);
+}
+
+static char *api_http_reply(const char *path)
+{
+	if (!strcmp(path, "/metrics"))
+		return api_metrics();
+	return strdup("HTTP/1.0 404 Not Found\r\n"
+		"Content-Type: text/plain\r\n"
+		"Content-Length: 10\r\n"
+		"Connection: close\r\n\r\n"
+		"Not Found\n");
+}
+
+// true wenn der Befehl vollstaendig ist; JSON kann in Stuecken kommen.
+// command ist immer gesetzt, leer wenn keiner zu erkennen war (volles
+// ungueltiges JSON, Verbindung mitten in der Anfrage geschlossen)
+static bool api_parse(struct api_client *c, char *command, size_t size)
+{
+	char *s = c->request;
+	size_t n;
+
+	command[0] = '\0';
+	c->request[c->len] = '\0';
+	while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')
+		s++;
+
+	// HTTP: der Pfad, sobald die Header vollstaendig sind
+	if (!strncmp(s, "GET ", 4)) {
+		c->http = true;
+		if (!strstr(s, "\r\n\r\n") && !strstr(s, "\n\n") && c->len < API_REQUEST - 1)
+			return false;
+		snprintf(command, size, "%s", s + 4);
+		n = strcspn(command, " ?\r\n");
+		command[n] = '\0';
+		return true;
+	}
+
+	if (*s == '{') {
+		json_error_t err;
+#if JANSSON_VERSION_HEX >= 0x020000
+		json_t *req = json_loads(s, 0, &err);
+#else
+		json_t *req = json_loads(s, &err);
+#endif
+		const char *cmd;
+
+		if (!req)
+			return c->len >= API_REQUEST - 1;
+		cmd = json_string_value(json_object_get(req, "command"));
+		snprintf(command, size, "%s", cmd ? cmd : "");
+		json_decref(req);
+		return true;
+	}
+
+	// Text: ein recv reicht, wie bei cgminer
+	snprintf(command, size, "%s", s);
+	n = strcspn(command, " \t\r\n|");
+	command[n] = '\0';
+	return true;
+}
+
+static void api_drop(struct api_client *c)
+{
+	api_close(c->sock);
+	free(c->reply);
+	memset(c, 0, sizeof(*c));
+	c->sock = CURL_SOCKET_BAD;
+}
+
+static void api_read(struct api_client *c)
+{
+	char command[64];
+	int n = recv(c->sock, c->request + c->len, API_REQUEST - 1 - c->len, 0);
+
+	if (n <= 0) {
+		if (n < 0 && socket_blocks())
+			return;
+		// ohne Befehl geschlossen
+		if (!c->len) {
+			api_drop(c);
+			return;
+		}
+		n = 0;
+	}
+	c->len += n;
+	if (!api_parse(c, command, sizeof(command)) && n > 0)
+		return;
+
+	c->reply = c->http ? api_http_reply(command) : api_reply(command);
+	if (!c->reply) {
+		api_drop(c);
+		return;
+	}
+	c->reply_len = strlen(c->reply) + !c->http;
+	c->sent = 0;
+}
+
+static void api_write(struct api_client *c)
+{
+	int n = send(c->sock, c->reply + c->sent, (int)(c->reply_len - c->sent), 0);
+
+	if (n < 0) {
+		if (!socket_blocks())
+			api_drop(c);
+		return;
+	}
+	c->sent += n;
+	if (c->sent == c->reply_len)
+		api_drop(c);
+}
+
+static void api_accept(struct api_client *clients)
+{
+	curl_socket_t sock = accept(api_sock, NULL, NULL);
+	int i;
+
+	if (sock == CURL_SOCKET_BAD)
+		return;
+	for (i = 0; i < opt_api_clients && clients[i].sock != CURL_SOCKET_BAD; i++)
+		;
+	if (i == opt_api_clients) {
+		api_close(sock);
+		return;
+	}
+	api_nonblocking(sock);
+	clients[i].sock = sock;
+	clients[i].deadline = api_now() + 1e-3 * API_TIMEOUT_MS;
+}
+
+static void *api_thread(void *userdata)
+{
+	static struct api_client clients[API_MAX_CLIENTS];
+
+	for (int i = 0; i < API_MAX_CLIENTS; i++)
+		clients[i].sock = CURL_SOCKET_BAD;
+
+	while (1)
+	{
+		struct timeval tv = { 1, 0 };
+		fd_set rd, wr;
+		curl_socket_t top = api_sock;
+		double now;
+
+		FD_ZERO(&rd);
+		FD_ZERO(&wr);
+		FD_SET(api_sock, &rd);
+		for (int i = 0; i < opt_api_clients; i++)
+		{
+			struct api_client *c = &clients[i];
+
+			if (c->sock == CURL_SOCKET_BAD)
+				continue;
+			FD_SET(c->sock, c->reply ? &wr : &rd);
+			if (c->sock > top)
+				top = c->sock;
+		}
+		if (select((int)top + 1, &rd, &wr, NULL, &tv) < 0)
+			continue;
+
+		now = api_now();
+		for (int i = 0; i < opt_api_clients; i++)
+		{
+			struct api_client *c = &clients[i];
+
+			if (c->sock == CURL_SOCKET_BAD)
+				continue;
+			if (c->reply && FD_ISSET(c->sock, &wr))
+				api_write(c);
+			else if (!c->reply && FD_ISSET(c->sock, &rd))
+				api_read(c);
+			if (c->sock != CURL_SOCKET_BAD && now > c->deadline)
+				api_drop(c);
+		}
+		if (FD_ISSET(api_sock, &rd))
+			api_accept(clients);
+	}
+	return NULL;
+}
+
+extern "C" bool api_start(const struct api_info *info)
+{
+	struct sockaddr_in addr;
+	char host[64] = API_DEFAULT_ADDR;
+	const char *colon = strrchr(opt_api_bind, ':');
+	int port, on = 1;
+	pthread_t pth;
+
+	api = info;
+	if (opt_api_clients > API_MAX_CLIENTS)
+		opt_api_clients = API_MAX_CLIENTS;
+
+	if (colon) {
+		snprintf(host, sizeof(host), "%.*s", (int)(colon - opt_api_bind), opt_api_bind);
+		port = atoi(colon + 1);
+	} else
+		port = atoi(opt_api_bind);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((unsigned short)port);
+	addr.sin_addr.s_addr = inet_addr(host);
+	if (port <= 0 || port > 65535 || addr.sin_addr.s_addr == INADDR_NONE) {
+		applog(LOG_ERR, "invalid API address %s", opt_api_bind);
+		return false;
+	}
+
+	api_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (api_sock == CURL_SOCKET_BAD)
+		return false;
+	setsockopt(api_sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+	if (bind(api_sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(api_sock, 16) < 0) {
+		applog(LOG_ERR, "API can not listen on %s:%d", host, port);
+		api_close(api_sock);
+		return false;
+	}
+	api_nonblocking(api_sock);
+
+	if (pthread_create(&pth, NULL, api_thread, NULL))
+		return false;
+	pthread_detach(pth);
+	applog(LOG_INFO, "API listening on %s:%d", host, port);
+	return true;
+}
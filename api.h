@@ -0,0 +1,39 @@
+#ifndef __API_H__
+#define __API_H__
+
+#include <stdbool.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct device_ctx;
+
+/* what the API reports besides the device snapshots, filled by main() */
+struct api_info {
+	const char *version;
+	const char *algo;
+	const char *url;
+	const char *user;
+	time_t start;
+	struct device_ctx **devices;
+	int n_devices;
+	/* share counts, read without stats_lock */
+	const unsigned long *accepted;
+	const unsigned long *rejected;
+};
+
+/* [IP:]PORT of the API, NULL = off */
+extern char *opt_api_bind;
+/* open connections at most, more are closed right away */
+extern int opt_api_clients;
+
+/* starts the API thread on opt_api_bind; info must stay valid */
+extern bool api_start(const struct api_info *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __API_H__ */
@@ -0,0 +1,265 @@
+//
+// Intensity Auto-Tuner
+//
+// Die Batchgroessen der scanhash Schleifen sind fuer eine bestimmte GPU
+// gewaehlt. Der Tuner misst pro Device und Algorithmus die Batches
+// default << intensity von AUTOTUNE_MAX_INTENSITY abwaerts: die Hashrate und
+// die Zeit, bis scanhash nach einem Restart zurueckkehrt (Jobwechsel).
+// Genommen wird die schnellste Einstellung, deren Jobwechsel hoechstens
+// opt_tune_latency ms dauert.
+//
+// Die Ergebnisse stehen in einer JSON Datei, Schluessel sind Device-Name,
+// Backend und Treiberversion. Spaetere Starts lesen nur noch die Datei.
+//
+// Die Threads pro Block sind in den Kernels fest, getunt wird nur der Batch.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "autotune.h"
+#include "device_backend.h"
+
+extern "C" int cuda_driver_version();
+
+bool opt_autotune = false;
+char *opt_tune_cache = NULL;
+int opt_tune_latency = 500;
+
+#define AUTOTUNE_CACHE "ccminer-tune.json"
+
+// Messdauer pro Einstellung, nach einem Init laeuft erst eine kurze Runde
+// zum Aufwaermen (Allokation, Kernel laden)
+#define AUTOTUNE_TRIAL_MS 1000
+#define AUTOTUNE_WARMUP_MS 300
+#define AUTOTUNE_RETRIES 3
+
+// Hashraten, die so nah an der besten liegen, gelten als gleich schnell
+#define AUTOTUNE_TOLERANCE 0.02
+
+// Lesen und Schreiben der Datei aus mehreren Miner-Threads
+static pthread_mutex_t autotune_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct autotune_result {
+	int intensity;
+	int batch;
+	double rate;		// hashes/s
+	double latency;		// ms vom Restart bis scanhash zurueck ist, mindestens ein Batch
+};
+
+struct autotune_timer {
+	int thr_id;
+	int ms;
+	struct timeval tv_fire;
+};
+
+static double autotune_ms(const struct timeval *end, const struct timeval *start)
+{
+	return 1e3 * (end->tv_sec - start->tv_sec) + 1e-3 * (end->tv_usec - start->tv_usec);
+}
+
+// setzt nach timer->ms den Restart des Miner-Threads, wie ein neuer Job
+static void *autotune_timer_thread(void *userdata)
+{
+	struct autotune_timer *timer = (struct autotune_timer *)userdata;
+
+	for (int ms = timer->ms; ms > 0; ms -= 100)
+		usleep((useconds_t)((ms < 100 ? ms : 100) * 1000));
+	gettimeofday(&timer->tv_fire, NULL);
+	work_restart[timer->thr_id].restart = 1;
+	return NULL;
+}
+
+// Header mit festem Muster, Target 0: die Messung findet keine Shares
+static void autotune_work(struct work *work, const struct algo_traits *algo)
+{
+	memset(work, 0, sizeof(*work));
+	for (int i = 0; i < 19; i++)
+		work->data[i] = 0x9e3779b9U * (i + 1);
+	work->data[20] = 0x80000000;
+	work->data[31] = algo->hdr_bits;
+	if (algo->vote)
+		work->maxvote = 1024;
+}
+
+// scannt, bis der Timer den Restart setzt; false wenn scanhash schon
+// vorher aufgehoert hat (Init fehlgeschlagen, Restart vom Pool)
+static bool autotune_trial(struct device_ctx *ctx, const struct algo_traits *algo, struct work *work,
+	int ms, struct autotune_result *res)
+{
+	struct autotune_timer timer;
+	struct timeval tv_start, tv_end;
+	unsigned long hashes_done, total = 0;
+	pthread_t pth;
+
+	timer.thr_id = ctx->thr_id;
+	timer.ms = ms;
+	work_restart[ctx->thr_id].restart = 0;
+	work->data[19] = 0;
+
+	gettimeofday(&tv_start, NULL);
+	if (pthread_create(&pth, NULL, autotune_timer_thread, &timer))
+		return false;
+	do {
+		// kehrt bei einem Kandidaten (--benchmark Target) frueher zurueck
+		hashes_done = 0;
+		algo->scanhash(ctx, work, 0xfffff000U, &hashes_done);
+		total += hashes_done;
+		work->data[19]++;
+	} while (ctx->init && !work_restart[ctx->thr_id].restart);
+	gettimeofday(&tv_end, NULL);
+	pthread_join(pth, NULL);
+	work_restart[ctx->thr_id].restart = 0;
+
+	if (!ctx->init || !total || autotune_ms(&tv_end, &timer.tv_fire) < 0.0)
+		return false;
+
+	// der Restart trifft den Batch irgendwo, schlimmstenfalls wartet er
+	// den ganzen ab (mit Pipeline auch mehr, das zeigt die Messung)
+	res->batch = ctx->batch;
+	res->rate = total / (1e-3 * autotune_ms(&tv_end, &tv_start));
+	res->latency = autotune_ms(&tv_end, &timer.tv_fire);
+	if (res->latency < 1e3 * res->batch / res->rate)
+		res->latency = 1e3 * res->batch / res->rate;
+	return true;
+}
+
+static bool autotune_sweep(struct device_ctx *ctx, const struct algo_traits *algo, struct autotune_result *best)
+{
+	struct autotune_result res[AUTOTUNE_MAX_INTENSITY - AUTOTUNE_MIN_INTENSITY + 1];
+	struct work work, *cur_work = ctx->cur_work;
+	const struct autotune_result *sel = NULL;
+	double top = 0.0;
+	int n = 0, i;
+
+	autotune_work(&work, algo);
+	// ohne cur_work verwirft submit_nonce() die Kandidaten der Messung
+	ctx->cur_work = NULL;
+
+	// absteigend: das erste Init legt die Puffer fuer den groessten Batch
+	// an, die kleineren laufen ohne neues Init darin
+	for (int intensity = AUTOTUNE_MAX_INTENSITY; intensity >= AUTOTUNE_MIN_INTENSITY; intensity--)
+	{
+		struct autotune_result *r = &res[n];
+		bool ok = false;
+
+		ctx->intensity = intensity;
+		if (!ctx->init)
+			autotune_trial(ctx, algo, &work, AUTOTUNE_WARMUP_MS, r);
+		for (i = 0; ctx->init && !ok && i < AUTOTUNE_RETRIES; i++)
+			ok = autotune_trial(ctx, algo, &work, AUTOTUNE_TRIAL_MS, r);
+
+		if (!ctx->init) {
+			// zu gross fuer das Device: was der Versuch schon belegt hat
+			// freigeben, mit dem naechsten Batch neu anlegen
+			device_ctx_reset(ctx);
+			continue;
+		}
+		// vom Backend auf denselben Batch begrenzt
+		if (!ok || (n > 0 && r->batch == res[n - 1].batch))
+			continue;
+
+		r->intensity = intensity;
+		applog(LOG_INFO, "GPU #%d: %s batch %d: %.2f khash/s, job switch %.1f ms",
+			ctx->thr_id, algo->name, r->batch, 1e-3 * r->rate, r->latency);
+		n++;
+	}
+	ctx->cur_work = cur_work;
+	if (!n)
+		return false;
+
+	// die schnellste innerhalb der Latenzgrenze, bei gleicher Hashrate die
+	// mit dem kuerzeren Jobwechsel; passt keine, die mit dem kuerzesten
+	for (i = 0; i < n; i++)
+		if (res[i].latency <= opt_tune_latency && res[i].rate > top)
+			top = res[i].rate;
+	for (i = 0; i < n; i++) {
+		if (top > 0.0 && (res[i].latency > opt_tune_latency || res[i].rate < (1.0 - AUTOTUNE_TOLERANCE) * top))
+			continue;
+		if (!sel || res[i].latency < sel->latency)
+			sel = &res[i];
+	}
+	*best = *sel;
+	return true;
+}
+
+static json_t *autotune_load(const char *path)
+{
+	json_error_t err;
+	json_t *root;
+
+#if JANSSON_VERSION_HEX >= 0x020000
+	root = json_load_file(path, 0, &err);
+#else
+	root = json_load_file(path, &err);
+#endif
+	if (!json_is_object(root)) {
+		if (root)
+			json_decref(root);
+		root = json_object();
+	}
+	return root;
+}
+
+void autotune_device(struct device_ctx *ctx, const struct algo_traits *algo)
+{
+	const char *path = opt_tune_cache ? opt_tune_cache : AUTOTUNE_CACHE;
+	struct autotune_result best;
+	json_t *root, *dev, *entry;
+	bool cached;
+	char key[256];
+
+	snprintf(key, sizeof(key), "%s/%s %d", ctx->name ? ctx->name : "unknown", ctx->backend->name,
+		(ctx->backend == &cuda_backend) ? cuda_driver_version() : 0);
+	key[sizeof(key) - 1] = '\0';
+
+	pthread_mutex_lock(&autotune_lock);
+	root = autotune_load(path);
+	entry = json_object_get(json_object_get(root, key), algo->name);
+	cached = json_is_object(entry);
+	if (cached) {
+		int intensity = json_integer_value(json_object_get(entry, "intensity"));
+
+		if (intensity > AUTOTUNE_MAX_INTENSITY)
+			intensity = AUTOTUNE_MAX_INTENSITY;
+		if (intensity < AUTOTUNE_MIN_INTENSITY)
+			intensity = AUTOTUNE_MIN_INTENSITY;
+		ctx->intensity = intensity;
+		applog(LOG_INFO, "GPU #%d: %s intensity %d from %s", ctx->thr_id, algo->name, intensity, path);
+	}
+	json_decref(root);
+	pthread_mutex_unlock(&autotune_lock);
+
+	if (cached || !opt_autotune)
+		return;
+
+	applog(LOG_INFO, "GPU #%d: tuning %s batch size", ctx->thr_id, algo->name);
+	if (!autotune_sweep(ctx, algo, &best)) {
+		applog(LOG_WARNING, "GPU #%d: tuning %s failed, using the default batch", ctx->thr_id, algo->name);
+		ctx->intensity = 0;
+		return;
+	}
+	ctx->intensity = best.intensity;
+	applog(LOG_INFO, "GPU #%d: %s intensity %d, batch %d", ctx->thr_id, algo->name,
+		best.intensity, best.batch);
+
+	// neu laden, damit die Ergebnisse der anderen Devices erhalten bleiben
+	pthread_mutex_lock(&autotune_lock);
+	root = autotune_load(path);
+	dev = json_object_get(root, key);
+	if (!json_is_object(dev)) {
+		dev = json_object();
+		json_object_set_new(root, key, dev);
+	}
+	entry = json_object();
+	json_object_set_new(entry, "intensity", json_integer(best.intensity));
+	json_object_set_new(entry, "batch", json_integer(best.batch));
+	json_object_set_new(entry, "khash", json_real(1e-3 * best.rate));
+	json_object_set_new(entry, "latency", json_real(best.latency));
+	json_object_set_new(dev, algo->name, entry);
+	if (json_dump_file(root, path, JSON_INDENT(2)) < 0)
+		applog(LOG_ERR, "failed to write the tune cache %s", path);
+	json_decref(root);
+	pthread_mutex_unlock(&autotune_lock);
+}
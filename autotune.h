@@ -0,0 +1,28 @@
+#ifndef __AUTOTUNE_H__
+#define __AUTOTUNE_H__
+
+#include "algos.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* intensities the tuner sweeps, the batch is the algorithm default
+ * shifted by the intensity, see device_throughput() */
+#define AUTOTUNE_MAX_INTENSITY 1
+#define AUTOTUNE_MIN_INTENSITY (-3)
+
+extern bool opt_autotune;
+extern char *opt_tune_cache;
+extern int opt_tune_latency;
+
+/* sets ctx->intensity from the tune cache; with --autotune a device and
+ * algorithm without an entry is measured and the result is stored. Runs in
+ * the miner thread before its first scanhash */
+extern void autotune_device(struct device_ctx *ctx, const struct algo_traits *algo);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __AUTOTUNE_H__ */
@@ -0,0 +1,652 @@
+//
+// Offline Benchmark (--benchmark, --bench-cpu)
+//
+// Gemessen wird in Versuchen fester Dauer (--bench-time) oder, bei den CPU
+// Primitiven, fester Zahl von Aufrufen (--bench-iters), nach einer
+// Aufwaermzeit (--bench-warmup). Jeder Versuch ergibt eine Rate, berichtet
+// werden alle Raten mit Mittelwert, Standardabweichung, Minimum und Maximum
+// als JSON, damit Versionen gegeneinander verglichen werden koennen.
+//
+// --benchmark misst die laufenden Miner-Threads ueber ihre Hash-Zaehler
+// (hashmeter), die Threads rechnen dabei wie sonst auf der festen Arbeit
+// aus get_work(). --bench-cpu ruft die Primitive einzeln im Haupt-Thread
+// auf: jeden sph Hash ueber 64 Byte, die verketteten CPU Hashes aus
+// algo_table, SHA-256d, scrypt, die Merkle-Wurzel eines Stratum-Jobs und
+// die Hex-Umwandlung.
+//
+// --bench-getwork misst den HTTP-Weg des Miners (json_rpc_call, curl)
+// gegen die URL aus -o, gedacht fuer --getwork-sim: getwork Abrufe pro s,
+// Einreichungen pro s (dieselbe Arbeit immer wieder, der Server lehnt sie
+// mit X-Reject-Reason ab, gemessen wird der Weg, nicht die Share) und die
+// Zeit vom Absenden einer Longpoll-Antwort ("sent" im Ergebnis, derselbe
+// Rechner) bis der Miner sie hat, ein Versuch je neuem Job.
+//
+// Mit --bench-baseline wird der Bericht mit einem frueheren verglichen,
+// Ergebnis fuer Ergebnis ueber den Namen. Faellt ein Mittelwert um mehr als
+// --bench-threshold Prozent, ist das eine Regression und der Lauf endet mit
+// Fehler, so kann ein Build-Skript --selftest und die Messung zusammen
+// pruefen.
+//
+
+extern "C"
+{
+#include "sph/sph_blake.h"
+#include "sph/sph_bmw.h"
+#include "sph/sph_groestl.h"
+#include "sph/sph_skein.h"
+#include "sph/sph_jh.h"
+#include "sph/sph_keccak.h"
+#include "sph/sph_luffa.h"
+#include "sph/sph_cubehash.h"
+#include "sph/sph_shavite.h"
+#include "sph/sph_simd.h"
+#include "sph/sph_echo.h"
+#include "sph/sph_hamsi.h"
+#include "sph/sph_fugue.h"
+}
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "miner.h"
+#include "algos.h"
+#include "device_backend.h"
+#include "hashmeter.h"
+#include "bench.h"
+
+// Vorgaben, wenn --bench-time und --bench-warmup fehlen: die Devices
+// brauchen ein paar Batches, bis Takt und Zaehler stehen
+#define BENCH_DEVICE_TIME 10.0
+#define BENCH_DEVICE_WARMUP 5.0
+#define BENCH_CPU_TIME 0.5
+#define BENCH_CPU_WARMUP 0.1
+#define BENCH_GETWORK_TIME 2.0
+#define BENCH_GETWORK_WARMUP 0.5
+#define BENCH_MAX_TRIALS 100
+// ein Block von Aufrufen zwischen zwei Blicken auf die Uhr dauert so lang
+#define BENCH_CHUNK_S 1e-3
+#define BENCH_BRANCHES 12
+#define BENCH_COINBASE 110
+
+double opt_bench_time = 0.0;
+int opt_bench_iters = 0;
+double opt_bench_warmup = -1.0;
+int opt_bench_trials = 5;
+char *opt_bench_json = NULL;
+char *opt_bench_cpu = NULL;
+char *opt_bench_baseline = NULL;
+double opt_bench_threshold = 10.0;
+
+// ein Aufruf auf buf (64 Worte, der Header in den ersten 20), n zaehlt die
+// Aufrufe; gibt die gerechneten Hashes bzw. Operationen zurueck
+typedef unsigned long (*bench_fn)(uint32_t *buf, uint32_t n, int arg);
+
+struct bench_primitive {
+	char name[32];
+	const char *group;
+	const char *unit;
+	int bytes;		// Eingabe pro Operation
+	bench_fn run;
+	int arg;
+};
+
+static double bench_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+static void bench_sleep(double s)
+{
+	// usleep() nimmt nicht ueberall mehr als 1 s
+	for (double end = bench_now() + s, left = s; left > 0.0; left = end - bench_now())
+		usleep((useconds_t)(1e6 * (left < 1.0 ? left : 1.0)));
+}
+
+// 64 Byte rein, 64 Byte raus, das Ergebnis ist die naechste Eingabe
+template <typename T, void (*init)(void *), void (*update)(void *, const void *, size_t), void (*close)(void *, void *)>
+static unsigned long bench_sph(uint32_t *buf, uint32_t n, int arg)
+{
+	T ctx;
+
+	init(&ctx);
+	update(&ctx, buf, 64);
+	close(&ctx, buf);
+	return 1;
+}
+
+#define BENCH_SPH(name) \
+	{ #name, "sph", "hash/s", 64, bench_sph<sph_##name##_context, sph_##name##_init, sph_##name, sph_##name##_close>, 0 }
+
+static unsigned long bench_algo(uint32_t *buf, uint32_t n, int arg)
+{
+	buf[19] = n;
+	algo_table[arg].hash(buf + 40, buf);
+	return 1;
+}
+
+static unsigned long bench_sha256d(uint32_t *buf, uint32_t n, int arg)
+{
+	buf[19] = n;
+	sha256d((unsigned char *)(buf + 40), (const unsigned char *)buf, 80);
+	return 1;
+}
+
+static unsigned long bench_scrypt(uint32_t *buf, uint32_t n, int arg)
+{
+	static unsigned char *scratchbuf;
+	static const uint32_t target[8] = { 0 };
+	unsigned long done = 0;
+	uint32_t data[32];
+
+	if (!scratchbuf && !(scratchbuf = scrypt_buffer_alloc()))
+		return 0;
+	memcpy(data, buf, sizeof(data));
+	data[19] = 1 + (n & 0xffffff);
+	// max_nonce = Startnonce: genau eine Runde ueber alle Lanes, und
+	// work_restart wird dabei nicht gelesen
+	scanhash_scrypt(0, data, scratchbuf, target, data[19], &done);
+	return done;
+}
+
+static unsigned long bench_merkle(uint32_t *buf, uint32_t n, int arg)
+{
+	static unsigned char branch[BENCH_BRANCHES][32], *branches[BENCH_BRANCHES];
+	unsigned char coinbase[BENCH_COINBASE];
+
+	if (!branches[0])
+		for (int i = 0; i < BENCH_BRANCHES; i++)
+		{
+			memset(branch[i], 0x11 * (i + 1), 32);
+			branches[i] = branch[i];
+		}
+	memset(coinbase, 0x5a, sizeof(coinbase));
+	memcpy(coinbase + 42, &n, sizeof(n));	// extranonce2
+	algo_merkle_root(MERKLE_SHA256D, (unsigned char *)(buf + 40), coinbase, sizeof(coinbase),
+		branches, BENCH_BRANCHES);
+	return 1;
+}
+
+static unsigned long bench_bin2hex(uint32_t *buf, uint32_t n, int arg)
+{
+	char *s = bin2hex((const unsigned char *)buf, 80);
+
+	if (!s)
+		return 0;
+	buf[40] += (unsigned char)s[n % 160];
+	free(s);
+	return 1;
+}
+
+static unsigned long bench_hex2bin(uint32_t *buf, uint32_t n, int arg)
+{
+	static char hex[161];
+
+	if (!hex[0])
+		for (int i = 0; i < 160; i++)
+			hex[i] = "0123456789abcdef"[(i * 7) & 15];
+	return hex2bin((unsigned char *)(buf + 40), hex, 80) ? 1 : 0;
+}
+
+static const struct bench_primitive bench_fixed[] = {
+	BENCH_SPH(blake512),
+	BENCH_SPH(bmw512),
+	BENCH_SPH(groestl512),
+	BENCH_SPH(jh512),
+	BENCH_SPH(keccak512),
+	BENCH_SPH(skein512),
+	BENCH_SPH(luffa512),
+	BENCH_SPH(cubehash512),
+	BENCH_SPH(shavite512),
+	BENCH_SPH(simd512),
+	BENCH_SPH(echo512),
+	BENCH_SPH(hamsi512),
+	BENCH_SPH(fugue512),
+	{ "sha256d", "sha256d", "hash/s", 80, bench_sha256d, 0 },
+	{ "scrypt", "scrypt", "hash/s", 80, bench_scrypt, 0 },
+	{ "merkle", "merkle", "root/s", BENCH_COINBASE + 32 * BENCH_BRANCHES, bench_merkle, 0 },
+	{ "bin2hex", "hex", "op/s", 80, bench_bin2hex, 0 },
+	{ "hex2bin", "hex", "op/s", 160, bench_hex2bin, 0 },
+};
+
+#define BENCH_FIXED (int)(sizeof(bench_fixed) / sizeof(bench_fixed[0]))
+#define BENCH_PRIMITIVES (BENCH_FIXED + ALGO_COUNT)
+
+// die festen Primitive und ein Eintrag pro Algorithmus aus algo_table
+static int bench_table(struct bench_primitive *table)
+{
+	int n = 0;
+
+	for (int i = 0; i < BENCH_FIXED; i++)
+		table[n++] = bench_fixed[i];
+	for (int i = 0; i < ALGO_COUNT; i++)
+	{
+		struct bench_primitive *p = &table[n++];
+
+		snprintf(p->name, sizeof(p->name), "%s", algo_table[i].name);
+		p->group = "algo";
+		p->unit = "hash/s";
+		p->bytes = algo_table[i].blocklen;
+		p->run = bench_algo;
+		p->arg = i;
+	}
+	return n;
+}
+
+// "all", Namen und Gruppen durch Komma getrennt
+static bool bench_select(const struct bench_primitive *table, int n, const char *list, bool *selected)
+{
+	char *copy = strdup(list);
+	bool ok = true;
+
+	memset(selected, 0, n * sizeof(bool));
+	for (char *tok = strtok(copy, ","); tok; tok = strtok(NULL, ","))
+	{
+		bool found = false;
+
+		for (int i = 0; i < n; i++)
+			if (!strcmp(tok, "all") || !strcmp(tok, table[i].name) || !strcmp(tok, table[i].group))
+				selected[i] = found = true;
+		if (!found) {
+			applog(LOG_ERR, "unknown benchmark '%s'", tok);
+			ok = false;
+		}
+	}
+	free(copy);
+
+	if (!ok) {
+		char names[1024] = "all";
+
+		for (int i = 0; i < n; i++)
+		{
+			if (i == 0 || strcmp(table[i].group, table[i - 1].group))
+				snprintf(names + strlen(names), sizeof(names) - strlen(names), ", %s:", table[i].group);
+			snprintf(names + strlen(names), sizeof(names) - strlen(names), " %s", table[i].name);
+		}
+		applog(LOG_ERR, "benchmarks: %s", names);
+	}
+	return ok;
+}
+
+// eine Rate: feste Zahl von Aufrufen, sonst Bloecke bis die Zeit um ist
+static double bench_trial(const struct bench_primitive *p, uint32_t *buf, uint32_t *n, double seconds, int iters)
+{
+	double start = bench_now(), elapsed;
+	unsigned long long ops = 0;
+
+	if (iters > 0) {
+		for (int i = 0; i < iters; i++)
+			ops += p->run(buf, (*n)++, p->arg);
+		elapsed = bench_now() - start;
+	} else {
+		unsigned long chunk = 1;
+
+		do {
+			double t = bench_now(), end;
+
+			for (unsigned long i = 0; i < chunk; i++)
+				ops += p->run(buf, (*n)++, p->arg);
+			end = bench_now();
+			if (end - t < BENCH_CHUNK_S)
+				chunk *= 2;
+			elapsed = end - start;
+		} while (elapsed < seconds);
+	}
+	return elapsed > 0.0 ? ops / elapsed : 0.0;
+}
+
+static json_t *bench_result(const char *name, const char *unit, const double *rates, int n)
+{
+	json_t *obj = json_object(), *samples = json_array();
+	double sum = 0.0, var = 0.0, lo = rates[0], hi = rates[0], mean;
+
+	for (int t = 0; t < n; t++)
+	{
+		sum += rates[t];
+		lo = (rates[t] < lo) ? rates[t] : lo;
+		hi = (rates[t] > hi) ? rates[t] : hi;
+		json_array_append_new(samples, json_real(rates[t]));
+	}
+	mean = sum / n;
+	for (int t = 0; t < n; t++)
+		var += (rates[t] - mean) * (rates[t] - mean);
+
+	json_object_set_new(obj, "name", json_string(name));
+	json_object_set_new(obj, "unit", json_string(unit));
+	json_object_set_new(obj, "mean", json_real(mean));
+	json_object_set_new(obj, "stddev", json_real(n > 1 ? sqrt(var / (n - 1)) : 0.0));
+	json_object_set_new(obj, "min", json_real(lo));
+	json_object_set_new(obj, "max", json_real(hi));
+	json_object_set_new(obj, "samples", samples);
+	return obj;
+}
+
+static json_t *bench_report(const char *mode, const char *version, double warmup, double seconds, int iters)
+{
+	json_t *report = json_object();
+
+	json_object_set_new(report, "ccminer", json_string(version));
+	json_object_set_new(report, "mode", json_string(mode));
+	json_object_set_new(report, "time", json_integer((int)time(NULL)));
+	json_object_set_new(report, "warmup", json_real(warmup));
+	if (iters > 0)
+		json_object_set_new(report, "trial_iterations", json_integer(iters));
+	else
+		json_object_set_new(report, "trial_seconds", json_real(seconds));
+	json_object_set_new(report, "trials", json_integer(opt_bench_trials));
+	return report;
+}
+
+extern "C" json_t *bench_devices(struct device_ctx **devices, int n, const char *algo, const char *version)
+{
+	static double rates[MAX_GPUS + 1][BENCH_MAX_TRIALS];
+	double seconds = (opt_bench_time > 0.0) ? opt_bench_time : BENCH_DEVICE_TIME;
+	double warmup = (opt_bench_warmup >= 0.0) ? opt_bench_warmup : BENCH_DEVICE_WARMUP;
+	json_t *report, *results;
+
+	if (n > MAX_GPUS)
+		n = MAX_GPUS;
+	applog(LOG_NOTICE, "benchmark: %g s warmup, %d trials of %g s", warmup, opt_bench_trials, seconds);
+	bench_sleep(warmup);
+
+	for (int t = 0; t < opt_bench_trials; t++)
+	{
+		long long start[MAX_GPUS];
+		double t0, dt, total = 0.0;
+
+		t0 = bench_now();
+		for (int i = 0; i < n; i++)
+			start[i] = hashmeter_hashes(i);
+		bench_sleep(seconds);
+		dt = bench_now() - t0;
+		for (int i = 0; i < n; i++)
+		{
+			rates[i][t] = (hashmeter_hashes(i) - start[i]) / dt;
+			total += rates[i][t];
+		}
+		rates[n][t] = total;
+		applog(LOG_INFO, "benchmark trial %d/%d: %.2f khash/s", t + 1, opt_bench_trials, 1e-3 * total);
+	}
+
+	report = bench_report("devices", version, warmup, seconds, 0);
+	json_object_set_new(report, "algo", json_string(algo));
+	results = json_array();
+	for (int i = 0; i < n; i++)
+	{
+		const struct device_ctx *ctx = devices[i];
+		json_t *obj;
+		char name[16];
+
+		sprintf(name, "gpu%d", i);
+		obj = bench_result(name, "hash/s", rates[i], opt_bench_trials);
+		json_object_set_new(obj, "device", json_integer(ctx->device_id));
+		json_object_set_new(obj, "device_name", json_string(ctx->name ? ctx->name : ""));
+		json_object_set_new(obj, "backend", json_string(ctx->backend->name));
+		json_object_set_new(obj, "batch", json_integer(ctx->batch));
+		json_array_append_new(results, obj);
+	}
+	json_array_append_new(results, bench_result("total", "hash/s", rates[n], opt_bench_trials));
+	json_object_set_new(report, "results", results);
+	return report;
+}
+
+extern "C" json_t *bench_primitives(const char *version)
+{
+	static struct bench_primitive table[BENCH_PRIMITIVES];
+	bool selected[BENCH_PRIMITIVES];
+	double rates[BENCH_MAX_TRIALS];
+	double seconds = (opt_bench_time > 0.0) ? opt_bench_time : BENCH_CPU_TIME;
+	double warmup = (opt_bench_warmup >= 0.0) ? opt_bench_warmup : BENCH_CPU_WARMUP;
+	uint32_t buf[64];
+	json_t *report, *results;
+	int n = bench_table(table);
+
+	if (!bench_select(table, n, opt_bench_cpu, selected))
+		return NULL;
+
+	report = bench_report("cpu", version, warmup, seconds, opt_bench_iters);
+	results = json_array();
+	for (int i = 0; i < n; i++)
+	{
+		const struct bench_primitive *p = &table[i];
+		uint32_t count = 0;
+		json_t *obj;
+
+		if (!selected[i])
+			continue;
+		// jedes Primitiv auf demselben Header, wie get_work() ihn baut
+		for (int k = 0; k < 64; k++)
+			buf[k] = (k < 19) ? 0x55555555 : 0;
+		buf[20] = 0x80000000;
+		buf[31] = 0x00000280;
+
+		if (warmup > 0.0)
+			bench_trial(p, buf, &count, warmup, 0);
+		for (int t = 0; t < opt_bench_trials; t++)
+			rates[t] = bench_trial(p, buf, &count, seconds, opt_bench_iters);
+
+		obj = bench_result(p->name, p->unit, rates, opt_bench_trials);
+		json_object_set_new(obj, "group", json_string(p->group));
+		json_object_set_new(obj, "bytes", json_integer(p->bytes));
+		json_array_append_new(results, obj);
+		applog(LOG_INFO, "%-12s %14.1f %s", p->name, json_real_value(json_object_get(obj, "mean")), p->unit);
+	}
+	json_object_set_new(report, "results", results);
+	return report;
+}
+
+// Aufrufe pro s einer Anfrage, feste Zahl oder bis die Zeit um ist
+static double bench_http(CURL *curl, const char *url, const char *userpass, const char *req,
+	double seconds, int iters)
+{
+	double start = bench_now(), elapsed;
+	long calls = 0, failed = 0;
+
+	do {
+		json_t *val = json_rpc_call(curl, url, userpass, req, false, false, NULL);
+
+		if (val) {
+			json_decref(val);
+			calls++;
+		} else
+			failed++;
+		elapsed = bench_now() - start;
+	} while ((iters > 0) ? calls + failed < iters : elapsed < seconds);
+
+	if (failed)
+		applog(LOG_WARNING, "benchmark: %ld of %ld requests failed", failed, calls + failed);
+	return elapsed > 0.0 ? calls / elapsed : 0.0;
+}
+
+// URL fuer X-Long-Polling, wie im longpoll_thread
+static char *bench_lp_url(const char *url, const char *path)
+{
+	char *lp_url;
+
+	if (strstr(path, "://"))
+		return strdup(path);
+	if (*path == '/')
+		path++;
+	lp_url = (char *)malloc(strlen(url) + strlen(path) + 2);
+	sprintf(lp_url, "%s%s%s", url, url[strlen(url) - 1] == '/' ? "" : "/", path);
+	return lp_url;
+}
+
+extern "C" json_t *bench_getwork(const char *url, const char *userpass, const char *version)
+{
+	static const char *getwork_req = "{\"method\": \"getwork\", \"params\": [], \"id\":0}\r\n";
+	double fetch[BENCH_MAX_TRIALS], submit[BENCH_MAX_TRIALS], wakeup[BENCH_MAX_TRIALS];
+	double seconds = (opt_bench_time > 0.0) ? opt_bench_time : BENCH_GETWORK_TIME;
+	double warmup = (opt_bench_warmup >= 0.0) ? opt_bench_warmup : BENCH_GETWORK_WARMUP;
+	CURL *curl = curl_easy_init();
+	const char *data, *lp_path;
+	char *submit_req, *lp_url = NULL;
+	json_t *val, *report, *results;
+	int wakeups = 0;
+
+	if (!curl)
+		return NULL;
+	// die erste Arbeit liefert die Daten zum Einreichen und den Longpoll-Pfad
+	val = json_rpc_call(curl, url, userpass, getwork_req, false, false, NULL);
+	data = json_string_value(json_object_get(json_object_get(val, "result"), "data"));
+	if (!data) {
+		applog(LOG_ERR, "benchmark: no getwork from %s", url);
+		if (val)
+			json_decref(val);
+		curl_easy_cleanup(curl);
+		return NULL;
+	}
+	submit_req = (char *)malloc(strlen(data) + 64);
+	sprintf(submit_req, "{\"method\": \"getwork\", \"params\": [ \"%s\" ], \"id\":1}\r\n", data);
+	lp_path = json_string_value(json_object_get(val, "longpoll-path"));
+	if (lp_path)
+		lp_url = bench_lp_url(url, lp_path);
+	json_decref(val);
+
+	applog(LOG_NOTICE, "benchmark: %g s warmup, %d trials of %g s", warmup, opt_bench_trials, seconds);
+	if (warmup > 0.0)
+		bench_http(curl, url, userpass, getwork_req, warmup, 0);
+	for (int t = 0; t < opt_bench_trials; t++)
+		fetch[t] = bench_http(curl, url, userpass, getwork_req, seconds, opt_bench_iters);
+	applog(LOG_INFO, "getwork %14.1f call/s", fetch[opt_bench_trials - 1]);
+	for (int t = 0; t < opt_bench_trials; t++)
+		submit[t] = bench_http(curl, url, userpass, submit_req, seconds, opt_bench_iters);
+	applog(LOG_INFO, "submit  %14.1f call/s", submit[opt_bench_trials - 1]);
+
+	// jeder Versuch wartet auf den naechsten Job des Servers
+	for (int t = 0; lp_url && t < opt_bench_trials; t++)
+	{
+		json_t *sent;
+
+		val = json_rpc_call(curl, lp_url, userpass, getwork_req, false, true, NULL);
+		sent = json_object_get(json_object_get(val, "result"), "sent");
+		if (sent)
+			wakeup[wakeups++] = 1e3 * (bench_now() - json_number_value(sent));
+		if (val)
+			json_decref(val);
+		else
+			break;
+	}
+	if (!lp_url)
+		applog(LOG_WARNING, "benchmark: %s sends no X-Long-Polling", url);
+	else if (wakeups)
+		applog(LOG_INFO, "longpoll %13.1f ms", wakeup[wakeups - 1]);
+
+	report = bench_report("getwork", version, warmup, seconds, opt_bench_iters);
+	json_object_set_new(report, "url", json_string(url));
+	results = json_array();
+	json_array_append_new(results, bench_result("getwork", "call/s", fetch, opt_bench_trials));
+	json_array_append_new(results, bench_result("submit", "call/s", submit, opt_bench_trials));
+	if (wakeups)
+		json_array_append_new(results, bench_result("longpoll_wakeup", "ms", wakeup, wakeups));
+	json_object_set_new(report, "results", results);
+
+	free(submit_req);
+	free(lp_url);
+	curl_easy_cleanup(curl);
+	return report;
+}
+
+extern "C" bool bench_write(json_t *report)
+{
+	FILE *f = opt_bench_json ? fopen(opt_bench_json, "w") : stdout;
+	bool ok;
+
+	if (!f) {
+		applog(LOG_ERR, "benchmark: cannot write %s", opt_bench_json);
+		json_decref(report);
+		return false;
+	}
+	ok = !json_dumpf(report, f, JSON_INDENT(2) | JSON_PRESERVE_ORDER);
+	fputc('\n', f);
+	if (f != stdout)
+		ok = !fclose(f) && ok;
+	else
+		fflush(f);
+	json_decref(report);
+	return ok;
+}
+
+static json_t *bench_load(const char *path)
+{
+	json_error_t err;
+	json_t *root;
+
+#if JANSSON_VERSION_HEX >= 0x020000
+	root = json_load_file(path, 0, &err);
+#else
+	root = json_load_file(path, &err);
+#endif
+	if (!json_is_object(root) || !json_is_array(json_object_get(root, "results"))) {
+		if (root)
+			json_decref(root);
+		return NULL;
+	}
+	return root;
+}
+
+extern "C" bool bench_compare(const json_t *report)
+{
+	json_t *base = bench_load(opt_bench_baseline), *results, *old;
+	const char *mode, *base_mode;
+	int regressions = 0, compared = 0;
+
+	if (!base) {
+		applog(LOG_ERR, "benchmark: cannot read the baseline %s", opt_bench_baseline);
+		return false;
+	}
+	mode = json_string_value(json_object_get(report, "mode"));
+	base_mode = json_string_value(json_object_get(base, "mode"));
+	if (!mode || !base_mode || strcmp(mode, base_mode)) {
+		applog(LOG_ERR, "benchmark: %s is a %s baseline", opt_bench_baseline, base_mode ? base_mode : "unknown");
+		json_decref(base);
+		return false;
+	}
+
+	results = json_object_get(report, "results");
+	old = json_object_get(base, "results");
+	for (unsigned int i = 0; i < json_array_size(results); i++)
+	{
+		json_t *r = json_array_get(results, i);
+		const char *name = json_string_value(json_object_get(r, "name"));
+		const char *unit = json_string_value(json_object_get(r, "unit"));
+		double mean = json_real_value(json_object_get(r, "mean")), before = 0.0, change;
+
+		for (unsigned int k = 0; k < json_array_size(old); k++)
+		{
+			json_t *o = json_array_get(old, k);
+			const char *old_name = json_string_value(json_object_get(o, "name"));
+
+			if (name && old_name && !strcmp(name, old_name))
+				before = json_real_value(json_object_get(o, "mean"));
+		}
+		if (before <= 0.0)
+			continue;
+
+		compared++;
+		change = 100.0 * (mean - before) / before;
+		// bei Zeiten ist weniger besser
+		if (unit && !strcmp(unit, "ms"))
+			change = -change;
+		if (change < -opt_bench_threshold) {
+			applog(LOG_ERR, "benchmark: %s regressed %.1f%% (%.1f, baseline %.1f)", name, -change, mean, before);
+			regressions++;
+		} else if (opt_debug)
+			applog(LOG_DEBUG, "benchmark: %s %+.1f%%", name, change);
+	}
+	json_decref(base);
+
+	if (!compared)
+		applog(LOG_WARNING, "benchmark: no result of the baseline %s matches", opt_bench_baseline);
+	else if (regressions)
+		applog(LOG_ERR, "benchmark: %d of %d results regressed more than %g%%", regressions, compared, opt_bench_threshold);
+	else
+		applog(LOG_NOTICE, "benchmark: %d results within %g%% of the baseline", compared, opt_bench_threshold);
+	return !regressions;
+}
@@ -0,0 +1,55 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdbool.h>
+#include <jansson.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct device_ctx;
+
+/* s per trial, 0 = default of the mode */
+extern double opt_bench_time;
+/* calls per trial instead of a time, --bench-cpu and --bench-getwork
+ * only, 0 = off */
+extern int opt_bench_iters;
+/* s before the first trial, < 0 = default of the mode */
+extern double opt_bench_warmup;
+extern int opt_bench_trials;
+/* file for the JSON report, NULL = stdout */
+extern char *opt_bench_json;
+/* comma separated primitives or groups for --bench-cpu, NULL = off */
+extern char *opt_bench_cpu;
+/* earlier report to compare with, NULL = off */
+extern char *opt_bench_baseline;
+/* % a mean may fall below the baseline before it counts as regression */
+extern double opt_bench_threshold;
+
+/* measures the running miner threads of --benchmark through their hash
+ * counters; blocks for warmup and all trials, returns the report */
+extern json_t *bench_devices(struct device_ctx **devices, int n, const char *algo, const char *version);
+
+/* runs the CPU primitives selected by opt_bench_cpu on the calling
+ * thread, returns the report or NULL on an unknown name */
+extern json_t *bench_primitives(const char *version);
+
+/* measures getwork fetches, submits and longpoll wakeups of the miner's
+ * HTTP stack against url, meant for --getwork-sim; NULL if url serves
+ * no work */
+extern json_t *bench_getwork(const char *url, const char *userpass, const char *version);
+
+/* writes the report to opt_bench_json or stdout and frees it */
+extern bool bench_write(json_t *report);
+
+/* compares the means with the results of the same name in
+ * opt_bench_baseline; false if one regressed by more than
+ * opt_bench_threshold or the baseline cannot be read */
+extern bool bench_compare(const json_t *report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BENCH_H__ */
@@ -21,10 +21,8 @@
 #include <unistd.h>
 #include <sys/time.h>
 #include <time.h>
-#include <hw_nvidia.h>
 #ifdef WIN32
 #include <windows.h>
-#include "nvapi.h"
 #else
 #include <errno.h>
 #include <signal.h>
@@ -43,6 +41,22 @@
 #include <openssl/sha.h>
 #include "compat.h"
 #include "miner.h"
+#include "algos.h"
+#include "api.h"
+#include "autotune.h"
+#include "bench.h"
+#include "cpu_batch.h"
+#include "cuda_sync.h"
+#include "device_backend.h"
+#include "hashmeter.h"
+#include "logring.h"
+#include "metrics.h"
+#include "hwmon.h"
+#include "poolsim.h"
+#include "profile.h"
+#include "selftest.h"
+#include "telemetry.h"
+#include "thermal.h"
 
 #ifdef WIN32
 #include <Mmsystem.h>
@@ -53,11 +67,6 @@
 #define PROGRAM_VERSION	"1.2"
 #define	PROGRAM_VERSION_SPLIT_SCREEN "1.2.7"
 #define LP_SCANTIME		60
-#define HEAVYCOIN_BLKHDR_SZ		84
-#define MNR_BLKHDR_SZ 80
-#define AVERAGE_COUNT 50
-#define MAX_GPU_TEMP 64
-#define ABNORMAL_DATA 1000000
 // from heavy.cu
 #ifdef __cplusplus
 extern "C"
@@ -67,6 +76,8 @@ int cuda_num_devices();
 void cuda_bus_ids();
 void cuda_devicenames();
 int cuda_finddevice(char *name);
+// from quark/cuda_quark_compactionTest.cu
+int compaction_selftest(int device);
 #ifdef __cplusplus
 }
 #endif
@@ -132,39 +143,14 @@ struct workio_cmd {
 	} u;
 };
 
-typedef enum {
-	ALGO_HEAVY,		/* Heavycoin hash */
-	ALGO_MJOLLNIR,		/* Mjollnir hash */
-	ALGO_FUGUE256,		/* Fugue256 */
-	ALGO_GROESTL,
-	ALGO_MYR_GR,
-	ALGO_JACKPOT,
-	ALGO_QUARK,
-	ALGO_ANIME,
-	ALGO_NIST5,
-	ALGO_X11,
-	ALGO_X13,
-	ALGO_DMD_GR
-} sha256_algos;
-
-static const char *algo_names[] = {
-	"heavy",
-	"mjollnir",
-	"fugue256",
-	"groestl",
-	"myr-gr",
-	"jackpot",
-	"quark",
-	"anime",
-	"nist5",
-	"x11",
-	"x13",
-	"dmd-gr"
-};
-
 bool opt_debug = false;
 bool opt_protocol = false;
 bool opt_benchmark = false;
+static bool opt_cpu_batch_bench = false;
+static bool opt_compaction_test = false;
+static bool opt_selftest = false;
+static bool opt_bench_getwork = false;
+static const struct device_backend *opt_backend = &cuda_backend;
 bool want_longpoll = true;
 bool have_longpoll = false;
 bool want_stratum = true;
@@ -182,17 +168,17 @@ static int opt_scantime = 5;
 static json_t *opt_config;
 static const bool opt_time = true;
 static sha256_algos opt_algo = ALGO_HEAVY;
+static const struct algo_traits *algo = &algo_table[ALGO_HEAVY];
 static int opt_n_threads = 0;
 static double opt_difficulty = 1; // CH
 bool opt_trust_pool = false;
 uint16_t opt_vote = 9999;
 static int num_processors;
-int device_map[8] =  {0,1,2,3,4,5,6,7}; // CB {9,9,9,9,9,9,9,9};
-int invert[8] = {0};
-int bus_ids[8] = {0};
-int device_map_invert[8] = {0,1,2,3,4,5,6,7};
-INT32 thermal_max[8] = {0};
-char *device_name[8]; // CB
+int device_map[MAX_GPUS] =  {0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31}; // CB {9,9,9,9,9,9,9,9};
+int invert[MAX_GPUS] = {0};
+int bus_ids[MAX_GPUS] = {0};
+int device_map_invert[MAX_GPUS] = {0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31};
+char *device_name[MAX_GPUS]; // CB
 char *menu_key[10] = {"","","","","","","","","F9 ShowUser","F10 Exit"};	
 //DWORD *driver_version;
 char *datetime_start_mining;
@@ -206,17 +192,25 @@ struct thr_info *thr_info;
 static int work_thr_id;
 int longpoll_thr_id = -1;
 int stratum_thr_id = -1;
+static int verify_thr_id = -1;
+static int opt_verify_threads = 1;
 struct work_restart *work_restart = NULL;
 static struct stratum_ctx stratum;
 
-pthread_mutex_t applog_lock;
 static pthread_mutex_t stats_lock;
 
 static unsigned long accepted_count = 0L;
 static unsigned long rejected_count = 0L;
-static double *thr_hashrates;
-static double thr_average_hashrates[8][AVERAGE_COUNT];
-static int thr_average_hashrates_counter[8];
+static struct device_ctx **devices;	/* one per miner thread */
+
+/* asynchronous CPU verification of the GPU results */
+struct verify_req {
+	struct work work;
+	struct device_ctx *ctx;
+	struct timeval tv_found;
+};
+
+static struct thread_q *verify_q;
 
 struct upload_buffer { const void *buf; size_t len; };
 struct MemoryStruct { char *memory; size_t size; };
@@ -238,6 +232,7 @@ int parent_x, parent_y, new_x, new_y, infoscr_x, infoscr_y;
 
 void SetWindow(int Width, int Height) 
 { 
+#ifdef WIN32
     _COORD coord; 
     coord.X = Width; 
     coord.Y = Height; 
@@ -251,6 +246,7 @@ void SetWindow(int Width, int Height)
     HANDLE Handle = GetStdHandle(STD_OUTPUT_HANDLE);      // Get Handle 
     SetConsoleScreenBufferSize(Handle, coord);            // Set Buffer Size 
     SetConsoleWindowInfo(Handle, TRUE, &Rect);            // Set Window Size 
+#endif
 } 
 
 void updatescr()
@@ -261,46 +257,24 @@ void updatescr()
 	wrefresh(info_screen);
 }
 
+/* queues a line for the log thread, which alone draws into out_screen;
+ * win and newline are kept for the callers, every line ends one. The
+ * line is LOG_INFO: errors, warnings and debug output use applog() so
+ * --headless and syslog see their level */
 int printline(WINDOW *win, bool newline, const char *fmt, ...) {
-    va_list args;
-    int retval;
-
-    va_start(args, fmt);
-		char *f;
-		int len;
-		time_t now;
-		struct tm tm, *tm_p;
-	
-		time(&now);
+	va_list args;
 
-		pthread_mutex_lock(&applog_lock);
-		tm_p = localtime(&now);
-		memcpy(&tm, tm_p, sizeof(tm));
-		pthread_mutex_unlock(&applog_lock);
-
-		len = (int)(40 + strlen(fmt) + 2);
-		f = (char*)alloca(len);
-		
-		sprintf(f, "[%d-%02d-%02d %02d:%02d:%02d] %s",
-			tm.tm_year + 1900,
-			tm.tm_mon + 1,
-			tm.tm_mday,
-			tm.tm_hour,
-			tm.tm_min,
-			tm.tm_sec,
-			fmt);
-
-		pthread_mutex_lock(&applog_lock);
-		retval = vwprintw(win, f, args);
-		if (newline)
-			wprintw(win, "\n");
-		updatescr();
-		pthread_mutex_unlock(&applog_lock);
-    va_end(args);
-	return retval;
+	va_start(args, fmt);
+	logring_vpush(LOG_INFO, fmt, args);
+	va_end(args);
+	return OK;
 }
 
 static void destroywins(void) {
+	/* what is still queued goes to the screen before it closes */
+	logring_stop();
+	if (opt_headless)
+		return;
 	delwin(info_screen);
 	delwin(out_screen);
 	delwin(menu_screen);
@@ -308,39 +282,6 @@ static void destroywins(void) {
 }
 
 
-int nvapi_init(){
-	NvDisplayHandle hDisplay_a[NVAPI_MAX_PHYSICAL_GPUS*2] = {0};
-	NvAPI_Status ret = NVAPI_OK;
-	ret = NvAPI_Initialize();
-    if(ret != NVAPI_OK)
-    {
-        printline(info_screen, true, "NvAPI_Initialize() failed = 0x%x", ret);
-		return 1; // Initialization failed
-    }
-	printline(info_screen, false, "\nDisplay Configuration Successful!\n");
-	
-	NvU32 cnt;
-	NvPhysicalGpuHandle phys;
-    ret = NvAPI_EnumPhysicalGPUs(&phys, &cnt);
-    if (!ret == NVAPI_OK){
-        NvAPI_ShortString string;
-        NvAPI_GetErrorMessage(ret, string);
-        printline(info_screen, false, "NVAPI NvAPI_EnumPhysicalGPUs: %s\n", string);
-    }
-	NV_GPU_THERMAL_SETTINGS thermal;
-    thermal.version =NV_GPU_THERMAL_SETTINGS_VER;
-    ret = NvAPI_GPU_GetThermalSettings(phys,0, &thermal);
-
-    if (!ret == NVAPI_OK){
-        NvAPI_ShortString string;
-        NvAPI_GetErrorMessage(ret, string);
-        printline(info_screen, false, "NVAPI NvAPI_GPU_GetThermalSettings: %s\n", string);
-    }
-
-   printline(info_screen, false, "Temp: %u C\n", thermal.sensor[0].currentTemp);
-    return 0;
-}
-
 void show_menu()
 {
 	if (isWorkerShow)
@@ -361,7 +302,7 @@ void start_info()
 	timestart = localtime ( &start );
 	getmaxyx(info_screen, infoscr_y, infoscr_x);
 	mvwprintw(info_screen, 0, 1, "Split Screen ccMiner %s by zelante_[ core: ccMiner %s ]_NVIDIA driver %3.2f",
-		PROGRAM_VERSION_SPLIT_SCREEN, PROGRAM_VERSION, (float)hw_nvidia_version() / 100);
+		PROGRAM_VERSION_SPLIT_SCREEN, PROGRAM_VERSION, (float)hwmon_driver_version() / 100);
 	mvwprintw(info_screen, 2, 0, "| GPU |     Full name       |   Hashrate  |Temp |   Fan   |  Core  |       Memory        |");
 	mvwprintw(info_screen, 3, 0, "|   b |                     |             |  C  |         |        |    MHz    |         |");
 	mvwprintw(info_screen, 4, 0, "| i u |                     |   khash/s   |cur/ |         |   MHz  |(controller| used MB |");
@@ -371,47 +312,37 @@ void start_info()
 int gpuinfo(int id, double dif, double balance) {
 	int ret;
 	char *s;
-	INT32 thermal_cur = 0;
-	double average_hashrate = 0;
-	ULONG cooler = 0;
+	struct hash_rates rates;
+	struct telemetry_sample hw;
 	struct thr_info *thr;
+	struct device_ctx *ctx = devices[id];
 
-	pthread_mutex_lock(&applog_lock);
-
-	if (thr_average_hashrates_counter[id] < AVERAGE_COUNT)
-		thr_average_hashrates_counter[id]++;
-	else
-		thr_average_hashrates_counter[id] = 0;
-	
-	thr_average_hashrates[id][ thr_average_hashrates_counter[id] ] = thr_hashrates[id];
-
-	for (int i=0; i<AVERAGE_COUNT; i++)
-		average_hashrate += thr_average_hashrates[id][i];
+	/* cur over 10 s, avrg over 15 min */
+	hashmeter_read(id, &rates);
 
-	average_hashrate = average_hashrate / AVERAGE_COUNT;
-
-	thermal_cur = hw_nvidia_gettemperature(invert[id]);
+	/* sensors from the telemetry thread, none behind the cpu backend */
+	if (!telemetry_read(id, &hw)) {
+		ret=mvwprintw(info_screen, id+7, 0, " #%1d    %-21s %6.0f/%-6.0f", 
+			ctx->device_id, ctx->name, rates.window[0] * 1e-3, rates.window[2] * 1e-3);
+		return ret;
+	}
 
-	if (thermal_max[invert[id]] < thermal_cur) 
-		thermal_max[invert[id]] = thermal_cur;
-	cooler = hw_nvidia_cooler(invert[id]);
-	//pthread_mutex_lock(&applog_lock);
 	ret=mvwprintw(info_screen, id+7, 0, " #%1d[%1d] %-21s %6.0f/%-6.0f %2d/%2d %4lu(%3lu) %4lu(%2lu)   %4lu(%2lu)   %4lu(%2lu)", 
-		device_map[id], 
+		ctx->device_id, 
 		invert[id]+1,
-		device_name[id],
-		thr_hashrates[id] * 1e-3,
-		average_hashrate * 1e-3,
-		thermal_cur < ABNORMAL_DATA ? thermal_cur : 0,
-		thermal_max[invert[id]] < ABNORMAL_DATA ? thermal_max[invert[id]] : 0,
-		cooler < ABNORMAL_DATA ? cooler : 0,
-		hw_nvidia_fan(invert[id]) < ABNORMAL_DATA ? hw_nvidia_fan(invert[id]) : 0,
-		hw_nvidia_clock(invert[id]) < ABNORMAL_DATA ? hw_nvidia_clock(invert[id]) : 0,
-		hw_nvidia_DynamicPstateInfoEx(invert[id]) < ABNORMAL_DATA ? hw_nvidia_DynamicPstateInfoEx(invert[id]) : 0,
-		hw_nvidia_clockMemory(invert[id]) < ABNORMAL_DATA ? hw_nvidia_clockMemory(invert[id]) : 0,
-		hw_nvidia_memory_util_prc(invert[id]) < ABNORMAL_DATA ? hw_nvidia_memory_util_prc(invert[id]) : 0,
-		hw_nvidia_memory(invert[id]) < ABNORMAL_DATA ? hw_nvidia_memory(invert[id]) : 0,
-		hw_nvidia_memory_prc(invert[id]) < ABNORMAL_DATA ? hw_nvidia_memory_prc(invert[id]) : 0
+		ctx->name,
+		rates.window[0] * 1e-3,
+		rates.window[2] * 1e-3,
+		hw.temp,
+		hw.temp_max,
+		hw.fan_rpm,
+		hw.fan,
+		hw.clock,
+		hw.load,
+		hw.clock_mem,
+		hw.load_mem,
+		hw.mem_used,
+		hw.mem_prc
 	);
 	time( &cur );
 	double num_seconds = difftime(cur, start);
@@ -422,11 +353,72 @@ int gpuinfo(int id, double dif, double balance) {
 	int minutes = remainder / 60; 
 	//int seconds = remainder % 60;
 	mvwprintw(info_screen, infoscr_y - 4, 0, " %dd %02d:%02d from start", days, hours, minutes);
-	pthread_mutex_unlock(&applog_lock);
-	updatescr();
 	return ret;
 }
 
+/* writer of the log thread for the curses screen */
+static void ui_line(int prio, time_t time, const char *line)
+{
+	struct tm tm = *localtime(&time);
+
+	wprintw(out_screen, "[%d-%02d-%02d %02d:%02d:%02d] %s\n",
+		tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+		tm.tm_hour, tm.tm_min, tm.tm_sec, line);
+#ifdef HAVE_SYSLOG_H
+	if (use_syslog)
+		logring_syslog(prio, time, line);
+#endif
+}
+
+static double pool_diff;	/* set by stratum_gen_work, drawn by ui_tick */
+
+/* the log thread polls the keys and redraws the device lines, no miner
+ * thread touches curses */
+static void ui_tick(void)
+{
+	static time_t drawn;
+	static double diff_drawn;
+	time_t now = time(NULL);
+	int i;
+
+	menukey = wgetch(menu_screen);
+
+	switch(menukey)
+	{
+		case KEY_F(9):
+			if (isWorkerShow)
+			{
+				menu_key[8] = "F9 ShowUser";
+				isWorkerShow = false;
+			}
+			else
+			{
+				menu_key[8] = "F9 HideUser";
+				isWorkerShow = true;
+			}
+			show_menu();
+			break;
+		case KEY_F(10):
+			destroywins();
+			printf("Normal exit by user request...\n");
+			exit(0);
+			break;
+		default:
+			break;
+	}
+
+	if (pool_diff != diff_drawn) {
+		mvwprintw(info_screen, infoscr_y-2, 0, " pool set diff to %lg", pool_diff);
+		diff_drawn = pool_diff;
+	}
+	if (now != drawn) {
+		for (i = 0; i < opt_n_threads; i++)
+			gpuinfo(i, 0, 0);
+		drawn = now;
+	}
+	updatescr();
+}
+
 
 static char const usage[] = "\
 Usage: " PROGRAM_NAME " [OPTIONS]\n\
@@ -458,6 +450,50 @@ Options:\n\
       --cert=FILE       certificate for mining server using SSL\n\
   -x, --proxy=[PROTOCOL://]HOST[:PORT]  connect through a proxy\n\
   -t, --threads=N       number of miner threads (default: number of nVidia GPUs)\n\
+      --verify-threads=N  number of CPU threads verifying GPU results\n\
+                          (default: 1)\n\
+      --backend=NAME    compute backend of the miner threads:\n\
+                        cuda      nVidia GPUs (default)\n\
+                        cpu       sph reference code on the host, no GPU\n\
+                                  needed (jackpot, quark, nist5, x11)\n\
+      --cpu-threads=N   worker threads of the cpu backend (default: one\n\
+                          per core)\n\
+      --autotune        measure the batch size of each device without an\n\
+                          entry in the tune cache and store the best one\n\
+      --tune-cache=FILE batch sizes found by --autotune, read at every\n\
+                          start (default: ccminer-tune.json)\n\
+      --tune-latency=N  longest job switch --autotune accepts, in ms\n\
+                          (default: 500)\n\
+      --sync=MODE       how miner threads wait for their GPU:\n\
+                        spin      poll, lowest latency, one core per GPU\n\
+                        yield     poll and yield the CPU in between\n\
+                        blocking  sleep in the driver until the GPU is done\n\
+                        sleep     sleep the predicted time, then wait\n\
+                                  (default)\n\
+      --profile         time every hash stage of the backend and print\n\
+                          min/avg/p99 and compaction survivors per stage\n\
+      --profile-trace=FILE  --profile and write the first stages of all\n\
+                          devices as a Chrome trace (chrome://tracing)\n\
+      --telemetry-interval=N  ms between two sensor readings of a GPU\n\
+                          (default: 1000)\n\
+      --temp-target=C   pause between batches to hold the GPUs at C degrees\n\
+                          instead of running into driver throttling\n\
+                          (default: off)\n\
+      --power-limit=W   same for the board power in watts (default: off)\n\
+      --hwmon=NAME      source of the GPU sensors (default: the first\n\
+                          that works of nvapi, nvml and sysfs):\n\
+                        nvapi     NVIDIA API (Windows)\n\
+                        nvml      NVIDIA Management Library\n\
+                        sysfs     hwmon files of the kernel driver (Linux)\n\
+                        mock      replays --hwmon-trace, no GPU needed\n\
+                        none      no sensors\n\
+      --hwmon-trace=FILE  --hwmon=mock with the JSON sensor traces\n\
+                          in FILE\n\
+      --api-bind=[IP:]PORT  serve the read-only JSON API (summary, devs,\n\
+                          pool, stats, jobs, version) and Prometheus metrics\n\
+                          (HTTP GET /metrics) on PORT, IP defaults to\n\
+                          127.0.0.1 (default: off)\n\
+      --api-clients=N   open API connections at most (default: 8)\n\
   -r, --retries=N       number of times to retry if a network call fails\n\
                           (default: retry indefinitely)\n\
   -R, --retry-pause=N   time to pause between retries, in seconds (default: 30)\n\
@@ -478,11 +514,52 @@ Options:\n\
   -B, --background      run the miner in the background\n"
 #endif
 "\
-      --benchmark       run in offline benchmark mode\n\
+      --benchmark       run in offline benchmark mode: measure the miner\n\
+                          threads in trials, report JSON and exit\n\
+      --bench-cpu=LIST  benchmark CPU primitives and exit, LIST is all or\n\
+                          names and groups (sph, algo, sha256d, scrypt,\n\
+                          merkle, hex) separated by commas\n\
+      --bench-getwork   benchmark getwork fetches, submits and longpoll\n\
+                          wakeups against the URL (see --getwork-sim) and exit\n\
+      --bench-time=S    seconds per trial (default: 10, 0.5 with --bench-cpu,\n\
+                          2 with --bench-getwork)\n\
+      --bench-iters=N   calls per trial instead of a time, --bench-cpu and\n\
+                          --bench-getwork only\n\
+      --bench-warmup=S  seconds before the first trial (default: 5, 0.1\n\
+                          with --bench-cpu, 0.5 with --bench-getwork)\n\
+      --bench-trials=N  trials, reported with mean and stddev (default: 5)\n\
+      --bench-json=FILE write the benchmark report to FILE (default: stdout)\n\
+      --bench-baseline=FILE  compare the means with an earlier report and\n\
+                          fail on a regression\n\
+      --bench-threshold=P  % a mean may fall below the baseline (default: 10)\n\
+      --selftest        check all hashes against known answers and the CPU\n\
+                          batch paths against the scalar hash, then run\n\
+                          --bench-cpu if given; exit code 1 on a failure\n\
+      --selftest-seed=N seed of the random headers (default: time)\n\
+      --pool-sim=[IP:]PORT  run a simulated stratum pool for the algorithm\n\
+                          that validates shares, report JSON and exit\n\
+      --sim-job-interval=S  seconds between two jobs (default: 30)\n\
+      --sim-clean=N     every N-th job starts a new block (default: 4)\n\
+      --sim-diff=LIST   share difficulty, a comma separated list is used\n\
+                          in turn per job (default: 1)\n\
+      --sim-merkle=N    Merkle branches per job (default: 4)\n\
+      --sim-latency=MS  delay every line the pool sends (default: 0)\n\
+      --sim-reconnect=S send client.reconnect every S seconds (default: off)\n\
+      --sim-time=S      stop after S seconds and write the report like\n\
+                          --bench-json (default: run until killed)\n\
+      --getwork-sim=[IP:]PORT  serve the simulated jobs over getwork with\n\
+                          longpoll, alone or next to --pool-sim\n\
+      --cpu-batch-bench benchmark the CPU batch path (quark/anime/jackpot)\n\
+                          with and without branch compaction and exit,\n\
+                          lane use comes from a simulated SIMD model\n\
+      --compaction-test check the GPU nonce compaction against the host\n\
+                          reference, print its throughput and exit\n\
   -c, --config=FILE     load a JSON-format configuration file\n\
   -V, --version         display version information and exit\n\
   -h, --help            display this help text and exit\n\
       --height          height of terminal window\n\
+      --headless        no curses screen, log JSON lines to stdout (or to\n\
+                          the system log with --syslog)\n\
 ";
 
 static char const short_options[] =
@@ -496,50 +573,79 @@ static char const short_options[] =
 
 static struct option const options[] = {
 	{ "algo", 1, NULL, 'a' },
+	{ "api-bind", 1, NULL, 1022 },
+	{ "api-clients", 1, NULL, 1023 },
+	{ "autotune", 0, NULL, 1013 },
 #ifndef WIN32
 	{ "background", 0, NULL, 'B' },
 #endif
+	{ "backend", 1, NULL, 1010 },
+	{ "bench-baseline", 1, NULL, 1033 },
+	{ "bench-cpu", 1, NULL, 1027 },
+	{ "bench-getwork", 0, NULL, 1045 },
+	{ "bench-iters", 1, NULL, 1028 },
+	{ "bench-json", 1, NULL, 1029 },
+	{ "bench-time", 1, NULL, 1030 },
+	{ "bench-trials", 1, NULL, 1031 },
+	{ "bench-threshold", 1, NULL, 1034 },
+	{ "bench-warmup", 1, NULL, 1032 },
 	{ "benchmark", 0, NULL, 1005 },
 	{ "cert", 1, NULL, 1001 },
+	{ "compaction-test", 0, NULL, 1012 },
 	{ "config", 1, NULL, 'c' },
+	{ "cpu-batch-bench", 0, NULL, 1008 },
+	{ "cpu-threads", 1, NULL, 1011 },
 	{ "debug", 0, NULL, 'D' },
 	{ "help", 0, NULL, 'h' },
+	{ "headless", 0, NULL, 1024 },
+	{ "getwork-sim", 1, NULL, 1046 },
 	{ "height", 1, NULL, 1006 },
+	{ "hwmon", 1, NULL, 1020 },
+	{ "hwmon-trace", 1, NULL, 1021 },
 	{ "no-longpoll", 0, NULL, 1003 },
 	{ "no-stratum", 0, NULL, 1007 },
 	{ "pass", 1, NULL, 'p' },
+	{ "pool-sim", 1, NULL, 1037 },
+	{ "power-limit", 1, NULL, 1026 },
+	{ "profile", 0, NULL, 1017 },
+	{ "profile-trace", 1, NULL, 1018 },
 	{ "protocol-dump", 0, NULL, 'P' },
 	{ "proxy", 1, NULL, 'x' },
 	{ "quiet", 0, NULL, 'q' },
 	{ "retries", 1, NULL, 'r' },
 	{ "retry-pause", 1, NULL, 'R' },
 	{ "scantime", 1, NULL, 's' },
+	{ "selftest", 0, NULL, 1035 },
+	{ "selftest-seed", 1, NULL, 1036 },
+	{ "sim-clean", 1, NULL, 1038 },
+	{ "sim-diff", 1, NULL, 1039 },
+	{ "sim-job-interval", 1, NULL, 1040 },
+	{ "sim-latency", 1, NULL, 1041 },
+	{ "sim-merkle", 1, NULL, 1042 },
+	{ "sim-reconnect", 1, NULL, 1043 },
+	{ "sim-time", 1, NULL, 1044 },
+	{ "sync", 1, NULL, 1016 },
 #ifdef HAVE_SYSLOG_H
 	{ "syslog", 0, NULL, 'S' },
 #endif
+	{ "telemetry-interval", 1, NULL, 1019 },
+	{ "temp-target", 1, NULL, 1025 },
 	{ "threads", 1, NULL, 't' },
 	{ "vote", 1, NULL, 'v' },
 	{ "trust-pool", 0, NULL, 'm' },
 	{ "timeout", 1, NULL, 'T' },
+	{ "tune-cache", 1, NULL, 1014 },
+	{ "tune-latency", 1, NULL, 1015 },
 	{ "url", 1, NULL, 'o' },
 	{ "user", 1, NULL, 'u' },
 	{ "userpass", 1, NULL, 'O' },
+	{ "verify-threads", 1, NULL, 1009 },
 	{ "version", 0, NULL, 'V' },
 	{ "devices", 1, NULL, 'd' },
 	{ "diff", 1, NULL, 'f' },
 	{ 0, 0, 0, 0 }
 };
 
-struct work {
-	uint32_t data[32];
-	uint32_t target[8];
-	uint32_t maxvote;
-
-	char job_id[128];
-	size_t xnonce2_len;
-	unsigned char xnonce2[32];
-};
-
 static struct work g_work;
 static time_t g_work_time;
 static pthread_mutex_t g_work_lock;
@@ -552,14 +658,12 @@ static bool jobj_binary(const json_t *obj, const char *key,
 
 	tmp = json_object_get(obj, key);
 	if (unlikely(!tmp)) {
-		//applog(LOG_ERR, "JSON key '%s' not found", key);
-		printline(out_screen, true, "JSON key '%s' not found", key);
+		applog(LOG_ERR, "JSON key '%s' not found", key);
 		return false;
 	}
 	hexstr = json_string_value(tmp);
 	if (unlikely(!hexstr)) {
-		//applog(LOG_ERR, "JSON key '%s' is not a string", key);
-		printline(out_screen, true, "JSON key '%s' is not a string", key);
+		applog(LOG_ERR, "JSON key '%s' is not a string", key);
 		return false;
 	}
 	if (!hex2bin((unsigned char*)buf, hexstr, buflen))
@@ -573,16 +677,14 @@ static bool work_decode(const json_t *val, struct work *work)
 	int i;
 	
 	if (unlikely(!jobj_binary(val, "data", work->data, sizeof(work->data)))) {
-		//applog(LOG_ERR, "JSON inval data");
-		printline(out_screen, true, "JSON inval data");
+		applog(LOG_ERR, "JSON inval data");
 		goto err_out;
 	}
 	if (unlikely(!jobj_binary(val, "target", work->target, sizeof(work->target)))) {
-		//applog(LOG_ERR, "JSON inval target");
-		printline(out_screen, true, "JSON inval target");
+		applog(LOG_ERR, "JSON inval target");
 		goto err_out;
 	}
-	if (opt_algo == ALGO_HEAVY) {
+	if (algo->vote) {
 		if (unlikely(!jobj_binary(val, "maxvote", &work->maxvote, sizeof(work->maxvote)))) {
 			work->maxvote = 1024;
 		}
@@ -601,15 +703,16 @@ err_out:
 static void share_result(int result, const char *reason)
 {
 	char s[345];
+	struct hash_rates rates;
 	double hashrate;
-	int i;
 
-	hashrate = 0.;
+	/* all devices over the last minute */
+	hashmeter_read(HASHMETER_TOTAL, &rates);
+	hashrate = rates.window[1];
 	pthread_mutex_lock(&stats_lock);
-	for (i = 0; i < opt_n_threads; i++)
-		hashrate += thr_hashrates[i];
 	result ? accepted_count++ : rejected_count++;
 	pthread_mutex_unlock(&stats_lock);
+	metrics_share(result != 0);
 	
 	sprintf(s, hashrate >= 1e6 ? "%.0f" : "%.2f", 1e-3 * hashrate);
 	printline(out_screen, true, "accepted: %lu/%lu (%.2f%%), %s khash/s %s",
@@ -628,8 +731,7 @@ static void share_result(int result, const char *reason)
 
 	if (opt_debug && reason)
 	//if (reason)
-		//applog(LOG_DEBUG, "DEBUG: reject reason: %s", reason);
-		printline(out_screen, true, "DEBUG: reject reason: %s", reason);
+		applog(LOG_DEBUG, "DEBUG: reject reason: %s", reason);
 }
 
 
@@ -728,7 +830,7 @@ retry:
 }
 
 
-static bool submit_upstream_work(CURL *curl, struct work *work)
+static bool submit_upstream_work(CURL *curl, int thr_id, struct work *work)
 {
 	char *str = NULL;
 	json_t *val, *res, *reason;
@@ -739,8 +841,8 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 	/* pass if the previous hash is not the current previous hash */
 	if (memcmp(work->data + 1, g_work.data + 1, 32)) {
 		if (opt_debug)
-			//applog(LOG_DEBUG, "DEBUG: stale work detected, discarding");
-			printline(out_screen, true, "DEBUG: stale work detected, discarding");
+			applog(LOG_DEBUG, "DEBUG: stale work detected, discarding");
+		metrics_stale(thr_id);
 		return true;
 	}
 
@@ -757,7 +859,7 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 		noncestr = bin2hex((const unsigned char *)(&nonce), 4);
 		xnonce2str = bin2hex(work->xnonce2, work->xnonce2_len);
 		nvotestr = bin2hex((const unsigned char *)(&nvote), 2);
-		if (opt_algo == ALGO_HEAVY) {
+		if (algo->vote) {
 			sprintf(s,
 				"{\"method\": \"mining.submit\", \"params\": [\"%s\", \"%s\", \"%s\", \"%s\", \"%s\", \"%s\"], \"id\":4}",
 				rpc_user, work->job_id, xnonce2str, ntimestr, noncestr, nvotestr);
@@ -771,23 +873,24 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 		free(xnonce2str);
 		free(nvotestr);
 
+		/* the answer may arrive before stratum_send_line returns */
+		metrics_submit(thr_id);
 		if (unlikely(!stratum_send_line(&stratum, s))) {
-			//applog(LOG_ERR, "submit_upstream_work stratum_send_line failed");
-			printline(out_screen, true, "submit_upstream_work stratum_send_line failed");
+			metrics_submit_reset();
+			applog(LOG_ERR, "submit_upstream_work stratum_send_line failed");
 			goto out;
 		}
 	} else {
 
 		/* build hex string */
 
-		if (opt_algo != ALGO_HEAVY && opt_algo != ALGO_MJOLLNIR) {
+		if (!algo->swab_header) {
 			for (i = 0; i < ARRAY_SIZE(work->data); i++)
 				le32enc(work->data + i, work->data[i]);
 			}
 			str = bin2hex((unsigned char *)work->data, sizeof(work->data));
 			if (unlikely(!str)) {
-				//applog(LOG_ERR, "submit_upstream_work OOM");
-				printline(out_screen, true, "submit_upstream_work OOM");
+				applog(LOG_ERR, "submit_upstream_work OOM");
 				goto out;
 		}
 
@@ -797,10 +900,11 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 			str);
 
 		/* issue JSON-RPC request */
+		metrics_submit(thr_id);
 		val = json_rpc_call(curl, rpc_url, rpc_userpass, s, false, false, NULL);
 		if (unlikely(!val)) {
-			//applog(LOG_ERR, "submit_upstream_work json_rpc_call failed");
-			printline(out_screen, true, "submit_upstream_work json_rpc_call failed");
+			metrics_submit_reset();
+			applog(LOG_ERR, "submit_upstream_work json_rpc_call failed");
 			goto out;
 		}
 
@@ -847,7 +951,7 @@ static bool get_upstream_work(CURL *curl, struct work *work)
 		timeval_subtract(&diff, &tv_end, &tv_start);
 		/*applog(LOG_DEBUG, "DEBUG: got new work in %d ms",
 		       diff.tv_sec * 1000 + diff.tv_usec / 1000);*/
-		printline(out_screen, true, "DEBUG: got new work in %d ms",
+		applog(LOG_DEBUG, "DEBUG: got new work in %d ms",
 		       diff.tv_sec * 1000 + diff.tv_usec / 1000);
 	}
 
@@ -885,8 +989,7 @@ static bool workio_get_work(struct workio_cmd *wc, CURL *curl)
 	/* obtain new work from bitcoin via JSON-RPC */
 	while (!get_upstream_work(curl, ret_work)) {
 		if (unlikely((opt_retries >= 0) && (++failures > opt_retries))) {
-			//applog(LOG_ERR, "json_rpc_call failed, terminating workio thread");
-			printline(out_screen, true, "json_rpc_call failed, terminating workio thread");
+			applog(LOG_ERR, "json_rpc_call failed, terminating workio thread");
 			free(ret_work);
 			return false;
 		}
@@ -894,7 +997,7 @@ static bool workio_get_work(struct workio_cmd *wc, CURL *curl)
 		/* pause, then restart work-request loop */
 		/*applog(LOG_ERR, "json_rpc_call failed, retry after %d seconds",
 			opt_fail_pause);*/
-		printline(out_screen, true, "json_rpc_call failed, retry after %d seconds",
+		applog(LOG_ERR, "json_rpc_call failed, retry after %d seconds",
 			opt_fail_pause);
 		sleep(opt_fail_pause);
 	}
@@ -911,17 +1014,16 @@ static bool workio_submit_work(struct workio_cmd *wc, CURL *curl)
 	int failures = 0;
 
 	/* submit solution to bitcoin via JSON-RPC */
-	while (!submit_upstream_work(curl, wc->u.work)) {
+	while (!submit_upstream_work(curl, wc->thr->id, wc->u.work)) {
 		if (unlikely((opt_retries >= 0) && (++failures > opt_retries))) {
-			printline(out_screen, true, "...terminating workio thread");
-			//applog(LOG_ERR, "...terminating workio thread");
+			applog(LOG_ERR, "...terminating workio thread");
 			return false;
 		}
 
 		/* pause, then restart work-request loop */
 		/*applog(LOG_ERR, "...retry after %d seconds",
 			opt_fail_pause);*/
-		printline(out_screen, true, "...retry after %d seconds",
+		applog(LOG_ERR, "...retry after %d seconds",
 			opt_fail_pause);
 		sleep(opt_fail_pause);
 	}
@@ -937,8 +1039,7 @@ static void *workio_thread(void *userdata)
 
 	curl = curl_easy_init();
 	if (unlikely(!curl)) {
-		printline(out_screen, true, "CURL initialization failed");
-		//applog(LOG_ERR, "CURL initialization failed");
+		applog(LOG_ERR, "CURL initialization failed");
 		return NULL;
 	}
 
@@ -1043,6 +1144,95 @@ err_out:
 	return false;
 }
 
+/* CPU hash of the work's current nonce, true if it meets the target */
+static bool verify_work(const struct work *work, uint32_t *hash)
+{
+	algo_hash_data(algo, hash, work->data);
+	return hash[7] <= work->target[7] && fulltest(hash, work->target);
+}
+
+void submit_nonce(struct device_ctx *ctx, uint32_t nonce)
+{
+	struct verify_req *req;
+
+	/* no work while the intensity tuner measures, see autotune.cpp */
+	if (!ctx->cur_work)
+		return;
+
+	req = (struct verify_req *)malloc(sizeof(*req));
+	if (!req)
+		return;
+
+	/* snapshot of the work the miner thread is scanning right now */
+	memcpy(&req->work, ctx->cur_work, sizeof(struct work));
+	req->work.data[19] = nonce;
+	req->ctx = ctx;
+	gettimeofday(&req->tv_found, NULL);
+
+	if (!tq_push(verify_q, req))
+		free(req);
+}
+
+int submit_candidates(struct device_ctx *ctx, const uint32_t *nonces, int count)
+{
+	int i, n = (count < DEVICE_CANDIDATES) ? count : DEVICE_CANDIDATES;
+
+	for (i = 0; i < n; i++)
+		submit_nonce(ctx, nonces[i]);
+
+	/* only the owning miner thread touches these */
+	ctx->checked_batches++;
+	ctx->candidates += count;
+	ctx->dropped += count - n;
+	hashmeter_batch(ctx->thr_id, ctx->batch);
+	metrics_batch(ctx->thr_id);
+	metrics_device(ctx);
+	/* idles here while the GPU is over --temp-target or --power-limit */
+	thermal_batch(ctx);
+	return n;
+}
+
+static void *verify_thread(void *userdata)
+{
+	struct verify_req *req;
+	struct verify_stats *vs;
+	struct timeval tv_end, diff;
+	uint32_t hash[8];
+	double latency;
+	bool valid;
+
+	while (1) {
+		req = (struct verify_req *)tq_pop(verify_q, NULL);
+		if (!req)
+			continue;
+
+		valid = verify_work(&req->work, hash);
+
+		gettimeofday(&tv_end, NULL);
+		timeval_subtract(&diff, &tv_end, &req->tv_found);
+		latency = 1e3 * diff.tv_sec + 1e-3 * diff.tv_usec;
+
+		pthread_mutex_lock(&stats_lock);
+		vs = &req->ctx->verify;
+		vs->latency = vs->checked ? 0.9 * vs->latency + 0.1 * latency : latency;
+		vs->checked++;
+		if (!valid)
+			vs->invalid++;
+		metrics_verify(req->ctx);
+		pthread_mutex_unlock(&stats_lock);
+
+		if (!valid)
+			applog(LOG_INFO, "GPU #%d: result for nonce $%08X does not validate on CPU!",
+				req->ctx->device_id, req->work.data[19]);
+		else if (!opt_benchmark && !submit_work(&thr_info[req->ctx->thr_id], &req->work))
+			applog(LOG_ERR, "GPU #%d: share submit failed", req->ctx->device_id);
+
+		free(req);
+	}
+
+	return NULL;
+}
+
 static void stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 {
 	unsigned char merkle_root[64];
@@ -1055,55 +1245,16 @@ static void stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 	memcpy(work->xnonce2, sctx->job.xnonce2, sctx->xnonce2_size);
 
 	/* Generate merkle root */
-	if (opt_algo == ALGO_HEAVY || opt_algo == ALGO_MJOLLNIR)
-		heavycoin_hash(merkle_root, sctx->job.coinbase, (int)sctx->job.coinbase_size);
-	else
-	if (opt_algo == ALGO_FUGUE256 || opt_algo == ALGO_GROESTL)
-		SHA256((unsigned char*)sctx->job.coinbase, sctx->job.coinbase_size, (unsigned char*)merkle_root);
-	else
-		sha256d(merkle_root, sctx->job.coinbase, (int)sctx->job.coinbase_size);
-
-	for (i = 0; i < sctx->job.merkle_count; i++) {
-		memcpy(merkle_root + 32, sctx->job.merkle[i], 32);
-		if (opt_algo == ALGO_HEAVY || opt_algo == ALGO_MJOLLNIR)
-			heavycoin_hash(merkle_root, merkle_root, 64);
-		else
-			sha256d(merkle_root, merkle_root, 64);
-	}
+	algo_merkle_root(algo->merkle, merkle_root, sctx->job.coinbase, sctx->job.coinbase_size,
+		sctx->job.merkle, sctx->job.merkle_count);
 	
 	/* Increment extranonce2 */
 	for (i = 0; i < (int)sctx->xnonce2_size && !++sctx->job.xnonce2[i]; i++);
 
 	/* Assemble block header */
-	memset(work->data, 0, 128);
-	work->data[0] = le32dec(sctx->job.version);
-	for (i = 0; i < 8; i++)
-		work->data[1 + i] = le32dec((uint32_t *)sctx->job.prevhash + i);
-	for (i = 0; i < 8; i++)
-		work->data[9 + i] = be32dec((uint32_t *)merkle_root + i);
-	work->data[17] = le32dec(sctx->job.ntime);
-	work->data[18] = le32dec(sctx->job.nbits);
-	if (opt_algo == ALGO_MJOLLNIR)
-	{
-		for (i = 0; i < 20; i++)
-			work->data[i] = be32dec((uint32_t *)&work->data[i]);
-	}
-
-	work->data[20] = 0x80000000;
-	work->data[31] = (opt_algo == ALGO_MJOLLNIR) ? 0x000002A0 : 0x00000280;
-
-	// HeavyCoin
-	if (opt_algo == ALGO_HEAVY) {
-		uint16_t *ext;
+	algo_stratum_header(algo, work->data, &sctx->job, merkle_root, opt_vote);
+	if (algo->vote)
 		work->maxvote = 1024;
-		ext = (uint16_t*)(&work->data[20]);
-		ext[0] = opt_vote;
-		ext[1] = be16dec(sctx->job.nreward);
-
-		for (i = 0; i < 20; i++)
-			work->data[i] = be32dec((uint32_t *)&work->data[i]);
-	}
-	//
 
 	pthread_mutex_unlock(&sctx->work_lock);
 
@@ -1111,18 +1262,13 @@ static void stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 		char *xnonce2str = bin2hex(work->xnonce2, sctx->xnonce2_size);
 		/*applog(LOG_DEBUG, "DEBUG: job_id='%s' extranonce2=%s ntime=%08x",
 		       work->job_id, xnonce2str, swab32(work->data[17]));*/
-		printline(out_screen, true, "DEBUG: job_id='%s' extranonce2=%s ntime=%08x",
+		applog(LOG_DEBUG, "DEBUG: job_id='%s' extranonce2=%s ntime=%08x",
 		       work->job_id, xnonce2str, swab32(work->data[17]));
 		free(xnonce2str);
 	}
-	if (opt_algo == ALGO_JACKPOT)
-		diff_to_target(work->target, sctx->job.diff / (65536.0 * opt_difficulty));
-	else if (opt_algo == ALGO_FUGUE256 || opt_algo == ALGO_GROESTL || opt_algo == ALGO_DMD_GR)
-		diff_to_target(work->target, sctx->job.diff / (256.0 * opt_difficulty));
-	else
-		diff_to_target(work->target, sctx->job.diff / opt_difficulty);
+	diff_to_target(work->target, sctx->job.diff / (algo->diff_factor * opt_difficulty));
 		 
-	mvwprintw(info_screen, infoscr_y-2, 0, " pool set diff to %lg", sctx->job.diff);
+	pool_diff = sctx->job.diff;
 
 }
 
@@ -1130,13 +1276,13 @@ static void *miner_thread(void *userdata)
 {
 	struct thr_info *mythr = (struct thr_info *)userdata;
 	int thr_id = mythr->id;
+	struct device_ctx *ctx = devices[thr_id];
 	struct work work;
 	uint32_t max_nonce;
 	uint32_t end_nonce = 0xffffffffU / opt_n_threads * (thr_id + 1) - 0x20;
 	unsigned char *scratchbuf = NULL;
 	char s[16];
 	int i;
-    static int rounds = 0;
 	
 	const char *key;
 	json_t *valu;
@@ -1146,6 +1292,7 @@ static void *miner_thread(void *userdata)
 
 
 	memset(&work, 0, sizeof(work)); // prevent work from being used uninitialized
+	ctx->cur_work = &work;
 
 	/* Set worker threads to nice 19 and then preferentially to SCHED_IDLE
 	 * and if that fails, then SCHED_BATCH. No need for this to be an
@@ -1166,11 +1313,15 @@ static void *miner_thread(void *userdata)
 		affine_to_cpu(thr_id, thr_id % num_processors);
 	}
 
+	/* batch size from the tune cache or a fresh measurement */
+	autotune_device(ctx, algo);
+	profile_start(ctx, algo->name);
+
 	while (1) {
 		unsigned long hashes_done;
 		struct timeval tv_start, tv_end, diff;
+		double cpu_start;
 		int64_t max64;
-		int rc;
 
 		if (have_stratum) {
 			while (time(NULL) >= g_work_time + 60)
@@ -1185,10 +1336,8 @@ static void *miner_thread(void *userdata)
 					time(NULL) >= g_work_time + LP_SCANTIME*3/4 ||
 					work.data[19] >= end_nonce)) {
 				if (unlikely(!get_work(mythr, &g_work))) {
-					printline(out_screen, true, "work retrieval failed, exiting "
+					applog(LOG_ERR, "work retrieval failed, exiting "
 						"mining thread %d", mythr->id);
-					//applog(LOG_ERR, "work retrieval failed, exiting "
-					//	"mining thread %d", mythr->id);
 					pthread_mutex_unlock(&g_work_lock);
 					goto out;
 				}
@@ -1205,6 +1354,8 @@ static void *miner_thread(void *userdata)
 		} else
 			work.data[19]++;
 		pthread_mutex_unlock(&g_work_lock);
+		if (work_restart[thr_id].restart)
+			metrics_job_switch(thr_id);
 		work_restart[thr_id].restart = 0;
 
 		/* adjust max_nonce to meet target scan time */
@@ -1213,9 +1364,9 @@ static void *miner_thread(void *userdata)
 		else
 			max64 = g_work_time + (have_longpoll ? LP_SCANTIME : opt_scantime)
 			      - time(NULL);
-		max64 *= (int64_t)thr_hashrates[thr_id];
+		max64 *= (int64_t)ctx->hashrate;
 		if (max64 <= 0)
-			max64 = (opt_algo == ALGO_JACKPOT) ? 0x1fffLL : 0xfffffLL;
+			max64 = algo->min_scan;
 		if ((int64_t)work.data[19] + max64 > end_nonce)
 			max_nonce = end_nonce;
 		else
@@ -1223,90 +1374,36 @@ static void *miner_thread(void *userdata)
 
 		hashes_done = 0;
 		gettimeofday(&tv_start, NULL);
+		cpu_start = thread_cpu_time();
 
 		/* scan nonces for a proof-of-work hash */
-		switch (opt_algo) {
-
-		case ALGO_HEAVY:
-			rc = scanhash_heavy(thr_id, work.data, work.target,
-			                      max_nonce, &hashes_done, work.maxvote, HEAVYCOIN_BLKHDR_SZ);
-			break;
-
-		case ALGO_MJOLLNIR:
-			rc = scanhash_heavy(thr_id, work.data, work.target,
-			                      max_nonce, &hashes_done, 0, MNR_BLKHDR_SZ);
-			break;
-
-		case ALGO_FUGUE256:
-			rc = scanhash_fugue256(thr_id, work.data, work.target,
-			                      max_nonce, &hashes_done);
-			break;
-
-		case ALGO_GROESTL:
-		case ALGO_DMD_GR:
-			rc = scanhash_groestlcoin(thr_id, work.data, work.target,
-			                      max_nonce, &hashes_done);
-			break;
-
-		case ALGO_MYR_GR:
-			rc = scanhash_myriad(thr_id, work.data, work.target,
-			                      max_nonce, &hashes_done);
-			break;
-
-		case ALGO_JACKPOT:
-			rc = scanhash_jackpot(thr_id, work.data, work.target,
-			                      max_nonce, &hashes_done);
-			break;
-
-		case ALGO_QUARK:
-			rc = scanhash_quark(thr_id, work.data, work.target,
-			                      max_nonce, &hashes_done);
-			break;
-
-		case ALGO_ANIME:
-			rc = scanhash_anime(thr_id, work.data, work.target,
-			                      max_nonce, &hashes_done);
-			break;
-
-		case ALGO_NIST5:
-			rc = scanhash_nist5(thr_id, work.data, work.target,
-			                      max_nonce, &hashes_done);
-			break;
-
-		case ALGO_X11:
-			rc = scanhash_x11(thr_id, work.data, work.target,
-			                      max_nonce, &hashes_done);
-			break;
-
-		case ALGO_X13:
-			rc = scanhash_x13(thr_id, work.data, work.target,
- 			                      max_nonce, &hashes_done);
- 			break;
-
-		default:
-			/* should never happen */
+		algo->scanhash(ctx, &work, max_nonce, &hashes_done);
+
+		/* scanhash could not set the device up: retrying only re-runs
+		 * the module inits, so give the memory back and stop here */
+		if (unlikely(!ctx->init)) {
+			applog(LOG_ERR, "GPU #%d: %s setup failed for a batch of %d nonces, "
+				"exiting mining thread %d", ctx->device_id, algo->name, ctx->batch, thr_id);
+			device_ctx_reset(ctx);
 			goto out;
 		}
 
-        if (opt_benchmark)
-            if (++rounds == 1) {
-				destroywins();
-				exit(0);
-			}
-
-		/* record scanhash elapsed time */
+		/* record scanhash elapsed time, nothing here takes a lock */
 		gettimeofday(&tv_end, NULL);
 		timeval_subtract(&diff, &tv_end, &tv_start);
+		hashmeter_scan(thr_id, hashes_done);
 		if (diff.tv_usec || diff.tv_sec) {
-			pthread_mutex_lock(&stats_lock);
-			thr_hashrates[thr_id] =
+			double cpu = thread_cpu_time() - cpu_start;
+			ctx->hashrate =
 				hashes_done / (diff.tv_sec + 1e-6 * diff.tv_usec);
-			pthread_mutex_unlock(&stats_lock);
+			ctx->cpu_load = cpu / (diff.tv_sec + 1e-6 * diff.tv_usec);
+			ctx->cpu_time += cpu;
 		}
+		/* snapshot for the API, also for scanhash loops without batches */
+		metrics_device(ctx);
 		
-		if (thr_hashrates[thr_id] > 1e8){
-			printline(out_screen, true, "abnormal hashes %f, exiting with code 211!", thr_hashrates[thr_id]);
-			//applog(LOG_ERR, "abnormal hashes %f, exiting with code 211!", thr_hashrates[thr_id]);
+		if (ctx->hashrate > 1e8){
+			applog(LOG_ERR, "abnormal hashes %f, exiting with code 211!", ctx->hashrate);
 			destroywins();
 			exit(211);
         }
@@ -1328,43 +1425,34 @@ static void *miner_thread(void *userdata)
 		}*/
 
 		
-		gpuinfo(thr_id,dif,balance);
-
-		menukey = wgetch(menu_screen);
-
-		switch(menukey)
-		{
-			case KEY_F(9):
-				if (isWorkerShow)
-				{
-					menu_key[8] = "F9 ShowUser";
-					isWorkerShow = false;
-				}
-				else
-				{
-					menu_key[8] = "F9 HideUser";
-					isWorkerShow = true;
-				}
-				show_menu();
-				break;
-			case KEY_F(10):
-				//destroywins();
-				//applog(LOG_INFO, "Normal exit by user request...");
-				delwin(info_screen);
-				delwin(out_screen);
-				endwin();
-				printf("Normal exit by user request...\n");
-				exit(0);
-				break;
-			default:
-				break;
-		}
+		/* the device lines and keys are the log thread's, see ui_tick() */
 
 		if (!opt_quiet) {
-			sprintf(s, thr_hashrates[thr_id] >= 1e6 ? "%.0f" : "%.2f",
-				1e-3 * thr_hashrates[thr_id]);
-			printline(out_screen, true, "GPU #%d: %s, %s khash/s",
-				device_map[thr_id], device_name[thr_id], s);
+			struct verify_stats vs;
+			char extra[192] = "";
+			int len = 0;
+			sprintf(s, ctx->hashrate >= 1e6 ? "%.0f" : "%.2f",
+				1e-3 * ctx->hashrate);
+			pthread_mutex_lock(&stats_lock);
+			vs = ctx->verify;
+			pthread_mutex_unlock(&stats_lock);
+			if (ctx->batches)
+				len += sprintf(extra + len, ", idle %.2f ms/batch", ctx->gpu_idle);
+			if (ctx->cpu_time > 0.0)
+				len += sprintf(extra + len, ", cpu %.0f%%", 100.0 * ctx->cpu_load);
+			if (ctx->candidates)
+				len += sprintf(extra + len, ", %.3f cand/batch",
+					(double)ctx->candidates / ctx->checked_batches);
+			if (ctx->dropped)
+				len += sprintf(extra + len, " (%lu dropped)", ctx->dropped);
+			if (vs.checked)
+				len += sprintf(extra + len, ", verify %.1f ms, %lu/%lu invalid",
+					vs.latency, vs.invalid, vs.checked);
+			if (opt_debug)
+				len += sprintf(extra + len, ", %lu allocs", ctx->arena.allocs);
+			printline(out_screen, true, "GPU #%d: %s, %s khash/s%s",
+				ctx->device_id, ctx->name, s, extra);
+			profile_report(ctx);
 
 			/*applog(LOG_INFO, "GPU #%d: %s, %s khash/s",
 				device_map[thr_id], device_name[thr_id], s);*/
@@ -1372,19 +1460,17 @@ static void *miner_thread(void *userdata)
 //				thr_id, hashes_done, s);
 		}
 		if (opt_benchmark && thr_id == opt_n_threads - 1) {
-			double hashrate = 0.;
-			for (i = 0; i < opt_n_threads && thr_hashrates[i]; i++)
-				hashrate += thr_hashrates[i];
-			if (i == opt_n_threads) {
+			struct hash_rates rates;
+			hashmeter_read(HASHMETER_TOTAL, &rates);
+			if (rates.uptime > 0.) {
+				double hashrate = rates.window[0];
 				sprintf(s, hashrate >= 1e6 ? "%.0f" : "%.2f", 1e-3 * hashrate);
 				printline(out_screen, true, "Total: %s khash/s", s);
 				//applog(LOG_INFO, "Total: %s khash/s", s);
 			}
 		}
 
-		/* if nonce found, submit work */
-		if (rc && !opt_benchmark && !submit_work(mythr, &work))
-			break;
+		/* found nonces were queued by scanhash, the verify pool submits them */
 	}
 
 out:
@@ -1397,6 +1483,7 @@ static void restart_threads(void)
 {
 	int i;
 
+	metrics_restart(opt_n_threads);
 	for (i = 0; i < opt_n_threads; i++)
 		work_restart[i].restart = 1;
 }
@@ -1410,8 +1497,7 @@ static void *longpoll_thread(void *userdata)
 
 	curl = curl_easy_init();
 	if (unlikely(!curl)) {
-		//applog(LOG_ERR, "CURL initialization failed");
-		printline(out_screen, true, "CURL initialization failed");
+		applog(LOG_ERR, "CURL initialization failed");
 		goto out;
 	}
 
@@ -1454,14 +1540,14 @@ start:
 			goto out;
 		}
 		if (likely(val)) {
+			metrics_notify();
 			if (!opt_quiet) printline(out_screen, true, "LONGPOLL detected new block");//applog(LOG_INFO, "LONGPOLL detected new block");
 			soval = json_object_get(json_object_get(val, "result"), "submitold");
 			submit_old = soval ? json_is_true(soval) : false;
 			pthread_mutex_lock(&g_work_lock);
 			if (work_decode(json_object_get(val, "result"), &g_work)) {
 				if (opt_debug)
-					//applog(LOG_DEBUG, "DEBUG: got new work");
-					printline(out_screen, true, "DEBUG: got new work");
+					applog(LOG_DEBUG, "DEBUG: got new work");
 				time(&g_work_time);
 				restart_threads();
 			}
@@ -1503,8 +1589,7 @@ static bool stratum_handle_response(char *buf)
 
 	val = JSON_LOADS(buf, &err);
 	if (!val) {
-		//applog(LOG_INFO, "JSON decode failed(%d): %s", err.line, err.text);
-		printline(out_screen, true, "JSON decode failed(%d): %s", err.line, err.text);
+		applog(LOG_ERR, "JSON decode failed(%d): %s", err.line, err.text);
 		goto out;
 	}
 
@@ -1545,19 +1630,19 @@ static void *stratum_thread(void *userdata)
 			g_work_time = 0;
 			pthread_mutex_unlock(&g_work_lock);
 			restart_threads();
+			/* shares of the old connection get no answer */
+			metrics_submit_reset();
 
 			if (!stratum_connect(&stratum, stratum.url) ||
 			    !stratum_subscribe(&stratum) ||
 			    !stratum_authorize(&stratum, rpc_user, rpc_pass)) {
 				stratum_disconnect(&stratum);
 				if (opt_retries >= 0 && ++failures > opt_retries) {
-					printline(out_screen, true, "..terminating workio thread");
-					//applog(LOG_ERR, "...terminating workio thread");
+					applog(LOG_ERR, "..terminating workio thread");
 					tq_push(thr_info[work_thr_id].q, NULL);
 					goto out;
 				}
-				printline(out_screen, true, "...retry after %d seconds", opt_fail_pause);
-				//applog(LOG_ERR, "...retry after %d seconds", opt_fail_pause);
+				applog(LOG_ERR, "...retry after %d seconds", opt_fail_pause);
 				sleep(opt_fail_pause);
 			}
 		}
@@ -1575,15 +1660,13 @@ static void *stratum_thread(void *userdata)
 		}
 		
 		if (!stratum_socket_full(&stratum, 60)) {
-			printline(out_screen, true, "Stratum connection timed out");
-			//applog(LOG_ERR, "Stratum connection timed out");
+			applog(LOG_ERR, "Stratum connection timed out");
 			s = NULL;
 		} else
 			s = stratum_recv_line(&stratum);
 		if (!s) {
 			stratum_disconnect(&stratum);
-			printline(out_screen, true, "Stratum connection interrupted");
-			//applog(LOG_ERR, "Stratum connection interrupted");
+			applog(LOG_ERR, "Stratum connection interrupted");
 			continue;
 		}
 		if (!stratum_handle_method(&stratum, s))
@@ -1641,20 +1724,15 @@ static int compare (const void * a, const void * b)
 static void parse_arg (int key, char *arg)
 {
 	char *p;
-	int v, i;
+	int v;
 	double d;
 
 	switch(key) {
 	case 'a':
-		for (i = 0; i < ARRAY_SIZE(algo_names); i++) {
-			if (algo_names[i] &&
-			    !strcmp(arg, algo_names[i])) {
-				opt_algo = (sha256_algos)i;
-				break;
-			}
-		}
-		if (i == ARRAY_SIZE(algo_names))
+		opt_algo = algo_by_name(arg);
+		if (opt_algo == ALGO_COUNT)
 			show_usage_and_exit(1);
+		algo = &algo_table[opt_algo];
 		break;
 	case 'B':
 		opt_background = true;
@@ -1715,7 +1793,7 @@ static void parse_arg (int key, char *arg)
 		break;
 	case 't':
 		v = atoi(arg);
-		if (v < 1 || v > 9999)	/* sanity check */
+		if (v < 1 || v > MAX_GPUS)	/* sanity check */
 			show_usage_and_exit(1);
 		opt_n_threads = v;
 		break;
@@ -1817,6 +1895,204 @@ static void parse_arg (int key, char *arg)
 	case 1007:
 		want_stratum = false;
 		break;
+	case 1008:
+		opt_cpu_batch_bench = true;
+		break;
+	case 1009:
+		v = atoi(arg);
+		if (v < 1 || v > 64)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_verify_threads = v;
+		break;
+	case 1010:
+		opt_backend = device_backend_by_name(arg);
+		if (!opt_backend) {
+			fprintf(stderr, "unknown backend -- '%s'\n", arg);
+			show_usage_and_exit(1);
+		}
+		break;
+	case 1011:
+		v = atoi(arg);
+		if (v < 0 || v > 128)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_cpu_backend_threads = v;
+		break;
+	case 1012:
+		opt_compaction_test = true;
+		break;
+	case 1013:
+		opt_autotune = true;
+		break;
+	case 1014:
+		free(opt_tune_cache);
+		opt_tune_cache = strdup(arg);
+		break;
+	case 1015:
+		v = atoi(arg);
+		if (v < 1 || v > 60000)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_tune_latency = v;
+		break;
+	case 1016:
+		if (!sync_policy_by_name(arg, &opt_sync_policy)) {
+			fprintf(stderr, "unknown sync mode -- '%s'\n", arg);
+			show_usage_and_exit(1);
+		}
+		break;
+	case 1017:
+		opt_profile = true;
+		break;
+	case 1018:
+		free(opt_profile_trace);
+		opt_profile_trace = strdup(arg);
+		opt_profile = true;
+		break;
+	case 1019:
+		v = atoi(arg);
+		if (v < 100 || v > 3600000)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_telemetry_interval = v;
+		break;
+	case 1020:
+		{
+		const struct hwmon_provider *provider;
+
+		if (!hwmon_provider_by_name(arg, &provider)) {
+			fprintf(stderr, "unknown hardware monitor -- '%s'\n", arg);
+			show_usage_and_exit(1);
+		}
+		free(opt_hwmon);
+		opt_hwmon = strdup(arg);
+		break;
+		}
+	case 1021:
+		free(opt_hwmon_trace);
+		opt_hwmon_trace = strdup(arg);
+		break;
+	case 1022:
+		free(opt_api_bind);
+		opt_api_bind = strdup(arg);
+		break;
+	case 1023:
+		v = atoi(arg);
+		if (v < 1 || v > 64)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_api_clients = v;
+		break;
+	case 1024:
+		opt_headless = true;
+		break;
+	case 1025:
+		v = atoi(arg);
+		if (v < 30 || v > 110)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_temp_target = v;
+		break;
+	case 1026:
+		v = atoi(arg);
+		if (v < 10 || v > 1000)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_power_limit = v;
+		break;
+	case 1027:
+		free(opt_bench_cpu);
+		opt_bench_cpu = strdup(arg);
+		break;
+	case 1028:
+		v = atoi(arg);
+		if (v < 1)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_bench_iters = v;
+		break;
+	case 1029:
+		free(opt_bench_json);
+		opt_bench_json = strdup(arg);
+		break;
+	case 1030:
+		d = atof(arg);
+		if (d <= 0 || d > 3600)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_bench_time = d;
+		break;
+	case 1031:
+		v = atoi(arg);
+		if (v < 1 || v > 100)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_bench_trials = v;
+		break;
+	case 1032:
+		d = atof(arg);
+		if (d < 0 || d > 3600)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_bench_warmup = d;
+		break;
+	case 1033:
+		free(opt_bench_baseline);
+		opt_bench_baseline = strdup(arg);
+		break;
+	case 1034:
+		d = atof(arg);
+		if (d < 0 || d > 100)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_bench_threshold = d;
+		break;
+	case 1035:
+		opt_selftest = true;
+		break;
+	case 1036:
+		opt_selftest_seed = (unsigned int)strtoul(arg, NULL, 0);
+		break;
+	case 1037:
+		free(opt_pool_sim);
+		opt_pool_sim = strdup(arg);
+		break;
+	case 1045:
+		opt_bench_getwork = true;
+		break;
+	case 1046:
+		free(opt_getwork_sim);
+		opt_getwork_sim = strdup(arg);
+		break;
+	case 1038:
+		v = atoi(arg);
+		if (v < 1)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_sim_clean = v;
+		break;
+	case 1039:
+		free(opt_sim_diff);
+		opt_sim_diff = strdup(arg);
+		break;
+	case 1040:
+		d = atof(arg);
+		if (d < 0.1 || d > 3600)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_sim_job_interval = d;
+		break;
+	case 1041:
+		v = atoi(arg);
+		if (v < 0 || v > 60000)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_sim_latency = v;
+		break;
+	case 1042:
+		v = atoi(arg);
+		if (v < 0 || v > 32)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_sim_merkle = v;
+		break;
+	case 1043:
+		d = atof(arg);
+		if (d < 0 || d > 86400)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_sim_reconnect = d;
+		break;
+	case 1044:
+		d = atof(arg);
+		if (d < 0)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_sim_time = d;
+		break;
 	case 'S':
 		use_syslog = true;
 		break;
@@ -1824,7 +2100,7 @@ static void parse_arg (int key, char *arg)
 		{
 			char * pch = strtok (arg,",");
 			opt_n_threads = 0;
-			while (pch != NULL) {
+			while (pch != NULL && opt_n_threads < MAX_GPUS) {
 				if (pch[0] >= '0' && pch[0] <= '9' && pch[1] == '\0')
 				{
 					if (atoi(pch) < num_processors)
@@ -1897,12 +2173,12 @@ static void parse_config(void)
 		else
 			/*applog(LOG_ERR, "JSON option %s invalid",
 				options[i].name);*/
-			printline(out_screen, true, "JSON option %s invalid",
+			applog(LOG_ERR, "JSON option %s invalid",
 				options[i].name);
 	}
 
-	if (opt_algo == ALGO_HEAVY && opt_vote == 9999) {
-		printline(out_screen, false, "Heavycoin hash requires block reward vote parameter (see --vote)\n");
+	if (algo->vote && opt_vote == 9999) {
+		applog(LOG_ERR, "Heavycoin hash requires block reward vote parameter (see --vote)");
 		//fprintf(stderr, "Heavycoin hash requires block reward vote parameter (see --vote)\n");
 		show_usage_and_exit(1);
 	}
@@ -1931,7 +2207,7 @@ static void parse_cmdline(int argc, char *argv[])
 		show_usage_and_exit(1);
 	}
 
-	if (opt_algo == ALGO_HEAVY && opt_vote == 9999) {
+	if (algo->vote && opt_vote == 9999) {
 		//printline(out_screen, false, "%s: Heavycoin hash requires block reward vote parameter (see --vote)\n",
 		//	argv[0]);
 		fprintf(stderr, "%s: Heavycoin hash requires block reward vote parameter (see --vote)\n",
@@ -1990,12 +2266,62 @@ void bubbleSort(int *array, int *array2, char *array3, int length)//Bubble sort
 
 }
 
+/* the curses screen, not with --headless */
+static void ui_init(void)
+{
+	SetWindow(90,terminal_height);
+	initscr();
+	noecho();
+	raw();
+	cbreak();
+	curs_set(0);
+
+	int info_scr_y = 12 + opt_n_threads;
+
+	getmaxyx(stdscr, parent_y, parent_x);
+	// set up initial windows
+	info_screen = newwin(info_scr_y, parent_x, 0, 0);
+	out_screen = newwin(parent_y - info_scr_y - 1, parent_x, info_scr_y, 0);
+	menu_screen = newwin(1, parent_x, parent_y - 1, 0);
+	wborder(info_screen,' ', ' ', '_', '_', '_', '_', '_', '_');
+	scrollok(out_screen, TRUE);
+	scrollok(info_screen, TRUE);
+	keypad(menu_screen, TRUE);
+	nodelay(menu_screen,TRUE);
+
+	start_color();
+	init_pair(1, COLOR_GREEN, COLOR_BLACK); 
+	init_pair(2, COLOR_WHITE, COLOR_BLACK);
+	init_pair(3, COLOR_CYAN, COLOR_BLACK);
+
+	wcolor_set(out_screen, 1, NULL);
+	wcolor_set(menu_screen, 3, NULL);
+
+	//updatescr();
+
+	//printf
+	vwprintw(out_screen, "     *** ccMiner for nVidia GPUs by Christian Buchner and Christian H. ***\n", NULL);
+	vwprintw(out_screen, "\t             This is version "PROGRAM_VERSION" (beta)\n", NULL);
+	vwprintw(out_screen, "\t  based on pooler-cpuminer 2.3.2 (c) 2010 Jeff Garzik, 2012 pooler\n", NULL);
+	vwprintw(out_screen, "\t  based on pooler-cpuminer extension for HVC from\n\t       https://github.com/heavycoin/cpuminer-heavycoin\n", NULL);
+	vwprintw(out_screen, "\t\t\tand\n\t       http://hvc.1gh.com/\n", NULL);
+	vwprintw(out_screen, "\tCuda additions Copyright 2014 Christian Buchner, Christian H.\n", NULL);
+	vwprintw(out_screen, "\t  LTC donation address: LKS1WDKGED647msBQfLBHV3Ls8sveGncnm\n", NULL);
+	vwprintw(out_screen, "\t  BTC donation address: 16hJF5mceSojnTD3ZTUDqdRhDyPJzoRakM\n", NULL);
+	vwprintw(out_screen, "\t  YAC donation address: Y87sptDEcpLkLeAuex6qZioDbvy1qXZEj4\n", NULL);
+	//updatescr();
+	start_info();
+	show_menu();
+	wcolor_set(out_screen, 2, NULL);
+}
+
 int main(int argc, char *argv[])
 {
 	struct thr_info *thr;
 	long flags;
 	int i;
 	char *gpuByPhysicalStr;
+	bool log_ok;
 
 #ifdef WIN32
 	SYSTEM_INFO sysinfo;
@@ -2010,21 +2336,30 @@ int main(int argc, char *argv[])
 	//cuda_devicenames();
 	//num_processors = cuda_num_devices();
 
-	pthread_mutex_init(&applog_lock, NULL);
 	num_processors = cuda_num_devices();
 
 	/* parse command line */
 	parse_cmdline(argc, argv);
 
-	cuda_devicenames();
-	if (nw_nvidia_init() != 0)
-		return 1;
-
-	get_bus_ids();
-
-
-
-	//for (int i = 0; i < num_processors-1; i++)
+	if (opt_cpu_batch_bench)
+		return cpu_batch_benchmark(65536);
+	if (opt_selftest) {
+		int failures = selftest_run();
+		if (failures || !opt_bench_cpu)
+			return failures ? 1 : 0;
+	}
+	if (opt_bench_cpu) {
+		json_t *report = bench_primitives(PROGRAM_VERSION);
+		bool ok;
+		if (!report)
+			return 1;
+		ok = !opt_bench_baseline || bench_compare(report);
+		return (bench_write(report) && ok) ? 0 : 1;
+	}
+	if (opt_compaction_test)
+		return compaction_selftest(device_map[0]);
+	if (opt_pool_sim || opt_getwork_sim)
+		return pool_sim_run(algo, PROGRAM_VERSION);
 
 	if (!opt_benchmark && !rpc_url) {
 		//printline(out_screen, false, "%s: no URL supplied\n", argv[0]);
@@ -2039,6 +2374,44 @@ int main(int argc, char *argv[])
 		sprintf(rpc_userpass, "%s:%s", rpc_user, rpc_pass);
 	}
 
+	if (opt_bench_getwork) {
+		json_t *report;
+		bool ok;
+		if (curl_global_init(CURL_GLOBAL_ALL)) {
+			applog(LOG_ERR, "CURL initialization failed");
+			return 1;
+		}
+		/* measure the HTTP path itself, do not follow X-Stratum */
+		want_stratum = false;
+		report = bench_getwork(rpc_url, rpc_userpass, PROGRAM_VERSION);
+		if (!report)
+			return 1;
+		ok = !opt_bench_baseline || bench_compare(report);
+		return (bench_write(report) && ok) ? 0 : 1;
+	}
+
+	if (opt_backend == &cpu_backend) {
+		if (!algo->portable) {
+			applog(LOG_ERR, "algorithm '%s' has no %s backend support", algo->name, opt_backend->name);
+			return 1;
+		}
+		if (!opt_n_threads)
+			opt_n_threads = 1;
+		for (i = 0; i < opt_n_threads; i++) {
+			device_map[i] = i;
+			device_name[i] = strdup("CPU");
+			bus_ids[i] = -1;
+		}
+	} else
+		cuda_devicenames();
+
+	if (!hwmon_init(opt_backend == &cuda_backend))
+		return 1;
+
+
+
+	//for (int i = 0; i < num_processors-1; i++)
+
 	pthread_mutex_init(&stats_lock, NULL);
 	pthread_mutex_init(&g_work_lock, NULL);
 	pthread_mutex_init(&stratum.sock_lock, NULL);
@@ -2072,7 +2445,7 @@ int main(int argc, char *argv[])
 	}
 #endif
 
-	if (num_processors == 0)
+	if (num_processors == 0 && opt_backend == &cuda_backend)
 	{
 		//printline(out_screen, true, "No CUDA devices found! terminating.");
 		applog(LOG_ERR, "No CUDA devices found! terminating.");
@@ -2087,62 +2460,43 @@ int main(int argc, char *argv[])
 		openlog("cpuminer", LOG_PID, LOG_USER);
 #endif
 
-	SetWindow(90,terminal_height);
-	initscr();
-	noecho();
-	raw();
-	cbreak();
-	curs_set(0);
-
-	int info_scr_y = 12 + opt_n_threads;
-
-	getmaxyx(stdscr, parent_y, parent_x);
-	// set up initial windows
-	info_screen = newwin(info_scr_y, parent_x, 0, 0);
-	out_screen = newwin(parent_y - info_scr_y - 1, parent_x, info_scr_y, 0);
-	menu_screen = newwin(1, parent_x, parent_y - 1, 0);
-	wborder(info_screen,' ', ' ', '_', '_', '_', '_', '_', '_');
-	scrollok(out_screen, TRUE);
-	scrollok(info_screen, TRUE);
-	keypad(menu_screen, TRUE);
-	nodelay(menu_screen,TRUE);
-
-	start_color();
-	init_pair(1, COLOR_GREEN, COLOR_BLACK); 
-	init_pair(2, COLOR_WHITE, COLOR_BLACK);
-	init_pair(3, COLOR_CYAN, COLOR_BLACK);
-
-	wcolor_set(out_screen, 1, NULL);
-	wcolor_set(menu_screen, 3, NULL);
-
-	//updatescr();
-
-	//printf
-	vwprintw(out_screen, "     *** ccMiner for nVidia GPUs by Christian Buchner and Christian H. ***\n", NULL);
-	vwprintw(out_screen, "\t             This is version "PROGRAM_VERSION" (beta)\n", NULL);
-	vwprintw(out_screen, "\t  based on pooler-cpuminer 2.3.2 (c) 2010 Jeff Garzik, 2012 pooler\n", NULL);
-	vwprintw(out_screen, "\t  based on pooler-cpuminer extension for HVC from\n\t       https://github.com/heavycoin/cpuminer-heavycoin\n", NULL);
-	vwprintw(out_screen, "\t\t\tand\n\t       http://hvc.1gh.com/\n", NULL);
-	vwprintw(out_screen, "\tCuda additions Copyright 2014 Christian Buchner, Christian H.\n", NULL);
-	vwprintw(out_screen, "\t  LTC donation address: LKS1WDKGED647msBQfLBHV3Ls8sveGncnm\n", NULL);
-	vwprintw(out_screen, "\t  BTC donation address: 16hJF5mceSojnTD3ZTUDqdRhDyPJzoRakM\n", NULL);
-	vwprintw(out_screen, "\t  YAC donation address: Y87sptDEcpLkLeAuex6qZioDbvy1qXZEj4\n", NULL);
-	//updatescr();
-	start_info();
-	show_menu();
-	wcolor_set(out_screen, 2, NULL);
+	if (!opt_headless)
+		ui_init();
+	else {
+		time(&start);
+		applog(LOG_NOTICE, "ccMiner %s (split screen %s) starting", PROGRAM_VERSION, PROGRAM_VERSION_SPLIT_SCREEN);
+	}
 
 	work_restart = (struct work_restart *)calloc(opt_n_threads, sizeof(*work_restart));
 	if (!work_restart)
 		return 1;
 
-	thr_info = (struct thr_info *)calloc(opt_n_threads + 3, sizeof(*thr));
+	thr_info = (struct thr_info *)calloc(opt_n_threads + 3 + opt_verify_threads, sizeof(*thr));
 	if (!thr_info)
 		return 1;
 	
-	thr_hashrates = (double *) calloc(opt_n_threads, sizeof(double));
-	if (!thr_hashrates)
+	devices = (struct device_ctx **) calloc(opt_n_threads, sizeof(*devices));
+	if (!devices)
+		return 1;
+	for (i = 0; i < opt_n_threads; i++) {
+		devices[i] = device_ctx_alloc(i, device_map[i], device_name[i], opt_backend);
+		if (!devices[i])
+			return 1;
+	}
+
+	/* from here on only the log thread writes to the screen */
+	if (!opt_headless)
+		log_ok = logring_start(ui_line, ui_tick);
+#ifdef HAVE_SYSLOG_H
+	else if (use_syslog)
+		log_ok = logring_start(logring_syslog, NULL);
+#endif
+	else
+		log_ok = logring_start(logring_json, NULL);
+	if (!log_ok) {
+		applog(LOG_ERR, "log thread create failed");
 		return 1;
+	}
 
 	//pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
@@ -2156,8 +2510,7 @@ int main(int argc, char *argv[])
 
 	/* start work I/O thread */
 	if (pthread_create(&thr->pth, NULL, workio_thread, thr)) {
-		//applog(LOG_ERR, "workio thread create failed");
-		printline(out_screen, true, "workio thread create failed");
+		applog(LOG_ERR, "workio thread create failed");
 		return 1;
 	}
 
@@ -2172,8 +2525,7 @@ int main(int argc, char *argv[])
 
 		/* start longpoll thread */
 		if (unlikely(pthread_create(&thr->pth, NULL, longpoll_thread, thr))) {
-			//applog(LOG_ERR, "longpoll thread create failed");
-			printline(out_screen, true, "longpoll thread create failed");
+			applog(LOG_ERR, "longpoll thread create failed");
 			return 1;
 		}
 	}
@@ -2188,8 +2540,7 @@ int main(int argc, char *argv[])
 
 		/* start stratum thread */
 		if (unlikely(pthread_create(&thr->pth, NULL, stratum_thread, thr))) {
-			//applog(LOG_ERR, "stratum thread create failed");
-			printline(out_screen, true, "stratum thread create failed");
+			applog(LOG_ERR, "stratum thread create failed");
 			return 1;
 		}
 
@@ -2197,6 +2548,34 @@ int main(int argc, char *argv[])
 			tq_push(thr_info[stratum_thr_id].q, strdup(rpc_url));
 	}
 
+	/* start CPU verification threads, all share one queue */
+	verify_q = tq_new();
+	if (!verify_q)
+		return 1;
+	verify_thr_id = opt_n_threads + 3;
+	for (i = 0; i < opt_verify_threads; i++) {
+		thr = &thr_info[verify_thr_id + i];
+		thr->id = verify_thr_id + i;
+		thr->q = verify_q;
+
+		if (unlikely(pthread_create(&thr->pth, NULL, verify_thread, thr))) {
+			applog(LOG_ERR, "verify thread %d create failed", i);
+			return 1;
+		}
+	}
+
+	/* start the hash rate aggregator, the miner threads only count */
+	if (!hashmeter_start(opt_n_threads)) {
+		applog(LOG_ERR, "hashmeter thread create failed");
+		return 1;
+	}
+
+	/* start the sensor sampler, the miner threads only read its results */
+	if (!telemetry_start(bus_ids, opt_n_threads)) {
+		applog(LOG_ERR, "telemetry thread create failed");
+		return 1;
+	}
+
 	//mvwprintw(info_screen, 8, 0, "GPU phys -d ");
 
 	/* start mining threads */
@@ -2209,8 +2588,7 @@ int main(int argc, char *argv[])
 			return 1;
 
 		if (unlikely(pthread_create(&thr->pth, NULL, miner_thread, thr))) {
-			//applog(LOG_ERR, "thread %d create failed", i);
-			printline(out_screen, true, "thread %d create failed", i);
+			applog(LOG_ERR, "thread %d create failed", i);
 			return 1;
 		}
 
@@ -2224,17 +2602,42 @@ int main(int argc, char *argv[])
 	
 	//mvwprintw(info_screen, 8, i+10, "%s", gpuByPhysicalStr);
 
-	printline(out_screen, true, "%d miner threads started, using '%s' algorithm.", opt_n_threads, algo_names[opt_algo]);
+	printline(out_screen, true, "%d miner threads started, using '%s' algorithm.", opt_n_threads, algo->name);
+
+	if (opt_api_bind) {
+		static struct api_info info;
+
+		info.version = PROGRAM_VERSION;
+		info.algo = algo->name;
+		info.url = rpc_url;
+		info.user = rpc_user;
+		info.start = start;
+		info.devices = devices;
+		info.n_devices = opt_n_threads;
+		info.accepted = &accepted_count;
+		info.rejected = &rejected_count;
+		if (!api_start(&info))
+			return 1;
+	}
 
 	/*applog(LOG_INFO, "%d miner threads started, "
 		"using '%s' algorithm.",
 		opt_n_threads,
-		algo_names[opt_algo]);*/
+		algo->name);*/
 
 #ifdef WIN32
 	timeBeginPeriod(1); // enable high timer precision (similar to Google Chrome Trick)
 #endif
 
+	if (opt_benchmark) {
+		/* the report goes to stdout once the screen is gone */
+		json_t *report = bench_devices(devices, opt_n_threads, algo->name, PROGRAM_VERSION);
+		bool ok;
+		destroywins();
+		ok = !opt_bench_baseline || bench_compare(report);
+		return (bench_write(report) && ok) ? 0 : 1;
+	}
+
 	/* main loop - simply wait for workio thread to exit */
 	pthread_join(thr_info[work_thr_id].pth, NULL);
 
@@ -0,0 +1,360 @@
+//
+// CPU Batch-Pfad fuer die verketteten Hashes mit bedingten Stufen (quark, anime, jackpot)
+//
+// Auf SIMD-Hardware (GPU-Warp oder CPU-Vektoreinheit) muessen bei einer Verzweigung
+// ohne Compaction beide Zweige fuer alle Lanes gerechnet und das Ergebnis per Maske
+// ausgewaehlt werden. Mit Compaction werden die Nonce-Indizes vorher nach dem
+// Praedikat in zwei dichte Listen aufgeteilt, jeder Zweig laeuft voll besetzt und
+// schreibt sein Ergebnis direkt an den urspruenglichen Index zurueck.
+//
+// Hier laeuft alles skalar ueber die sph Funktionen. Die Lanes sind ein Modell:
+// lane_slots zaehlt, was CPU_BATCH_LANES breiter SIMD-Code belegen wuerde, und der
+// maskierte Pfad rechnet beide Zweige nacheinander, wie es die Lanes taeten.
+//
+
+extern "C"
+{
+#include "sph/sph_blake.h"
+#include "sph/sph_bmw.h"
+#include "sph/sph_groestl.h"
+#include "sph/sph_skein.h"
+#include "sph/sph_jh.h"
+#include "sph/sph_keccak.h"
+#include "miner.h"
+}
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "cpu_batch.h"
+
+typedef void (*cpu_hash64_t)(uint32_t *hash);
+
+// Einzelne 64 Byte -> 64 Byte Stufen, rechnen in-place
+static void cpu_blake512_64(uint32_t *hash)
+{
+	sph_blake512_context ctx;
+	sph_blake512_init(&ctx);
+	sph_blake512(&ctx, hash, 64);
+	sph_blake512_close(&ctx, hash);
+}
+
+static void cpu_bmw512_64(uint32_t *hash)
+{
+	sph_bmw512_context ctx;
+	sph_bmw512_init(&ctx);
+	sph_bmw512(&ctx, hash, 64);
+	sph_bmw512_close(&ctx, hash);
+}
+
+static void cpu_groestl512_64(uint32_t *hash)
+{
+	sph_groestl512_context ctx;
+	sph_groestl512_init(&ctx);
+	sph_groestl512(&ctx, hash, 64);
+	sph_groestl512_close(&ctx, hash);
+}
+
+static void cpu_skein512_64(uint32_t *hash)
+{
+	sph_skein512_context ctx;
+	sph_skein512_init(&ctx);
+	sph_skein512(&ctx, hash, 64);
+	sph_skein512_close(&ctx, hash);
+}
+
+static void cpu_jh512_64(uint32_t *hash)
+{
+	sph_jh512_context ctx;
+	sph_jh512_init(&ctx);
+	sph_jh512(&ctx, hash, 64);
+	sph_jh512_close(&ctx, hash);
+}
+
+static void cpu_keccak512_64(uint32_t *hash)
+{
+	sph_keccak512_context ctx;
+	sph_keccak512_init(&ctx);
+	sph_keccak512(&ctx, hash, 64);
+	sph_keccak512_close(&ctx, hash);
+}
+
+static inline uint64_t lanes_round_up(int n)
+{
+	return (uint64_t)((n + CPU_BATCH_LANES - 1) / CPU_BATCH_LANES) * CPU_BATCH_LANES;
+}
+
+// unbedingte Stufe ueber eine (dichte) Indexliste
+static void cpu_batch_stage(cpu_hash64_t fn, uint32_t *hashes, const uint32_t *idx, int n, struct cpu_batch_stats *stats)
+{
+	for (int i = 0; i < n; i++)
+		fn(&hashes[16 * idx[i]]);
+
+	stats->lane_slots += lanes_round_up(n);
+	stats->lane_active += n;
+}
+
+void cpu_batch_partition(const uint32_t *hashes, const uint32_t *idx, int n, uint32_t mask,
+	uint32_t *idxTrue, int *nTrue, uint32_t *idxFalse, int *nFalse)
+{
+	int t = 0, f = 0;
+	for (int i = 0; i < n; i++)
+	{
+		uint32_t k = idx[i];
+		if (hashes[16 * k] & mask)
+			idxTrue[t++] = k;
+		else
+			idxFalse[f++] = k;
+	}
+	*nTrue = t;
+	*nFalse = f;
+}
+
+// bedingte Stufe: (hash[0] & mask) ? fnTrue : fnFalse
+static void cpu_batch_branch(cpu_hash64_t fnTrue, cpu_hash64_t fnFalse, uint32_t mask,
+	uint32_t *hashes, const uint32_t *idx, int n, bool compact,
+	uint32_t *idxTrue, uint32_t *idxFalse, struct cpu_batch_stats *stats)
+{
+	if (compact)
+	{
+		int nTrue, nFalse;
+		cpu_batch_partition(hashes, idx, n, mask, idxTrue, &nTrue, idxFalse, &nFalse);
+		cpu_batch_stage(fnTrue, hashes, idxTrue, nTrue, stats);
+		cpu_batch_stage(fnFalse, hashes, idxFalse, nFalse, stats);
+		return;
+	}
+
+	// maskiert: jede Lanegruppe rechnet beide Zweige, das Praedikat waehlt das Ergebnis
+	uint32_t tmpTrue[CPU_BATCH_LANES][16];
+	uint32_t tmpFalse[CPU_BATCH_LANES][16];
+	for (int g = 0; g < n; g += CPU_BATCH_LANES)
+	{
+		int width = n - g;
+		if (width > CPU_BATCH_LANES) width = CPU_BATCH_LANES;
+
+		for (int l = 0; l < width; l++)
+		{
+			uint32_t *hash = &hashes[16 * idx[g + l]];
+			memcpy(tmpTrue[l], hash, 64);
+			memcpy(tmpFalse[l], hash, 64);
+			fnTrue(tmpTrue[l]);
+			fnFalse(tmpFalse[l]);
+		}
+		for (int l = 0; l < width; l++)
+		{
+			uint32_t *hash = &hashes[16 * idx[g + l]];
+			memcpy(hash, (hash[0] & mask) ? tmpTrue[l] : tmpFalse[l], 64);
+		}
+
+		stats->lane_slots += 2 * CPU_BATCH_LANES;
+		stats->lane_active += width;
+	}
+}
+
+// Arbeitsspeicher fuer die Indexlisten eines Batches
+struct cpu_batch_lists {
+	uint32_t *all;
+	uint32_t *branch1;
+	uint32_t *branch2;
+};
+
+static bool cpu_batch_lists_alloc(struct cpu_batch_lists *l, int count)
+{
+	l->all = (uint32_t*)malloc(count * sizeof(uint32_t));
+	l->branch1 = (uint32_t*)malloc(count * sizeof(uint32_t));
+	l->branch2 = (uint32_t*)malloc(count * sizeof(uint32_t));
+	if (!l->all || !l->branch1 || !l->branch2)
+		return false;
+	for (int i = 0; i < count; i++)
+		l->all[i] = i;
+	return true;
+}
+
+static void cpu_batch_lists_free(struct cpu_batch_lists *l)
+{
+	free(l->all);
+	free(l->branch1);
+	free(l->branch2);
+}
+
+bool quark_cpu_batch_hash(const uint32_t *endiandata, uint32_t startNounce, int count,
+	uint32_t *outputHashes, bool compact, struct cpu_batch_stats *stats)
+{
+	struct cpu_batch_lists l;
+	if (!cpu_batch_lists_alloc(&l, count)) {
+		cpu_batch_lists_free(&l);
+		return false;
+	}
+
+	uint32_t data[20];
+	memcpy(data, endiandata, sizeof(data));
+	for (int i = 0; i < count; i++)
+	{
+		sph_blake512_context ctx;
+		be32enc(&data[19], startNounce + i);
+		sph_blake512_init(&ctx);
+		sph_blake512(&ctx, data, 80);
+		sph_blake512_close(&ctx, &outputHashes[16 * i]);
+	}
+	stats->lane_slots += lanes_round_up(count);
+	stats->lane_active += count;
+
+	cpu_batch_stage(cpu_bmw512_64, outputHashes, l.all, count, stats);
+	cpu_batch_branch(cpu_groestl512_64, cpu_skein512_64, 0x8, outputHashes, l.all, count, compact, l.branch1, l.branch2, stats);
+	cpu_batch_stage(cpu_groestl512_64, outputHashes, l.all, count, stats);
+	cpu_batch_stage(cpu_jh512_64, outputHashes, l.all, count, stats);
+	cpu_batch_branch(cpu_blake512_64, cpu_bmw512_64, 0x8, outputHashes, l.all, count, compact, l.branch1, l.branch2, stats);
+	cpu_batch_stage(cpu_keccak512_64, outputHashes, l.all, count, stats);
+	cpu_batch_stage(cpu_skein512_64, outputHashes, l.all, count, stats);
+	cpu_batch_branch(cpu_keccak512_64, cpu_jh512_64, 0x8, outputHashes, l.all, count, compact, l.branch1, l.branch2, stats);
+
+	cpu_batch_lists_free(&l);
+	return true;
+}
+
+bool anime_cpu_batch_hash(const uint32_t *endiandata, uint32_t startNounce, int count,
+	uint32_t *outputHashes, bool compact, struct cpu_batch_stats *stats)
+{
+	struct cpu_batch_lists l;
+	if (!cpu_batch_lists_alloc(&l, count)) {
+		cpu_batch_lists_free(&l);
+		return false;
+	}
+
+	uint32_t data[20];
+	memcpy(data, endiandata, sizeof(data));
+	for (int i = 0; i < count; i++)
+	{
+		sph_bmw512_context ctx;
+		be32enc(&data[19], startNounce + i);
+		sph_bmw512_init(&ctx);
+		sph_bmw512(&ctx, data, 80);
+		sph_bmw512_close(&ctx, &outputHashes[16 * i]);
+	}
+	stats->lane_slots += lanes_round_up(count);
+	stats->lane_active += count;
+
+	cpu_batch_stage(cpu_blake512_64, outputHashes, l.all, count, stats);
+	cpu_batch_branch(cpu_groestl512_64, cpu_skein512_64, 0x8, outputHashes, l.all, count, compact, l.branch1, l.branch2, stats);
+	cpu_batch_stage(cpu_groestl512_64, outputHashes, l.all, count, stats);
+	cpu_batch_stage(cpu_jh512_64, outputHashes, l.all, count, stats);
+	cpu_batch_branch(cpu_blake512_64, cpu_bmw512_64, 0x8, outputHashes, l.all, count, compact, l.branch1, l.branch2, stats);
+	cpu_batch_stage(cpu_keccak512_64, outputHashes, l.all, count, stats);
+	cpu_batch_stage(cpu_skein512_64, outputHashes, l.all, count, stats);
+	cpu_batch_branch(cpu_keccak512_64, cpu_jh512_64, 0x8, outputHashes, l.all, count, compact, l.branch1, l.branch2, stats);
+
+	cpu_batch_lists_free(&l);
+	return true;
+}
+
+bool jackpot_cpu_batch_hash(const uint32_t *endiandata, uint32_t startNounce, int count,
+	uint32_t *outputHashes, bool compact, struct cpu_batch_stats *stats)
+{
+	struct cpu_batch_lists l;
+	if (!cpu_batch_lists_alloc(&l, count)) {
+		cpu_batch_lists_free(&l);
+		return false;
+	}
+
+	uint32_t data[20];
+	memcpy(data, endiandata, sizeof(data));
+	for (int i = 0; i < count; i++)
+	{
+		sph_keccak512_context ctx;
+		be32enc(&data[19], startNounce + i);
+		sph_keccak512_init(&ctx);
+		sph_keccak512(&ctx, data, 80);
+		sph_keccak512_close(&ctx, &outputHashes[16 * i]);
+	}
+	stats->lane_slots += lanes_round_up(count);
+	stats->lane_active += count;
+
+	for (int round = 0; round < 3; round++)
+	{
+		cpu_batch_branch(cpu_groestl512_64, cpu_skein512_64, 0x01, outputHashes, l.all, count, compact, l.branch1, l.branch2, stats);
+		cpu_batch_branch(cpu_blake512_64, cpu_jh512_64, 0x01, outputHashes, l.all, count, compact, l.branch1, l.branch2, stats);
+	}
+
+	cpu_batch_lists_free(&l);
+	return true;
+}
+
+typedef bool (*cpu_batch_hash_t)(const uint32_t *endiandata, uint32_t startNounce, int count,
+	uint32_t *outputHashes, bool compact, struct cpu_batch_stats *stats);
+
+static double cpu_batch_seconds()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+int cpu_batch_benchmark(int count)
+{
+	static const struct {
+		const char *name;
+		cpu_batch_hash_t fn;
+	} algos[] = {
+		{ "quark",   quark_cpu_batch_hash },
+		{ "anime",   anime_cpu_batch_hash },
+		{ "jackpot", jackpot_cpu_batch_hash },
+	};
+
+	uint32_t endiandata[20];
+	for (int k = 0; k < 20; k++)
+		endiandata[k] = 0x55555555;
+
+	uint32_t *hashMasked = (uint32_t*)malloc((size_t)count * 64);
+	uint32_t *hashCompact = (uint32_t*)malloc((size_t)count * 64);
+	if (!hashMasked || !hashCompact) {
+		fprintf(stderr, "cpu batch benchmark: out of memory\n");
+		free(hashMasked);
+		free(hashCompact);
+		return 1;
+	}
+
+	int rc = 0;
+	// khash/s ist gemessen, die Lane-Spalte nur modelliert (siehe oben)
+	printf("CPU batch benchmark: %d nonces, scalar sph code\n", count);
+	printf("lanes: simulated %d lane model, masked runs both branches per nonce\n", CPU_BATCH_LANES);
+	printf("%-8s %-10s %12s %10s\n", "algo", "mode", "khash/s", "lanes(sim)");
+	for (int a = 0; a < (int)(sizeof(algos) / sizeof(algos[0])); a++)
+	{
+		for (int compact = 0; compact < 2; compact++)
+		{
+			struct cpu_batch_stats stats = { 0, 0 };
+			uint32_t *out = compact ? hashCompact : hashMasked;
+
+			double t0 = cpu_batch_seconds();
+			if (!algos[a].fn(endiandata, 0, count, out, compact != 0, &stats)) {
+				fprintf(stderr, "cpu batch benchmark: out of memory\n");
+				free(hashMasked);
+				free(hashCompact);
+				return 1;
+			}
+			double dt = cpu_batch_seconds() - t0;
+
+			printf("%-8s %-10s %12.2f %9.1f%%\n", algos[a].name,
+				compact ? "compacted" : "masked",
+				dt > 0 ? count / dt / 1000.0 : 0.0,
+				stats.lane_slots ? 100.0 * stats.lane_active / stats.lane_slots : 0.0);
+		}
+
+		// beide Pfade muessen dieselben Hashes liefern
+		for (int i = 0; i < count; i++)
+		{
+			if (memcmp(&hashMasked[16 * i], &hashCompact[16 * i], 32)) {
+				printf("%s: result mismatch at nonce %08x\n", algos[a].name, i);
+				rc = 1;
+				break;
+			}
+		}
+	}
+
+	free(hashMasked);
+	free(hashCompact);
+	return rc;
+}
@@ -0,0 +1,35 @@
+#ifndef _CPU_BATCH_H
+#define _CPU_BATCH_H
+
+#include <stdint.h>
+
+// Anzahl der Lanes, die wir fuer die Auslastungsstatistik annehmen (AVX2: 8x32 Bit).
+// Gerechnet wird skalar mit sph, die Lanes sind nur ein Rechenmodell.
+#define CPU_BATCH_LANES 8
+
+struct cpu_batch_stats {
+	uint64_t lane_slots;	// Lane-Slots, die SIMD-Code belegen wuerde (inkl. maskierter Lanes)
+	uint64_t lane_active;	// davon tatsaechlich benoetigte Lane-Slots
+};
+
+// Hasht count Nonces ab startNounce ueber den 80 Byte Header in endiandata.
+// outputHashes nimmt 16 Worte pro Nonce auf, die ersten 8 Worte sind das Ergebnis.
+// Mit compact=true werden die bedingten Stufen wie auf der GPU ueber dichte
+// Nonce-Listen (Branch 1 / Branch 2) gerechnet, sonst maskiert ueber alle Lanes.
+// false, wenn die Indexlisten nicht belegt werden konnten; outputHashes ist dann ungueltig.
+bool quark_cpu_batch_hash(const uint32_t *endiandata, uint32_t startNounce, int count,
+	uint32_t *outputHashes, bool compact, struct cpu_batch_stats *stats);
+bool anime_cpu_batch_hash(const uint32_t *endiandata, uint32_t startNounce, int count,
+	uint32_t *outputHashes, bool compact, struct cpu_batch_stats *stats);
+bool jackpot_cpu_batch_hash(const uint32_t *endiandata, uint32_t startNounce, int count,
+	uint32_t *outputHashes, bool compact, struct cpu_batch_stats *stats);
+
+// Teilt die Indizes in idx nach Praedikat (hash[0] & mask) in zwei dichte Listen auf
+void cpu_batch_partition(const uint32_t *hashes, const uint32_t *idx, int n, uint32_t mask,
+	uint32_t *idxTrue, int *nTrue, uint32_t *idxFalse, int *nFalse);
+
+// Misst Durchsatz und die modellierte Lane-Auslastung mit und ohne Compaction,
+// gibt 0 bei Erfolg zurueck
+int cpu_batch_benchmark(int count);
+
+#endif
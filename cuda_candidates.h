@@ -0,0 +1,29 @@
+#ifndef CUDA_CANDIDATES_H
+#define CUDA_CANDIDATES_H
+
+// Kandidatenpuffer der Target-Tests: Wort 0 zaehlt alle Treffer des Batches
+// (auch ueber DEVICE_CANDIDATES hinaus), danach folgen die ersten
+// DEVICE_CANDIDATES Nonces in beliebiger Reihenfolge. Der Puffer wird in
+// einem Stueck zurueckgelesen. Braucht device.h und uint32_t.
+
+#define CANDIDATE_WORDS (1 + DEVICE_CANDIDATES)
+
+static __device__ __forceinline__ void candidate_append(uint32_t *buf, uint32_t nounce)
+{
+	uint32_t pos = atomicAdd(&buf[0], 1);
+	if (pos < DEVICE_CANDIDATES)
+		buf[1 + pos] = nounce;
+}
+
+// Nonces aus dem zurueckgelesenen Puffer kopieren, liefert die Zahl der Treffer
+static __host__ int candidate_read(const uint32_t *h_buf, uint32_t *nonces)
+{
+	int count = (int)h_buf[0];
+	int n = (count < DEVICE_CANDIDATES) ? count : DEVICE_CANDIDATES;
+
+	for (int i = 0; i < n; i++)
+		nonces[i] = h_buf[1 + i];
+	return count;
+}
+
+#endif
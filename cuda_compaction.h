@@ -0,0 +1,317 @@
+#ifndef CUDA_COMPACTION_H
+#define CUDA_COMPACTION_H
+
+// Stream-Compaction fuer Nonce-Listen
+//
+// Teilt eine Nonce-Liste (oder ohne Liste alle Nonces startNounce ..
+// startNounce+threads-1) mit einem Test auf den Hash der Nonce auf. Der Test
+// ist ein Funktor und wird als Template-Parameter in die Kernel inlined:
+//
+//   uint32_t operator()(const uint32_t *hashes, uint32_t index) const
+//
+// mit index = nonce - startNounce. Die Listen bleiben in der Reihenfolge der
+// Eingabe. Die *_ref Funktionen sind die Host-Referenz (auch im CPU Backend),
+// die Kernel und compaction_single/_dual brauchen nvcc. Braucht uint32_t.
+
+#ifdef __CUDACC__
+#define COMPACTION_HD __host__ __device__ __forceinline__
+#else
+#define COMPACTION_HD inline
+#endif
+
+// Tests der bedingten Zweige, 16 Worte Hash pro Nonce
+struct compaction_test_quark {
+	COMPACTION_HD uint32_t operator()(const uint32_t *hashes, uint32_t index) const
+	{
+		return ((hashes[index << 4] & 0x08) == 0x08);
+	}
+};
+
+struct compaction_test_jackpot {
+	COMPACTION_HD uint32_t operator()(const uint32_t *hashes, uint32_t index) const
+	{
+		return ((hashes[index << 4] & 0x01) == 0x01);
+	}
+};
+
+// kehrt einen Test um, fuer Compactions die nur den false-Zweig brauchen
+template <class Test>
+struct compaction_not {
+	Test test;
+	COMPACTION_HD uint32_t operator()(const uint32_t *hashes, uint32_t index) const
+	{
+		return !test(hashes, index);
+	}
+};
+
+// Host-Referenz: true -> nonces1, false -> nonces2, beide duerfen NULL sein
+template <class Test>
+static void compaction_dual_ref(const Test &test, int threads, uint32_t startNounce,
+	const uint32_t *hashes, const uint32_t *validNonceTable,
+	uint32_t *nonces1, uint32_t *nrm1, uint32_t *nonces2, uint32_t *nrm2)
+{
+	uint32_t t = 0, f = 0;
+
+	for (int i = 0; i < threads; i++)
+	{
+		uint32_t index = validNonceTable ? validNonceTable[i] - startNounce : (uint32_t)i;
+		if (test(hashes, index)) {
+			if (nonces1)
+				nonces1[t] = startNounce + index;
+			t++;
+		} else {
+			if (nonces2)
+				nonces2[f] = startNounce + index;
+			f++;
+		}
+	}
+	if (nrm1)
+		*nrm1 = t;
+	if (nrm2)
+		*nrm2 = f;
+}
+
+template <class Test>
+static uint32_t compaction_single_ref(const Test &test, int threads, uint32_t startNounce,
+	const uint32_t *hashes, const uint32_t *validNonceTable, uint32_t *nonces)
+{
+	uint32_t nrm;
+	compaction_dual_ref(test, threads, startNounce, hashes, validNonceTable, nonces, &nrm, NULL, NULL);
+	return nrm;
+}
+
+#ifdef __CUDACC__
+
+#define COMPACTION_BLOCKSIZE 256
+// Ebenen der Blocksummen, zwei reichen fuer 256^3 Nonces
+#define COMPACTION_LEVELS 2
+#define COMPACTION_MAX_THREADS (COMPACTION_BLOCKSIZE * COMPACTION_BLOCKSIZE * COMPACTION_BLOCKSIZE)
+
+// Zwischenpuffer eines Threads, ein Satz reicht fuer beliebig viele Tests
+struct compaction_buffers {
+	uint32_t *d_scan;		// inklusive Praefixsummen der Testergebnisse
+	uint32_t *d_partSum[COMPACTION_LEVELS];	// Blocksummen je Ebene
+	uint32_t *h_count;		// pinned, Zahl der true-Treffer
+	int threads;
+};
+
+// inklusive Praefixsumme ueber einen Block per shfl-Scan (vom NVIDIA SDK),
+// alle Threads des Blocks muessen mitlaufen
+static __device__ __forceinline__ uint32_t compaction_block_scan(uint32_t value, uint32_t *partial_sums)
+{
+	__shared__ uint32_t sums[32];
+	int lane_id = threadIdx.x % 32;
+	int warp_id = threadIdx.x / 32;
+
+	// Scan innerhalb des Warps
+#pragma unroll
+	for (int i=1; i<32; i*=2)
+	{
+		uint32_t n = __shfl_up((int)value, i);
+		if (lane_id >= i) value += n;
+	}
+
+	if (lane_id == 31)
+		sums[warp_id] = value;
+
+	__syncthreads();
+
+	// Scan der Warp-Summen im ersten Warp
+	if (warp_id == 0)
+	{
+		uint32_t warp_sum = (lane_id < COMPACTION_BLOCKSIZE / 32) ? sums[lane_id] : 0;
+
+#pragma unroll
+		for (int i=1; i<32; i*=2)
+		{
+			uint32_t n = __shfl_up((int)warp_sum, i);
+			if (lane_id >= i) warp_sum += n;
+		}
+		sums[lane_id] = warp_sum;
+	}
+
+	__syncthreads();
+
+	if (warp_id > 0)
+		value += sums[warp_id-1];
+
+	// der letzte Thread hat die Summe des Blocks
+	if (partial_sums != NULL && threadIdx.x == blockDim.x-1)
+		partial_sums[blockIdx.x] = value;
+
+	return value;
+}
+
+// erste Ebene: Testergebnisse aufsummieren
+template <class Test>
+__global__ void compaction_gpu_scan_test(uint32_t *data, int threads, uint32_t *partial_sums, Test test,
+	uint32_t startNounce, const uint32_t *inpHashes, const uint32_t *d_validNonceTable)
+{
+	int id = ((blockIdx.x * blockDim.x) + threadIdx.x);
+	uint32_t value = 0;
+
+	if (id < threads)
+	{
+		uint32_t index = d_validNonceTable ? d_validNonceTable[id] - startNounce : id;
+		value = test(inpHashes, index);
+	}
+
+	value = compaction_block_scan(value, partial_sums);
+	if (id < threads)
+		data[id] = value;
+}
+
+// weitere Ebenen: Blocksummen in place aufsummieren
+static __global__ void compaction_gpu_scan(uint32_t *data, int len, uint32_t *partial_sums)
+{
+	int id = ((blockIdx.x * blockDim.x) + threadIdx.x);
+	uint32_t value = (id < len) ? data[id] : 0;
+
+	value = compaction_block_scan(value, partial_sums);
+	if (id < len)
+		data[id] = value;
+}
+
+// Summe der vorherigen Bloecke addieren, startet ab dem zweiten Block
+static __global__ void compaction_gpu_add(uint32_t *data, const uint32_t *partial_sums, int len)
+{
+	int id = ((blockIdx.x * blockDim.x) + threadIdx.x);
+
+	if (id < len)
+		data[id] += partial_sums[blockIdx.x];
+}
+
+// Der Scatter: true an Position sum-1, false an Position id-sum
+template <class Test>
+__global__ void compaction_gpu_scatter(const uint32_t *sum, int threads, Test test,
+	uint32_t startNounce, const uint32_t *inpHashes, const uint32_t *d_validNonceTable,
+	uint32_t *d_nonces1, uint32_t *d_nonces2)
+{
+	int id = ((blockIdx.x * blockDim.x) + threadIdx.x);
+
+	if (id < threads)
+	{
+		uint32_t index = d_validNonceTable ? d_validNonceTable[id] - startNounce : id;
+		uint32_t pos = sum[id];
+
+		if (test(inpHashes, index)) {
+			if (d_nonces1)
+				d_nonces1[pos-1] = startNounce + index;
+		} else if (d_nonces2)
+			d_nonces2[id-pos] = startNounce + index;
+	}
+}
+
+static inline int compaction_blocks(int len)
+{
+	return (len + COMPACTION_BLOCKSIZE-1) / COMPACTION_BLOCKSIZE;
+}
+
+static inline void compaction_free(struct compaction_buffers *buf)
+{
+	cudaFree(buf->d_scan);
+	for (int l = 0; l < COMPACTION_LEVELS; l++)
+		cudaFree(buf->d_partSum[l]);
+	cudaFreeHost(buf->h_count);
+	memset(buf, 0, sizeof(*buf));
+}
+
+// Puffer fuer bis zu threads Nonces anlegen, vorhandene groessere bleiben
+static inline bool compaction_alloc(struct compaction_buffers *buf, int threads)
+{
+	if (buf->d_scan && buf->threads >= threads)
+		return true;
+	if (threads > COMPACTION_MAX_THREADS)
+		return false;
+
+	compaction_free(buf);
+
+	int len = (threads > 0) ? threads : 1;
+	bool ok = (cudaMalloc(&buf->d_scan, sizeof(uint32_t) * len) == cudaSuccess);
+	for (int l = 0; l < COMPACTION_LEVELS; l++) {
+		len = compaction_blocks(len);
+		ok = ok && (cudaMalloc(&buf->d_partSum[l], sizeof(uint32_t) * len) == cudaSuccess);
+	}
+	ok = ok && (cudaMallocHost(&buf->h_count, sizeof(uint32_t)) == cudaSuccess);
+
+	if (!ok) {
+		compaction_free(buf);
+		return false;
+	}
+	buf->threads = threads;
+	return true;
+}
+
+// inklusive Praefixsumme ueber len Blocksummen der vorigen Ebene
+static inline void compaction_scan(struct compaction_buffers *buf, cudaStream_t stream,
+	uint32_t *data, int len, int level)
+{
+	int blocks = compaction_blocks(len);
+	uint32_t *partial = (blocks > 1) ? buf->d_partSum[level] : NULL;
+
+	compaction_gpu_scan<<<blocks, COMPACTION_BLOCKSIZE, 0, stream>>>(data, len, partial);
+	if (blocks > 1)
+	{
+		compaction_scan(buf, stream, partial, blocks, level+1);
+		compaction_gpu_add<<<blocks-1, COMPACTION_BLOCKSIZE, 0, stream>>>(data+COMPACTION_BLOCKSIZE, partial, len-COMPACTION_BLOCKSIZE);
+	}
+}
+
+// ein Scan fuer beide Listen, liefert die Zahl der true-Treffer
+template <class Test>
+static uint32_t compaction_run(struct compaction_buffers *buf, cudaStream_t stream, const Test &test,
+	int threads, uint32_t startNounce, const uint32_t *d_hashes, const uint32_t *d_validNonceTable,
+	uint32_t *d_nonces1, uint32_t *d_nonces2)
+{
+	if (threads <= 0)
+		return 0;
+
+	int blocks = compaction_blocks(threads);
+	uint32_t *partial = (blocks > 1) ? buf->d_partSum[0] : NULL;
+
+	compaction_gpu_scan_test<Test><<<blocks, COMPACTION_BLOCKSIZE, 0, stream>>>(
+		buf->d_scan, threads, partial, test, startNounce, d_hashes, d_validNonceTable);
+	if (blocks > 1)
+	{
+		compaction_scan(buf, stream, partial, blocks, 1);
+		compaction_gpu_add<<<blocks-1, COMPACTION_BLOCKSIZE, 0, stream>>>(buf->d_scan+COMPACTION_BLOCKSIZE, partial, threads-COMPACTION_BLOCKSIZE);
+	}
+
+	compaction_gpu_scatter<Test><<<blocks, COMPACTION_BLOCKSIZE, 0, stream>>>(
+		buf->d_scan, threads, test, startNounce, d_hashes, d_validNonceTable, d_nonces1, d_nonces2);
+
+	// die letzte Praefixsumme ist die Zahl der true-Treffer
+	cudaMemcpyAsync(buf->h_count, buf->d_scan+threads-1, sizeof(uint32_t), cudaMemcpyDeviceToHost, stream);
+	cudaStreamSynchronize(stream);
+	return *buf->h_count;
+}
+
+// Wenn d_validNonceTable genutzt wird, ist threads die Laenge dieser Liste.
+// Eine der beiden Ausgabelisten darf NULL sein.
+template <class Test>
+static void compaction_dual(struct compaction_buffers *buf, cudaStream_t stream, const Test &test,
+	int threads, uint32_t startNounce, const uint32_t *d_hashes, const uint32_t *d_validNonceTable,
+	uint32_t *d_nonces1, uint32_t *nrm1, uint32_t *d_nonces2, uint32_t *nrm2)
+{
+	uint32_t n = compaction_run(buf, stream, test, threads, startNounce, d_hashes, d_validNonceTable,
+		d_nonces1, d_nonces2);
+
+	if (nrm1)
+		*nrm1 = n;
+	if (nrm2)
+		*nrm2 = (threads > 0) ? (uint32_t)threads - n : 0;
+}
+
+// nur die Nonces, deren Test true liefert
+template <class Test>
+static uint32_t compaction_single(struct compaction_buffers *buf, cudaStream_t stream, const Test &test,
+	int threads, uint32_t startNounce, const uint32_t *d_hashes, const uint32_t *d_validNonceTable,
+	uint32_t *d_nonces)
+{
+	return compaction_run(buf, stream, test, threads, startNounce, d_hashes, d_validNonceTable,
+		d_nonces, (uint32_t *)NULL);
+}
+
+#endif /* __CUDACC__ */
+
+#endif
@@ -5,12 +5,14 @@
 #include <stdio.h>
 #include <memory.h>
 
+#include "device.h"
+
 #include "sph/sph_fugue.h"
 
 #define USE_SHARED 1
 
 // aus cpu-miner.c
-extern int device_map[8];
+extern int device_map[MAX_GPUS];
 
 // aus heavy.cu
 extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
@@ -20,11 +22,13 @@ typedef unsigned char uint8_t;
 typedef unsigned int uint32_t;
 typedef unsigned long long uint64_t;
 
+#include "cuda_candidates.h"
+
 // schon in sph_fugue.h definiert
 //#define SPH_C32(x)	((uint32_t)(x ## U))
 
-uint32_t *d_fugue256_hashoutput[8];
-uint32_t *d_resultNonce[8];
+uint32_t *d_fugue256_hashoutput[MAX_GPUS];
+uint32_t *d_resultNonce[MAX_GPUS];
 
 __constant__ uint32_t GPUstate[30]; // Single GPU
 __constant__ uint32_t pTarget[8]; // Single GPU
@@ -715,22 +719,21 @@ fugue256_gpu_hash(int thr_id, int threads, uint32_t startNounce, void *outputHas
 		}
 
 		if(rc == true)
-		{
-			if(resNounce[0] > nounce)
-				resNounce[0] = nounce;
-		}
+			candidate_append(resNounce, nounce);
 	}
 }
 
+// Tabellen einmal pro Thread anlegen, ein neues Init bindet sie nur
 #define texDef(texname, texmem, texsource, texsize) \
-	unsigned int *texmem; \
-	cudaMalloc(&texmem, texsize); \
-	cudaMemcpy(texmem, texsource, texsize, cudaMemcpyHostToDevice); \
+	static unsigned int *texmem[MAX_GPUS]; \
+	if (!texmem[thr_id]) { \
+	  cudaMalloc(&texmem[thr_id], texsize); \
+	  cudaMemcpy(texmem[thr_id], texsource, texsize, cudaMemcpyHostToDevice); } \
 	texname.normalized = 0; \
 	texname.filterMode = cudaFilterModePoint; \
 	texname.addressMode[0] = cudaAddressModeClamp; \
 	{ cudaChannelFormatDesc channelDesc = cudaCreateChannelDesc<unsigned int>(); \
-	  cudaBindTexture(NULL, &texname, texmem, &channelDesc, texsize ); }
+	  cudaBindTexture(NULL, &texname, texmem[thr_id], &channelDesc, texsize ); }
 
 
 void fugue256_cpu_init(int thr_id, int threads)
@@ -743,9 +746,11 @@ void fugue256_cpu_init(int thr_id, int threads)
 	texDef(mixTab2Tex, mixTab2m, mixtab2_cpu, sizeof(uint32_t)*256);
 	texDef(mixTab3Tex, mixTab3m, mixtab3_cpu, sizeof(uint32_t)*256);
 
-	// Speicher fr alle Ergebnisse belegen
+	// Speicher fr alle Ergebnisse belegen, den eines frueheren Batches ersetzen
+	cudaFree(d_fugue256_hashoutput[thr_id]);
 	cudaMalloc(&d_fugue256_hashoutput[thr_id], 8 * sizeof(uint32_t) * threads);
-	cudaMalloc(&d_resultNonce[thr_id], sizeof(uint32_t)); 
+	if (!d_resultNonce[thr_id])
+		cudaMalloc(&d_resultNonce[thr_id], CANDIDATE_WORDS*sizeof(uint32_t)); 
 }
 
 __host__ void fugue256_cpu_setBlock(int thr_id, void *data, void *pTargetIn)
@@ -762,12 +767,12 @@ __host__ void fugue256_cpu_setBlock(int thr_id, void *data, void *pTargetIn)
 	cudaMemcpyToSymbol(	pTarget,
 						pTargetIn,
 						sizeof(uint32_t) * 8 );
-
-	cudaMemset(d_resultNonce[thr_id], 0xFF, sizeof(uint32_t));
 }
 
-__host__ void fugue256_cpu_hash(int thr_id, int threads, int startNounce, void *outputHashes, uint32_t *nounce)
+__host__ int fugue256_cpu_hash(int thr_id, int threads, int startNounce, void *outputHashes, uint32_t *nonces)
 {
+	uint32_t h_result[CANDIDATE_WORDS];
+
 #if USE_SHARED
 	const int threadsperblock = 256; // Alignment mit mixtab Grsse. NICHT NDERN
 #else
@@ -783,11 +788,14 @@ __host__ void fugue256_cpu_hash(int thr_id, int threads, int startNounce, void *
 #else
 	size_t shared_size = 0;
 #endif
+	// der Zaehler muss pro Batch zurueck, sonst meldet jeder Batch die alten Treffer
+	cudaMemset(d_resultNonce[thr_id], 0, sizeof(uint32_t));
 	fugue256_gpu_hash<<<grid, block, shared_size>>>(thr_id, threads, startNounce, d_fugue256_hashoutput[thr_id], d_resultNonce[thr_id]);
 
 	// Strategisches Sleep Kommando zur Senkung der CPU Last
 	MyStreamSynchronize(NULL, 0, thr_id);
 
 	//cudaMemcpy(outputHashes, d_fugue256_hashoutput[thr_id], 8 * sizeof(uint32_t), cudaMemcpyDeviceToHost);
-	cudaMemcpy(nounce, d_resultNonce[thr_id], sizeof(uint32_t), cudaMemcpyDeviceToHost);
+	cudaMemcpy(h_result, d_resultNonce[thr_id], sizeof(h_result), cudaMemcpyDeviceToHost);
+	return candidate_read(h_result, nonces);
 }
@@ -7,8 +7,10 @@
 #include <stdio.h>
 #include <memory.h>
 
+#include "device.h"
+
 // aus cpu-miner.c
-extern int device_map[8];
+extern int device_map[MAX_GPUS];
 
 // aus heavy.cu
 extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
@@ -18,12 +20,14 @@ typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
 
+#include "cuda_candidates.h"
+
 // diese Struktur wird in der Init Funktion angefordert
-static cudaDeviceProp props[8];
+static cudaDeviceProp props[MAX_GPUS];
 
 // globaler Speicher fr alle HeftyHashes aller Threads
 __constant__ uint32_t pTarget[8]; // Single GPU
-extern uint32_t *d_resultNonce[8];
+extern uint32_t *d_resultNonce[MAX_GPUS];
 
 __constant__ uint32_t groestlcoin_gpu_msg[32];
 
@@ -97,8 +101,7 @@ __global__ void __launch_bounds__(256, 4)
             }
 
             if(rc == true)
-                if(resNounce[0] > nounce)
-                    resNounce[0] = nounce;
+                candidate_append(resNounce, nounce);
         }
     }
 }
@@ -110,8 +113,9 @@ __host__ void groestlcoin_cpu_init(int thr_id, int threads)
 
     cudaGetDeviceProperties(&props[thr_id], device_map[thr_id]);
 
-    // Speicher fr Gewinner-Nonce belegen
-    cudaMalloc(&d_resultNonce[thr_id], sizeof(uint32_t)); 
+    // Speicher fr die Gewinner-Nonces belegen, einmal pro Thread
+    if (!d_resultNonce[thr_id])
+        cudaMalloc(&d_resultNonce[thr_id], CANDIDATE_WORDS*sizeof(uint32_t)); 
 }
 
 __host__ void groestlcoin_cpu_setBlock(int thr_id, void *data, void *pTargetIn)
@@ -135,14 +139,14 @@ __host__ void groestlcoin_cpu_setBlock(int thr_id, void *data, void *pTargetIn)
                         msgBlock,
                         128);
 
-    cudaMemset(d_resultNonce[thr_id], 0xFF, sizeof(uint32_t));
     cudaMemcpyToSymbol( pTarget,
                         pTargetIn,
                         sizeof(uint32_t) * 8 );
 }
 
-__host__ void groestlcoin_cpu_hash(int thr_id, int threads, uint32_t startNounce, void *outputHashes, uint32_t *nounce)
+__host__ int groestlcoin_cpu_hash(int thr_id, int threads, uint32_t startNounce, void *outputHashes, uint32_t *nonces)
 {
+    uint32_t h_result[CANDIDATE_WORDS];
     int threadsperblock = 256;
 
     // Compute 3.0 benutzt die registeroptimierte Quad Variante mit Warp Shuffle
@@ -156,11 +160,12 @@ __host__ void groestlcoin_cpu_hash(int thr_id, int threads, uint32_t startNounce
     // Gre des dynamischen Shared Memory Bereichs
     size_t shared_size = 0;
 
-    cudaMemset(d_resultNonce[thr_id], 0xFF, sizeof(uint32_t));
+    cudaMemset(d_resultNonce[thr_id], 0, sizeof(uint32_t));
     groestlcoin_gpu_hash_quad<<<grid, block, shared_size>>>(threads, startNounce, d_resultNonce[thr_id]);
 
     // Strategisches Sleep Kommando zur Senkung der CPU Last
     MyStreamSynchronize(NULL, 0, thr_id);
 
-    cudaMemcpy(nounce, d_resultNonce[thr_id], sizeof(uint32_t), cudaMemcpyDeviceToHost);
+    cudaMemcpy(h_result, d_resultNonce[thr_id], sizeof(h_result), cudaMemcpyDeviceToHost);
+    return candidate_read(h_result, nonces);
 }
@@ -7,8 +7,10 @@
 #include <stdio.h>
 #include <memory.h>
 
+#include "device.h"
+
 // aus cpu-miner.c
-extern int device_map[8];
+extern int device_map[MAX_GPUS];
 
 // aus heavy.cu
 extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
@@ -18,13 +20,15 @@ typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
 
+#include "cuda_candidates.h"
+
 // diese Struktur wird in der Init Funktion angefordert
-static cudaDeviceProp props[8];
+static cudaDeviceProp props[MAX_GPUS];
 
 // globaler Speicher fr alle HeftyHashes aller Threads
 __constant__ uint32_t pTarget[8]; // Single GPU
-uint32_t *d_outputHashes[8];
-extern uint32_t *d_resultNonce[8];
+uint32_t *d_outputHashes[MAX_GPUS];
+extern uint32_t *d_resultNonce[MAX_GPUS];
 
 __constant__ uint32_t myriadgroestl_gpu_msg[32];
 
@@ -304,8 +308,7 @@ __global__ void
         }
 
         if(rc == true)
-            if(resNounce[0] > nounce)
-                resNounce[0] = nounce;
+            candidate_append(resNounce, nounce);
     }
 }
 
@@ -333,10 +336,12 @@ __host__ void myriadgroestl_cpu_init(int thr_id, int threads)
 
     cudaGetDeviceProperties(&props[thr_id], device_map[thr_id]);
 
-    // Speicher fr Gewinner-Nonce belegen
-    cudaMalloc(&d_resultNonce[thr_id], sizeof(uint32_t)); 
+    // Speicher fr die Gewinner-Nonces belegen, einmal pro Thread
+    if (!d_resultNonce[thr_id])
+        cudaMalloc(&d_resultNonce[thr_id], CANDIDATE_WORDS*sizeof(uint32_t)); 
 
-    // Speicher fr temporreHashes
+    // Speicher fr temporreHashes, den eines frueheren Batches ersetzen
+    cudaFree(d_outputHashes[thr_id]);
     cudaMalloc(&d_outputHashes[thr_id], 16*sizeof(uint32_t)*threads); 
 }
 
@@ -361,14 +366,14 @@ __host__ void myriadgroestl_cpu_setBlock(int thr_id, void *data, void *pTargetIn
                         msgBlock,
                         128);
 
-    cudaMemset(d_resultNonce[thr_id], 0xFF, sizeof(uint32_t));
     cudaMemcpyToSymbol( pTarget,
                         pTargetIn,
                         sizeof(uint32_t) * 8 );
 }
 
-__host__ void myriadgroestl_cpu_hash(int thr_id, int threads, uint32_t startNounce, void *outputHashes, uint32_t *nounce)
+__host__ int myriadgroestl_cpu_hash(int thr_id, int threads, uint32_t startNounce, void *outputHashes, uint32_t *nonces)
 {
+    uint32_t h_result[CANDIDATE_WORDS];
     int threadsperblock = 256;
 
     // Compute 3.0 benutzt die registeroptimierte Quad Variante mit Warp Shuffle
@@ -378,7 +383,7 @@ __host__ void myriadgroestl_cpu_hash(int thr_id, int threads, uint32_t startNoun
     // Gre des dynamischen Shared Memory Bereichs
     size_t shared_size = 0;
 
-    cudaMemset(d_resultNonce[thr_id], 0xFF, sizeof(uint32_t));
+    cudaMemset(d_resultNonce[thr_id], 0, sizeof(uint32_t));
     // berechne wie viele Thread Blocks wir brauchen
     dim3 grid(factor*((threads + threadsperblock-1)/threadsperblock));
     dim3 block(threadsperblock);
@@ -390,5 +395,6 @@ __host__ void myriadgroestl_cpu_hash(int thr_id, int threads, uint32_t startNoun
     // Strategisches Sleep Kommando zur Senkung der CPU Last
     MyStreamSynchronize(NULL, 0, thr_id);
 
-    cudaMemcpy(nounce, d_resultNonce[thr_id], sizeof(uint32_t), cudaMemcpyDeviceToHost);
+    cudaMemcpy(h_result, d_resultNonce[thr_id], sizeof(h_result), cudaMemcpyDeviceToHost);
+    return candidate_read(h_result, nonces);
 }
@@ -0,0 +1,153 @@
+//
+// Warten auf die GPU
+//
+// Jeder Miner-Thread hat seinen eigenen Zustand, es gibt keine gemeinsame
+// Tabelle mehr. Gewartet wird immer auf ein Event hinter der Stufe, die Art
+// bestimmt opt_sync_policy:
+//
+//   spin      Event pollen, kleinste Latenz, kostet einen Kern pro GPU
+//   yield     pollen und dazwischen die Zeitscheibe abgeben
+//   blocking  der Treiber legt den Thread schlafen (cudaEventBlockingSync)
+//   sleep     95% der erwarteten Zeit schlafen, den Rest warten (wie bisher)
+//
+// Die erwartete Zeit misst die GPU selbst: beim Aufruf wird ein Event auf
+// einem leeren Stream gesetzt, der Abstand zum Event der Stufe ist die
+// Restzeit, egal wie lange der Thread danach geschlafen hat.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <cuda.h>
+#include "cuda_runtime.h"
+
+#include "miner.h"
+#include "cuda_sync.h"
+
+// aus heavy.cu
+extern cudaStream_t gpustream[MAX_GPUS];
+
+enum sync_policy opt_sync_policy = SYNC_SLEEP;
+
+static const char *sync_policy_names[] = { "spin", "yield", "blocking", "sleep" };
+
+// Situationen mit eigener Vorhersage, die Stufen-Nummern werden gefaltet
+#define SYNC_SITUATIONS 32
+
+struct DEVICE_ALIGN sync_state {
+	bool init;
+	cudaStream_t idle;		// bleibt leer, traegt nur die Marken
+	cudaEvent_t mark;		// Zeitpunkt des Aufrufs
+	cudaEvent_t done;		// Ende der Stufe fuer MyStreamSynchronize
+	double predict[SYNC_SITUATIONS + 1];	// erwartete Restzeit (s)
+	bool seen[SYNC_SITUATIONS + 1];
+};
+
+static struct sync_state sync_states[MAX_GPUS];
+
+extern "C" bool sync_policy_by_name(const char *name, enum sync_policy *policy)
+{
+	for (int i = 0; i <= SYNC_SLEEP; i++)
+	{
+		if (!strcmp(name, sync_policy_names[i]))
+		{
+			*policy = (enum sync_policy)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+extern "C" const char *sync_policy_name(enum sync_policy policy)
+{
+	return sync_policy_names[policy];
+}
+
+extern "C" unsigned int cuda_sync_event_flags(void)
+{
+	return (opt_sync_policy == SYNC_BLOCKING) ? cudaEventBlockingSync : cudaEventDefault;
+}
+
+// im Miner-Thread, das Device ist schon gewaehlt
+static bool sync_state_init(struct sync_state *s)
+{
+	if (s->init)
+		return true;
+	if (cudaStreamCreateWithFlags(&s->idle, cudaStreamNonBlocking) != cudaSuccess)
+		return false;
+	cudaEventCreate(&s->mark);
+	cudaEventCreateWithFlags(&s->done, cuda_sync_event_flags());
+	s->init = true;
+	return true;
+}
+
+extern "C" cudaError_t cuda_sync_event(int thr_id, cudaEvent_t event, int situation)
+{
+	struct sync_state *s = &sync_states[thr_id];
+	int k = (situation == SYNC_BATCH) ? SYNC_SITUATIONS : (situation >= 0) ? situation % SYNC_SITUATIONS : 0;
+	cudaError_t result;
+	bool marked;
+	float remain;
+
+	result = cudaEventQuery(event);
+	if (result != cudaErrorNotReady)
+	{
+		// schon fertig, die Vorhersage geht gegen 0
+		if (situation >= 0)
+			s->predict[k] *= 0.95;
+		return result;
+	}
+
+	marked = sync_state_init(s) && cudaEventRecord(s->mark, s->idle) == cudaSuccess;
+
+	switch (opt_sync_policy)
+	{
+	case SYNC_SPIN:
+		while ((result = cudaEventQuery(event)) == cudaErrorNotReady)
+			;
+		break;
+	case SYNC_YIELD:
+		while ((result = cudaEventQuery(event)) == cudaErrorNotReady)
+			sched_yield();
+		break;
+	case SYNC_SLEEP:
+		if (situation >= 0 && s->predict[k] > 0.0)
+			usleep((useconds_t)(1e6 * 0.95 * s->predict[k]));
+		result = cudaEventSynchronize(event);
+		break;
+	default:
+		result = cudaEventSynchronize(event);
+		break;
+	}
+
+	if (situation >= 0 && marked && cudaEventSynchronize(s->mark) == cudaSuccess &&
+		cudaEventElapsedTime(&remain, s->mark, event) == cudaSuccess)
+	{
+		double t = (remain > 0.0f) ? 1e-3 * remain : 0.0;
+
+		// schnelle erste Konvergenz
+		s->predict[k] = s->seen[k] ? 0.95 * s->predict[k] + 0.05 * t : t;
+		s->seen[k] = true;
+	}
+	return result;
+}
+
+// Wartet auf die Stufen eines Kernel-Moduls. Stufen auf einem Pipeline-Stream
+// laufen ohne Zwischen-Sync durch, gewartet wird einmal pro Batch auf das
+// Event des Slots (device_cuda.cu)
+cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id)
+{
+	struct sync_state *s = &sync_states[thr_id];
+
+	if (situation >= 0 && stream != NULL && stream == gpustream[thr_id])
+		return cudaSuccess;
+
+	if (!sync_state_init(s) || cudaEventRecord(s->done, stream) != cudaSuccess)
+		return cudaStreamSynchronize(stream);
+	return cuda_sync_event(thr_id, s->done, situation);
+}
@@ -0,0 +1,41 @@
+#ifndef __CUDA_SYNC_H__
+#define __CUDA_SYNC_H__
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* how a miner thread waits for its GPU, see cuda_sync.cu */
+enum sync_policy {
+	SYNC_SPIN,		/* poll the event, lowest latency, one core per GPU */
+	SYNC_YIELD,		/* poll, give up the time slice in between */
+	SYNC_BLOCKING,		/* the driver puts the thread to sleep */
+	SYNC_SLEEP		/* sleep most of the predicted time, wait for the rest */
+};
+
+extern enum sync_policy opt_sync_policy;
+
+/* false for unknown names */
+extern bool sync_policy_by_name(const char *name, enum sync_policy *policy);
+extern const char *sync_policy_name(enum sync_policy policy);
+
+/* situation of the per batch wait of the CUDA backend; the kernel modules
+ * pass their stage order */
+#define SYNC_BATCH 1000
+
+#ifdef __CUDACC__
+/* flags for events that cuda_sync_event() waits on */
+extern unsigned int cuda_sync_event_flags(void);
+
+/* waits for the event with opt_sync_policy; situation >= 0 keys the
+ * predicted time in the state of the miner thread */
+extern cudaError_t cuda_sync_event(int thr_id, cudaEvent_t event, int situation);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CUDA_SYNC_H__ */
@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "device_backend.h"
+
+extern "C" struct device_ctx *device_ctx_alloc(int thr_id, int device_id, const char *name,
+	const struct device_backend *backend)
+{
+	struct device_ctx *ctx;
+
+#ifdef _MSC_VER
+	ctx = (struct device_ctx *)_aligned_malloc(sizeof(*ctx), 64);
+#else
+	if (posix_memalign((void **)&ctx, 64, sizeof(*ctx)))
+		ctx = NULL;
+#endif
+	if (!ctx)
+		return NULL;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->thr_id = thr_id;
+	ctx->device_id = device_id;
+	ctx->name = name;
+	ctx->backend = backend ? backend : &cuda_backend;
+	return ctx;
+}
+
+static void device_arena_release(struct device_ctx *ctx, int kind)
+{
+	struct device_arena *arena = &ctx->arena;
+
+	if (kind == ARENA_DEVICE)
+		ctx->backend->release(ctx, arena->base[kind]);
+	else
+		ctx->backend->release_host(ctx, arena->base[kind]);
+	arena->base[kind] = NULL;
+	arena->size[kind] = 0;
+	arena->used[kind] = 0;
+}
+
+extern "C" bool device_arena_reserve(struct device_ctx *ctx, size_t device_bytes, size_t host_bytes)
+{
+	struct device_arena *arena = &ctx->arena;
+	const size_t bytes[2] = { device_bytes, host_bytes };
+	int kind;
+
+	for (kind = ARENA_DEVICE; kind <= ARENA_HOST; kind++)
+	{
+		arena->used[kind] = 0;
+		if (arena->size[kind] >= bytes[kind])
+			continue;
+
+		device_arena_release(ctx, kind);
+		arena->base[kind] = (char *)((kind == ARENA_DEVICE) ?
+			ctx->backend->alloc(ctx, bytes[kind]) : ctx->backend->alloc_host(ctx, bytes[kind]));
+		arena->allocs++;
+		if (!arena->base[kind])
+			return false;
+		arena->size[kind] = bytes[kind];
+	}
+	return true;
+}
+
+extern "C" void *device_arena_alloc(struct device_ctx *ctx, enum arena_kind kind, size_t size)
+{
+	struct device_arena *arena = &ctx->arena;
+	size_t bytes = device_arena_size(size);
+	void *ptr;
+
+	if (!arena->base[kind] || arena->used[kind] + bytes > arena->size[kind])
+		return NULL;
+
+	ptr = arena->base[kind] + arena->used[kind];
+	arena->used[kind] += bytes;
+	return ptr;
+}
+
+extern "C" void device_ctx_reset(struct device_ctx *ctx)
+{
+	// auch nach einem fehlgeschlagenen Init: Arena und Modulpuffer koennen
+	// schon halb angelegt sein, nur ein nie benutzter Kontext bleibt liegen
+	if (!ctx->init && !ctx->arena.allocs && !ctx->backend_data)
+		return;
+
+	device_arena_release(ctx, ARENA_DEVICE);
+	device_arena_release(ctx, ARENA_HOST);
+	ctx->backend->reset(ctx);
+
+	memset(ctx->d_hash, 0, sizeof(ctx->d_hash));
+	memset(ctx->d_nonces, 0, sizeof(ctx->d_nonces));
+	memset(ctx->upload_key, 0, sizeof(ctx->upload_key));
+	ctx->throughput = 0;
+	ctx->init = false;
+}
+
+extern "C" void device_ctx_free(struct device_ctx *ctx)
+{
+	if (!ctx)
+		return;
+
+	device_ctx_reset(ctx);
+	free(ctx->profile);
+#ifdef _MSC_VER
+	_aligned_free(ctx);
+#else
+	free(ctx);
+#endif
+}
+
+// Miner-Thread, der zuletzt Konstanten auf das Device geladen hat. Die
+// __constant__ Symbole gibt es einmal pro CUDA Kontext, laufen zwei Threads
+// auf derselben GPU, gilt der Schluessel nur fuer den letzten.
+static volatile int upload_owner[MAX_GPUS][DEVICE_UPLOADS];
+
+extern "C" bool device_upload_needed(struct device_ctx *ctx, enum upload_kind kind, const void *data, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	unsigned long long key = 14695981039346656037ULL;	// FNV-1a
+	int owner = ctx->thr_id + 1;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		// Nonce-Wort des Headers
+		if (kind == UPLOAD_BLOCK && i >= 76 && i < 80)
+			continue;
+		key = (key ^ p[i]) * 1099511628211ULL;
+	}
+	key = ((key ^ len) * 1099511628211ULL) | 1;
+
+	if (ctx->upload_key[kind] == key && upload_owner[ctx->device_id % MAX_GPUS][kind] == owner)
+		return false;
+	ctx->upload_key[kind] = key;
+	upload_owner[ctx->device_id % MAX_GPUS][kind] = owner;
+	return true;
+}
+
+extern "C" const char *hash_stage_name(enum hash_stage stage)
+{
+	static const char *names[STAGE_COUNT] = {
+		"blake512_80", "keccak512_80",
+		"blake512", "bmw512", "groestl512", "doublegroestl512", "skein512", "jh512",
+		"keccak512", "luffa512", "cubehash512", "shavite512", "simd512", "echo512",
+		"check", "compact_quark", "compact_jackpot"
+	};
+	return names[stage];
+}
+
+extern "C" const struct device_backend *device_backend_by_name(const char *name)
+{
+	if (!strcmp(name, cuda_backend.name))
+		return &cuda_backend;
+	if (!strcmp(name, cpu_backend.name))
+		return &cpu_backend;
+	return NULL;
+}
@@ -0,0 +1,110 @@
+#ifndef __DEVICE_H__
+#define __DEVICE_H__
+
+/* no includes here: the CUDA modules pull this in next to their own
+ * uint32_t/uint64_t typedefs, so only built-in types are used below */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* upper bound for the per-device tables that are still indexed by
+ * thr_id or device number (device_map, CUDA module state) */
+#define MAX_GPUS 32
+
+/* batches in flight per device, see device_backend.h */
+#define DEVICE_SLOTS 2
+
+/* nonces one target check reports per batch, see cuda_candidates.h */
+#define DEVICE_CANDIDATES 16
+
+/* kinds of per work constants, see device_upload_needed() */
+#define DEVICE_UPLOADS 2
+
+#ifdef _MSC_VER
+#define DEVICE_ALIGN __declspec(align(64))
+#else
+#define DEVICE_ALIGN __attribute__((aligned(64)))
+#endif
+
+struct work;
+struct device_backend;
+struct device_profile;
+
+/* device and pinned host memory of the active algorithm: one block of
+ * each, reserved at scanhash init and carved into the stage buffers, see
+ * device_arena_reserve() */
+struct device_arena {
+	char *base[2];			/* ARENA_DEVICE, ARENA_HOST */
+	unsigned long long size[2];
+	unsigned long long used[2];
+	unsigned long allocs;		/* backend allocations, never reset */
+};
+
+struct verify_stats {
+	unsigned long checked;
+	unsigned long invalid;
+	double latency;		/* ms, moving average */
+};
+
+/* everything one miner thread keeps about its GPU, allocated once per
+ * thread and aligned so two devices never share a cache line */
+struct DEVICE_ALIGN device_ctx {
+	int thr_id;		/* miner thread, index for the CUDA module state */
+	int device_id;		/* CUDA device number, device_map[thr_id] */
+	const char *name;
+
+	/* compute backend, see device_backend.h */
+	const struct device_backend *backend;
+	void *backend_data;
+
+	/* scanhash state of the active algorithm, see device_ctx_reset() */
+	bool init;
+	int throughput;
+	int intensity;		/* batch = default << intensity, see autotune.h */
+	int batch;		/* nonces per batch of the last scanhash call */
+	unsigned int *d_hash[DEVICE_SLOTS];	/* chained hashes, 16 words per nonce */
+	unsigned int *d_nonces[4];	/* nonce vectors for the conditional branches */
+	struct device_arena arena;	/* owns d_hash and d_nonces */
+	unsigned long long upload_key[DEVICE_UPLOADS];	/* constants on the device, 0 = none */
+
+	/* per stage timing with --profile, see profile.h */
+	struct device_profile *profile;
+
+	/* work currently scanned by the miner thread */
+	struct work *cur_work;
+
+	/* pipelined scanhash, written by the owning miner thread only */
+	double gpu_idle;	/* ms the GPU waited for the host per batch, moving average */
+	unsigned long batches;
+
+	/* target check results, see submit_candidates() */
+	unsigned long checked_batches;
+	unsigned long candidates;	/* nonces below target, including dropped ones */
+	unsigned long dropped;		/* candidates beyond DEVICE_CANDIDATES */
+
+	/* last scanhash call, owning miner thread only; windowed rates for
+	 * the other threads are in hashmeter.h */
+	double hashrate;
+	double cpu_load;	/* cores the miner thread used while scanning */
+	double cpu_time;	/* s of host CPU spent on this device */
+
+	/* written by the verify threads, guarded by stats_lock */
+	struct verify_stats verify;
+};
+
+extern struct device_ctx *device_ctx_alloc(int thr_id, int device_id, const char *name,
+	const struct device_backend *backend);
+/* frees the arena and backend state of the active algorithm, also after
+ * a failed init; scanhash re-inits */
+extern void device_ctx_reset(struct device_ctx *ctx);
+extern void device_ctx_free(struct device_ctx *ctx);
+
+/* "cuda" or "cpu", NULL for unknown names */
+extern const struct device_backend *device_backend_by_name(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DEVICE_H__ */
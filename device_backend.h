@@ -0,0 +1,164 @@
+#ifndef __DEVICE_BACKEND_H__
+#define __DEVICE_BACKEND_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "device.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Compute backend behind a device_ctx. The scanhash front ends only talk
+ * to ctx->backend, so the same hash pipeline runs on the CUDA kernels or
+ * on the sph reference code in a host thread pool.
+ *
+ * Buffers follow the CUDA kernels: d_hash holds 16 words per nonce at
+ * index (nonce - startNounce), nonce vectors hold absolute nonces and a
+ * NULL vector means all nonces startNounce .. startNounce+threads-1.
+ *
+ * Pipelined loops keep DEVICE_SLOTS batches in flight: select(ctx, slot)
+ * routes the following stages to the slot's queue, check_async() starts
+ * the target test and its readback, check_wait() collects the result of
+ * the slot while the next batch already runs. select(ctx, -1) returns to
+ * the synchronous mode used by hash()/check() alone.
+ */
+
+enum hash_stage {
+	/* 80 byte header -> 64 byte hash, header from set_block() */
+	STAGE_BLAKE512_80,
+	STAGE_JHA_KECCAK512_80,
+
+	/* 64 byte -> 64 byte, in place */
+	STAGE_BLAKE512,
+	STAGE_BMW512,
+	STAGE_GROESTL512,
+	STAGE_DOUBLEGROESTL512,
+	STAGE_SKEIN512,
+	STAGE_JH512,
+	STAGE_KECCAK512,
+	STAGE_LUFFA512,
+	STAGE_CUBEHASH512,
+	STAGE_SHAVITE512,
+	STAGE_SIMD512,
+	STAGE_ECHO512,
+
+	/* no hash output, listed so init() sets them up */
+	STAGE_CHECK,
+	STAGE_COMPACT_QUARK,
+	STAGE_COMPACT_JACKPOT,
+
+	STAGE_COUNT
+};
+
+/* branch predicates of the conditional chains */
+enum branch_test {
+	BRANCH_QUARK,		/* hash[0] & 0x08 */
+	BRANCH_JACKPOT		/* hash[0] & 0x01 */
+};
+
+struct device_backend {
+	const char *name;
+	/* largest batch the backend wants per launch, 0 = no limit */
+	int max_throughput;
+
+	/* select the device and set up the listed stages for throughput nonces */
+	bool (*init)(struct device_ctx *ctx, int throughput, const enum hash_stage *stages, int count);
+	/* drop backend state, the arena is released by device_ctx_reset() */
+	void (*reset)(struct device_ctx *ctx);
+
+	void *(*alloc)(struct device_ctx *ctx, size_t size);
+	void (*release)(struct device_ctx *ctx, void *ptr);
+	/* page locked host memory for async readbacks */
+	void *(*alloc_host)(struct device_ctx *ctx, size_t size);
+	void (*release_host)(struct device_ctx *ctx, void *ptr);
+	void (*read)(struct device_ctx *ctx, void *dst, const void *src, size_t size);
+
+	/* constants: byte swapped header of an *_80 stage and the share target */
+	void (*set_block)(struct device_ctx *ctx, enum hash_stage stage, const uint32_t *endiandata, size_t len);
+	void (*set_target)(struct device_ctx *ctx, const uint32_t *ptarget);
+
+	void (*hash)(struct device_ctx *ctx, enum hash_stage stage, int threads, uint32_t startNounce,
+		uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+
+	/* splits d_validNonceTable (or all nonces) by the test into d_nonces1 (true)
+	 * and d_nonces2 (false); d_nonces1 may be NULL to keep only the false
+	 * branch (BRANCH_QUARK only on CUDA) */
+	void (*compact)(struct device_ctx *ctx, enum branch_test test, int threads, uint32_t startNounce,
+		uint32_t *d_hash, uint32_t *d_validNonceTable,
+		uint32_t *d_nonces1, size_t *nrm1, uint32_t *d_nonces2, size_t *nrm2, int order);
+
+	/* number of nonces whose hash meets the target, the first
+	 * DEVICE_CANDIDATES of them are stored in nonces */
+	int (*check)(struct device_ctx *ctx, int threads, uint32_t startNounce,
+		uint32_t *d_nonceVector, uint32_t *d_hash, uint32_t *nonces, int order);
+
+	void (*select)(struct device_ctx *ctx, int slot);
+	void (*check_async)(struct device_ctx *ctx, int slot, int threads, uint32_t startNounce,
+		uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+	/* waits for the slot, same result as check(); updates ctx->gpu_idle */
+	int (*check_wait)(struct device_ctx *ctx, int slot, uint32_t *nonces);
+};
+
+enum arena_kind {
+	ARENA_DEVICE,
+	ARENA_HOST
+};
+
+/* sub-buffers start on this boundary, size the arena with device_arena_size() */
+#define DEVICE_ARENA_ALIGN 256
+
+static inline size_t device_arena_size(size_t bytes)
+{
+	return (bytes + DEVICE_ARENA_ALIGN - 1) & ~(size_t)(DEVICE_ARENA_ALIGN - 1);
+}
+
+/* allocates the blocks once per init, keeps larger blocks from an earlier
+ * init and empties both; false if the backend is out of memory */
+extern bool device_arena_reserve(struct device_ctx *ctx, size_t device_bytes, size_t host_bytes);
+/* next sub-buffer of the block, NULL if the reservation was too small */
+extern void *device_arena_alloc(struct device_ctx *ctx, enum arena_kind kind, size_t size);
+
+extern const struct device_backend cuda_backend;
+extern const struct device_backend cpu_backend;
+
+enum upload_kind {
+	UPLOAD_BLOCK,		/* header constants of the *_80 stages */
+	UPLOAD_TARGET		/* share target */
+};
+
+/* false if the device already holds constants built from the same data
+ * (the nonce word of a header is ignored, the kernels insert their own);
+ * remembers the data otherwise, the caller uploads */
+extern bool device_upload_needed(struct device_ctx *ctx, enum upload_kind kind, const void *data, size_t len);
+
+/* short name for the profile output */
+extern const char *hash_stage_name(enum hash_stage stage);
+
+/* worker threads of the CPU backend, 0 = one per core */
+extern int opt_cpu_backend_threads;
+
+/* batch of the scanhash loop: the algorithm default scaled by the tuned
+ * intensity and capped for the backend, remembered in ctx->batch */
+static inline int device_throughput(struct device_ctx *ctx, int throughput)
+{
+	int max = ctx->backend->max_throughput;
+
+	if (ctx->intensity > 0)
+		throughput <<= ctx->intensity;
+	else if (ctx->intensity < 0)
+		throughput >>= -ctx->intensity;
+	if (max && throughput > max)
+		throughput = max;
+	ctx->batch = throughput;
+	return throughput;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DEVICE_BACKEND_H__ */
@@ -0,0 +1,454 @@
+//
+// CPU Backend: rechnet die Stufen mit den sph Referenzimplementierungen
+//
+// Die Puffer liegen im Hauptspeicher und haben dasselbe Layout wie auf der
+// GPU, damit die scanhash Schleifen unveraendert laufen. Jede Stufe wird
+// auf opt_cpu_backend_threads Host-Threads verteilt; die Worker starten
+// einmal in cpu_init() und warten zwischen den Stufen auf den naechsten Job.
+//
+// heavy und mjollnir laufen noch nicht hier: der hefty1 Vorfilter und
+// heavy_compact() haben keine Stufe im Backend, daher portable = false in
+// algos.cpp.
+//
+
+extern "C"
+{
+#include "sph/sph_blake.h"
+#include "sph/sph_bmw.h"
+#include "sph/sph_groestl.h"
+#include "sph/sph_skein.h"
+#include "sph/sph_jh.h"
+#include "sph/sph_keccak.h"
+#include "sph/sph_luffa.h"
+#include "sph/sph_cubehash.h"
+#include "sph/sph_shavite.h"
+#include "sph/sph_simd.h"
+#include "sph/sph_echo.h"
+#include "miner.h"
+}
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "device_backend.h"
+#include "cuda_compaction.h"
+#include "profile.h"
+
+int opt_cpu_backend_threads = 0;
+
+// groesster Batch pro Aufruf, damit ein Restart nicht zu lange wartet
+#define CPU_BACKEND_MAX_THROUGHPUT 65536
+
+// Worker pro Kontext, einschliesslich des Miner-Threads
+#define CPU_BACKEND_MAX_WORKERS (MAX_GPUS * 4)
+
+// ein Stueck einer Stufe, jeder Worker nimmt jede nworkers-te Nonce
+struct cpu_stage_job {
+	struct cpu_backend_state *state;
+	enum hash_stage stage;
+	int threads;
+	uint32_t startNounce;
+	const uint32_t *nonceVector;
+	uint32_t *hashes;
+	int worker, nworkers;
+};
+
+struct cpu_worker {
+	struct cpu_backend_state *state;
+	int index;
+	pthread_t pth;
+};
+
+struct cpu_backend_state {
+	uint32_t block[32];	// Header der *_80 Stufen
+	size_t blocklen;
+	uint32_t target[8];
+	// check_async() rechnet sofort, check_wait() liefert nur ab
+	uint32_t nonces[DEVICE_SLOTS][DEVICE_CANDIDATES];
+	int count[DEVICE_SLOTS];
+	struct timeval zero;	// Nullpunkt der Zeiten fuer --profile
+
+	// Worker 1..nworkers, Worker 0 ist der Miner-Thread; job gilt fuer
+	// die Generation gen, pending zaehlt die Worker, die noch rechnen
+	struct cpu_worker workers[CPU_BACKEND_MAX_WORKERS];
+	int nworkers;
+	pthread_mutex_t lock;
+	pthread_cond_t start, done;
+	struct cpu_stage_job job;
+	unsigned long gen;
+	int pending;
+	bool quit;
+};
+
+// --profile misst die Stufen mit der Host-Uhr, ms seit der ersten Messung
+static double cpu_profile_now(struct device_ctx *ctx)
+{
+	struct cpu_backend_state *state = (struct cpu_backend_state *)ctx->backend_data;
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	if (!state->zero.tv_sec)
+		state->zero = tv;
+	return 1e3 * (tv.tv_sec - state->zero.tv_sec) + 1e-3 * (tv.tv_usec - state->zero.tv_usec);
+}
+
+typedef void (*cpu_hash64_t)(uint32_t *hash);
+
+#define CPU_STAGE_64(algo) \
+static void cpu_##algo##_64(uint32_t *hash) \
+{ \
+	sph_##algo##_context ctx; \
+	sph_##algo##_init(&ctx); \
+	sph_##algo(&ctx, hash, 64); \
+	sph_##algo##_close(&ctx, hash); \
+}
+
+CPU_STAGE_64(blake512)
+CPU_STAGE_64(bmw512)
+CPU_STAGE_64(groestl512)
+CPU_STAGE_64(skein512)
+CPU_STAGE_64(jh512)
+CPU_STAGE_64(keccak512)
+CPU_STAGE_64(luffa512)
+CPU_STAGE_64(cubehash512)
+CPU_STAGE_64(shavite512)
+CPU_STAGE_64(simd512)
+CPU_STAGE_64(echo512)
+
+static void cpu_doublegroestl512_64(uint32_t *hash)
+{
+	cpu_groestl512_64(hash);
+	cpu_groestl512_64(hash);
+}
+
+static const cpu_hash64_t cpu_stages[STAGE_COUNT] = {
+	NULL,					// STAGE_BLAKE512_80
+	NULL,					// STAGE_JHA_KECCAK512_80
+	cpu_blake512_64,
+	cpu_bmw512_64,
+	cpu_groestl512_64,
+	cpu_doublegroestl512_64,
+	cpu_skein512_64,
+	cpu_jh512_64,
+	cpu_keccak512_64,
+	cpu_luffa512_64,
+	cpu_cubehash512_64,
+	cpu_shavite512_64,
+	cpu_simd512_64,
+	cpu_echo512_64,
+	NULL,					// STAGE_CHECK
+	NULL,					// STAGE_COMPACT_QUARK
+	NULL,					// STAGE_COMPACT_JACKPOT
+};
+
+static int cpu_num_threads()
+{
+	int n = opt_cpu_backend_threads;
+
+	if (n <= 0) {
+#ifdef WIN32
+		SYSTEM_INFO sysinfo;
+		GetSystemInfo(&sysinfo);
+		n = sysinfo.dwNumberOfProcessors;
+#else
+		n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	}
+	return (n < 1) ? 1 : n;
+}
+
+static void cpu_stage_run(const struct cpu_stage_job *job)
+{
+	cpu_hash64_t fn = cpu_stages[job->stage];
+	uint32_t data[32];
+
+	if (fn == NULL)
+		memcpy(data, job->state->block, sizeof(data));
+
+	for (int i = job->worker; i < job->threads; i += job->nworkers)
+	{
+		uint32_t nonce = job->nonceVector ? job->nonceVector[i] : job->startNounce + i;
+		uint32_t *hash = &job->hashes[16 * (nonce - job->startNounce)];
+
+		if (fn) {
+			fn(hash);
+			continue;
+		}
+
+		be32enc(&data[19], nonce);
+		if (job->stage == STAGE_JHA_KECCAK512_80) {
+			sph_keccak512_context ctx;
+			sph_keccak512_init(&ctx);
+			sph_keccak512(&ctx, data, job->state->blocklen);
+			sph_keccak512_close(&ctx, hash);
+		} else {
+			sph_blake512_context ctx;
+			sph_blake512_init(&ctx);
+			sph_blake512(&ctx, data, job->state->blocklen);
+			sph_blake512_close(&ctx, hash);
+		}
+	}
+}
+
+static void *cpu_stage_worker(void *arg)
+{
+	struct cpu_worker *w = (struct cpu_worker *)arg;
+	struct cpu_backend_state *state = w->state;
+	unsigned long seen = 0;
+
+	for (;;)
+	{
+		struct cpu_stage_job job;
+
+		pthread_mutex_lock(&state->lock);
+		while (!state->quit && state->gen == seen)
+			pthread_cond_wait(&state->start, &state->lock);
+		if (state->quit) {
+			pthread_mutex_unlock(&state->lock);
+			break;
+		}
+		seen = state->gen;
+		job = state->job;
+		pthread_mutex_unlock(&state->lock);
+
+		// kleine Batches brauchen nicht alle Worker
+		if (w->index >= job.nworkers)
+			continue;
+		job.worker = w->index;
+		cpu_stage_run(&job);
+
+		pthread_mutex_lock(&state->lock);
+		if (--state->pending == 0)
+			pthread_cond_signal(&state->done);
+		pthread_mutex_unlock(&state->lock);
+	}
+	return NULL;
+}
+
+static bool cpu_init(struct device_ctx *ctx, int throughput, const enum hash_stage *stages, int count)
+{
+	struct cpu_backend_state *state;
+	int n = cpu_num_threads();
+
+	if (ctx->backend_data)
+		return true;
+
+	state = (struct cpu_backend_state *)calloc(1, sizeof(struct cpu_backend_state));
+	if (!state)
+		return false;
+	pthread_mutex_init(&state->lock, NULL);
+	pthread_cond_init(&state->start, NULL);
+	pthread_cond_init(&state->done, NULL);
+	ctx->backend_data = state;
+
+	if (n > CPU_BACKEND_MAX_WORKERS)
+		n = CPU_BACKEND_MAX_WORKERS;
+	// scheitert ein Start, rechnen eben weniger Worker mit
+	for (int i = 1; i < n; i++)
+	{
+		struct cpu_worker *w = &state->workers[state->nworkers];
+
+		w->state = state;
+		w->index = i;
+		if (pthread_create(&w->pth, NULL, cpu_stage_worker, w))
+			break;
+		state->nworkers++;
+	}
+	return true;
+}
+
+static void cpu_reset(struct device_ctx *ctx)
+{
+	struct cpu_backend_state *state = (struct cpu_backend_state *)ctx->backend_data;
+
+	if (!state)
+		return;
+
+	pthread_mutex_lock(&state->lock);
+	state->quit = true;
+	pthread_cond_broadcast(&state->start);
+	pthread_mutex_unlock(&state->lock);
+	for (int i = 0; i < state->nworkers; i++)
+		pthread_join(state->workers[i].pth, NULL);
+
+	pthread_cond_destroy(&state->done);
+	pthread_cond_destroy(&state->start);
+	pthread_mutex_destroy(&state->lock);
+	free(state);
+	ctx->backend_data = NULL;
+}
+
+static void *cpu_alloc(struct device_ctx *ctx, size_t size)
+{
+	return malloc(size);
+}
+
+static void cpu_release(struct device_ctx *ctx, void *ptr)
+{
+	free(ptr);
+}
+
+static void cpu_read(struct device_ctx *ctx, void *dst, const void *src, size_t size)
+{
+	memcpy(dst, src, size);
+}
+
+static void cpu_set_block(struct device_ctx *ctx, enum hash_stage stage, const uint32_t *endiandata, size_t len)
+{
+	struct cpu_backend_state *state = (struct cpu_backend_state *)ctx->backend_data;
+
+	if (len > sizeof(state->block))
+		len = sizeof(state->block);
+	memcpy(state->block, endiandata, len);
+	state->blocklen = len;
+}
+
+static void cpu_set_target(struct device_ctx *ctx, const uint32_t *ptarget)
+{
+	struct cpu_backend_state *state = (struct cpu_backend_state *)ctx->backend_data;
+	memcpy(state->target, ptarget, sizeof(state->target));
+}
+
+static void cpu_hash(struct device_ctx *ctx, enum hash_stage stage, int threads, uint32_t startNounce,
+	uint32_t *d_nonceVector, uint32_t *d_hash, int order)
+{
+	struct cpu_backend_state *state = (struct cpu_backend_state *)ctx->backend_data;
+	struct cpu_stage_job job;
+	int n = state->nworkers + 1;
+	double t0 = ctx->profile ? cpu_profile_now(ctx) : 0.0;
+
+	if (n > threads)
+		n = threads;
+	if (n < 1)
+		return;
+
+	job.state = state;
+	job.stage = stage;
+	job.threads = threads;
+	job.startNounce = startNounce;
+	job.nonceVector = d_nonceVector;
+	job.hashes = d_hash;
+	job.worker = 0;
+	job.nworkers = n;
+
+	// die Worker 1..n-1 wecken, Worker 0 laeuft im Miner-Thread selbst
+	if (n > 1) {
+		pthread_mutex_lock(&state->lock);
+		state->job = job;
+		state->pending = n - 1;
+		state->gen++;
+		pthread_cond_broadcast(&state->start);
+		pthread_mutex_unlock(&state->lock);
+	}
+	cpu_stage_run(&job);
+	if (n > 1) {
+		pthread_mutex_lock(&state->lock);
+		while (state->pending > 0)
+			pthread_cond_wait(&state->done, &state->lock);
+		pthread_mutex_unlock(&state->lock);
+	}
+
+	if (ctx->profile)
+		profile_add(ctx, order, hash_stage_name(stage), 0, t0, cpu_profile_now(ctx) - t0, threads, -1, -1);
+}
+
+static void cpu_compact(struct device_ctx *ctx, enum branch_test test, int threads, uint32_t startNounce,
+	uint32_t *d_hash, uint32_t *d_validNonceTable,
+	uint32_t *d_nonces1, size_t *nrm1, uint32_t *d_nonces2, size_t *nrm2, int order)
+{
+	uint32_t t, f;
+	double t0 = ctx->profile ? cpu_profile_now(ctx) : 0.0;
+
+	// Host-Referenz der GPU Compaction, siehe cuda_compaction.h
+	if (test == BRANCH_JACKPOT)
+		compaction_dual_ref(compaction_test_jackpot(), threads, startNounce, d_hash, d_validNonceTable,
+			d_nonces1, &t, d_nonces2, &f);
+	else
+		compaction_dual_ref(compaction_test_quark(), threads, startNounce, d_hash, d_validNonceTable,
+			d_nonces1, &t, d_nonces2, &f);
+	if (nrm1)
+		*nrm1 = t;
+	*nrm2 = f;
+
+	if (ctx->profile)
+		profile_add(ctx, order, hash_stage_name((test == BRANCH_JACKPOT) ? STAGE_COMPACT_JACKPOT : STAGE_COMPACT_QUARK),
+			0, t0, cpu_profile_now(ctx) - t0, threads, nrm1 ? (long)t : -1, (long)f);
+}
+
+static int cpu_check(struct device_ctx *ctx, int threads, uint32_t startNounce,
+	uint32_t *d_nonceVector, uint32_t *d_hash, uint32_t *nonces, int order)
+{
+	struct cpu_backend_state *state = (struct cpu_backend_state *)ctx->backend_data;
+	double t0 = ctx->profile ? cpu_profile_now(ctx) : 0.0;
+	int count = 0;
+
+	for (int i = 0; i < threads; i++)
+	{
+		uint32_t nonce = d_nonceVector ? d_nonceVector[i] : startNounce + i;
+		const uint32_t *hash = &d_hash[16 * (nonce - startNounce)];
+		bool rc = true;
+
+		// wie quark_check_gpu_hash_64: vom hoechstwertigen Wort abwaerts vergleichen
+		for (int k = 7; k >= 0; k--) {
+			if (hash[k] != state->target[k]) {
+				rc = hash[k] < state->target[k];
+				break;
+			}
+		}
+		if (rc) {
+			if (count < DEVICE_CANDIDATES)
+				nonces[count] = nonce;
+			count++;
+		}
+	}
+
+	if (ctx->profile)
+		profile_add(ctx, order, hash_stage_name(STAGE_CHECK), 0, t0, cpu_profile_now(ctx) - t0, threads, -1, -1);
+	return count;
+}
+
+static void cpu_select(struct device_ctx *ctx, int slot)
+{
+}
+
+static void cpu_check_async(struct device_ctx *ctx, int slot, int threads, uint32_t startNounce,
+	uint32_t *d_nonceVector, uint32_t *d_hash, int order)
+{
+	struct cpu_backend_state *state = (struct cpu_backend_state *)ctx->backend_data;
+	state->count[slot] = cpu_check(ctx, threads, startNounce, d_nonceVector, d_hash, state->nonces[slot], order);
+}
+
+static int cpu_check_wait(struct device_ctx *ctx, int slot, uint32_t *nonces)
+{
+	struct cpu_backend_state *state = (struct cpu_backend_state *)ctx->backend_data;
+	int n = (state->count[slot] < DEVICE_CANDIDATES) ? state->count[slot] : DEVICE_CANDIDATES;
+
+	memcpy(nonces, state->nonces[slot], n * sizeof(uint32_t));
+	return state->count[slot];
+}
+
+const struct device_backend cpu_backend = {
+	"cpu",
+	CPU_BACKEND_MAX_THROUGHPUT,
+	cpu_init,
+	cpu_reset,
+	cpu_alloc,
+	cpu_release,
+	cpu_alloc,
+	cpu_release,
+	cpu_read,
+	cpu_set_block,
+	cpu_set_target,
+	cpu_hash,
+	cpu_compact,
+	cpu_check,
+	cpu_select,
+	cpu_check_async,
+	cpu_check_wait
+};
@@ -0,0 +1,458 @@
+//
+// CUDA Backend: reicht die Stufen an die vorhandenen Kernel-Module weiter
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <cuda.h>
+#include "cuda_runtime.h"
+
+#include "miner.h"
+#include "device_backend.h"
+#include "cuda_sync.h"
+#include "profile.h"
+
+// aus heavy.cu
+extern cudaStream_t gpustream[MAX_GPUS];
+
+typedef void (*cuda_init_t)(int thr_id, int threads);
+typedef void (*cuda_free_t)(int thr_id);
+typedef void (*cuda_hash64_t)(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+
+extern void quark_blake512_cpu_init(int thr_id, int threads);
+extern void quark_blake512_cpu_setBlock_80(void *pdata);
+extern void quark_blake512_cpu_hash_80(int thr_id, int threads, uint32_t startNounce, uint32_t *d_hash, int order);
+extern void quark_blake512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+
+extern void jackpot_keccak512_cpu_init(int thr_id, int threads);
+extern void jackpot_keccak512_cpu_setBlock(void *pdata, size_t inlen);
+extern void jackpot_keccak512_cpu_hash(int thr_id, int threads, uint32_t startNounce, uint32_t *d_hash, int order);
+
+extern void quark_bmw512_cpu_init(int thr_id, int threads);
+extern void quark_bmw512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+
+extern void quark_groestl512_cpu_init(int thr_id, int threads);
+extern void quark_groestl512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+extern void quark_doublegroestl512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+
+extern void quark_skein512_cpu_init(int thr_id, int threads);
+extern void quark_skein512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+
+extern void quark_jh512_cpu_init(int thr_id, int threads);
+extern void quark_jh512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+
+extern void quark_keccak512_cpu_init(int thr_id, int threads);
+extern void quark_keccak512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+
+extern void x11_luffa512_cpu_init(int thr_id, int threads);
+extern void x11_luffa512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+
+extern void x11_cubehash512_cpu_init(int thr_id, int threads);
+extern void x11_cubehash512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+
+extern void x11_shavite512_cpu_init(int thr_id, int threads);
+extern void x11_shavite512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+
+extern void x11_simd512_cpu_init(int thr_id, int threads);
+extern void x11_simd512_cpu_free(int thr_id);
+extern void x11_simd512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+
+extern void x11_echo512_cpu_init(int thr_id, int threads);
+extern void x11_echo512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
+
+extern void quark_check_cpu_init(int thr_id, int threads);
+extern void quark_check_cpu_free(int thr_id);
+extern void quark_check_cpu_setTarget(const void *ptarget);
+extern int quark_check_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_inputHash, uint32_t *nonces, int order);
+extern void quark_check_cpu_hash_64_async(int thr_id, int slot, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_inputHash, int order);
+extern int quark_check_cpu_result(int thr_id, int slot, uint32_t *nonces);
+
+extern void quark_compactTest_cpu_init(int thr_id, int threads);
+extern void quark_compactTest_cpu_free(int thr_id);
+extern void quark_compactTest_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *inpHashes, uint32_t *d_validNonceTable,
+											uint32_t *d_nonces1, size_t *nrm1,
+											uint32_t *d_nonces2, size_t *nrm2,
+											int order);
+extern void quark_compactTest_single_false_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *inpHashes, uint32_t *d_validNonceTable,
+											uint32_t *d_nonces1, size_t *nrm1,
+											int order);
+
+extern void jackpot_compactTest_cpu_init(int thr_id, int threads);
+extern void jackpot_compactTest_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *inpHashes, uint32_t *d_validNonceTable,
+											uint32_t *d_nonces1, size_t *nrm1,
+											uint32_t *d_nonces2, size_t *nrm2,
+											int order);
+
+// heavy.cu legt seine Stufen selbst an
+extern void heavy_cpu_free(int thr_id);
+
+// Init-, Hash- und Freigabefunktion je Stufe, die *_80 Stufen werden in
+// cuda_hash() gesondert behandelt; free nur fuer Module mit eigenen Puffern
+static const struct {
+	cuda_init_t init;
+	cuda_hash64_t hash;
+	cuda_free_t free;
+} cuda_stages[STAGE_COUNT] = {
+	{ quark_blake512_cpu_init, NULL, NULL },						// STAGE_BLAKE512_80
+	{ jackpot_keccak512_cpu_init, NULL, NULL },						// STAGE_JHA_KECCAK512_80
+	{ quark_blake512_cpu_init, quark_blake512_cpu_hash_64, NULL },
+	{ quark_bmw512_cpu_init, quark_bmw512_cpu_hash_64, NULL },
+	{ quark_groestl512_cpu_init, quark_groestl512_cpu_hash_64, NULL },
+	{ quark_groestl512_cpu_init, quark_doublegroestl512_cpu_hash_64, NULL },
+	{ quark_skein512_cpu_init, quark_skein512_cpu_hash_64, NULL },
+	{ quark_jh512_cpu_init, quark_jh512_cpu_hash_64, NULL },
+	{ quark_keccak512_cpu_init, quark_keccak512_cpu_hash_64, NULL },
+	{ x11_luffa512_cpu_init, x11_luffa512_cpu_hash_64, NULL },
+	{ x11_cubehash512_cpu_init, x11_cubehash512_cpu_hash_64, NULL },
+	{ x11_shavite512_cpu_init, x11_shavite512_cpu_hash_64, NULL },
+	{ x11_simd512_cpu_init, x11_simd512_cpu_hash_64, x11_simd512_cpu_free },
+	{ x11_echo512_cpu_init, x11_echo512_cpu_hash_64, NULL },
+	{ quark_check_cpu_init, NULL, quark_check_cpu_free },			// STAGE_CHECK
+	{ quark_compactTest_cpu_init, NULL, quark_compactTest_cpu_free },	// STAGE_COMPACT_QUARK
+	{ jackpot_compactTest_cpu_init, NULL, quark_compactTest_cpu_free },	// STAGE_COMPACT_JACKPOT
+};
+
+// Stufen mit --profile, deren Events noch nicht ausgewertet sind
+#define CUDA_PROFILE_PENDING 64
+
+// Pipeline: ein Stream je Slot, die Slots laufen ueber Events nacheinander,
+// weil die Module (SIMD, Compaction) Zwischenpuffer pro Thread teilen
+struct cuda_backend_state {
+	cudaStream_t stream[DEVICE_SLOTS];
+	cudaEvent_t start[DEVICE_SLOTS];	// Batch des Slots beginnt auf der GPU
+	cudaEvent_t done[DEVICE_SLOTS];		// Check und Readback des Slots fertig
+	int next[DEVICE_SLOTS];				// danach gestarteter Slot, -1 = keiner
+	int last;							// zuletzt gestarteter Slot, -1 = keiner
+
+	// --profile: Events um jede Stufe, ausgewertet sobald sie fertig sind
+	bool profiling;
+	cudaEvent_t zero;					// Nullpunkt der Trace-Zeitstempel
+	struct {
+		cudaEvent_t begin, end;
+		enum hash_stage stage;
+		int order, slot, threads;
+		long out1, out2;
+	} prof[CUDA_PROFILE_PENDING];		// Ring ab prof_head
+	int prof_head, nprof;
+};
+
+// Stufen einer Messung, die auf der GPU noch offen sein duerfen
+static void cuda_profile_flush(struct device_ctx *ctx, bool wait)
+{
+	struct cuda_backend_state *state = (struct cuda_backend_state *)ctx->backend_data;
+
+	for (; state->nprof > 0; state->nprof--)
+	{
+		int i = state->prof_head;
+		float ts, dur;
+
+		if (wait)
+			cudaEventSynchronize(state->prof[i].end);
+		else if (cudaEventQuery(state->prof[i].end) != cudaSuccess)
+			break;
+		if (cudaEventElapsedTime(&dur, state->prof[i].begin, state->prof[i].end) == cudaSuccess &&
+			cudaEventElapsedTime(&ts, state->zero, state->prof[i].begin) == cudaSuccess)
+			profile_add(ctx, state->prof[i].order, hash_stage_name(state->prof[i].stage), state->prof[i].slot,
+				ts, dur, state->prof[i].threads, state->prof[i].out1, state->prof[i].out2);
+		state->prof_head = (i + 1) % CUDA_PROFILE_PENDING;
+	}
+}
+
+// Event vor der Stufe, -1 ohne --profile
+static int cuda_profile_begin(struct device_ctx *ctx)
+{
+	struct cuda_backend_state *state = (struct cuda_backend_state *)ctx->backend_data;
+
+	if (!ctx->profile)
+		return -1;
+	if (!state->profiling)
+	{
+		for (int i = 0; i < CUDA_PROFILE_PENDING; i++)
+		{
+			cudaEventCreate(&state->prof[i].begin);
+			cudaEventCreate(&state->prof[i].end);
+		}
+		cudaEventCreate(&state->zero);
+		cudaEventRecord(state->zero, NULL);
+		state->profiling = true;
+	}
+	if (state->nprof == CUDA_PROFILE_PENDING)
+		cuda_profile_flush(ctx, true);
+
+	int i = (state->prof_head + state->nprof++) % CUDA_PROFILE_PENDING;
+	cudaEventRecord(state->prof[i].begin, gpustream[ctx->thr_id]);
+	return i;
+}
+
+static void cuda_profile_end(struct device_ctx *ctx, int i, enum hash_stage stage, int order, int threads,
+	long out1, long out2)
+{
+	struct cuda_backend_state *state = (struct cuda_backend_state *)ctx->backend_data;
+
+	if (i < 0)
+		return;
+	cudaEventRecord(state->prof[i].end, gpustream[ctx->thr_id]);
+	state->prof[i].stage = stage;
+	state->prof[i].order = order;
+	state->prof[i].slot = (state->last >= 0) ? state->last : 0;
+	state->prof[i].threads = threads;
+	state->prof[i].out1 = out1;
+	state->prof[i].out2 = out2;
+}
+
+static bool cuda_init(struct device_ctx *ctx, int throughput, const enum hash_stage *stages, int count)
+{
+	cuda_init_t done[STAGE_COUNT];
+	int ndone = 0;
+
+	cudaSetDevice(ctx->device_id);
+
+	if (!ctx->backend_data)
+	{
+		struct cuda_backend_state *state = (struct cuda_backend_state *)calloc(1, sizeof(*state));
+		if (!state)
+			return false;
+		for (int slot = 0; slot < DEVICE_SLOTS; slot++)
+		{
+			cudaStreamCreate(&state->stream[slot]);
+			cudaEventCreate(&state->start[slot]);
+			cudaEventCreateWithFlags(&state->done[slot], cuda_sync_event_flags());
+			state->next[slot] = -1;
+		}
+		state->last = -1;
+		ctx->backend_data = state;
+	}
+
+	// jede Init-Funktion nur einmal aufrufen (Blake 80/64, Groestl/Doublegroestl)
+	for (int i = 0; i < count; i++)
+	{
+		cuda_init_t init = cuda_stages[stages[i]].init;
+		int k;
+		for (k = 0; k < ndone; k++)
+			if (done[k] == init)
+				break;
+		if (k < ndone)
+			continue;
+		init(ctx->thr_id, throughput);
+		done[ndone++] = init;
+	}
+	return cudaGetLastError() == cudaSuccess;
+}
+
+static void cuda_reset(struct device_ctx *ctx)
+{
+	struct cuda_backend_state *state = (struct cuda_backend_state *)ctx->backend_data;
+
+	// Modulpuffer des Batches, sonst haengt das naechste Init neue daneben;
+	// die Freigaben vertragen doppelte Aufrufe und nie belegte Puffer
+	for (int i = 0; i < STAGE_COUNT; i++)
+		if (cuda_stages[i].free)
+			cuda_stages[i].free(ctx->thr_id);
+	heavy_cpu_free(ctx->thr_id);
+
+	gpustream[ctx->thr_id] = NULL;
+	if (!state)
+		return;
+	for (int slot = 0; slot < DEVICE_SLOTS; slot++)
+	{
+		cudaStreamDestroy(state->stream[slot]);
+		cudaEventDestroy(state->start[slot]);
+		cudaEventDestroy(state->done[slot]);
+	}
+	if (state->profiling)
+	{
+		for (int i = 0; i < CUDA_PROFILE_PENDING; i++)
+		{
+			cudaEventDestroy(state->prof[i].begin);
+			cudaEventDestroy(state->prof[i].end);
+		}
+		cudaEventDestroy(state->zero);
+	}
+	free(state);
+	ctx->backend_data = NULL;
+}
+
+static void *cuda_alloc(struct device_ctx *ctx, size_t size)
+{
+	void *ptr = NULL;
+	if (cudaMalloc(&ptr, size) != cudaSuccess)
+		return NULL;
+	return ptr;
+}
+
+static void cuda_release(struct device_ctx *ctx, void *ptr)
+{
+	if (ptr)
+		cudaFree(ptr);
+}
+
+static void *cuda_alloc_host(struct device_ctx *ctx, size_t size)
+{
+	void *ptr = NULL;
+	if (cudaMallocHost(&ptr, size) != cudaSuccess)
+		return NULL;
+	return ptr;
+}
+
+static void cuda_release_host(struct device_ctx *ctx, void *ptr)
+{
+	if (ptr)
+		cudaFreeHost(ptr);
+}
+
+static void cuda_read(struct device_ctx *ctx, void *dst, const void *src, size_t size)
+{
+	cudaMemcpy(dst, src, size, cudaMemcpyDeviceToHost);
+}
+
+static void cuda_set_block(struct device_ctx *ctx, enum hash_stage stage, const uint32_t *endiandata, size_t len)
+{
+	if (!device_upload_needed(ctx, UPLOAD_BLOCK, endiandata, len))
+		return;
+	if (stage == STAGE_JHA_KECCAK512_80)
+		jackpot_keccak512_cpu_setBlock((void*)endiandata, len);
+	else
+		quark_blake512_cpu_setBlock_80((void*)endiandata);
+}
+
+static void cuda_set_target(struct device_ctx *ctx, const uint32_t *ptarget)
+{
+	if (!device_upload_needed(ctx, UPLOAD_TARGET, ptarget, 8 * sizeof(uint32_t)))
+		return;
+	quark_check_cpu_setTarget(ptarget);
+}
+
+static void cuda_hash(struct device_ctx *ctx, enum hash_stage stage, int threads, uint32_t startNounce,
+	uint32_t *d_nonceVector, uint32_t *d_hash, int order)
+{
+	int prof = cuda_profile_begin(ctx);
+
+	switch (stage)
+	{
+	case STAGE_BLAKE512_80:
+		quark_blake512_cpu_hash_80(ctx->thr_id, threads, startNounce, d_hash, order);
+		break;
+	case STAGE_JHA_KECCAK512_80:
+		jackpot_keccak512_cpu_hash(ctx->thr_id, threads, startNounce, d_hash, order);
+		break;
+	default:
+		cuda_stages[stage].hash(ctx->thr_id, threads, startNounce, d_nonceVector, d_hash, order);
+		break;
+	}
+	cuda_profile_end(ctx, prof, stage, order, threads, -1, -1);
+}
+
+static void cuda_compact(struct device_ctx *ctx, enum branch_test test, int threads, uint32_t startNounce,
+	uint32_t *d_hash, uint32_t *d_validNonceTable,
+	uint32_t *d_nonces1, size_t *nrm1, uint32_t *d_nonces2, size_t *nrm2, int order)
+{
+	int prof = cuda_profile_begin(ctx);
+
+	if (test == BRANCH_JACKPOT)
+		jackpot_compactTest_cpu_hash_64(ctx->thr_id, threads, startNounce, d_hash, d_validNonceTable,
+			d_nonces1, nrm1, d_nonces2, nrm2, order);
+	else if (d_nonces1 == NULL)
+		quark_compactTest_single_false_cpu_hash_64(ctx->thr_id, threads, startNounce, d_hash, d_validNonceTable,
+			d_nonces2, nrm2, order);
+	else
+		quark_compactTest_cpu_hash_64(ctx->thr_id, threads, startNounce, d_hash, d_validNonceTable,
+			d_nonces1, nrm1, d_nonces2, nrm2, order);
+	cuda_profile_end(ctx, prof, (test == BRANCH_JACKPOT) ? STAGE_COMPACT_JACKPOT : STAGE_COMPACT_QUARK,
+		order, threads, nrm1 ? (long)*nrm1 : -1, (long)*nrm2);
+}
+
+static int cuda_check(struct device_ctx *ctx, int threads, uint32_t startNounce,
+	uint32_t *d_nonceVector, uint32_t *d_hash, uint32_t *nonces, int order)
+{
+	int prof = cuda_profile_begin(ctx);
+	int count = quark_check_cpu_hash_64(ctx->thr_id, threads, startNounce, d_nonceVector, d_hash, nonces, order);
+
+	cuda_profile_end(ctx, prof, STAGE_CHECK, order, threads, -1, -1);
+	if (prof >= 0)
+		cuda_profile_flush(ctx, false);
+	return count;
+}
+
+static void cuda_select(struct device_ctx *ctx, int slot)
+{
+	struct cuda_backend_state *state = (struct cuda_backend_state *)ctx->backend_data;
+
+	if (slot < 0) {
+		gpustream[ctx->thr_id] = NULL;
+		state->last = -1;
+		return;
+	}
+
+	// der neue Batch startet erst, wenn der vorige fertig ist
+	if (state->last >= 0) {
+		cudaStreamWaitEvent(state->stream[slot], state->done[state->last], 0);
+		state->next[state->last] = slot;
+	}
+	cudaEventRecord(state->start[slot], state->stream[slot]);
+	state->next[slot] = -1;
+	state->last = slot;
+	gpustream[ctx->thr_id] = state->stream[slot];
+}
+
+static void cuda_check_async(struct device_ctx *ctx, int slot, int threads, uint32_t startNounce,
+	uint32_t *d_nonceVector, uint32_t *d_hash, int order)
+{
+	struct cuda_backend_state *state = (struct cuda_backend_state *)ctx->backend_data;
+	int prof = cuda_profile_begin(ctx);
+
+	quark_check_cpu_hash_64_async(ctx->thr_id, slot, threads, startNounce, d_nonceVector, d_hash, order);
+	cuda_profile_end(ctx, prof, STAGE_CHECK, order, threads, -1, -1);
+	cudaEventRecord(state->done[slot], state->stream[slot]);
+}
+
+static int cuda_check_wait(struct device_ctx *ctx, int slot, uint32_t *nonces)
+{
+	struct cuda_backend_state *state = (struct cuda_backend_state *)ctx->backend_data;
+
+	cuda_sync_event(ctx->thr_id, state->done[slot], SYNC_BATCH);
+	if (ctx->profile)
+		cuda_profile_flush(ctx, false);
+
+	// Leerlauf der GPU zwischen diesem und dem folgenden Batch
+	int next = state->next[slot];
+	if (next >= 0)
+	{
+		float idle = 0.0f;
+		cudaEventSynchronize(state->start[next]);
+		if (cudaEventElapsedTime(&idle, state->done[slot], state->start[next]) == cudaSuccess)
+		{
+			if (idle < 0.0f)
+				idle = 0.0f;
+			ctx->gpu_idle = ctx->batches ? 0.9 * ctx->gpu_idle + 0.1 * idle : idle;
+			ctx->batches++;
+		}
+	}
+
+	return quark_check_cpu_result(ctx->thr_id, slot, nonces);
+}
+
+const struct device_backend cuda_backend = {
+	"cuda",
+	0,
+	cuda_init,
+	cuda_reset,
+	cuda_alloc,
+	cuda_release,
+	cuda_alloc_host,
+	cuda_release_host,
+	cuda_read,
+	cuda_set_block,
+	cuda_set_target,
+	cuda_hash,
+	cuda_compact,
+	cuda_check,
+	cuda_select,
+	cuda_check_async,
+	cuda_check_wait
+};
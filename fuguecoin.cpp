@@ -7,6 +7,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <cuda_fugue256.h>
+#include "device_backend.h"
 
 extern "C" void my_fugue256_init(void *cc);
 extern "C" void my_fugue256(void *cc, const void *data, size_t len);
@@ -14,25 +15,24 @@ extern "C" void my_fugue256_close(void *cc, void *dst);
 extern "C" void my_fugue256_addbits_and_close(void *cc, unsigned ub, unsigned n, void *dst);
 
 // vorbereitete Kontexte nach den ersten 80 Bytes
-sph_fugue256_context  ctx_fugue_const[8];
-
 #define SWAP32(x) \
     ((((x) << 24) & 0xff000000u) | (((x) << 8) & 0x00ff0000u)   | \
       (((x) >> 8) & 0x0000ff00u) | (((x) >> 24) & 0x000000ffu))
 
-extern "C" int scanhash_fugue256(int thr_id, uint32_t *pdata, const uint32_t *ptarget,
+extern "C" int scanhash_fugue256(struct device_ctx *ctx, uint32_t *pdata, const uint32_t *ptarget,
 	uint32_t max_nonce, unsigned long *hashes_done)
 {	
+	const int thr_id = ctx->thr_id;
 	uint32_t start_nonce = pdata[19]++;
-	const uint32_t Htarg = ptarget[7];
-	const uint32_t throughPut = 4096 * 128;
+	int found = 0;
+	const uint32_t throughPut = device_throughput(ctx, 4096 * 128);
 
 	// init
-	static bool init[8] = { false, false, false, false, false, false, false, false };
-	if(!init[thr_id])
+	if(!ctx->init)
 	{
 		fugue256_cpu_init(thr_id, throughPut);
-		init[thr_id] = true;
+		ctx->throughput = throughPut;
+		ctx->init = true;
 	}
 	
 	// Endian Drehung ist notwendig
@@ -41,31 +41,19 @@ extern "C" int scanhash_fugue256(int thr_id, uint32_t *pdata, const uint32_t *pt
 		be32enc(&endiandata[kk], pdata[kk]);
 
 	// Context mit dem Endian gedrehten Blockheader vorbereiten (Nonce wird später ersetzt)
-	fugue256_cpu_setBlock(thr_id, endiandata, (void*)ptarget);
+	// beide Schluessel pruefen, setBlock laedt auch das Target
+	bool newBlock = device_upload_needed(ctx, UPLOAD_BLOCK, endiandata, 80);
+	bool newTarget = device_upload_needed(ctx, UPLOAD_TARGET, ptarget, 32);
+	if (newBlock || newTarget)
+		fugue256_cpu_setBlock(thr_id, endiandata, (void*)ptarget);
 
 	do {
 		// GPU
-		uint32_t foundNounce = 0xFFFFFFFF;
-		fugue256_cpu_hash(thr_id, throughPut, pdata[19], NULL, &foundNounce);
-
-		if(foundNounce < 0xffffffff)
-		{
-			uint32_t hash[8];
-			endiandata[19] = SWAP32(foundNounce);
-			sph_fugue256_context ctx_fugue;
-			sph_fugue256_init(&ctx_fugue);
-			sph_fugue256 (&ctx_fugue, endiandata, 80);
-			sph_fugue256_close(&ctx_fugue, &hash);
+		uint32_t nonces[DEVICE_CANDIDATES];
+		int count = fugue256_cpu_hash(thr_id, throughPut, pdata[19], NULL, nonces);
 
-			if (hash[7] <= Htarg && fulltest(hash, ptarget))
-			{
-				pdata[19] = foundNounce;
-				*hashes_done = foundNounce - start_nonce;
-				return 1;
-			} else {
-				applog(LOG_INFO, "GPU #%d: result for nonce $%08X does not validate on CPU!", thr_id, foundNounce);
-			}
-		}
+		// Verifikation und Submit laufen asynchron im CPU Verify-Pool
+		found += submit_candidates(ctx, nonces, count);
 
 		if (pdata[19] + throughPut < pdata[19])
 			pdata[19] = max_nonce;
@@ -74,7 +62,7 @@ extern "C" int scanhash_fugue256(int thr_id, uint32_t *pdata, const uint32_t *pt
 	} while (pdata[19] < max_nonce && !work_restart[thr_id].restart);
 	
 	*hashes_done = pdata[19] - start_nonce;
-	return 0;
+	return found;
 }
 
 void fugue256_hash(unsigned char* output, const unsigned char* input, int len)
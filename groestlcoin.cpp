@@ -7,6 +7,7 @@
 #include <string.h>
 #include <stdint.h>
 #include "cuda_groestlcoin.h"
+#include "device_backend.h"
 #include <openssl/sha.h>
 
 #define SWAP32(x) \
@@ -40,7 +41,7 @@ void sha256func(unsigned char *hash, const unsigned char *data, int len)
         be32enc((uint32_t *)hash + i, T[i]);
 }
 
-static void groestlhash(void *state, const void *input)
+void groestlhash(void *state, const void *input)
 {
     // Tryout GPU-groestl
 
@@ -67,24 +68,25 @@ static void groestlhash(void *state, const void *input)
 
 extern bool opt_benchmark;
 
-extern "C" int scanhash_groestlcoin(int thr_id, uint32_t *pdata, const uint32_t *ptarget,
+extern "C" int scanhash_groestlcoin(struct device_ctx *ctx, uint32_t *pdata, const uint32_t *ptarget,
     uint32_t max_nonce, unsigned long *hashes_done)
 {    
+    const int thr_id = ctx->thr_id;
+
     if (opt_benchmark)
         ((uint32_t*)ptarget)[7] = 0x000000ff;
 
     uint32_t start_nonce = pdata[19]++;
-    const uint32_t Htarg = ptarget[7];
-    const uint32_t throughPut = 4096 * 128;
+    int found = 0;
+    const uint32_t throughPut = device_throughput(ctx, 4096 * 128);
     //const uint32_t throughPut = 1;
-    uint32_t *outputHash = (uint32_t*)malloc(throughPut * 16 * sizeof(uint32_t));
 
     // init
-    static bool init[8] = { false, false, false, false, false, false, false, false };
-    if(!init[thr_id])
+    if(!ctx->init)
     {
         groestlcoin_cpu_init(thr_id, throughPut);
-        init[thr_id] = true;
+        ctx->throughput = throughPut;
+        ctx->init = true;
     }
     
     // Endian Drehung ist notwendig
@@ -93,31 +95,19 @@ extern "C" int scanhash_groestlcoin(int thr_id, uint32_t *pdata, const uint32_t
         be32enc(&endiandata[kk], pdata[kk]);
 
     // Context mit dem Endian gedrehten Blockheader vorbereiten (Nonce wird spter ersetzt)
-    groestlcoin_cpu_setBlock(thr_id, endiandata, (void*)ptarget);
+    // beide Schluessel pruefen, setBlock laedt auch das Target
+    bool newBlock = device_upload_needed(ctx, UPLOAD_BLOCK, endiandata, 80);
+    bool newTarget = device_upload_needed(ctx, UPLOAD_TARGET, ptarget, 32);
+    if (newBlock || newTarget)
+        groestlcoin_cpu_setBlock(thr_id, endiandata, (void*)ptarget);
     
     do {
         // GPU
-        uint32_t foundNounce = 0xFFFFFFFF;
-
-        groestlcoin_cpu_hash(thr_id, throughPut, pdata[19], outputHash, &foundNounce);
-
-        if(foundNounce < 0xffffffff)
-        {
-            uint32_t tmpHash[8];
-            endiandata[19] = SWAP32(foundNounce);
-            groestlhash(tmpHash, endiandata);
-            if (tmpHash[7] <= Htarg && 
-                    fulltest(tmpHash, ptarget)) {
-                        pdata[19] = foundNounce;
-                        *hashes_done = foundNounce - start_nonce;
-                        free(outputHash);
-                return true;
-            } else {
-                applog(LOG_INFO, "GPU #%d: result for nonce $%08X does not validate on CPU!", thr_id, foundNounce);
-            }
-
-            foundNounce = 0xffffffff;
-        }
+        uint32_t nonces[DEVICE_CANDIDATES];
+        int count = groestlcoin_cpu_hash(thr_id, throughPut, pdata[19], NULL, nonces);
+
+        // Verifikation und Submit laufen asynchron im CPU Verify-Pool
+        found += submit_candidates(ctx, nonces, count);
 
         if (pdata[19] + throughPut < pdata[19])
             pdata[19] = max_nonce;
@@ -126,7 +116,6 @@ extern "C" int scanhash_groestlcoin(int thr_id, uint32_t *pdata, const uint32_t
     } while (pdata[19] < max_nonce && !work_restart[thr_id].restart);
     
     *hashes_done = pdata[19] - start_nonce;
-    free(outputHash);
-    return 0;
+    return found;
 }
 
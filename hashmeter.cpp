@@ -0,0 +1,163 @@
+//
+// Hashraten der Miner-Threads
+//
+// Jeder Miner-Thread zaehlt seine Hashes in einem eigenen Zaehler auf
+// einer eigenen Cache-Line, pro Batch (submit_candidates) statt erst am
+// Ende von scanhash, das bei Stratum bis zu LP_SCANTIME s dauert. Ein
+// Aggregator-Thread liest die Zaehler jede Sekunde und rechnet daraus die
+// Raten ueber 10 s, 1 min und 15 min, gleitend und als EWMA, pro Device und
+// fuer alle zusammen. Gelesen wird ueber einen Seqlock, kein Miner-Thread
+// nimmt dafuer einen Lock.
+//
+// Am Ende von scanhash ersetzt hashes_done die gezaehlten Nonces: manche
+// Algorithmen zaehlen anders (jackpot die Haelfte), der Faktor gilt dann
+// fuer die Batches des naechsten Scans.
+//
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "miner.h"
+#include "seqlock.h"
+#include "hashmeter.h"
+
+#define HASHMETER_TICK_MS 1000
+// Ticks des laengsten Fensters
+#define HASHMETER_HISTORY 900
+
+const int hashmeter_window_s[HASHMETER_WINDOWS] = { 10, 60, 900 };
+
+struct DEVICE_ALIGN hash_counter {
+	std::atomic<long long> hashes;	// nur der Miner-Thread schreibt
+	// Stand des laufenden Scans, nur im Miner-Thread
+	long long scan_hashes;
+	unsigned long long scan_nonces;
+	double scale;			// Hashes pro Nonce im letzten Scan, 0 = noch keiner
+};
+
+// Verlauf eines Devices (oder aller), nur im Aggregator
+struct hash_history {
+	long long last;
+	double delta[HASHMETER_HISTORY];	// Hashes pro Tick
+	struct hash_rates rates;
+};
+
+static struct hash_counter counters[MAX_GPUS];
+static struct seqlock<struct hash_rates> published[MAX_GPUS + 1];
+static int hashmeter_count;
+
+extern "C" void hashmeter_batch(int thr_id, unsigned long nonces)
+{
+	struct hash_counter *c = &counters[thr_id];
+	long long h = (c->scale > 0.0) ? (long long)(c->scale * nonces + 0.5) : (long long)nonces;
+
+	c->scan_hashes += h;
+	c->scan_nonces += nonces;
+	c->hashes.store(c->hashes.load(std::memory_order_relaxed) + h, std::memory_order_relaxed);
+}
+
+extern "C" void hashmeter_scan(int thr_id, unsigned long hashes_done)
+{
+	struct hash_counter *c = &counters[thr_id];
+
+	// der Rest, kann bei anderer Zaehlweise auch negativ sein
+	c->hashes.store(c->hashes.load(std::memory_order_relaxed) + (long long)hashes_done - c->scan_hashes,
+		std::memory_order_relaxed);
+	if (c->scan_nonces && hashes_done)
+		c->scale = (double)hashes_done / c->scan_nonces;
+	c->scan_hashes = 0;
+	c->scan_nonces = 0;
+}
+
+// ein Tick: delta Hashes in dt s, dts[] sind die Laengen der letzten Ticks
+static void hashmeter_update(struct hash_history *h, double delta, int tick, const double *dts, double dt)
+{
+	struct hash_rates *r = &h->rates;
+	int slot = tick % HASHMETER_HISTORY;
+
+	h->delta[slot] = delta;
+	r->hashes += delta;
+	r->uptime += dt;
+
+	for (int w = 0; w < HASHMETER_WINDOWS; w++)
+	{
+		double sum = 0.0, t = 0.0;
+		double a = exp(-dt / hashmeter_window_s[w]);
+
+		// zurueck bis das Fenster voll ist oder der Verlauf anfaengt
+		for (int k = 0; k < HASHMETER_HISTORY && k <= tick && t < hashmeter_window_s[w] - 0.5 * dt; k++)
+		{
+			int i = (slot - k + HASHMETER_HISTORY) % HASHMETER_HISTORY;
+			sum += h->delta[i];
+			t += dts[i];
+		}
+		r->window[w] = (t > 0.0 && sum > 0.0) ? sum / t : 0.0;
+		r->ewma[w] = (tick == 0) ? delta / dt : a * r->ewma[w] + (1.0 - a) * delta / dt;
+		if (r->ewma[w] < 0.0)
+			r->ewma[w] = 0.0;
+	}
+}
+
+static double hashmeter_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+static void *hashmeter_thread(void *userdata)
+{
+	static struct hash_history history[MAX_GPUS + 1];
+	static double dts[HASHMETER_HISTORY];
+	double last = hashmeter_now();
+
+	for (int tick = 0; ; tick++)
+	{
+		double now, dt, total = 0.0;
+
+		usleep(HASHMETER_TICK_MS * 1000);
+		now = hashmeter_now();
+		dt = now - last;
+		last = now;
+		if (dt <= 0.0)
+			dt = 1e-3 * HASHMETER_TICK_MS;
+		dts[tick % HASHMETER_HISTORY] = dt;
+
+		for (int i = 0; i < hashmeter_count; i++)
+		{
+			long long hashes = counters[i].hashes.load(std::memory_order_relaxed);
+			double delta = (double)(hashes - history[i].last);
+
+			history[i].last = hashes;
+			total += delta;
+			hashmeter_update(&history[i], delta, tick, dts, dt);
+			published[i].write(history[i].rates);
+		}
+		hashmeter_update(&history[MAX_GPUS], total, tick, dts, dt);
+		published[MAX_GPUS].write(history[MAX_GPUS].rates);
+	}
+	return NULL;
+}
+
+extern "C" bool hashmeter_start(int n)
+{
+	pthread_t pth;
+
+	hashmeter_count = (n < MAX_GPUS) ? n : MAX_GPUS;
+	if (pthread_create(&pth, NULL, hashmeter_thread, NULL))
+		return false;
+	pthread_detach(pth);
+	return true;
+}
+
+extern "C" void hashmeter_read(int thr_id, struct hash_rates *rates)
+{
+	published[(thr_id == HASHMETER_TOTAL) ? MAX_GPUS : thr_id].read(*rates);
+}
+
+extern "C" long long hashmeter_hashes(int thr_id)
+{
+	return counters[thr_id].hashes.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,47 @@
+#ifndef __HASHMETER_H__
+#define __HASHMETER_H__
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* rates over 10 s, 1 min and 15 min */
+#define HASHMETER_WINDOWS 3
+
+/* hashmeter_read() of all devices together */
+#define HASHMETER_TOTAL (-1)
+
+struct hash_rates {
+	double window[HASHMETER_WINDOWS];	/* hashes/s, sliding windows */
+	double ewma[HASHMETER_WINDOWS];		/* hashes/s, same time constants */
+	double hashes;				/* since start */
+	double uptime;				/* s the meter ran, shorter windows cover only this */
+};
+
+/* lengths of the windows in s, for the labels */
+extern const int hashmeter_window_s[HASHMETER_WINDOWS];
+
+/* a batch of nonces left the GPU, called by submit_candidates() of the
+ * owning miner thread, never blocks */
+extern void hashmeter_batch(int thr_id, unsigned long nonces);
+
+/* end of a scanhash call: hashes_done replaces the nonces of its batches,
+ * which also scales the next batches to the algorithm's hash count */
+extern void hashmeter_scan(int thr_id, unsigned long hashes_done);
+
+/* starts the aggregator thread for n miner threads */
+extern bool hashmeter_start(int n);
+
+/* last rates of a miner thread or HASHMETER_TOTAL, all 0 before the first tick */
+extern void hashmeter_read(int thr_id, struct hash_rates *rates);
+
+/* hashes a miner thread counted up to now, without waiting for a tick */
+extern long long hashmeter_hashes(int thr_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HASHMETER_H__ */
@@ -5,17 +5,19 @@
 #include <stdio.h>
 #include <memory.h>
 
+#include "device.h"
+
 // Folgende Definitionen spter durch header ersetzen
 typedef unsigned char uint8_t;
 typedef unsigned int uint32_t;
 typedef unsigned long long uint64_t;
 
 // globaler Speicher fr alle HeftyHashes aller Threads
-extern uint32_t *d_heftyHashes[8];
-extern uint32_t *d_nonceVector[8];
+extern uint32_t *d_heftyHashes[MAX_GPUS];
+extern uint32_t *d_nonceVector[MAX_GPUS];
 
 // globaler Speicher fr unsere Ergebnisse
-uint32_t *d_hash5output[8];
+uint32_t *d_hash5output[MAX_GPUS];
 
 // die Message (112 bzw. 116 Bytes) mit Padding zur Berechnung auf der GPU
 __constant__ uint64_t c_PaddedMessage[16]; // padded message (80/84+32 bytes + padding)
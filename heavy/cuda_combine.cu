@@ -2,17 +2,19 @@
 #include "cuda_runtime.h"
 #include "device_launch_parameters.h"
 
+#include "device.h"
+
 // Folgende Definitionen spter durch header ersetzen
 typedef unsigned int uint32_t;
 
 // globaler Speicher fr unsere Ergebnisse
-uint32_t *d_hashoutput[8];
+uint32_t *d_hashoutput[MAX_GPUS];
 
-extern uint32_t *d_hash2output[8];
-extern uint32_t *d_hash3output[8];
-extern uint32_t *d_hash4output[8];
-extern uint32_t *d_hash5output[8];
-extern uint32_t *d_nonceVector[8];
+extern uint32_t *d_hash2output[MAX_GPUS];
+extern uint32_t *d_hash3output[MAX_GPUS];
+extern uint32_t *d_hash4output[MAX_GPUS];
+extern uint32_t *d_hash5output[MAX_GPUS];
+extern uint32_t *d_nonceVector[MAX_GPUS];
 
 /* Combines top 64-bits from each hash into a single hash */
 static void __device__ combine_hashes(uint32_t *out, uint32_t *hash1, uint32_t *hash2, uint32_t *hash3, uint32_t *hash4)
@@ -5,17 +5,19 @@
 #include <stdio.h>
 #include <memory.h>
 
+#include "device.h"
+
 // Folgende Definitionen spter durch header ersetzen
 typedef unsigned char uint8_t;
 typedef unsigned int uint32_t;
 typedef unsigned long long uint64_t;
 
 // globaler Speicher fr alle HeftyHashes aller Threads
-extern uint32_t *d_heftyHashes[8];
-extern uint32_t *d_nonceVector[8];
+extern uint32_t *d_heftyHashes[MAX_GPUS];
+extern uint32_t *d_nonceVector[MAX_GPUS];
 
 // globaler Speicher fr unsere Ergebnisse
-uint32_t *d_hash4output[8];
+uint32_t *d_hash4output[MAX_GPUS];
 
 __constant__ uint32_t groestl_gpu_state[32];
 __constant__ uint32_t groestl_gpu_msg[32];
@@ -737,15 +739,18 @@ template <int BLOCKSIZE> __global__ void groestl512_gpu_hash(int threads, uint32
 	}
 }
 
+// die Tabellen haengen nicht am Batch: einmal pro Thread kopieren, bei
+// jedem Init nur neu binden
 #define texDef(texname, texmem, texsource, texsize) \
-	unsigned int *texmem; \
-	cudaMalloc(&texmem, texsize); \
-	cudaMemcpy(texmem, texsource, texsize, cudaMemcpyHostToDevice); \
+	static unsigned int *texmem[MAX_GPUS]; \
+	if (!texmem[thr_id]) { \
+	  cudaMalloc(&texmem[thr_id], texsize); \
+	  cudaMemcpy(texmem[thr_id], texsource, texsize, cudaMemcpyHostToDevice); } \
 	texname.normalized = 0; \
 	texname.filterMode = cudaFilterModePoint; \
 	texname.addressMode[0] = cudaAddressModeClamp; \
 	{ cudaChannelFormatDesc channelDesc = cudaCreateChannelDesc<unsigned int>(); \
-	  cudaBindTexture(NULL, &texname, texmem, &channelDesc, texsize ); } \
+	  cudaBindTexture(NULL, &texname, texmem[thr_id], &channelDesc, texsize ); } \
 
 // Setup-Funktionen
 __host__ void groestl512_cpu_init(int thr_id, int threads)
@@ -5,10 +5,12 @@
 #include <stdio.h>
 #include <memory.h>
 
+#include "device.h"
+
 #define USE_SHARED 1
 
 // aus cpu-miner.c
-extern int device_map[8];
+extern int device_map[MAX_GPUS];
 
 // aus heavy.cu
 extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
@@ -19,10 +21,10 @@ typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 
 // diese Struktur wird in der Init Funktion angefordert
-static cudaDeviceProp props[8];
+static cudaDeviceProp props[MAX_GPUS];
 
 // globaler Speicher fr alle HeftyHashes aller Threads
-uint32_t *d_heftyHashes[8];
+uint32_t *d_heftyHashes[MAX_GPUS];
 
 /* Hash-Tabellen */
 __constant__ uint32_t hefty_gpu_constantTable[64];
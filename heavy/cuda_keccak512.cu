@@ -5,19 +5,21 @@
 #include <stdio.h>
 #include <memory.h>
 
+#include "device.h"
+
 // Folgende Definitionen spter durch header ersetzen
 typedef unsigned char uint8_t;
 typedef unsigned int uint32_t;
 typedef unsigned long long uint64_t;
 
 // globaler Speicher fr alle HeftyHashes aller Threads
-extern uint32_t *d_heftyHashes[8];
-extern uint32_t *d_nonceVector[8];
+extern uint32_t *d_heftyHashes[MAX_GPUS];
+extern uint32_t *d_nonceVector[MAX_GPUS];
 
 // globaler Speicher fr unsere Ergebnisse
-uint32_t *d_hash3output[8];
-extern uint32_t *d_hash4output[8];
-extern uint32_t *d_hash5output[8];
+uint32_t *d_hash3output[MAX_GPUS];
+extern uint32_t *d_hash4output[MAX_GPUS];
+extern uint32_t *d_hash5output[MAX_GPUS];
 
 // der Keccak512 State nach der ersten Runde (72 Bytes)
 __constant__ uint64_t c_State[25];
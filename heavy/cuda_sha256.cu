@@ -5,15 +5,17 @@
 #include <stdio.h>
 #include <memory.h>
 
+#include "device.h"
+
 // Folgende Definitionen spter durch header ersetzen
 typedef unsigned int uint32_t;
 
 // globaler Speicher fr alle HeftyHashes aller Threads
-extern uint32_t *d_heftyHashes[8];
-extern uint32_t *d_nonceVector[8];
+extern uint32_t *d_heftyHashes[MAX_GPUS];
+extern uint32_t *d_nonceVector[MAX_GPUS];
 
 // globaler Speicher fr unsere Ergebnisse
-uint32_t *d_hash2output[8];
+uint32_t *d_hash2output[MAX_GPUS];
 
 
 /* Hash-Tabellen */
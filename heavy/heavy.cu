@@ -3,19 +3,13 @@
 #include <cuda.h>
 #include "cuda_runtime.h"
 #include "device_launch_parameters.h"
-#include <map>
 
 #ifndef _WIN32
 #include <unistd.h>
 #endif
 
-// include thrust
-#include <thrust/version.h>
-#include <thrust/remove.h>
-#include <thrust/device_vector.h>
-#include <thrust/iterator/constant_iterator.h>
-
 #include "miner.h"
+#include "device_backend.h"
 
 #include "hefty1.h"
 #include "sph/sph_keccak.h"
@@ -28,17 +22,40 @@
 #include "heavy/cuda_groestl512.h"
 #include "heavy/cuda_blake512.h"
 #include "heavy/cuda_combine.h"
+#include "cuda_compaction.h"
 
-extern uint32_t *d_hash2output[8];
-extern uint32_t *d_hash3output[8];
-extern uint32_t *d_hash4output[8];
-extern uint32_t *d_hash5output[8];
+extern uint32_t *d_hash2output[MAX_GPUS];
+extern uint32_t *d_hash3output[MAX_GPUS];
+extern uint32_t *d_hash4output[MAX_GPUS];
+extern uint32_t *d_hash5output[MAX_GPUS];
+extern uint32_t *d_heftyHashes[MAX_GPUS];
+extern uint32_t *d_hashoutput[MAX_GPUS];
 
 #define HEAVYCOIN_BLKHDR_SZ        84
 #define MNR_BLKHDR_SZ		       80
 
 // nonce-array fr die threads
-uint32_t *d_nonceVector[8];
+uint32_t *d_nonceVector[MAX_GPUS];
+
+// Zwischenpuffer der Compaction
+static struct compaction_buffers d_compaction[MAX_GPUS];
+
+// pinned Readback-Puffer im Arena-Block des Threads
+static uint32_t *h_hash[MAX_GPUS];
+static uint32_t *h_nonceVector[MAX_GPUS];
+
+// Ausgaben der Stufen und Compaction, ruft cuda_reset() und jedes Init
+void heavy_cpu_free(int thr_id)
+{
+    uint32_t **outputs[] = { d_heftyHashes, d_hash2output, d_hash3output, d_hash4output, d_hash5output, d_hashoutput };
+
+    for (int i = 0; i < (int)(sizeof(outputs) / sizeof(outputs[0])); i++)
+    {
+        cudaFree(outputs[i][thr_id]);
+        outputs[i][thr_id] = NULL;
+    }
+    compaction_free(&d_compaction[thr_id]);
+}
 
 /* Combines top 64-bits from each hash into a single hash */
 static void combine_hashes(uint32_t *out, const uint32_t *hash1, const uint32_t *hash2, const uint32_t *hash3, const uint32_t *hash4)
@@ -110,33 +127,29 @@ static void genmask(uint32_t *ptarget, int words, int highbit)
     }
 }
 
-struct check_nonce_for_remove
+// Compaction-Test: true fr die Nonces, die im Rennen bleiben
+struct check_nonce_for_target
 {    
-    check_nonce_for_remove(uint64_t target, uint32_t *hashes, uint32_t hashlen, uint32_t startNonce) :
+    check_nonce_for_target(uint64_t target, uint32_t hashlen) :
         m_target(target),
-        m_hashes(hashes),
-        m_hashlen(hashlen),
-        m_startNonce(startNonce) { }
+        m_hashlen(hashlen) { }
 
-    __device__
-    bool operator()(const uint32_t x)
+    __host__ __device__
+    uint32_t operator()(const uint32_t *hashes, uint32_t hashIndex) const
     {
-        // Position im Hash Buffer
-        uint32_t hashIndex = x - m_startNonce;
         // Wert des Hashes (als uint64_t) auslesen.
         // Steht im 6. und 7. Wort des Hashes (jeder dieser Hashes hat 512 Bits)
-        uint64_t hashValue = *((uint64_t*)(&m_hashes[m_hashlen*hashIndex + 6]));
+        uint64_t hashValue = *((uint64_t*)(&hashes[m_hashlen*hashIndex + 6]));
         // gegen das Target prfen. Es drfen nur Bits aus dem Target gesetzt sein.
-        return (hashValue & m_target) != hashValue;
+        return (hashValue & m_target) == hashValue;
     }
 
     uint64_t  m_target;
-    uint32_t *m_hashes;
     uint32_t  m_hashlen;
-    uint32_t  m_startNonce;
 };
 
-// Zahl der CUDA Devices im System bestimmen
+// Zahl der CUDA Devices im System bestimmen, 0 wenn kein Treiber da ist
+// (der CPU Backend laeuft auch ohne GPU)
 extern "C" int cuda_num_devices()
 {
     int version;
@@ -144,14 +157,14 @@ extern "C" int cuda_num_devices()
     if (err != cudaSuccess)
     {
         applog(LOG_ERR, "Unable to query CUDA driver version! Is an nVidia driver installed?");
-        exit(1);
+        return 0;
     }
 
     int maj = version / 1000, min = version % 100; // same as in deviceQuery sample
     if (maj < 5 || (maj == 5 && min < 5))
     {
         applog(LOG_ERR, "Driver does not support CUDA %d.%d API! Update your nVidia driver!", 5, 5);
-        exit(1);
+        return 0;
     }
 
     int GPU_N;
@@ -159,15 +172,25 @@ extern "C" int cuda_num_devices()
     if (err != cudaSuccess)
     {
         applog(LOG_ERR, "Unable to query number of CUDA devices! Is an nVidia driver installed?");
-        exit(1);
+        return 0;
     }
     return GPU_N;
 }
 
+// Treiberversion wie von cudaDriverGetVersion, 0 ohne Treiber
+extern "C" int cuda_driver_version()
+{
+    int version;
+    if (cudaDriverGetVersion(&version) != cudaSuccess)
+        return 0;
+    return version;
+}
+
 // Gertenamen holen
-extern char *device_name[8];
-extern int device_map[8];
-extern int invert[8];
+extern char *device_name[MAX_GPUS];
+extern int device_map[MAX_GPUS];
+extern int invert[MAX_GPUS];
+extern int bus_ids[MAX_GPUS];
 
 extern "C" void cuda_devicenames()
 {
@@ -185,6 +208,7 @@ extern "C" void cuda_devicenames()
         cudaDeviceProp props;
         cudaGetDeviceProperties(&props, device_map[i]);
 		invert[i] = props.pciBusID-1;
+		bus_ids[i] = props.pciBusID;
         device_name[i] = strdup(props.name);
     }
 }
@@ -228,66 +252,52 @@ extern "C" int cuda_finddevice(char *name)
 	return -1;
 }
 
-// Zeitsynchronisations-Routine von cudaminer mit CPU sleep
-typedef struct { double value[8]; } tsumarray;
-cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id)
-{
-    cudaError_t result = cudaSuccess;
-    if (situation >= 0)
-    {   
-        static std::map<int, tsumarray> tsum;
+// Stream, auf dem die Kernel-Module eines Miner-Threads starten. NULL ist der
+// synchrone Default, der CUDA Backend setzt hier den Stream des Pipeline-Slots.
+cudaStream_t gpustream[MAX_GPUS];
 
-        double a = 0.95, b = 0.05;
-        if (tsum.find(situation) == tsum.end()) { a = 0.5; b = 0.5; } // faster initial convergence
-
-        double tsync = 0.0;
-        double tsleep = 0.95 * tsum[situation].value[thr_id];
-        if (cudaStreamQuery(stream) == cudaErrorNotReady)
-        {
-            usleep((useconds_t)(1e6*tsleep));
-            struct timeval tv_start, tv_end;
-            gettimeofday(&tv_start, NULL);
-            result = cudaStreamSynchronize(stream);
-            gettimeofday(&tv_end, NULL);
-            tsync = 1e-6 * (tv_end.tv_usec-tv_start.tv_usec) + (tv_end.tv_sec-tv_start.tv_sec);
-        }
-        if (tsync >= 0) tsum[situation].value[thr_id] = a * tsum[situation].value[thr_id] + b * (tsleep+tsync);
-    }
-    else
-        result = cudaStreamSynchronize(stream);
-    return result;
-}
-
-int scanhash_heavy_cpp(int thr_id, uint32_t *pdata,
+int scanhash_heavy_cpp(struct device_ctx *ctx, uint32_t *pdata,
  const uint32_t *ptarget, uint32_t max_nonce,
  unsigned long *hashes_done, uint32_t maxvote, int blocklen);
 
+// Compaction der Nonce-Liste in den anderen der beiden Nonce-Puffer, die
+// Hash-Kernel lesen danach die neue Liste ber d_nonceVector
+static uint32_t heavy_compact(struct device_ctx *ctx, uint32_t count, uint64_t target,
+    uint32_t *hashes, uint32_t hashlen, uint32_t startNonce)
+{
+    const int thr_id = ctx->thr_id;
+    uint32_t *d_out = (d_nonceVector[thr_id] == ctx->d_nonces[0]) ? ctx->d_nonces[1] : ctx->d_nonces[0];
+
+    count = compaction_single(&d_compaction[thr_id], gpustream[thr_id], check_nonce_for_target(target, hashlen),
+        count, startNonce, hashes, d_nonceVector[thr_id], d_out);
+    d_nonceVector[thr_id] = d_out;
+    return count;
+}
+
 extern "C"
-int scanhash_heavy(int thr_id, uint32_t *pdata,
+int scanhash_heavy(struct device_ctx *ctx, uint32_t *pdata,
  const uint32_t *ptarget, uint32_t max_nonce,
  unsigned long *hashes_done, uint32_t maxvote, int blocklen)
 {
- return scanhash_heavy_cpp(thr_id, pdata,
+ return scanhash_heavy_cpp(ctx, pdata,
   ptarget, max_nonce, hashes_done, maxvote, blocklen);
 }
 
 extern bool opt_benchmark;
 
-int scanhash_heavy_cpp(int thr_id, uint32_t *pdata,
+int scanhash_heavy_cpp(struct device_ctx *ctx, uint32_t *pdata,
  const uint32_t *ptarget, uint32_t max_nonce,
  unsigned long *hashes_done, uint32_t maxvote, int blocklen)
 {
+    const int thr_id = ctx->thr_id;
+
     // CUDA will process thousands of threads.
-    const int throughput = 4096 * 128;
+    const int throughput = device_throughput(ctx, 4096 * 128);
 
     if (opt_benchmark)
         ((uint32_t*)ptarget)[7] = 0x000000ff;
 
     int rc = 0;
-    uint32_t *hash = NULL;
-    cudaMallocHost(&hash, throughput*8*sizeof(uint32_t));
-    uint32_t *cpu_nonceVector = NULL;
-    cudaMallocHost(&cpu_nonceVector, throughput*sizeof(uint32_t));
 
     int nrmCalls[6];
     memset(nrmCalls, 0, sizeof(int) * 6);
@@ -303,19 +313,37 @@ int scanhash_heavy_cpp(int thr_id, uint32_t *pdata,
     genmask(target4, 2, highbit/4+(((highbit%4)>1)?1:0) ); // groestl512
     genmask(target5, 2, highbit/4+(((highbit%4)>0)?1:0) ); // blake512
 
-    static bool init[8] = {0,0,0,0,0,0,0,0};
-    if (!init[thr_id])
+    if (!ctx->init)
     {
+        const size_t hashBytes = 8 * sizeof(uint32_t) * throughput;
+        const size_t nonceBytes = sizeof(uint32_t) * throughput;
+
+        // Reste eines frueheren Batches, dann Nonce-Listen und pinned
+        // Readback-Puffer einmal belegen
+        heavy_cpu_free(thr_id);
+        if (!device_arena_reserve(ctx, 2 * device_arena_size(nonceBytes),
+                device_arena_size(hashBytes) + device_arena_size(nonceBytes)))
+            return 0;
+
         hefty_cpu_init(thr_id, throughput);
         sha256_cpu_init(thr_id, throughput);
         keccak512_cpu_init(thr_id, throughput);
         groestl512_cpu_init(thr_id, throughput);
         blake512_cpu_init(thr_id, throughput);
         combine_cpu_init(thr_id, throughput);
-        init[thr_id] = true;
-        cudaMalloc(&d_nonceVector[thr_id], sizeof(uint32_t) * throughput);
+        if (!compaction_alloc(&d_compaction[thr_id], throughput) || cudaGetLastError() != cudaSuccess)
+            return 0;
+        ctx->d_nonces[0] = (uint32_t *)device_arena_alloc(ctx, ARENA_DEVICE, nonceBytes);
+        ctx->d_nonces[1] = (uint32_t *)device_arena_alloc(ctx, ARENA_DEVICE, nonceBytes);
+        h_hash[thr_id] = (uint32_t *)device_arena_alloc(ctx, ARENA_HOST, hashBytes);
+        h_nonceVector[thr_id] = (uint32_t *)device_arena_alloc(ctx, ARENA_HOST, nonceBytes);
+        ctx->throughput = throughput;
+        ctx->init = true;
     }
 
+    uint32_t *hash = h_hash[thr_id];
+    uint32_t *cpu_nonceVector = h_nonceVector[thr_id];
+
     if (blocklen == HEAVYCOIN_BLKHDR_SZ)
     {
         uint16_t *ext = (uint16_t *)&pdata[20];
@@ -334,20 +362,26 @@ int scanhash_heavy_cpp(int thr_id, uint32_t *pdata,
             ext[0] = opt_vote;
     }
 
-    // Setze die Blockdaten
-    hefty_cpu_setBlock(thr_id, throughput, pdata, blocklen);
-    sha256_cpu_setBlock(pdata, blocklen);
-    keccak512_cpu_setBlock(pdata, blocklen);
-    groestl512_cpu_setBlock(pdata, blocklen);
-    blake512_cpu_setBlock(pdata, blocklen);
+    // Setze die Blockdaten, nur wenn sich der Header (ohne Nonce) geaendert hat
+    if (device_upload_needed(ctx, UPLOAD_BLOCK, pdata, blocklen))
+    {
+        hefty_cpu_setBlock(thr_id, throughput, pdata, blocklen);
+        sha256_cpu_setBlock(pdata, blocklen);
+        keccak512_cpu_setBlock(pdata, blocklen);
+        groestl512_cpu_setBlock(pdata, blocklen);
+        blake512_cpu_setBlock(pdata, blocklen);
+    }
 
     do {
+        // Treffer eines Batches, gemeldet wie bei den anderen Algos ueber
+        // submit_candidates(), damit Hashmeter, Metriken und Drosselung laufen
+        uint32_t nonces[DEVICE_CANDIDATES];
+        int count = 0;
         int i;
 
-        ////// Compaction init
-        thrust::device_ptr<uint32_t> devNoncePtr(d_nonceVector[thr_id]);
-        thrust::device_ptr<uint32_t> devNoncePtrEnd((d_nonceVector[thr_id]) + throughput);
+        ////// Compaction init, sha256 fllt die erste Liste
         uint32_t actualNumberOfValuesInNonceVectorGPU = throughput;
+        d_nonceVector[thr_id] = ctx->d_nonces[0];
 
         hefty_cpu_hash(thr_id, throughput, pdata[19]);
         //cudaThreadSynchronize();
@@ -358,8 +392,7 @@ int scanhash_heavy_cpp(int thr_id, uint32_t *pdata,
         MyStreamSynchronize(NULL, 1, thr_id);
 
         ////// Compaction
-        devNoncePtrEnd = thrust::remove_if(devNoncePtr, devNoncePtrEnd, check_nonce_for_remove(*((uint64_t*)target2), d_hash2output[thr_id], 8, pdata[19]));
-        actualNumberOfValuesInNonceVectorGPU = (uint32_t)(devNoncePtrEnd - devNoncePtr);
+        actualNumberOfValuesInNonceVectorGPU = heavy_compact(ctx, actualNumberOfValuesInNonceVectorGPU, *((uint64_t*)target2), d_hash2output[thr_id], 8, pdata[19]);
         if(actualNumberOfValuesInNonceVectorGPU == 0)
             goto emptyNonceVector;
         
@@ -367,8 +400,7 @@ int scanhash_heavy_cpp(int thr_id, uint32_t *pdata,
         //cudaThreadSynchronize();
 
         ////// Compaction
-        devNoncePtrEnd = thrust::remove_if(devNoncePtr, devNoncePtrEnd, check_nonce_for_remove(*((uint64_t*)target3), d_hash3output[thr_id], 16, pdata[19]));
-        actualNumberOfValuesInNonceVectorGPU = (uint32_t)(devNoncePtrEnd - devNoncePtr);
+        actualNumberOfValuesInNonceVectorGPU = heavy_compact(ctx, actualNumberOfValuesInNonceVectorGPU, *((uint64_t*)target3), d_hash3output[thr_id], 16, pdata[19]);
         if(actualNumberOfValuesInNonceVectorGPU == 0)
             goto emptyNonceVector;
 
@@ -376,8 +408,7 @@ int scanhash_heavy_cpp(int thr_id, uint32_t *pdata,
         //cudaThreadSynchronize();
 
         ////// Compaction
-        devNoncePtrEnd = thrust::remove_if(devNoncePtr, devNoncePtrEnd, check_nonce_for_remove(*((uint64_t*)target5), d_hash5output[thr_id], 16, pdata[19]));
-        actualNumberOfValuesInNonceVectorGPU = (uint32_t)(devNoncePtrEnd - devNoncePtr);
+        actualNumberOfValuesInNonceVectorGPU = heavy_compact(ctx, actualNumberOfValuesInNonceVectorGPU, *((uint64_t*)target5), d_hash5output[thr_id], 16, pdata[19]);
         if(actualNumberOfValuesInNonceVectorGPU == 0)
             goto emptyNonceVector;
 
@@ -385,8 +416,7 @@ int scanhash_heavy_cpp(int thr_id, uint32_t *pdata,
         //cudaThreadSynchronize();
 
         ////// Compaction
-        devNoncePtrEnd = thrust::remove_if(devNoncePtr, devNoncePtrEnd, check_nonce_for_remove(*((uint64_t*)target4), d_hash4output[thr_id], 16, pdata[19]));
-        actualNumberOfValuesInNonceVectorGPU = (uint32_t)(devNoncePtrEnd - devNoncePtr);
+        actualNumberOfValuesInNonceVectorGPU = heavy_compact(ctx, actualNumberOfValuesInNonceVectorGPU, *((uint64_t*)target4), d_hash4output[thr_id], 16, pdata[19]);
         if(actualNumberOfValuesInNonceVectorGPU == 0)
             goto emptyNonceVector;
         
@@ -404,35 +434,23 @@ int scanhash_heavy_cpp(int thr_id, uint32_t *pdata,
                 //uint32_t index = nonce - pdata[19];
                 uint32_t index = i;
                 uint32_t *foundhash = &hash[8*index];
-                if (foundhash[7] <= ptarget[7]) {
-                    if (fulltest(foundhash, ptarget)) {
-                        uint32_t verification[8];
-                        pdata[19] += nonce - pdata[19];
-                        heavycoin_hash((unsigned char *)verification, (const unsigned char *)pdata, blocklen);
-                        if (memcmp(verification, foundhash, 8*sizeof(uint32_t))) {
-                            applog(LOG_ERR, "hash for nonce=$%08X does not validate on CPU!\n", nonce);
-                        }
-                        else
-                        {
-                            *hashes_done = pdata[19] - start_nonce;
-                            rc = 1;
-                            goto exit;
-                        }
-                    }
+                if (foundhash[7] <= ptarget[7] && fulltest(foundhash, ptarget)) {
+                    if (count < DEVICE_CANDIDATES)
+                        nonces[count] = nonce;
+                    count++;
                 }
             }
         }
 
 emptyNonceVector:
+        // Verifikation und Submit laufen asynchron im CPU Verify-Pool
+        rc += submit_candidates(ctx, nonces, count);
 
         pdata[19] += throughput;
 
     } while (pdata[19] < max_nonce && !work_restart[thr_id].restart);
     *hashes_done = pdata[19] - start_nonce;
 
-exit:
-    cudaFreeHost(cpu_nonceVector);
-    cudaFreeHost(hash);
     return rc;
 }
 
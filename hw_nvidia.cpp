@@ -1,7 +1,18 @@
+//
+// NVAPI Provider der Sensoren (--hwmon=nvapi, nur Windows)
+//
+
+#define _WIN32_WINNT 0x0502
+#define WINVER 0x0502
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
 #include <stdio.h>
 #include <stdlib.h>
-#include "hw_nvidia.h"
 #include "nvapi.h" // I'll let you fix this one, I haven't included the files here, but they can be downloaded from the Nvidia website
+#include "device.h"
+#include "hwmon.h"
+#include "telemetry.h"
 
 // Link with nvapi
 #pragma comment( lib, "nvapi.lib" )
@@ -71,253 +82,117 @@ static NvAPI_GPU_GetUsages_t NvAPI_GPU_GetUsages = NULL;
 static NvAPI_GPU_GetCoolerSettings_t NvAPI_GPU_GetCoolerSettings = NULL;
 
 
-//
-// **** hw_nvidia_gettemperature ****
-//
-// Retrieve the temperature (in degrees) of a Nvidia GPU. -1 if not available
-// Thread safe, well as long as nvapi is thread safe ;)
-
-NvPhysicalGpuHandle nvGPUHandles[NVAPI_MAX_PHYSICAL_GPUS];
-NvU32 gpuCount = 0;
+// Array of physical GPU handle
+static NvPhysicalGpuHandle nvGPUHandles[NVAPI_MAX_PHYSICAL_GPUS];
+static NvU32 gpuCount = 0;
 
-int nw_nvidia_init()
+static bool nvapi_init()
 {
 	HMODULE hmod = LoadLibraryA("nvapi.dll");
 	if (hmod == NULL)
-		return -1;
-	
+		return false;
+
 	NvAPI_QueryInterface = (NvAPI_QueryInterface_t) GetProcAddress(hmod, "nvapi_QueryInterface");
+	if (NvAPI_QueryInterface == NULL)
+		return false;
 	NvAPI_GPU_GetUsages = (NvAPI_GPU_GetUsages_t) (*NvAPI_QueryInterface)(0x189A1FDF);
 	NvAPI_GPU_GetCoolerSettings = (NvAPI_GPU_GetCoolerSettings_t) (*NvAPI_QueryInterface)(0xDA141340);
-   
+
 	if (NvAPI_GPU_GetUsages == NULL || NvAPI_GPU_GetCoolerSettings == NULL)
-        return -1;
+		return false;
 
+	// Only initialize nvapi once
 	static bool s_nvapi_initialized = false;
 	CriticalSectionHolder csh( s_hw_nvidia_cs );
-	if( !s_nvapi_initialized )
+	if( !s_nvapi_initialized ) {
 		if( NvAPI_Initialize() != NVAPI_OK )
-			return -1;
+			return false;
 		s_nvapi_initialized = true;
+	}
 	if( NvAPI_EnumPhysicalGPUs( nvGPUHandles, &gpuCount ) != NVAPI_OK ) // !TODO: cache the table for drivers >= 105.00
-		return -1;
-	return 0;
+		return false;
+	return true;
 }
 
-INT32 hw_nvidia_gettemperature( DWORD dwGPUIndex )
+static int nvapi_find(int index, int pci_bus)
 {
-	DWORD *busid;
-	// Only initialize nvapi once
-	static bool s_nvapi_initialized = false;
-	// Array of physical GPU handle
-
-	// Thermal settings
-	NV_GPU_THERMAL_SETTINGS temperature;
-
-
-	// Ensure the index is correct
-	if( dwGPUIndex > gpuCount )
-		return -1;
-
-	/*for (int i = 0; i < gpuCount; i++)
+	for (NvU32 i = 0; i < gpuCount; i++)
 	{
-		if (NvAPI_GPU_GetBusId(nvGPUHandles[dwGPUIndex], busid) == NVAPI_OK )
-			if (int(busid) - 1 == i)
-			{*/
-				// Retrive the temperature
-				ZeroMemory( &temperature, sizeof( NV_GPU_THERMAL_SETTINGS ) );
-				temperature.version = NV_GPU_THERMAL_SETTINGS_VER;
-				if( NvAPI_GPU_GetThermalSettings( nvGPUHandles[ dwGPUIndex ], NVAPI_THERMAL_TARGET_ALL, &temperature ) != NVAPI_OK )
-					return -1;
-
-				if( temperature.count == 0 )
-					return -1;
-			/*}
-	}*/
-	return temperature.sensor[0].currentTemp;
-}
-
-ULONG hw_nvidia_DynamicPstateInfoEx( DWORD dwGPUIndex ) {
-	NV_GPU_DYNAMIC_PSTATES_INFO_EX m_DynamicPStateInfo;
-	ZeroMemory( &m_DynamicPStateInfo, sizeof( NV_GPU_DYNAMIC_PSTATES_INFO_EX ) );
-	m_DynamicPStateInfo.version = NV_GPU_DYNAMIC_PSTATES_INFO_EX_VER;
-
-	// Ensure the index is correct
-	if( dwGPUIndex > gpuCount )
-		return -1;
-
-	if (NvAPI_GPU_GetDynamicPstatesInfoEx( nvGPUHandles [dwGPUIndex], &m_DynamicPStateInfo) != NVAPI_OK)
-		return -1;
-	return m_DynamicPStateInfo.utilization[0].percentage;
-}
-
-
-ULONG hw_nvidia_memory_util_prc( DWORD dwGPUIndex ) {
-	NV_GPU_DYNAMIC_PSTATES_INFO_EX m_DynamicPStateInfo;
-	ZeroMemory( &m_DynamicPStateInfo, sizeof( NV_GPU_DYNAMIC_PSTATES_INFO_EX ) );
-	m_DynamicPStateInfo.version = NV_GPU_DYNAMIC_PSTATES_INFO_EX_VER;
-
-	// Ensure the index is correct
-	if( dwGPUIndex > gpuCount )
-		return -1;
-
-	if (NvAPI_GPU_GetDynamicPstatesInfoEx( nvGPUHandles [dwGPUIndex], &m_DynamicPStateInfo) != NVAPI_OK)
-		return -1;
-	return m_DynamicPStateInfo.utilization[1].percentage;
-}
-
-ULONG hw_nvidia_Pstate20 (DWORD dwGPUIndex) {
-	NV_GPU_PERF_PSTATES20_INFO m_PStateInfo;
-	ZeroMemory( &m_PStateInfo, sizeof(NV_GPU_PERF_PSTATES20_INFO));
-	m_PStateInfo.version = NV_GPU_PERF_PSTATES_INFO_VER2;
-
-	// Ensure the index is correct
-	if( dwGPUIndex > gpuCount )
-		return -1;
-	//if (NvAPI_GPU_GetPstates20( nvGPUHandles [dwGPUIndex], &m_PStateInfo) != NVAPI_OK)
-	if (NvAPI_GPU_GetPstates20( nvGPUHandles [dwGPUIndex], &m_PStateInfo) != NVAPI_OK)
-		return -1;
-	return m_PStateInfo.pstates[0].clocks[0].data.single.freq_kHz;
-}
-
-ULONG hw_nvidia_memory (DWORD dwGPUIndex)
-{
-	NV_DISPLAY_DRIVER_MEMORY_INFO pMemoryInfo;
-	ZeroMemory(&pMemoryInfo, sizeof(NV_DISPLAY_DRIVER_MEMORY_INFO));
-	pMemoryInfo.version = NV_DISPLAY_DRIVER_MEMORY_INFO_VER_2;
-	NvU32 usedMemory = 0, totalMemory = 0, availableMemory = 0;
-
-	// Ensure the index is correct
-	if( dwGPUIndex > gpuCount )
-		return -1;	
-
-	if (NvAPI_GPU_GetMemoryInfo( nvGPUHandles[dwGPUIndex], &pMemoryInfo) != NVAPI_OK)
-		return -1;
-	usedMemory = (pMemoryInfo.dedicatedVideoMemory-pMemoryInfo.curAvailableDedicatedVideoMemory)/1024;
-	return usedMemory;
-}
-
-ULONG hw_nvidia_memory_prc (DWORD dwGPUIndex)
-{
-	NV_DISPLAY_DRIVER_MEMORY_INFO pMemoryInfo2;
-	ZeroMemory(&pMemoryInfo2, sizeof(NV_DISPLAY_DRIVER_MEMORY_INFO));
-	pMemoryInfo2.version = NV_DISPLAY_DRIVER_MEMORY_INFO_VER_2;
-	NvU32 usedMemory = 0, totalMemory = 0, availableMemory = 0, usedMemoryPrc = 0;
-
-	// Ensure the index is correct
-	if( dwGPUIndex > gpuCount )
-		return -1;	
-
-	if (NvAPI_GPU_GetMemoryInfo( nvGPUHandles[dwGPUIndex], &pMemoryInfo2) != NVAPI_OK)
-		return -1;
-	totalMemory = pMemoryInfo2.dedicatedVideoMemory / 1024;
-	availableMemory = pMemoryInfo2.curAvailableDedicatedVideoMemory / 1024;
-	usedMemory = totalMemory - availableMemory;
-	usedMemoryPrc = 100 * usedMemory / totalMemory;
-	return usedMemoryPrc;
-}
-
-ULONG hw_nvidia_cooler (DWORD dwGPUIndex)
-{
-	NvU32 speed = 0;
-
-	if( dwGPUIndex > gpuCount )
-		return -1;
-	if (NvAPI_GPU_GetTachReading ( nvGPUHandles[dwGPUIndex], &speed) != NVAPI_OK)
-		return -1;
-	return speed;
-}
-
-ULONG hw_nvidia_fan (DWORD dwGPUIndex)
-{
-	NV_GPU_GETCOOLER_SETTINGS PCoolerSettings;
-	ZeroMemory(&PCoolerSettings, sizeof(NV_GPU_GETCOOLER_SETTINGS));
-	PCoolerSettings.version = NV_GPU_GETCOOLER_SETTINGS_VER;
-	if( dwGPUIndex > gpuCount )
-		return -1;
-	if ((*NvAPI_GPU_GetCoolerSettings)(nvGPUHandles[dwGPUIndex], 0, &PCoolerSettings) != NVAPI_OK)
-		return -1;
-	return PCoolerSettings.cooler[0].currentLevel;
-}
-
-extern int bus_ids[8];
-extern int device_map[8];
-ULONG get_bus_ids()
-{
-	NvU32 busid;
-	for (int i=0; i < gpuCount; i++)
-	{
-		if ( NvAPI_GPU_GetBusId(nvGPUHandles[device_map[i]], &busid) != NVAPI_OK )
-			return -1;
-		bus_ids[i] = busid;
+		NvU32 busid;
+		if (NvAPI_GPU_GetBusId(nvGPUHandles[i], &busid) == NVAPI_OK && (int)busid == pci_bus)
+			return i;
 	}
-	return 0;
-}
-
-
-ULONG get_bus_id(DWORD dwGPUindex)
-{
-	NvU32 busid;
-	if ( NvAPI_GPU_GetBusId(nvGPUHandles[dwGPUindex], &busid) != NVAPI_OK )
-		return -1;
-	return busid;
+	return -1;
 }
 
-ULONG hw_nvidia_clock (DWORD dwGPUIndex)
+// One query per NVAPI call, the old per-metric helpers asked for the clocks,
+// the pstates and the memory twice each
+static bool nvapi_sample_all(int gpu, struct telemetry_sample *s)
 {
-	NV_GPU_CLOCK_FREQUENCIES pClockInfo;
-	ZeroMemory(&pClockInfo, sizeof(NV_GPU_CLOCK_FREQUENCIES));
-	pClockInfo.version = NV_GPU_CLOCK_FREQUENCIES_VER_2;
-
-
-	// Ensure the index is correct
-	if( dwGPUIndex > gpuCount )
-		return -1;
-
-	if (NvAPI_GPU_GetAllClockFrequencies(nvGPUHandles[dwGPUIndex], &pClockInfo) != NVAPI_OK)
-		return -1;
-
-	return pClockInfo.domain[NVAPI_GPU_PUBLIC_CLOCK_GRAPHICS].frequency/1000;
-}
-
-ULONG hw_nvidia_clockMemory (DWORD dwGPUIndex)
-{
-	NV_GPU_CLOCK_FREQUENCIES pClockMemory;
-	ZeroMemory(&pClockMemory, sizeof(NV_GPU_CLOCK_FREQUENCIES));
-	pClockMemory.version = NV_GPU_CLOCK_FREQUENCIES_VER_2;
-
-	// Ensure the index is correct
-	if( dwGPUIndex > gpuCount )
-		return -1;
-
-	if (NvAPI_GPU_GetAllClockFrequencies(nvGPUHandles[dwGPUIndex], &pClockMemory) != NVAPI_OK)
-		return -1;
-
-	return pClockMemory.domain[NVAPI_GPU_PUBLIC_CLOCK_MEMORY].frequency/1000;
-}
-
-ULONG hw_nvidia_voltage (DWORD dwGPUIndex)
-{
-	NV_GPU_PERF_PSTATES20_INFO pPstatesInfo;
-	ZeroMemory(&pPstatesInfo, sizeof(NV_GPU_PERF_PSTATES20_INFO));
-	pPstatesInfo.version = NV_GPU_PERF_PSTATES20_INFO_VER;
-	
-	if( dwGPUIndex > gpuCount )
-		return -1;
-	 
-	if (NvAPI_GPU_GetPstates20(nvGPUHandles[dwGPUIndex], &pPstatesInfo) != NVAPI_OK)
-		return -1;
+	NvPhysicalGpuHandle handle = nvGPUHandles[gpu];
+	NV_GPU_THERMAL_SETTINGS temperature;
+	NV_GPU_GETCOOLER_SETTINGS cooler;
+	NV_GPU_CLOCK_FREQUENCIES clocks;
+	NV_GPU_DYNAMIC_PSTATES_INFO_EX pstates;
+	NV_DISPLAY_DRIVER_MEMORY_INFO memory;
+	NvU32 speed = 0;
 
-	return pPstatesInfo.ov.voltages[0].volt_uV;
-	//return pPstatesInfo.pstates[0].baseVoltages[j].volt_uV;
+	// Retrieve the temperature, the GPU is gone without it
+	ZeroMemory( &temperature, sizeof( NV_GPU_THERMAL_SETTINGS ) );
+	temperature.version = NV_GPU_THERMAL_SETTINGS_VER;
+	if( NvAPI_GPU_GetThermalSettings( handle, NVAPI_THERMAL_TARGET_ALL, &temperature ) != NVAPI_OK ||
+		temperature.count == 0 )
+		return false;
+	s->temp = temperature.sensor[0].currentTemp;
+
+	s->fan_rpm = (NvAPI_GPU_GetTachReading( handle, &speed ) == NVAPI_OK) ? speed : 0;
+
+	ZeroMemory(&cooler, sizeof(NV_GPU_GETCOOLER_SETTINGS));
+	cooler.version = NV_GPU_GETCOOLER_SETTINGS_VER;
+	if ((*NvAPI_GPU_GetCoolerSettings)(handle, 0, &cooler) == NVAPI_OK)
+		s->fan = cooler.cooler[0].currentLevel;
+	else
+		s->fan = 0;
+
+	ZeroMemory(&clocks, sizeof(NV_GPU_CLOCK_FREQUENCIES));
+	clocks.version = NV_GPU_CLOCK_FREQUENCIES_VER_2;
+	if (NvAPI_GPU_GetAllClockFrequencies(handle, &clocks) == NVAPI_OK) {
+		s->clock = clocks.domain[NVAPI_GPU_PUBLIC_CLOCK_GRAPHICS].frequency / 1000;
+		s->clock_mem = clocks.domain[NVAPI_GPU_PUBLIC_CLOCK_MEMORY].frequency / 1000;
+	} else
+		s->clock = s->clock_mem = 0;
+
+	ZeroMemory( &pstates, sizeof( NV_GPU_DYNAMIC_PSTATES_INFO_EX ) );
+	pstates.version = NV_GPU_DYNAMIC_PSTATES_INFO_EX_VER;
+	if (NvAPI_GPU_GetDynamicPstatesInfoEx( handle, &pstates ) == NVAPI_OK) {
+		s->load = pstates.utilization[0].percentage;
+		s->load_mem = pstates.utilization[1].percentage;
+	} else
+		s->load = s->load_mem = 0;
+
+	ZeroMemory(&memory, sizeof(NV_DISPLAY_DRIVER_MEMORY_INFO));
+	memory.version = NV_DISPLAY_DRIVER_MEMORY_INFO_VER_2;
+	if (NvAPI_GPU_GetMemoryInfo( handle, &memory ) == NVAPI_OK && memory.dedicatedVideoMemory) {
+		NvU32 usedMemory = memory.dedicatedVideoMemory - memory.curAvailableDedicatedVideoMemory;
+		s->mem_used = usedMemory / 1024;
+		s->mem_prc = 100 * (unsigned long long)usedMemory / memory.dedicatedVideoMemory;
+	} else
+		s->mem_used = s->mem_prc = 0;
+
+	// the public NVAPI has no power reading
+	s->power = 0;
+	return true;
 }
 
-
-ULONG hw_nvidia_version ()
+static int nvapi_driver_version()
 {
 	NV_DISPLAY_DRIVER_VERSION version = {0}; 
 	version.version = NV_DISPLAY_DRIVER_VERSION_VER; 
 	if (NvAPI_GetDisplayDriverVersion (NVAPI_DEFAULT_HANDLE, & version) != NVAPI_OK) 
-		return -1;
+		return 0;
 	return version.drvVersion;
-}
\ No newline at end of file
+}
+
+const struct hwmon_provider hwmon_nvapi = {
+	"nvapi", nvapi_init, nvapi_find, nvapi_sample_all, nvapi_driver_version
+};
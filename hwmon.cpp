@@ -0,0 +1,89 @@
+//
+// Quellen der GPU-Sensoren
+//
+// Jeder Provider liest alle Sensoren einer GPU mit einem sample_all()
+// Aufruf. Ohne --hwmon wird der erste genommen, der sich initialisieren
+// laesst: unter Windows NVAPI, dann NVML, unter Linux NVML, dann sysfs
+// (hwmon des Kernel-Treibers). Der mock Provider spielt Verlaeufe aus einer
+// Datei ab und braucht keine GPU.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "miner.h"
+#include "hwmon.h"
+
+const struct hwmon_provider *hwmon = NULL;
+char *opt_hwmon = NULL;
+char *opt_hwmon_trace = NULL;
+
+// Reihenfolge der Erkennung
+static const struct hwmon_provider *hwmon_providers[] = {
+#ifdef WIN32
+	&hwmon_nvapi,
+#endif
+	&hwmon_nvml,
+#ifndef WIN32
+	&hwmon_sysfs,
+#endif
+	&hwmon_mock,
+	NULL
+};
+
+extern "C" bool hwmon_provider_by_name(const char *name, const struct hwmon_provider **provider)
+{
+	if (!strcmp(name, "none"))
+	{
+		*provider = NULL;
+		return true;
+	}
+	for (int i = 0; hwmon_providers[i]; i++)
+	{
+		if (!strcmp(name, hwmon_providers[i]->name))
+		{
+			*provider = hwmon_providers[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+extern "C" bool hwmon_init(bool gpu)
+{
+	const struct hwmon_provider *provider;
+
+	// --hwmon-trace alleine heisst mock
+	if (opt_hwmon || opt_hwmon_trace)
+	{
+		if (!hwmon_provider_by_name(opt_hwmon ? opt_hwmon : "mock", &provider))
+			return false;
+		if (provider && !provider->init()) {
+			applog(LOG_ERR, "hardware monitor %s not available", provider->name);
+			return false;
+		}
+		hwmon = provider;
+		return true;
+	}
+
+	// ohne GPU gibt es nichts zu erkennen
+	if (!gpu)
+		return true;
+
+	// der mock Provider nur auf Wunsch
+	for (int i = 0; hwmon_providers[i] && hwmon_providers[i] != &hwmon_mock; i++)
+	{
+		if (hwmon_providers[i]->init())
+		{
+			hwmon = hwmon_providers[i];
+			return true;
+		}
+	}
+	applog(LOG_WARNING, "no hardware monitor found, GPU sensors disabled");
+	return true;
+}
+
+extern "C" int hwmon_driver_version(void)
+{
+	return hwmon ? hwmon->driver_version() : 0;
+}
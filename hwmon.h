@@ -0,0 +1,55 @@
+#ifndef __HWMON_H__
+#define __HWMON_H__
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct telemetry_sample;
+
+/* source of the GPU sensors read by the telemetry thread */
+struct hwmon_provider {
+	const char *name;
+	/* false if the library or interface is not there */
+	bool (*init)(void);
+	/* provider index of the index-th miner device on this PCI bus, -1 for none */
+	int (*find)(int index, int pci_bus);
+	/* all sensors of one GPU in one go, 0 for the ones it does not have;
+	 * false if the GPU did not answer */
+	bool (*sample_all)(int gpu, struct telemetry_sample *sample);
+	/* display driver version * 100, 0 if unknown */
+	int (*driver_version)(void);
+};
+
+#ifdef WIN32
+extern const struct hwmon_provider hwmon_nvapi;	/* hw_nvidia.cpp */
+#else
+extern const struct hwmon_provider hwmon_sysfs;	/* hwmon_sysfs.cpp */
+#endif
+extern const struct hwmon_provider hwmon_nvml;
+extern const struct hwmon_provider hwmon_mock;
+
+/* the provider in use, NULL without sensors */
+extern const struct hwmon_provider *hwmon;
+
+/* --hwmon, NULL = detect; --hwmon-trace for the mock provider */
+extern char *opt_hwmon;
+extern char *opt_hwmon_trace;
+
+/* "none" or a provider name, false for unknown names */
+extern bool hwmon_provider_by_name(const char *name, const struct hwmon_provider **provider);
+
+/* sets hwmon: opt_hwmon or, for GPU backends, the first provider that
+ * works; false only if the one asked for does not */
+extern bool hwmon_init(bool gpu);
+
+/* driver version * 100 from hwmon, 0 without one */
+extern int hwmon_driver_version(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HWMON_H__ */
@@ -0,0 +1,108 @@
+//
+// Mock Provider fuer die Sensoren (--hwmon=mock)
+//
+// Spielt Verlaeufe aus der --hwmon-trace Datei ab, ein Wert pro Abfrage:
+//
+//   [ { "temp": [60, 65, 70, 75], "clock": [1100, 1100, 1050], "fan": [40, 50] },
+//     { "temp": [55] } ]
+//
+// Schluessel sind die Felder von struct telemetry_sample (power in W).
+// Ein Objekt pro GPU, gibt es weniger als GPUs, faengt die Liste wieder von
+// vorne an. Jeder Verlauf laeuft fuer sich im Kreis, fehlende Sensoren
+// bleiben 0. Ohne Datei steigt die Temperatur langsam von 40 auf 90 C.
+//
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "miner.h"
+#include "hwmon.h"
+#include "telemetry.h"
+
+#define MOCK_SENSORS 10
+
+struct mock_sensor {
+	const char *name;
+	size_t offset;
+	bool temp;		// int statt unsigned long
+};
+
+static const struct mock_sensor mock_sensors[MOCK_SENSORS] = {
+	{ "temp", offsetof(struct telemetry_sample, temp), true },
+	{ "fan_rpm", offsetof(struct telemetry_sample, fan_rpm), false },
+	{ "fan", offsetof(struct telemetry_sample, fan), false },
+	{ "clock", offsetof(struct telemetry_sample, clock), false },
+	{ "load", offsetof(struct telemetry_sample, load), false },
+	{ "clock_mem", offsetof(struct telemetry_sample, clock_mem), false },
+	{ "load_mem", offsetof(struct telemetry_sample, load_mem), false },
+	{ "mem_used", offsetof(struct telemetry_sample, mem_used), false },
+	{ "mem_prc", offsetof(struct telemetry_sample, mem_prc), false },
+	{ "power", offsetof(struct telemetry_sample, power), false },
+};
+
+// nur der Telemetrie-Thread fragt ab
+static json_t *mock_trace = NULL;
+static unsigned long mock_step[MAX_GPUS];
+
+static bool mock_init(void)
+{
+	json_error_t err;
+
+	if (!opt_hwmon_trace)
+		return true;
+#if JANSSON_VERSION_HEX >= 0x020000
+	mock_trace = json_load_file(opt_hwmon_trace, 0, &err);
+#else
+	mock_trace = json_load_file(opt_hwmon_trace, &err);
+#endif
+	if (!json_is_array(mock_trace) || !json_array_size(mock_trace)) {
+		applog(LOG_ERR, "%s: no sensor traces (line %d: %s)", opt_hwmon_trace, err.line, err.text);
+		if (mock_trace)
+			json_decref(mock_trace);
+		mock_trace = NULL;
+		return false;
+	}
+	return true;
+}
+
+// jede Miner-Device bekommt eine eigene GPU
+static int mock_find(int index, int pci_bus)
+{
+	return (index < MAX_GPUS) ? index : -1;
+}
+
+static bool mock_sample_all(int gpu, struct telemetry_sample *s)
+{
+	unsigned long step = mock_step[gpu]++;
+	json_t *dev;
+
+	if (!mock_trace) {
+		s->temp = 40 + (int)(step % 51);
+		return true;
+	}
+
+	dev = json_array_get(mock_trace, gpu % json_array_size(mock_trace));
+	for (int i = 0; i < MOCK_SENSORS; i++)
+	{
+		json_t *trace = json_object_get(dev, mock_sensors[i].name);
+		size_t n = json_array_size(trace);
+		long v = n ? (long)json_number_value(json_array_get(trace, step % n)) : 0;
+		char *field = (char *)s + mock_sensors[i].offset;
+
+		if (mock_sensors[i].temp)
+			*(int *)field = (int)v;
+		else
+			*(unsigned long *)field = (v > 0) ? (unsigned long)v : 0;
+	}
+	return true;
+}
+
+static int mock_driver_version(void)
+{
+	return 0;
+}
+
+const struct hwmon_provider hwmon_mock = {
+	"mock", mock_init, mock_find, mock_sample_all, mock_driver_version
+};
@@ -0,0 +1,193 @@
+//
+// NVML Provider (--hwmon=nvml)
+//
+// Die NVIDIA Management Library kommt mit dem Treiber (libnvidia-ml.so.1,
+// unter Windows nvml.dll im NVSMI Ordner) und wird erst zur Laufzeit
+// geladen, ohne sie startet der Miner trotzdem. Die Drehzahl des Luefters
+// kennt NVML nicht, nur seine Stufe in %.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "miner.h"
+#include "hwmon.h"
+#include "telemetry.h"
+
+// aus nvml.h, nur was hier gebraucht wird
+#define NVML_SUCCESS 0
+#define NVML_TEMPERATURE_GPU 0
+#define NVML_CLOCK_GRAPHICS 0
+#define NVML_CLOCK_MEM 2
+
+typedef void *nvmlDevice_t;
+
+struct nvml_pci_info {
+	char bus_id_legacy[16];
+	unsigned int domain;
+	unsigned int bus;
+	unsigned int device;
+	unsigned int pci_device_id;
+	unsigned int pci_subsystem_id;
+	char reserved[64];	// busId und reserved der neueren Versionen
+};
+
+struct nvml_utilization {
+	unsigned int gpu;
+	unsigned int memory;
+};
+
+struct nvml_memory {
+	unsigned long long total;
+	unsigned long long free;
+	unsigned long long used;
+};
+
+static struct {
+	int (*init)(void);
+	int (*device_count)(unsigned int *count);
+	int (*device_handle)(unsigned int index, nvmlDevice_t *device);
+	int (*pci_info)(nvmlDevice_t device, struct nvml_pci_info *pci);
+	int (*temperature)(nvmlDevice_t device, int sensor, unsigned int *temp);
+	int (*fan_speed)(nvmlDevice_t device, unsigned int *speed);
+	int (*clock)(nvmlDevice_t device, int type, unsigned int *clock);
+	int (*utilization)(nvmlDevice_t device, struct nvml_utilization *util);
+	int (*memory)(nvmlDevice_t device, struct nvml_memory *mem);
+	int (*power)(nvmlDevice_t device, unsigned int *mw);	/* optional */
+	int (*driver_version)(char *version, unsigned int length);
+} nvml;
+
+static nvmlDevice_t nvml_devices[MAX_GPUS];
+static unsigned int nvml_count;
+
+static void *nvml_open(void)
+{
+#ifdef WIN32
+	HMODULE lib = LoadLibraryA("nvml.dll");
+	if (!lib) {
+		char path[MAX_PATH];
+
+		// nicht im Suchpfad, liegt beim Treiber
+		if (!ExpandEnvironmentStringsA("%ProgramW6432%\\NVIDIA Corporation\\NVSMI\\nvml.dll", path, sizeof(path)))
+			return NULL;
+		lib = LoadLibraryA(path);
+	}
+	return (void *)lib;
+#else
+	return dlopen("libnvidia-ml.so.1", RTLD_NOW);
+#endif
+}
+
+static void *nvml_symbol(void *lib, const char *name)
+{
+#ifdef WIN32
+	return (void *)GetProcAddress((HMODULE)lib, name);
+#else
+	return dlsym(lib, name);
+#endif
+}
+
+// die _v2/_v3 Varianten, wenn der Treiber sie hat
+static void *nvml_function(void *lib, const char *name, const char *versioned)
+{
+	void *f = versioned ? nvml_symbol(lib, versioned) : NULL;
+	return f ? f : nvml_symbol(lib, name);
+}
+
+static bool nvml_init(void)
+{
+	void *lib = nvml_open();
+
+	if (!lib)
+		return false;
+
+	*(void **)&nvml.init = nvml_function(lib, "nvmlInit", "nvmlInit_v2");
+	*(void **)&nvml.device_count = nvml_function(lib, "nvmlDeviceGetCount", "nvmlDeviceGetCount_v2");
+	*(void **)&nvml.device_handle = nvml_function(lib, "nvmlDeviceGetHandleByIndex", "nvmlDeviceGetHandleByIndex_v2");
+	*(void **)&nvml.pci_info = nvml_function(lib, "nvmlDeviceGetPciInfo", "nvmlDeviceGetPciInfo_v3");
+	*(void **)&nvml.temperature = nvml_function(lib, "nvmlDeviceGetTemperature", NULL);
+	*(void **)&nvml.fan_speed = nvml_function(lib, "nvmlDeviceGetFanSpeed", NULL);
+	*(void **)&nvml.clock = nvml_function(lib, "nvmlDeviceGetClockInfo", NULL);
+	*(void **)&nvml.utilization = nvml_function(lib, "nvmlDeviceGetUtilizationRates", NULL);
+	*(void **)&nvml.memory = nvml_function(lib, "nvmlDeviceGetMemoryInfo", NULL);
+	*(void **)&nvml.driver_version = nvml_function(lib, "nvmlSystemGetDriverVersion", NULL);
+	*(void **)&nvml.power = nvml_function(lib, "nvmlDeviceGetPowerUsage", NULL);
+
+	if (!nvml.init || !nvml.device_count || !nvml.device_handle || !nvml.pci_info ||
+		!nvml.temperature || !nvml.fan_speed || !nvml.clock || !nvml.utilization ||
+		!nvml.memory || !nvml.driver_version)
+		return false;
+
+	if (nvml.init() != NVML_SUCCESS || nvml.device_count(&nvml_count) != NVML_SUCCESS)
+		return false;
+	if (nvml_count > MAX_GPUS)
+		nvml_count = MAX_GPUS;
+	for (unsigned int i = 0; i < nvml_count; i++)
+		if (nvml.device_handle(i, &nvml_devices[i]) != NVML_SUCCESS)
+			nvml_devices[i] = NULL;
+	return nvml_count > 0;
+}
+
+static int nvml_find(int index, int pci_bus)
+{
+	for (unsigned int i = 0; i < nvml_count; i++)
+	{
+		struct nvml_pci_info pci;
+
+		if (nvml_devices[i] && nvml.pci_info(nvml_devices[i], &pci) == NVML_SUCCESS &&
+			(int)pci.bus == pci_bus)
+			return i;
+	}
+	return -1;
+}
+
+static bool nvml_sample_all(int gpu, struct telemetry_sample *s)
+{
+	nvmlDevice_t dev = nvml_devices[gpu];
+	struct nvml_utilization util;
+	struct nvml_memory mem;
+	unsigned int v;
+
+	if (nvml.temperature(dev, NVML_TEMPERATURE_GPU, &v) != NVML_SUCCESS)
+		return false;
+	s->temp = v;
+	s->fan_rpm = 0;
+	s->fan = (nvml.fan_speed(dev, &v) == NVML_SUCCESS) ? v : 0;
+	s->clock = (nvml.clock(dev, NVML_CLOCK_GRAPHICS, &v) == NVML_SUCCESS) ? v : 0;
+	s->clock_mem = (nvml.clock(dev, NVML_CLOCK_MEM, &v) == NVML_SUCCESS) ? v : 0;
+	if (nvml.utilization(dev, &util) == NVML_SUCCESS) {
+		s->load = util.gpu;
+		s->load_mem = util.memory;
+	} else
+		s->load = s->load_mem = 0;
+	if (nvml.memory(dev, &mem) == NVML_SUCCESS && mem.total) {
+		s->mem_used = (unsigned long)(mem.used >> 20);
+		s->mem_prc = (unsigned long)(100 * mem.used / mem.total);
+	} else
+		s->mem_used = s->mem_prc = 0;
+	s->power = (nvml.power && nvml.power(dev, &v) == NVML_SUCCESS) ? (v + 500) / 1000 : 0;
+	return true;
+}
+
+// "340.52" -> 34052
+static int nvml_driver_version(void)
+{
+	char version[80];
+	int major = 0, minor = 0;
+
+	if (nvml.driver_version(version, sizeof(version)) != NVML_SUCCESS ||
+		sscanf(version, "%d.%d", &major, &minor) < 1)
+		return 0;
+	return 100 * major + minor;
+}
+
+const struct hwmon_provider hwmon_nvml = {
+	"nvml", nvml_init, nvml_find, nvml_sample_all, nvml_driver_version
+};
@@ -0,0 +1,154 @@
+//
+// sysfs Provider (--hwmon=sysfs, nur Linux)
+//
+// Liest die hwmon Dateien, die der Kernel-Treiber (nouveau) unter dem
+// PCI Geraet anlegt:
+//
+//   /sys/bus/pci/devices/0000:01:00.0/hwmon/hwmon2/temp1_input   mC
+//                                                  fan1_input    RPM
+//                                                  pwm1          0..255
+//                                                  power1_average uW
+//
+// Der proprietaere Treiber legt keine an, dort findet NVML die GPU. Takt,
+// Last und Speicher gibt es hier nicht.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "miner.h"
+#include "hwmon.h"
+#include "telemetry.h"
+
+#define SYSFS_PCI "/sys/bus/pci/devices"
+
+// hwmon Verzeichnis pro gefundener GPU
+static char *sysfs_paths[MAX_GPUS];
+static int sysfs_count;
+
+// erstes hwmonN unter dem PCI Geraet, NULL wenn der Treiber keins hat
+static char *sysfs_hwmon(const char *pci)
+{
+	char path[256];
+	struct dirent *ent;
+	char *found = NULL;
+	DIR *dir;
+
+	snprintf(path, sizeof(path), SYSFS_PCI "/%s/hwmon", pci);
+	dir = opendir(path);
+	if (!dir)
+		return NULL;
+	while (!found && (ent = readdir(dir)) != NULL)
+	{
+		if (strncmp(ent->d_name, "hwmon", 5))
+			continue;
+		found = (char *)malloc(strlen(path) + strlen(ent->d_name) + 2);
+		if (found)
+			sprintf(found, "%s/%s", path, ent->d_name);
+	}
+	closedir(dir);
+	return found;
+}
+
+// eine Zahl aus einer sysfs Datei, -1 wenn es sie nicht gibt
+static long sysfs_read(int gpu, const char *name)
+{
+	char path[320];
+	long v = -1;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", sysfs_paths[gpu], name);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%ld", &v) != 1)
+		v = -1;
+	fclose(f);
+	return v;
+}
+
+// nur brauchbar, wenn mindestens eine NVIDIA GPU Sensoren hat
+static bool sysfs_init(void)
+{
+	struct dirent *ent;
+	bool found = false;
+	DIR *dir = opendir(SYSFS_PCI);
+
+	if (!dir)
+		return false;
+	while (!found && (ent = readdir(dir)) != NULL)
+	{
+		char path[256];
+		unsigned int vendor = 0;
+		char *hwmon;
+		FILE *f;
+
+		snprintf(path, sizeof(path), SYSFS_PCI "/%s/vendor", ent->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		if (fscanf(f, "%x", &vendor) == 1 && vendor == 0x10de && (hwmon = sysfs_hwmon(ent->d_name)) != NULL) {
+			free(hwmon);
+			found = true;
+		}
+		fclose(f);
+	}
+	closedir(dir);
+	return found;
+}
+
+static int sysfs_find(int index, int pci_bus)
+{
+	struct dirent *ent;
+	int gpu = -1;
+	DIR *dir;
+
+	if (sysfs_count >= MAX_GPUS || !(dir = opendir(SYSFS_PCI)))
+		return -1;
+
+	// Funktion 0 des Geraets auf dem Bus, in jeder PCI Domain
+	while (gpu < 0 && (ent = readdir(dir)) != NULL)
+	{
+		unsigned int domain, bus, slot, func;
+
+		if (sscanf(ent->d_name, "%x:%x:%x.%x", &domain, &bus, &slot, &func) != 4 ||
+			(int)bus != pci_bus || func != 0)
+			continue;
+		sysfs_paths[sysfs_count] = sysfs_hwmon(ent->d_name);
+		if (sysfs_paths[sysfs_count])
+			gpu = sysfs_count++;
+	}
+	closedir(dir);
+	return gpu;
+}
+
+static bool sysfs_sample_all(int gpu, struct telemetry_sample *s)
+{
+	long temp = sysfs_read(gpu, "temp1_input");
+	long rpm = sysfs_read(gpu, "fan1_input");
+	long pwm = sysfs_read(gpu, "pwm1");
+	long power = sysfs_read(gpu, "power1_average");
+
+	if (temp < 0)
+		return false;
+	s->temp = (int)(temp / 1000);
+	s->fan_rpm = (rpm > 0) ? rpm : 0;
+	s->fan = (pwm > 0) ? (100 * pwm + 127) / 255 : 0;
+	s->clock = s->load = 0;
+	s->clock_mem = s->load_mem = 0;
+	s->mem_used = s->mem_prc = 0;
+	s->power = (power > 0) ? (power + 500000) / 1000000 : 0;
+	return true;
+}
+
+// der Kernel-Treiber hat keine NVIDIA Versionsnummer
+static int sysfs_driver_version(void)
+{
+	return 0;
+}
+
+const struct hwmon_provider hwmon_sysfs = {
+	"sysfs", sysfs_init, sysfs_find, sysfs_sample_all, sysfs_driver_version
+};
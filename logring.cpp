@@ -0,0 +1,260 @@
+//
+// Log-Ring
+//
+// applog() und printline() formatieren ihre Zeile direkt in einen Slot
+// eines festen Rings und kehren zurueck, ohne Lock und ohne curses. Ein
+// Log-Thread leert den Ring und ist der einzige, der schreibt: in das
+// curses Fenster, oder mit --headless als JSON-Zeile nach stdout bzw. ins
+// syslog. Er ruft auch die Anzeige auf (Tasten, GPU-Zeilen), so bleibt
+// curses ganz aus den Miner-Threads heraus.
+//
+// Der Ring ist eine begrenzte MPSC-Queue (nach Vyukov): jeder Slot traegt
+// eine Sequenznummer, ein Schreiber reserviert seinen Slot mit einem CAS.
+// Ist der Ring voll, wird die Zeile verworfen und gezaehlt, ein Miner-
+// Thread wartet nie auf die Ausgabe.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+
+#include "miner.h"
+#include "logring.h"
+
+#define LOGRING_POLL_MS 50
+
+bool opt_headless = false;
+
+struct logring_slot {
+	std::atomic<unsigned int> seq;
+	int prio;
+	time_t time;
+	char line[LOGRING_LINE];
+};
+
+static struct logring_slot ring[LOGRING_SLOTS];
+static std::atomic<unsigned int> ring_head;	// naechster Slot der Schreiber
+static unsigned int ring_tail;			// naechster Slot des Log-Threads
+static std::atomic<unsigned long> ring_dropped;
+static std::atomic<bool> ring_running;
+
+static logring_writer ring_write;
+static void (*ring_tick)(void);
+static pthread_t ring_thread;
+// nur zwischen Log-Thread und logring_stop(), nie fuer die Schreiber
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// ohne Log-Thread: sofort und im Format von frueher
+// localtime() teilt einen statischen Puffer, vor logring_start() und nach
+// logring_stop() schreibt jeder Thread selbst
+static void logring_localtime(time_t time, struct tm *tm)
+{
+#ifdef _WIN32
+	localtime_s(tm, &time);
+#else
+	localtime_r(&time, tm);
+#endif
+}
+
+static void logring_stderr(int prio, time_t time, const char *line)
+{
+	struct tm tm;
+
+	logring_localtime(time, &tm);
+
+	fprintf(stderr, "[%d-%02d-%02d %02d:%02d:%02d] %s\n", tm.tm_year + 1900, tm.tm_mon + 1,
+		tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, line);
+}
+
+// Zeilenenden gehoeren dem Writer
+static void logring_trim(char *line)
+{
+	size_t n = strlen(line);
+
+	while (n && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+		line[--n] = '\0';
+}
+
+extern "C" void logring_vpush(int prio, const char *fmt, va_list ap)
+{
+	struct logring_slot *s;
+	unsigned int pos;
+
+	if (!ring_running.load(std::memory_order_acquire)) {
+		char line[LOGRING_LINE];
+
+		vsnprintf(line, sizeof(line), fmt, ap);
+		line[sizeof(line) - 1] = '\0';
+		logring_trim(line);
+		logring_stderr(prio, time(NULL), line);
+		return;
+	}
+
+	pos = ring_head.load(std::memory_order_relaxed);
+	while (1)
+	{
+		s = &ring[pos % LOGRING_SLOTS];
+		int diff = (int)(s->seq.load(std::memory_order_acquire) - pos);
+
+		if (diff == 0) {
+			if (ring_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			// voll, der Log-Thread kommt nicht nach
+			ring_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		} else
+			pos = ring_head.load(std::memory_order_relaxed);
+	}
+
+	s->prio = prio;
+	s->time = time(NULL);
+	vsnprintf(s->line, sizeof(s->line), fmt, ap);
+	s->line[sizeof(s->line) - 1] = '\0';
+	logring_trim(s->line);
+	s->seq.store(pos + 1, std::memory_order_release);
+}
+
+// alles Fertige schreiben, unter drain_lock oder im Log-Thread
+static void logring_drain(void)
+{
+	static unsigned long reported;
+	unsigned long dropped = ring_dropped.load(std::memory_order_relaxed);
+
+	while (1)
+	{
+		struct logring_slot *s = &ring[ring_tail % LOGRING_SLOTS];
+
+		// leer, oder ein Schreiber ist mit seinem Slot noch nicht fertig
+		if (s->seq.load(std::memory_order_acquire) != ring_tail + 1)
+			break;
+		ring_write(s->prio, s->time, s->line);
+		s->seq.store(ring_tail + LOGRING_SLOTS, std::memory_order_release);
+		ring_tail++;
+	}
+
+	if (dropped != reported) {
+		char line[64];
+
+		sprintf(line, "%lu log lines dropped, output too slow", dropped - reported);
+		ring_write(LOG_WARNING, time(NULL), line);
+		reported = dropped;
+	}
+	if (opt_headless)
+		fflush(stdout);
+}
+
+static void *logring_thread(void *userdata)
+{
+	while (ring_running.load(std::memory_order_acquire))
+	{
+		pthread_mutex_lock(&drain_lock);
+		if (ring_running.load(std::memory_order_relaxed)) {
+			logring_drain();
+			if (ring_tick)
+				ring_tick();
+		}
+		pthread_mutex_unlock(&drain_lock);
+		usleep(LOGRING_POLL_MS * 1000);
+	}
+	return NULL;
+}
+
+static void logring_exit(void)
+{
+	logring_stop();
+}
+
+extern "C" bool logring_start(logring_writer write, void (*tick)(void))
+{
+	for (unsigned int i = 0; i < LOGRING_SLOTS; i++)
+		ring[i].seq.store(i, std::memory_order_relaxed);
+	ring_head.store(0, std::memory_order_relaxed);
+	ring_tail = 0;
+	ring_write = write;
+	ring_tick = tick;
+	ring_running.store(true, std::memory_order_release);
+
+	if (pthread_create(&ring_thread, NULL, logring_thread, NULL)) {
+		ring_running.store(false, std::memory_order_release);
+		return false;
+	}
+	pthread_detach(ring_thread);
+	atexit(logring_exit);
+	return true;
+}
+
+extern "C" void logring_stop(void)
+{
+	bool own;
+
+	if (!ring_running.load(std::memory_order_acquire))
+		return;
+	// aus dem Log-Thread selbst (F10 in der Anzeige) haelt er den Lock schon
+	own = pthread_equal(pthread_self(), ring_thread) != 0;
+	if (!own)
+		pthread_mutex_lock(&drain_lock);
+	if (ring_running.load(std::memory_order_relaxed)) {
+		logring_drain();
+		ring_running.store(false, std::memory_order_release);
+	}
+	if (!own)
+		pthread_mutex_unlock(&drain_lock);
+}
+
+static const char *logring_level(int prio)
+{
+	switch (prio) {
+	case LOG_ERR:
+		return "error";
+	case LOG_WARNING:
+		return "warning";
+	case LOG_NOTICE:
+		return "notice";
+	case LOG_DEBUG:
+		return "debug";
+	default:
+		return "info";
+	}
+}
+
+extern "C" void logring_json(int prio, time_t time, const char *line)
+{
+	struct tm tm;
+	char msg[6 * LOGRING_LINE + 1];
+	size_t n = 0;
+
+	logring_localtime(time, &tm);
+
+	for (const unsigned char *p = (const unsigned char *)line; *p; p++)
+	{
+		if (*p == '"' || *p == '\\') {
+			msg[n++] = '\\';
+			msg[n++] = *p;
+		} else if (*p == '\n') {
+			msg[n++] = '\\';
+			msg[n++] = 'n';
+		} else if (*p == '\t') {
+			msg[n++] = '\\';
+			msg[n++] = 't';
+		} else if (*p < 0x20)
+			n += sprintf(msg + n, "\\u%04x", *p);
+		else
+			msg[n++] = *p;
+	}
+	msg[n] = '\0';
+
+	printf("{\"time\":\"%d-%02d-%02dT%02d:%02d:%02d\",\"level\":\"%s\",\"msg\":\"%s\"}\n",
+		tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+		logring_level(prio), msg);
+}
+
+#ifdef HAVE_SYSLOG_H
+extern "C" void logring_syslog(int prio, time_t time, const char *line)
+{
+	syslog(prio, "%s", line);
+}
+#endif
@@ -0,0 +1,44 @@
+#ifndef __LOGRING_H__
+#define __LOGRING_H__
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* lines in flight, more are dropped and counted */
+#define LOGRING_SLOTS 1024
+/* characters per line, longer ones are cut */
+#define LOGRING_LINE 256
+
+/* writes one line, called only by the log thread */
+typedef void (*logring_writer)(int prio, time_t time, const char *line);
+
+/* no curses screen, log lines go to stdout as JSON (or to syslog) */
+extern bool opt_headless;
+
+/* queues a line without a lock, any thread; before logring_start() and
+ * after logring_stop() it goes straight to stderr */
+extern void logring_vpush(int prio, const char *fmt, va_list ap);
+
+/* starts the log thread: drains the ring into write and calls tick
+ * (may be NULL) every LOGRING_POLL_MS, both on that thread only */
+extern bool logring_start(logring_writer write, void (*tick)(void));
+
+/* writes what is queued and stops the log thread, also at exit() */
+extern void logring_stop(void);
+
+/* writers for --headless */
+extern void logring_json(int prio, time_t time, const char *line);
+#ifdef HAVE_SYSLOG_H
+extern void logring_syslog(int prio, time_t time, const char *line);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LOGRING_H__ */
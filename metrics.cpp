@@ -0,0 +1,531 @@
+//
+// Prometheus Metriken (GET /metrics am --api-bind Port)
+//
+// Die Zaehler und Histogramme werden dort vorab summiert, wo die Ereignisse
+// passieren, mit relaxed Atomics und festen Buckets. Beim Abfragen wird
+// nur noch Text in einen wiederverwendeten Puffer geschrieben, Hashraten
+// und Sensoren kommen aus den Snapshots von hashmeter und telemetry.
+//
+// Die Antwort des Pools auf einen Share kennt weder GPU noch Sendezeit
+// (Stratum antwortet immer auf id 4), deshalb merkt sich metrics_submit()
+// beides in einer kleinen FIFO und metrics_share() nimmt den aeltesten
+// Eintrag, der Pool antwortet in der Reihenfolge der Shares.
+//
+// Ein neuer Block wird von der Meldung des Pools bis zum ersten Batch jedes
+// Devices verfolgt: metrics_notify() (mining.notify mit clean_jobs bzw.
+// Longpoll-Antwort), metrics_restart() (Arbeit gebaut, restart_threads),
+// metrics_job_switch() (der Miner-Thread nimmt sie, erst nach seinem
+// laufenden Batch) und metrics_batch() (erster Batch darauf fertig). Die
+// letzten METRICS_JOBS Neustarts liegen in einem Ring, geschrieben nur
+// unter job_lock von restart_threads und pro Device vom eigenen Miner-
+// Thread, gelesen ohne Lock mit Pruefung der Sequenznummer.
+//
+// Die Zaehler aus device_ctx (Batches, Idle, Verify) lesen API und /metrics
+// nur ueber metrics_device_read(): zwei Seqlocks pro Device, den einen
+// schreibt allein der Miner-Thread, den anderen die Verify-Threads unter
+// stats_lock.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <atomic>
+
+#include "miner.h"
+#include "device_backend.h"
+#include "hashmeter.h"
+#include "telemetry.h"
+#include "thermal.h"
+#include "api.h"
+#include "metrics.h"
+#include "seqlock.h"
+
+// Shares ohne Antwort, aeltere fallen heraus
+#define METRICS_PENDING 64
+#define METRICS_LINE 512
+
+enum { SHARE_ACCEPTED, SHARE_REJECTED, SHARE_STALE, SHARE_RESULTS };
+
+static const char *share_results[SHARE_RESULTS] = { "accepted", "rejected", "stale" };
+
+// obere Grenzen in s, dazu der +Inf Bucket
+static const double submit_bounds[] = { 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0 };
+static const double switch_bounds[] = { 0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 5.0 };
+static const double build_bounds[] = { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.05, 0.25, 1.0 };
+
+#define SUBMIT_BUCKETS (int)(sizeof(submit_bounds) / sizeof(submit_bounds[0]))
+#define SWITCH_BUCKETS (int)(sizeof(switch_bounds) / sizeof(switch_bounds[0]))
+#define BUILD_BUCKETS (int)(sizeof(build_bounds) / sizeof(build_bounds[0]))
+#define MAX_BUCKETS 10
+
+struct histogram {
+	std::atomic<unsigned long> buckets[MAX_BUCKETS + 1];	// nicht kumuliert
+	std::atomic<long long> sum_us;
+};
+
+struct DEVICE_ALIGN device_metrics {
+	std::atomic<unsigned long> shares[SHARE_RESULTS];
+	// nur der Miner-Thread schreibt
+	struct histogram job_switch;	// Arbeit gebaut -> vom Thread genommen
+	struct histogram job_first;	// Meldung -> erster Batch fertig
+	unsigned int job_pending;	// Neustart, dessen erster Batch aussteht
+};
+
+// ein Neustart, alle Zeiten in us, 0 = noch nicht
+struct job_event {
+	std::atomic<unsigned int> seq;	// 0 solange metrics_restart() ihn fuellt
+	std::atomic<long long> notify_us, built_us;
+	std::atomic<int> n_devices, done;
+	std::atomic<long long> took_us[MAX_GPUS], first_us[MAX_GPUS];
+};
+
+struct pending_share {
+	int thr_id;
+	long long sent_us;
+};
+
+static struct device_metrics device_metrics[MAX_GPUS];
+static struct histogram submit_latency;
+static struct histogram job_build;	// Meldung -> Arbeit gebaut
+static struct histogram job_all;	// Meldung -> erster Batch auf allen Devices
+
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct job_event job_events[METRICS_JOBS];
+static std::atomic<unsigned int> job_seq;	// letzter Neustart, 0 = keiner
+static std::atomic<long long> notify_us;	// Meldung ohne Neustart bisher
+
+// verify bleibt in published_stats leer, es kommt aus published_verify
+static struct seqlock<struct device_stats> published_stats[MAX_GPUS];
+static struct seqlock<struct verify_stats> published_verify[MAX_GPUS];
+
+// FIFO der Shares ohne Antwort, workio schreibt, stratum liest
+static pthread_mutex_t pending_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct pending_share pending[METRICS_PENDING];
+static int pending_head, pending_count;
+
+static long long metrics_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return 1000000LL * tv.tv_sec + tv.tv_usec;
+}
+
+static void histogram_observe(struct histogram *h, const double *bounds, int n, long long us)
+{
+	double s = 1e-6 * us;
+	int i;
+
+	for (i = 0; i < n && s > bounds[i]; i++)
+		;
+	h->buckets[i].fetch_add(1, std::memory_order_relaxed);
+	h->sum_us.fetch_add(us, std::memory_order_relaxed);
+}
+
+extern "C" void metrics_submit(int thr_id)
+{
+	struct pending_share *p;
+
+	pthread_mutex_lock(&pending_lock);
+	if (pending_count == METRICS_PENDING) {
+		pending_head = (pending_head + 1) % METRICS_PENDING;
+		pending_count--;
+	}
+	p = &pending[(pending_head + pending_count++) % METRICS_PENDING];
+	p->thr_id = thr_id;
+	p->sent_us = metrics_now();
+	pthread_mutex_unlock(&pending_lock);
+}
+
+extern "C" void metrics_share(bool accepted)
+{
+	struct pending_share p;
+	bool found;
+
+	pthread_mutex_lock(&pending_lock);
+	found = pending_count > 0;
+	if (found) {
+		p = pending[pending_head];
+		pending_head = (pending_head + 1) % METRICS_PENDING;
+		pending_count--;
+	}
+	pthread_mutex_unlock(&pending_lock);
+
+	// eine Antwort ohne gesendeten Share gehoert keiner GPU
+	if (!found || p.thr_id < 0 || p.thr_id >= MAX_GPUS)
+		return;
+	device_metrics[p.thr_id].shares[accepted ? SHARE_ACCEPTED : SHARE_REJECTED]
+		.fetch_add(1, std::memory_order_relaxed);
+	histogram_observe(&submit_latency, submit_bounds, SUBMIT_BUCKETS, metrics_now() - p.sent_us);
+}
+
+extern "C" void metrics_submit_reset(void)
+{
+	pthread_mutex_lock(&pending_lock);
+	pending_head = pending_count = 0;
+	pthread_mutex_unlock(&pending_lock);
+}
+
+extern "C" void metrics_stale(int thr_id)
+{
+	if (thr_id >= 0 && thr_id < MAX_GPUS)
+		device_metrics[thr_id].shares[SHARE_STALE].fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" void metrics_notify(void)
+{
+	notify_us.store(metrics_now(), std::memory_order_relaxed);
+}
+
+extern "C" void metrics_restart(int n_devices)
+{
+	long long now = metrics_now();
+	long long notify = notify_us.exchange(0, std::memory_order_relaxed);
+	struct job_event *e;
+	unsigned int seq;
+
+	// Reconnect und Longpoll-Timeout kommen ohne Meldung, sie beginnen hier
+	if (notify && notify <= now)
+		histogram_observe(&job_build, build_bounds, BUILD_BUCKETS, now - notify);
+	else
+		notify = now;
+
+	pthread_mutex_lock(&job_lock);
+	seq = job_seq.load(std::memory_order_relaxed) + 1;
+	e = &job_events[seq % METRICS_JOBS];
+	e->seq.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	e->notify_us.store(notify, std::memory_order_relaxed);
+	e->built_us.store(now, std::memory_order_relaxed);
+	e->n_devices.store(n_devices, std::memory_order_relaxed);
+	e->done.store(0, std::memory_order_relaxed);
+	for (int i = 0; i < MAX_GPUS; i++)
+	{
+		e->took_us[i].store(0, std::memory_order_relaxed);
+		e->first_us[i].store(0, std::memory_order_relaxed);
+	}
+	e->seq.store(seq, std::memory_order_release);
+	// vor work_restart[].restart, so findet der Miner-Thread diesen Eintrag
+	job_seq.store(seq, std::memory_order_release);
+	pthread_mutex_unlock(&job_lock);
+}
+
+extern "C" void metrics_job_switch(int thr_id)
+{
+	unsigned int seq = job_seq.load(std::memory_order_acquire);
+	struct job_event *e = &job_events[seq % METRICS_JOBS];
+	long long now, built;
+
+	if (!seq || thr_id < 0 || thr_id >= MAX_GPUS)
+		return;
+	built = e->built_us.load(std::memory_order_relaxed);
+	if (e->seq.load(std::memory_order_acquire) != seq)
+		return;
+
+	now = metrics_now();
+	e->took_us[thr_id].store(now, std::memory_order_relaxed);
+	histogram_observe(&device_metrics[thr_id].job_switch, switch_bounds, SWITCH_BUCKETS, now - built);
+	device_metrics[thr_id].job_pending = seq;
+}
+
+extern "C" void metrics_batch(int thr_id)
+{
+	struct device_metrics *m;
+	struct job_event *e;
+	long long now, notify;
+	unsigned int seq;
+	int n;
+
+	if (thr_id < 0 || thr_id >= MAX_GPUS || !device_metrics[thr_id].job_pending)
+		return;
+	m = &device_metrics[thr_id];
+	seq = m->job_pending;
+	m->job_pending = 0;
+
+	e = &job_events[seq % METRICS_JOBS];
+	notify = e->notify_us.load(std::memory_order_relaxed);
+	n = e->n_devices.load(std::memory_order_relaxed);
+	// schon ueberschrieben, der Thread hing laenger als METRICS_JOBS Neustarts
+	if (e->seq.load(std::memory_order_acquire) != seq)
+		return;
+
+	now = metrics_now();
+	e->first_us[thr_id].store(now, std::memory_order_relaxed);
+	histogram_observe(&m->job_first, switch_bounds, SWITCH_BUCKETS, now - notify);
+	// das letzte Device schliesst den Neustart ab
+	if (e->done.fetch_add(1, std::memory_order_relaxed) + 1 == n)
+		histogram_observe(&job_all, switch_bounds, SWITCH_BUCKETS, now - notify);
+}
+
+extern "C" void metrics_device(const struct device_ctx *ctx)
+{
+	struct device_stats s;
+
+	if (ctx->thr_id < 0 || ctx->thr_id >= MAX_GPUS)
+		return;
+	memset(&s, 0, sizeof(s));
+	s.intensity = ctx->intensity;
+	s.batch = ctx->batch;
+	s.batches = ctx->batches;
+	s.gpu_idle = ctx->gpu_idle;
+	s.checked_batches = ctx->checked_batches;
+	s.candidates = ctx->candidates;
+	s.dropped = ctx->dropped;
+	s.hashrate = ctx->hashrate;
+	s.cpu_load = ctx->cpu_load;
+	s.cpu_time = ctx->cpu_time;
+	s.allocs = ctx->arena.allocs;
+	published_stats[ctx->thr_id].write(s);
+}
+
+extern "C" void metrics_verify(const struct device_ctx *ctx)
+{
+	if (ctx->thr_id >= 0 && ctx->thr_id < MAX_GPUS)
+		published_verify[ctx->thr_id].write(ctx->verify);
+}
+
+extern "C" void metrics_device_read(int thr_id, struct device_stats *stats)
+{
+	if (thr_id < 0 || thr_id >= MAX_GPUS) {
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+	published_stats[thr_id].read(*stats);
+	published_verify[thr_id].read(stats->verify);
+}
+
+extern "C" bool metrics_job_read(int age, struct job_timing *t)
+{
+	unsigned int last = job_seq.load(std::memory_order_acquire), seq;
+	struct job_event *e;
+
+	if (age < 0 || age >= METRICS_JOBS || (unsigned int)age >= last)
+		return false;
+	seq = last - age;
+	e = &job_events[seq % METRICS_JOBS];
+	if (e->seq.load(std::memory_order_acquire) != seq)
+		return false;
+
+	t->seq = seq;
+	t->notify = e->notify_us.load(std::memory_order_relaxed);
+	t->built = e->built_us.load(std::memory_order_relaxed);
+	t->n_devices = e->n_devices.load(std::memory_order_relaxed);
+	if (t->n_devices > MAX_GPUS)
+		t->n_devices = MAX_GPUS;
+	for (int i = 0; i < t->n_devices; i++)
+	{
+		t->took[i] = e->took_us[i].load(std::memory_order_relaxed);
+		t->first[i] = e->first_us[i].load(std::memory_order_relaxed);
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return e->seq.load(std::memory_order_relaxed) == seq;
+}
+
+// Ausgabe: ein Puffer, der nur waechst
+struct metrics_out {
+	char **buf;
+	size_t *size;
+	size_t len;
+	bool oom;
+};
+
+static void metrics_printf(struct metrics_out *out, const char *fmt, ...)
+{
+	char line[METRICS_LINE];
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+	if (n < 0 || n >= (int)sizeof(line))
+		n = (int)sizeof(line) - 1;
+
+	if (out->len + n + 1 > *out->size) {
+		size_t size = *out->size ? 2 * *out->size : 16384;
+		char *buf;
+
+		while (size < out->len + n + 1)
+			size *= 2;
+		buf = (char *)realloc(*out->buf, size);
+		if (!buf) {
+			out->oom = true;
+			return;
+		}
+		*out->buf = buf;
+		*out->size = size;
+	}
+	memcpy(*out->buf + out->len, line, n);
+	out->len += n;
+	(*out->buf)[out->len] = '\0';
+}
+
+static void metrics_header(struct metrics_out *out, const char *name, const char *type, const char *help)
+{
+	metrics_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// Labelwert mit \ " und Zeilenumbruch maskiert
+static const char *metrics_label(char *dst, size_t size, const char *s)
+{
+	size_t n = 0;
+
+	for (; s && *s && n + 3 < size; s++)
+	{
+		if (*s == '\\' || *s == '"')
+			dst[n++] = '\\';
+		else if (*s == '\n') {
+			dst[n++] = '\\';
+			dst[n++] = 'n';
+			continue;
+		}
+		dst[n++] = *s;
+	}
+	dst[n] = '\0';
+	return dst;
+}
+
+static void metrics_histogram(struct metrics_out *out, const char *name, const char *labels,
+	const struct histogram *h, const double *bounds, int n)
+{
+	unsigned long count = 0;
+	const char *sep = *labels ? "," : "";
+	char braces[160] = "";
+
+	if (*labels)
+		snprintf(braces, sizeof(braces), "{%s}", labels);
+
+	for (int i = 0; i <= n; i++)
+	{
+		count += h->buckets[i].load(std::memory_order_relaxed);
+		if (i < n)
+			metrics_printf(out, "%s_bucket{%s%sle=\"%g\"} %lu\n", name, labels, sep, bounds[i], count);
+		else
+			metrics_printf(out, "%s_bucket{%s%sle=\"+Inf\"} %lu\n", name, labels, sep, count);
+	}
+	metrics_printf(out, "%s_sum%s %.6f\n", name, braces, 1e-6 * h->sum_us.load(std::memory_order_relaxed));
+	metrics_printf(out, "%s_count%s %lu\n", name, braces, count);
+}
+
+extern "C" size_t metrics_render(const struct api_info *info, char **buf, size_t *size)
+{
+	static const char *windows[HASHMETER_WINDOWS] = { "10s", "1m", "15m" };
+	struct metrics_out out = { buf, size, 0, false };
+	struct telemetry_sample hw[MAX_GPUS];
+	struct thermal_state th[MAX_GPUS];
+	struct device_stats st[MAX_GPUS];
+	bool have_hw[MAX_GPUS];
+	int n = (info->n_devices < MAX_GPUS) ? info->n_devices : MAX_GPUS;
+	char label[128], labels[160], algo[64];
+	struct hash_rates r;
+
+	metrics_header(&out, "ccminer_info", "gauge", "Miner version and algorithm.");
+	metrics_printf(&out, "ccminer_info{version=\"%s\",algo=\"%s\"} 1\n",
+		metrics_label(labels, sizeof(labels), info->version), metrics_label(label, sizeof(label), info->algo));
+	metrics_header(&out, "ccminer_uptime_seconds", "gauge", "Seconds since the miner started.");
+	metrics_printf(&out, "ccminer_uptime_seconds %d\n", (int)(time(NULL) - info->start));
+
+	for (int i = 0; i < n; i++)
+		metrics_device_read(i, &st[i]);
+
+	metrics_header(&out, "ccminer_device_info", "gauge", "Device of each miner thread.");
+	for (int i = 0; i < n; i++)
+	{
+		const struct device_ctx *ctx = info->devices[i];
+
+		metrics_printf(&out, "ccminer_device_info{gpu=\"%d\",device=\"%d\",name=\"%s\",backend=\"%s\"} 1\n",
+			i, ctx->device_id, metrics_label(label, sizeof(label), ctx->name), ctx->backend->name);
+	}
+
+	metrics_header(&out, "ccminer_hashrate", "gauge", "Hashes per second over a sliding window.");
+	for (int i = 0; i < n; i++)
+	{
+		hashmeter_read(i, &r);
+		for (int w = 0; w < HASHMETER_WINDOWS; w++)
+			metrics_printf(&out, "ccminer_hashrate{gpu=\"%d\",window=\"%s\"} %.3f\n", i, windows[w], r.window[w]);
+	}
+	metrics_header(&out, "ccminer_hashes_total", "counter", "Hashes since start.");
+	for (int i = 0; i < n; i++)
+	{
+		hashmeter_read(i, &r);
+		metrics_printf(&out, "ccminer_hashes_total{gpu=\"%d\"} %.0f\n", i, r.hashes);
+	}
+
+	metrics_header(&out, "ccminer_shares_total", "counter",
+		"Shares answered by the pool, stale ones were not submitted.");
+	for (int i = 0; i < n; i++)
+		for (int k = 0; k < SHARE_RESULTS; k++)
+			metrics_printf(&out, "ccminer_shares_total{gpu=\"%d\",result=\"%s\"} %lu\n", i, share_results[k],
+				device_metrics[i].shares[k].load(std::memory_order_relaxed));
+
+	metrics_header(&out, "ccminer_share_submit_seconds", "histogram", "Time from submission to the pool's answer.");
+	metrics_histogram(&out, "ccminer_share_submit_seconds", "", &submit_latency, submit_bounds, SUBMIT_BUCKETS);
+
+	// pro Algorithmus und Batchgroesse vergleichbar, die bestimmen, wie
+	// lange ein Thread nach einem neuen Block noch auf alter Arbeit rechnet
+	metrics_label(algo, sizeof(algo), info->algo);
+	metrics_header(&out, "ccminer_job_build_seconds", "histogram",
+		"Time from the pool's new block notification until the work is built.");
+	sprintf(labels, "algo=\"%s\"", algo);
+	metrics_histogram(&out, "ccminer_job_build_seconds", labels, &job_build, build_bounds, BUILD_BUCKETS);
+	metrics_header(&out, "ccminer_job_switch_seconds", "histogram",
+		"Time from a work restart until the miner thread takes the new work.");
+	for (int i = 0; i < n; i++)
+	{
+		sprintf(labels, "gpu=\"%d\",algo=\"%s\",batch=\"%d\"", i, algo, st[i].batch);
+		metrics_histogram(&out, "ccminer_job_switch_seconds", labels,
+			&device_metrics[i].job_switch, switch_bounds, SWITCH_BUCKETS);
+	}
+	metrics_header(&out, "ccminer_job_first_batch_seconds", "histogram",
+		"Time from the pool's new block notification until the first batch on the new work is done.");
+	for (int i = 0; i < n; i++)
+	{
+		sprintf(labels, "gpu=\"%d\",algo=\"%s\",batch=\"%d\"", i, algo, st[i].batch);
+		metrics_histogram(&out, "ccminer_job_first_batch_seconds", labels,
+			&device_metrics[i].job_first, switch_bounds, SWITCH_BUCKETS);
+	}
+	metrics_header(&out, "ccminer_job_all_devices_seconds", "histogram",
+		"Time from the pool's new block notification until every device finished a batch on the new work.");
+	sprintf(labels, "algo=\"%s\"", algo);
+	metrics_histogram(&out, "ccminer_job_all_devices_seconds", labels, &job_all, switch_bounds, SWITCH_BUCKETS);
+
+	// aus dem Snapshot von metrics_device_read(), wie in der API
+	metrics_header(&out, "ccminer_verify_checked_total", "counter", "GPU results checked on the CPU.");
+	for (int i = 0; i < n; i++)
+		metrics_printf(&out, "ccminer_verify_checked_total{gpu=\"%d\"} %lu\n", i, st[i].verify.checked);
+	metrics_header(&out, "ccminer_verify_invalid_total", "counter", "GPU results that do not validate on the CPU.");
+	for (int i = 0; i < n; i++)
+		metrics_printf(&out, "ccminer_verify_invalid_total{gpu=\"%d\"} %lu\n", i, st[i].verify.invalid);
+
+	for (int i = 0; i < n; i++)
+		have_hw[i] = telemetry_read(i, &hw[i]);
+
+#define METRICS_SENSOR(name, help, field) \
+	metrics_header(&out, name, "gauge", help); \
+	for (int i = 0; i < n; i++) \
+		if (have_hw[i]) \
+			metrics_printf(&out, name "{gpu=\"%d\"} %lu\n", i, (unsigned long)hw[i].field);
+
+	METRICS_SENSOR("ccminer_gpu_temperature_celsius", "GPU temperature.", temp)
+	METRICS_SENSOR("ccminer_gpu_fan_percent", "Fan speed in percent.", fan)
+	METRICS_SENSOR("ccminer_gpu_clock_mhz", "GPU core clock.", clock)
+	METRICS_SENSOR("ccminer_gpu_memory_clock_mhz", "GPU memory clock.", clock_mem)
+	METRICS_SENSOR("ccminer_gpu_load_percent", "GPU load in percent.", load)
+	METRICS_SENSOR("ccminer_gpu_power_watts", "Board power.", power)
+#undef METRICS_SENSOR
+
+	// Entscheidungen des Reglers, nur mit --temp-target oder --power-limit
+	metrics_header(&out, "ccminer_thermal_duty", "gauge", "Share of the time the device hashes, 1 = not throttled.");
+	for (int i = 0; i < n; i++)
+		if (thermal_read(i, &th[i]))
+			metrics_printf(&out, "ccminer_thermal_duty{gpu=\"%d\"} %.3f\n", i, th[i].duty);
+	metrics_header(&out, "ccminer_thermal_throttled_seconds_total", "counter",
+		"Seconds the miner thread paused to hold the temperature or power limit.");
+	for (int i = 0; i < n; i++)
+		if (thermal_read(i, &th[i]))
+			metrics_printf(&out, "ccminer_thermal_throttled_seconds_total{gpu=\"%d\"} %.3f\n", i, th[i].throttled);
+
+	return out.oom ? 0 : out.len;
+}
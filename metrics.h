@@ -0,0 +1,88 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "device.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct api_info;
+
+/* work restarts kept for metrics_job_read() */
+#define METRICS_JOBS 16
+
+/* one work restart, times in us since the epoch, 0 = not yet */
+struct job_timing {
+	unsigned int seq;		/* counts restarts from 1 */
+	int n_devices;
+	long long notify;		/* pool announced the block, = built without */
+	long long built;		/* work built, restart_threads() */
+	long long took[MAX_GPUS];	/* the miner thread took the work */
+	long long first[MAX_GPUS];	/* its first batch on the work is done */
+};
+
+/* counters of one miner thread as the API and /metrics see them, copies
+ * so no reader touches the device_ctx its thread is writing */
+struct device_stats {
+	int intensity, batch;
+	unsigned long batches;
+	double gpu_idle;
+	unsigned long checked_batches, candidates, dropped;
+	double hashrate, cpu_load, cpu_time;
+	unsigned long allocs;
+	struct verify_stats verify;
+};
+
+/* the miner thread publishes its counters, after each batch and scanhash
+ * call; never blocks */
+extern void metrics_device(const struct device_ctx *ctx);
+
+/* a verify thread changed ctx->verify, called under stats_lock */
+extern void metrics_verify(const struct device_ctx *ctx);
+
+/* last published counters of a miner thread, never waits */
+extern void metrics_device_read(int thr_id, struct device_stats *stats);
+
+/* a share goes out to the pool for miner thread thr_id, the answer
+ * (metrics_share) is matched in order of submission */
+extern void metrics_submit(int thr_id);
+
+/* the pool answered the oldest submitted share */
+extern void metrics_share(bool accepted);
+
+/* the pool will not answer the shares in flight (disconnect, send error) */
+extern void metrics_submit_reset(void);
+
+/* a share was discarded before submission, its block is gone */
+extern void metrics_stale(int thr_id);
+
+/* the pool announced a new block (clean notify, longpoll answer) */
+extern void metrics_notify(void);
+
+/* restart_threads() is about to tell n_devices miner threads to drop
+ * their work, called before work_restart[] is set */
+extern void metrics_restart(int n_devices);
+
+/* the miner thread took new work after metrics_restart() */
+extern void metrics_job_switch(int thr_id);
+
+/* the miner thread finished a batch, the first after a job switch ends
+ * the device's part of the restart */
+extern void metrics_batch(int thr_id);
+
+/* the age-th latest work restart (0 = latest), false if there is none or
+ * it was just overwritten */
+extern bool metrics_job_read(int age, struct job_timing *t);
+
+/* renders all metrics in the Prometheus text format into *buf, which is
+ * grown with realloc and reused; returns the length, 0 on OOM */
+extern size_t metrics_render(const struct api_info *info, char **buf, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __METRICS_H__ */
@@ -15,6 +15,8 @@ extern "C" {
 #include <jansson.h>
 #include <curl/curl.h>
 
+#include "device.h"
+
 extern WINDOW *info_screen, *out_screen;
 extern int printline(WINDOW *win, bool newline, const char *fmt, ...);
 extern int sendmail(char* subject, char* error);
@@ -201,6 +203,16 @@ void sha256_init_8way(uint32_t *state);
 void sha256_transform_8way(uint32_t *state, const uint32_t *block, int swap);
 #endif
 
+struct work {
+	uint32_t data[32];
+	uint32_t target[8];
+	uint32_t maxvote;
+
+	char job_id[128];
+	size_t xnonce2_len;
+	unsigned char xnonce2[32];
+};
+
 extern int scanhash_sha256d(int thr_id, uint32_t *pdata,
 	const uint32_t *ptarget, uint32_t max_nonce, unsigned long *hashes_done);
 
@@ -210,43 +222,43 @@ extern int scanhash_scrypt(int thr_id, uint32_t *pdata,
 	unsigned char *scratchbuf, const uint32_t *ptarget,
 	uint32_t max_nonce, unsigned long *hashes_done);
 
-extern int scanhash_heavy(int thr_id, uint32_t *pdata,
+extern int scanhash_heavy(struct device_ctx *ctx, uint32_t *pdata,
 	const uint32_t *ptarget, uint32_t max_nonce,
 	unsigned long *hashes_done, uint32_t maxvote, int blocklen);
 
-extern int scanhash_fugue256(int thr_id, uint32_t *pdata,
+extern int scanhash_fugue256(struct device_ctx *ctx, uint32_t *pdata,
 	const uint32_t *ptarget, uint32_t max_nonce,
 	unsigned long *hashes_done);
 
-extern int scanhash_groestlcoin(int thr_id, uint32_t *pdata,
+extern int scanhash_groestlcoin(struct device_ctx *ctx, uint32_t *pdata,
 	const uint32_t *ptarget, uint32_t max_nonce,
 	unsigned long *hashes_done);
 
-extern int scanhash_myriad(int thr_id, uint32_t *pdata,
+extern int scanhash_myriad(struct device_ctx *ctx, uint32_t *pdata,
 	const uint32_t *ptarget, uint32_t max_nonce,
 	unsigned long *hashes_done);
 
-extern int scanhash_jackpot(int thr_id, uint32_t *pdata,
+extern int scanhash_jackpot(struct device_ctx *ctx, uint32_t *pdata,
 	const uint32_t *ptarget, uint32_t max_nonce,
 	unsigned long *hashes_done);
 
-extern int scanhash_quark(int thr_id, uint32_t *pdata,
+extern int scanhash_quark(struct device_ctx *ctx, uint32_t *pdata,
 	const uint32_t *ptarget, uint32_t max_nonce,
 	unsigned long *hashes_done);
 
-extern int scanhash_anime(int thr_id, uint32_t *pdata,
+extern int scanhash_anime(struct device_ctx *ctx, uint32_t *pdata,
 	const uint32_t *ptarget, uint32_t max_nonce,
 	unsigned long *hashes_done);
 
-extern int scanhash_nist5(int thr_id, uint32_t *pdata,
+extern int scanhash_nist5(struct device_ctx *ctx, uint32_t *pdata,
 	const uint32_t *ptarget, uint32_t max_nonce,
 	unsigned long *hashes_done);
 
-extern int scanhash_x11(int thr_id, uint32_t *pdata,
+extern int scanhash_x11(struct device_ctx *ctx, uint32_t *pdata,
 	const uint32_t *ptarget, uint32_t max_nonce,
 	unsigned long *hashes_done);
 	
-extern int scanhash_x13(int thr_id, uint32_t *pdata,
+extern int scanhash_x13(struct device_ctx *ctx, uint32_t *pdata,
 	const uint32_t *ptarget, uint32_t max_nonce,
 	unsigned long *hashes_done);
 
@@ -254,6 +266,23 @@ extern void fugue256_hash(unsigned char* output, const unsigned char* input, int
 extern void heavycoin_hash(unsigned char* output, const unsigned char* input, int len);
 extern void groestlcoin_hash(unsigned char* output, const unsigned char* input, int len);
 
+/* CPU reference hashes, input is the byte-swapped 80 byte header */
+extern void groestlhash(void *state, const void *input);
+extern void myriadhash(void *state, const void *input);
+extern unsigned int jackpothash(void *state, const void *input);
+extern void quarkhash(void *state, const void *input);
+extern void animehash(void *state, const void *input);
+extern void nist5hash(void *state, const void *input);
+extern void x11hash(void *state, const void *input);
+extern void x13hash(void *state, const void *input);
+
+/* queue a GPU result of the device for asynchronous CPU verification;
+ * valid shares are submitted from the verify pool */
+extern void submit_nonce(struct device_ctx *ctx, uint32_t nonce);
+/* queues the candidates of one target check (count as reported by the
+ * GPU, at most DEVICE_CANDIDATES in nonces), returns the number queued */
+extern int submit_candidates(struct device_ctx *ctx, const uint32_t *nonces, int count);
+
 struct thr_info {
 	int		id;
 	pthread_t	pth;
@@ -276,7 +305,6 @@ extern char *opt_cert;
 extern char *opt_proxy;
 extern long opt_proxy_type;
 extern bool use_syslog;
-extern pthread_mutex_t applog_lock;
 extern struct thr_info *thr_info;
 extern int longpoll_thr_id;
 extern int stratum_thr_id;
@@ -291,6 +319,8 @@ extern char *bin2hex(const unsigned char *p, size_t len);
 extern bool hex2bin(unsigned char *p, const char *hexstr, size_t len);
 extern int timeval_subtract(struct timeval *result, struct timeval *x,
 	struct timeval *y);
+/* CPU time of the calling thread in seconds, 0 where the OS has no clock */
+extern double thread_cpu_time(void);
 extern bool fulltest(const uint32_t *hash, const uint32_t *target);
 extern void diff_to_target(uint32_t *target, double diff);
 
@@ -7,18 +7,19 @@
 #include <string.h>
 #include <stdint.h>
 #include <openssl/sha.h>
+#include "device_backend.h"
 
 extern bool opt_benchmark;
 
 void myriadgroestl_cpu_init(int thr_id, int threads);
 void myriadgroestl_cpu_setBlock(int thr_id, void *data, void *pTargetIn);
-void myriadgroestl_cpu_hash(int thr_id, int threads, uint32_t startNounce, void *outputHashes, uint32_t *nounce);
+int myriadgroestl_cpu_hash(int thr_id, int threads, uint32_t startNounce, void *outputHashes, uint32_t *nonces);
 
 #define SWAP32(x) \
     ((((x) << 24) & 0xff000000u) | (((x) << 8) & 0x00ff0000u)   | \
       (((x) >> 8) & 0x0000ff00u) | (((x) >> 24) & 0x000000ffu))
 
-static void myriadhash(void *state, const void *input)
+void myriadhash(void *state, const void *input)
 {
     sph_groestl512_context     ctx_groestl;
 
@@ -37,31 +38,29 @@ static void myriadhash(void *state, const void *input)
 
 extern bool opt_benchmark;
 
-extern "C" int scanhash_myriad(int thr_id, uint32_t *pdata, const uint32_t *ptarget,
+extern "C" int scanhash_myriad(struct device_ctx *ctx, uint32_t *pdata, const uint32_t *ptarget,
 	uint32_t max_nonce, unsigned long *hashes_done)
 {	
+	const int thr_id = ctx->thr_id;
+
     if (opt_benchmark)
         ((uint32_t*)ptarget)[7] = 0x000000ff;
 
 	uint32_t start_nonce = pdata[19]++;
-	const uint32_t throughPut = 128 * 1024;
-
-	uint32_t *outputHash = (uint32_t*)malloc(throughPut * 16 * sizeof(uint32_t));
+	int found = 0;
+	const uint32_t throughPut = device_throughput(ctx, 128 * 1024);
 
 	if (opt_benchmark)
 		((uint32_t*)ptarget)[7] = 0x0000ff;
 
-	const uint32_t Htarg = ptarget[7];
-
 	// init
-	static bool init[8] = { false, false, false, false, false, false, false, false };
-	if(!init[thr_id])
+	if(!ctx->init)
 	{
 #if BIG_DEBUG
 #else
 		myriadgroestl_cpu_init(thr_id, throughPut);
 #endif
-		init[thr_id] = true;
+		ctx->init = true;
 	}
 	
 	uint32_t endiandata[32];
@@ -69,31 +68,19 @@ extern "C" int scanhash_myriad(int thr_id, uint32_t *pdata, const uint32_t *ptar
 		be32enc(&endiandata[kk], pdata[kk]);
 
 	// Context mit dem Endian gedrehten Blockheader vorbereiten (Nonce wird spter ersetzt)
-	myriadgroestl_cpu_setBlock(thr_id, endiandata, (void*)ptarget);
+	// beide Schluessel pruefen, setBlock laedt auch das Target
+	bool newBlock = device_upload_needed(ctx, UPLOAD_BLOCK, endiandata, 80);
+	bool newTarget = device_upload_needed(ctx, UPLOAD_TARGET, ptarget, 32);
+	if (newBlock || newTarget)
+		myriadgroestl_cpu_setBlock(thr_id, endiandata, (void*)ptarget);
 	
 	do {
 		// GPU
-		uint32_t foundNounce = 0xFFFFFFFF;
-
-		myriadgroestl_cpu_hash(thr_id, throughPut, pdata[19], outputHash, &foundNounce);
-
-		if(foundNounce < 0xffffffff)
-		{
-			uint32_t tmpHash[8];
-			endiandata[19] = SWAP32(foundNounce);
-			myriadhash(tmpHash, endiandata);
-			if (tmpHash[7] <= Htarg && 
-					fulltest(tmpHash, ptarget)) {
-						pdata[19] = foundNounce;
-						*hashes_done = foundNounce - start_nonce;
-						free(outputHash);
-				return true;
-			} else {
-				applog(LOG_INFO, "GPU #%d: result for nonce $%08X does not validate on CPU!", thr_id, foundNounce);
-			}
-
-			foundNounce = 0xffffffff;
-		}
+		uint32_t nonces[DEVICE_CANDIDATES];
+		int count = myriadgroestl_cpu_hash(thr_id, throughPut, pdata[19], NULL, nonces);
+
+		// Verifikation und Submit laufen asynchron im CPU Verify-Pool
+		found += submit_candidates(ctx, nonces, count);
 
 		if (pdata[19] + throughPut < pdata[19])
 			pdata[19] = max_nonce;
@@ -102,7 +89,6 @@ extern "C" int scanhash_myriad(int thr_id, uint32_t *pdata, const uint32_t *ptar
 	} while (pdata[19] < max_nonce && !work_restart[thr_id].restart);
 	
 	*hashes_done = pdata[19] - start_nonce;
-	free(outputHash);
-	return 0;
+	return found;
 }
 
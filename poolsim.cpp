@@ -0,0 +1,1088 @@
+//
+// Simulierter Pool (--pool-sim, --getwork-sim)
+//
+// Ein Pool auf dem eigenen Rechner, gegen den ein zweiter ccminer mit
+// -o stratum+tcp://127.0.0.1:PORT laeuft. Damit lassen sich Netzwerk und
+// Arbeitserzeugung ohne echten Pool messen und wiederholbar vergleichen.
+//
+// Der Pool beantwortet mining.subscribe, mining.authorize und
+// mining.submit und schickt mining.set_difficulty, mining.notify und
+// client.reconnect. Gesteuert wird ueber die Optionen:
+//
+//   --sim-job-interval  s zwischen zwei Jobs
+//   --sim-clean         jeder n-te Job beginnt einen neuen Block
+//   --sim-diff          Share-Difficulty, eine Liste wird Job fuer Job
+//                       reihum verwendet (Vardiff nachspielen)
+//   --sim-merkle        Zahl der Merkle-Zweige
+//   --sim-latency       ms, die jede Zeile des Pools zurueckgehalten wird
+//   --sim-reconnect     s zwischen zwei client.reconnect auf sich selbst
+//   --sim-time          Laufzeit, danach Bericht und Ende
+//
+// Jede Share wird wie bei einem Pool geprueft: Header aus Job,
+// extranonce1/2, ntime und Nonce bauen (algo_stratum_header, wie der
+// Miner), mit dem CPU Hash des Algorithmus hashen und gegen die
+// Difficulty des Jobs halten. Shares auf einen Job vor dem letzten
+// Blockwechsel oder auf einen unbekannten Job sind stale, dazu kommen
+// Duplikate, zu niedrige Difficulty und kaputte Parameter.
+//
+// --getwork-sim bedient denselben Jobstrom ueber HTTP getwork: jede
+// Anfrage ohne Parameter bekommt einen Header mit eigener Merkle-Wurzel,
+// eine mit Parameter ist eine Share und wird abgelehnt mit
+// X-Reject-Reason (stale-prevblk, high-hash, duplicate, bad-data). Jede
+// Antwort nennt den Longpoll-Pfad in X-Long-Polling; wartende Longpolls
+// bekommen bei jedem neuen Job Arbeit mit "submitold": false bei einem
+// Blockwechsel, true sonst, und "sent", der Zeit, zu der der Pool sie
+// abgeschickt hat (fuer --bench-getwork). Laeuft --pool-sim mit, zeigt
+// X-Stratum auf ihn und der Miner wechselt zu Stratum.
+//
+// Gemessen werden pro Verbindung die Zeit vom mining.notify bis zur
+// ersten gueltigen Share auf den Job und, fuer jede stale Share, wie
+// lange nach dem Blockwechsel sie noch kam. Mit --sim-time wird der
+// Bericht als JSON wie bei --benchmark geschrieben (--bench-json).
+//
+// Alles laeuft im Haupt-Thread mit select(), wie die API, HTTP mit
+// Keep-Alive.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+
+#ifdef WIN32
+#include <winsock2.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
+#include "miner.h"
+#include "algos.h"
+#include "bench.h"
+#include "poolsim.h"
+
+#ifdef WIN32
+#define sim_close(s) closesocket(s)
+#define socket_blocks() (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+#define sim_close(s) close(s)
+#define socket_blocks() (errno == EAGAIN || errno == EWOULDBLOCK)
+#endif
+
+#define SIM_DEFAULT_ADDR "127.0.0.1"
+#define SIM_MAX_CLIENTS 64
+// so viele Jobs kennt der Pool, Shares auf aeltere sind stale
+#define SIM_JOBS 16
+#define SIM_LINE 4096
+#define SIM_MAX_DIFFS 16
+#define SIM_MAX_MERKLE 32
+#define SIM_COINB1 42
+#define SIM_COINB2 56
+#define SIM_XNONCE2 4
+#define SIM_LP_PATH "/LP"
+// Zwischenstand im Log
+#define SIM_LOG_S 60
+
+// Stratum Fehlercodes wie bei den ueblichen Pools
+#define SIM_ERR_OTHER 20
+#define SIM_ERR_STALE 21
+#define SIM_ERR_DUPLICATE 22
+#define SIM_ERR_LOW_DIFF 23
+#define SIM_ERR_UNAUTHORIZED 24
+
+char *opt_pool_sim = NULL;
+char *opt_getwork_sim = NULL;
+double opt_sim_job_interval = 30.0;
+int opt_sim_clean = 4;
+char *opt_sim_diff = NULL;
+int opt_sim_merkle = 4;
+int opt_sim_latency = 0;
+double opt_sim_reconnect = 0.0;
+double opt_sim_time = 0.0;
+
+struct sim_job {
+	unsigned int seq;	// 0 = noch nie benutzt
+	unsigned int block;
+	bool clean;
+	double diff;
+	double sent;		// s
+	struct stratum_job header;	// version, prevhash, nbits, nreward
+	unsigned char coinb1[SIM_COINB1];
+	unsigned char coinb2[SIM_COINB2];
+	unsigned char merkle[SIM_MAX_MERKLE][32];
+	uint32_t data[32];	// getwork Header, Merkle-Wurzel 0
+	char *notify;
+	// Schluessel der gueltigen Shares gegen Duplikate
+	uint64_t *shares;
+	int n_shares, max_shares;
+};
+
+struct sim_line {
+	struct sim_line *next;
+	double due;		// s, frueher wird nicht gesendet
+	size_t len, sent;
+	char s[1];
+};
+
+struct sim_client {
+	curl_socket_t sock;
+	unsigned int xnonce1;
+	char in[SIM_LINE];
+	int in_len;
+	struct sim_line *out, *out_tail;
+	bool http;
+	bool subscribed, authorized;
+	bool longpoll;		// wartet auf den naechsten Job
+	double diff;		// zuletzt gesendet, 0 = noch keine
+	unsigned int first_seq;	// Job mit der letzten ersten Share
+	unsigned long accepted, rejected;
+};
+
+struct sim_samples {
+	double *v;
+	int n, max;
+};
+
+struct sim_stats {
+	unsigned long connections, reconnects, jobs, blocks;
+	unsigned long accepted, stale, low_diff, duplicate, invalid;
+	unsigned long getworks, submits, longpolls;
+	double work;		// Hashes, die die gueltigen Shares im Mittel kosten
+	struct sim_samples first_share;	// ms vom notify bis zur ersten Share
+	struct sim_samples stale_after;	// ms vom Blockwechsel bis zur stale Share
+};
+
+struct sim_listener {
+	curl_socket_t sock;
+	char host[64];
+	int port;
+};
+
+static const struct algo_traits *sim_algo;
+static struct sim_listener stratum_listener = { CURL_SOCKET_BAD };
+static struct sim_listener http_listener = { CURL_SOCKET_BAD };
+static struct sim_client clients[SIM_MAX_CLIENTS];
+static struct sim_job jobs[SIM_JOBS];
+static unsigned int job_seq, block;
+static double block_time;	// s, notify des letzten Blockwechsels
+static double diffs[SIM_MAX_DIFFS];
+static int n_diffs;
+static struct sim_stats stats;
+
+static double sim_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+static void sim_nonblocking(curl_socket_t sock)
+{
+#ifdef WIN32
+	u_long on = 1;
+	ioctlsocket(sock, FIONBIO, &on);
+#else
+	fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+static void sim_random(unsigned char *p, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		p[i] = (unsigned char)(rand() >> 7);
+}
+
+static json_t *sim_hex(const unsigned char *p, size_t len)
+{
+	char *s = bin2hex(p, len);
+	json_t *str = json_string(s);
+
+	free(s);
+	return str;
+}
+
+static void sim_add(struct sim_samples *s, double v)
+{
+	if (s->n == s->max) {
+		s->max = s->max ? 2 * s->max : 256;
+		s->v = (double *)realloc(s->v, s->max * sizeof(double));
+	}
+	s->v[s->n++] = v;
+}
+
+static int sim_cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+// Mittelwert und Quantile, sortiert die Werte
+static json_t *sim_summary(struct sim_samples *s)
+{
+	json_t *obj = json_object();
+	double sum = 0.0;
+
+	json_object_set_new(obj, "count", json_integer(s->n));
+	if (!s->n)
+		return obj;
+	qsort(s->v, s->n, sizeof(double), sim_cmp);
+	for (int i = 0; i < s->n; i++)
+		sum += s->v[i];
+	json_object_set_new(obj, "mean", json_real(sum / s->n));
+	json_object_set_new(obj, "p50", json_real(s->v[s->n / 2]));
+	json_object_set_new(obj, "p95", json_real(s->v[(int)(0.95 * s->n) < s->n ? (int)(0.95 * s->n) : s->n - 1]));
+	json_object_set_new(obj, "max", json_real(s->v[s->n - 1]));
+	return obj;
+}
+
+// haengt Text an, gesendet wird er nach --sim-latency in sim_flush
+static void sim_send(struct sim_client *c, const char *s, size_t len, double now)
+{
+	struct sim_line *l = (struct sim_line *)malloc(sizeof(struct sim_line) + len);
+
+	memcpy(l->s, s, len);
+	l->s[len] = '\0';
+	l->len = len;
+	l->sent = 0;
+	l->due = now + 1e-3 * opt_sim_latency;
+	l->next = NULL;
+	if (c->out_tail)
+		c->out_tail->next = l;
+	else
+		c->out = l;
+	c->out_tail = l;
+}
+
+// eine Stratum Zeile
+static void sim_queue(struct sim_client *c, json_t *msg, double now)
+{
+	char *s = json_dumps(msg, JSON_COMPACT | JSON_PRESERVE_ORDER);
+	size_t len = strlen(s);
+
+	if (opt_protocol)
+		applog(LOG_DEBUG, "pool > %s", s);
+	s[len] = '\n';
+	sim_send(c, s, len + 1, now);
+	free(s);
+}
+
+static void sim_drop(struct sim_client *c)
+{
+	while (c->out)
+	{
+		struct sim_line *l = c->out;
+		c->out = l->next;
+		free(l);
+	}
+	sim_close(c->sock);
+	if (c->subscribed)
+		applog(LOG_INFO, "pool sim: client %08x gone, %lu accepted, %lu rejected",
+			c->xnonce1, c->accepted, c->rejected);
+	memset(c, 0, sizeof(*c));
+	c->sock = CURL_SOCKET_BAD;
+}
+
+static void sim_flush(struct sim_client *c, double now)
+{
+	while (c->out && c->out->due <= now)
+	{
+		struct sim_line *l = c->out;
+		int n = send(c->sock, l->s + l->sent, (int)(l->len - l->sent), 0);
+
+		if (n < 0) {
+			if (!socket_blocks())
+				sim_drop(c);
+			return;
+		}
+		l->sent += n;
+		if (l->sent < l->len)
+			return;
+		c->out = l->next;
+		if (!c->out)
+			c->out_tail = NULL;
+		free(l);
+	}
+}
+
+static void sim_method(struct sim_client *c, const char *method, json_t *params, double now)
+{
+	json_t *msg = json_object();
+
+	json_object_set_new(msg, "id", json_null());
+	json_object_set_new(msg, "method", json_string(method));
+	json_object_set(msg, "params", params);
+	sim_queue(c, msg, now);
+	json_decref(msg);
+}
+
+static void sim_reply(struct sim_client *c, json_t *id, json_t *result, int code, const char *reason, double now)
+{
+	json_t *msg = json_object();
+
+	json_object_set(msg, "id", id);
+	json_object_set_new(msg, "result", result);
+	if (code) {
+		json_t *err = json_array();
+		json_array_append_new(err, json_integer(code));
+		json_array_append_new(err, json_string(reason));
+		json_array_append_new(err, json_null());
+		json_object_set_new(msg, "error", err);
+	} else
+		json_object_set_new(msg, "error", json_null());
+	sim_queue(c, msg, now);
+	json_decref(msg);
+}
+
+// Difficulty wenn sie sich geaendert hat, dann der Job
+static void sim_send_job(struct sim_client *c, const struct sim_job *job, bool clean, double now)
+{
+	json_t *params;
+	json_error_t err;
+
+	if (c->diff != job->diff) {
+		params = json_array();
+		json_array_append_new(params, json_real(job->diff));
+		sim_method(c, "mining.set_difficulty", params, now);
+		json_decref(params);
+		c->diff = job->diff;
+	}
+
+	params = JSON_LOADS(job->notify, &err);
+	// nach authorize beginnt der Miner immer neu
+	json_array_set_new(params, 8, clean ? json_true() : json_false());
+	sim_method(c, "mining.notify", params, now);
+	json_decref(params);
+}
+
+// Adresse fuer die Miner, 0.0.0.0 ist nur zum Binden
+static const char *sim_addr(const struct sim_listener *l)
+{
+	return strcmp(l->host, "0.0.0.0") ? l->host : "127.0.0.1";
+}
+
+// HTTP Antwort mit JSON-RPC Ergebnis, reason wird X-Reject-Reason
+static void sim_http_reply(struct sim_client *c, json_t *id, json_t *result, json_t *error,
+	const char *reason, double now)
+{
+	json_t *msg = json_object();
+	char head[512], *body;
+	int n;
+
+	json_object_set_new(msg, "result", result);
+	json_object_set_new(msg, "error", error ? error : json_null());
+	json_object_set(msg, "id", id);
+	body = json_dumps(msg, JSON_COMPACT | JSON_PRESERVE_ORDER);
+	json_decref(msg);
+	if (opt_protocol)
+		applog(LOG_DEBUG, "pool > %s", body);
+
+	n = sprintf(head, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+		"Content-Length: %d\r\nX-Long-Polling: " SIM_LP_PATH "\r\n", (int)strlen(body));
+	if (stratum_listener.sock != CURL_SOCKET_BAD)
+		n += sprintf(head + n, "X-Stratum: stratum+tcp://%s:%d\r\n",
+			sim_addr(&stratum_listener), stratum_listener.port);
+	if (reason)
+		n += sprintf(head + n, "X-Reject-Reason: %s\r\n", reason);
+	n += sprintf(head + n, "\r\n");
+	sim_send(c, head, n, now);
+	sim_send(c, body, strlen(body), now);
+	free(body);
+}
+
+// getwork Arbeit zum Job, eigene Merkle-Wurzel je Anfrage wie die
+// extranonce eines echten Pools
+static json_t *sim_getwork(const struct sim_job *job)
+{
+	json_t *result = json_object();
+	unsigned char root[32];
+	uint32_t data[32], target[8];
+
+	sim_random(root, 32);
+	algo_stratum_header(sim_algo, data, &job->header, root, 0);
+	diff_to_target(target, job->diff / sim_algo->diff_factor);
+	for (int i = 0; i < 32; i++)
+		le32enc(&data[i], data[i]);
+	for (int i = 0; i < 8; i++)
+		le32enc(&target[i], target[i]);
+	json_object_set_new(result, "data", sim_hex((unsigned char *)data, sizeof(data)));
+	json_object_set_new(result, "target", sim_hex((unsigned char *)target, sizeof(target)));
+	stats.getworks++;
+	return result;
+}
+
+static void sim_longpoll(struct sim_client *c, const struct sim_job *job, double now)
+{
+	json_t *result = sim_getwork(job);
+	json_t *id = json_integer(0);
+
+	json_object_set_new(result, "submitold", job->clean ? json_false() : json_true());
+	json_object_set_new(result, "sent", json_real(now));
+	sim_http_reply(c, id, result, NULL, NULL, now);
+	json_decref(id);
+	c->longpoll = false;
+	stats.longpolls++;
+}
+
+static void sim_new_job(double now)
+{
+	struct sim_job *prev = &jobs[job_seq % SIM_JOBS];
+	struct sim_job *job = &jobs[++job_seq % SIM_JOBS];
+	unsigned char prevhash[32], zero[32];
+	json_t *params, *branches;
+	char id[16];
+
+	memcpy(prevhash, prev->header.prevhash, 32);
+	free(job->notify);
+	free(job->shares);
+	memset(job, 0, sizeof(*job));
+
+	job->seq = job_seq;
+	job->clean = (job_seq - 1) % opt_sim_clean == 0;
+	if (job->clean) {
+		sim_random(prevhash, 32);
+		block++;
+		block_time = now;
+		stats.blocks++;
+	}
+	job->block = block;
+	job->diff = diffs[(job_seq - 1) % n_diffs];
+	job->sent = now;
+	memcpy(job->header.prevhash, prevhash, 32);
+	be32enc(job->header.version, 2);
+	be32enc(job->header.nbits, 0x1b01a0e5);
+	be32enc(job->header.ntime, (uint32_t)time(NULL));
+	be16enc(job->header.nreward, 0x0100);
+	sim_random(job->coinb1, SIM_COINB1);
+	sim_random(job->coinb2, SIM_COINB2);
+	sim_random(&job->merkle[0][0], sizeof(job->merkle));
+	memset(zero, 0, sizeof(zero));
+	algo_stratum_header(sim_algo, job->data, &job->header, zero, 0);
+
+	sprintf(id, "%x", job_seq);
+	params = json_array();
+	json_array_append_new(params, json_string(id));
+	json_array_append_new(params, sim_hex(job->header.prevhash, 32));
+	json_array_append_new(params, sim_hex(job->coinb1, SIM_COINB1));
+	json_array_append_new(params, sim_hex(job->coinb2, SIM_COINB2));
+	branches = json_array();
+	for (int i = 0; i < opt_sim_merkle; i++)
+		json_array_append_new(branches, sim_hex(job->merkle[i], 32));
+	json_array_append_new(params, branches);
+	json_array_append_new(params, sim_hex(job->header.version, 4));
+	json_array_append_new(params, sim_hex(job->header.nbits, 4));
+	json_array_append_new(params, sim_hex(job->header.ntime, 4));
+	json_array_append_new(params, job->clean ? json_true() : json_false());
+	if (sim_algo->vote)
+		json_array_append_new(params, sim_hex(job->header.nreward, 2));
+	job->notify = json_dumps(params, JSON_COMPACT);
+	json_decref(params);
+	stats.jobs++;
+
+	for (int i = 0; i < SIM_MAX_CLIENTS; i++)
+		if (clients[i].sock != CURL_SOCKET_BAD && clients[i].authorized)
+			sim_send_job(&clients[i], job, job->clean, now);
+		else if (clients[i].sock != CURL_SOCKET_BAD && clients[i].longpoll)
+			sim_longpoll(&clients[i], job, now);
+	if (opt_debug)
+		applog(LOG_DEBUG, "pool sim: job %s, block %u, diff %g%s", id, block, job->diff,
+			job->clean ? ", clean" : "");
+}
+
+static bool sim_hex_param(json_t *params, int i, unsigned char *p, size_t len)
+{
+	const char *s = json_string_value(json_array_get(params, i));
+
+	return s && strlen(s) == 2 * len && hex2bin(p, s, len);
+}
+
+static int sim_share_key(struct sim_job *job, const uint32_t *hash)
+{
+	uint64_t key = ((uint64_t)hash[1] << 32) | hash[0];
+
+	for (int i = 0; i < job->n_shares; i++)
+		if (job->shares[i] == key)
+			return SIM_ERR_DUPLICATE;
+	if (job->n_shares == job->max_shares) {
+		job->max_shares = job->max_shares ? 2 * job->max_shares : 64;
+		job->shares = (uint64_t *)realloc(job->shares, job->max_shares * sizeof(uint64_t));
+	}
+	job->shares[job->n_shares++] = key;
+	return 0;
+}
+
+// prueft eine Share wie ein Pool, 0 wenn sie gilt, sonst der Fehlercode
+static int sim_check(struct sim_client *c, json_t *params, double now)
+{
+	const char *id = json_string_value(json_array_get(params, 1));
+	unsigned char coinbase[SIM_COINB1 + 4 + SIM_XNONCE2 + SIM_COINB2];
+	unsigned char root[64], ntime[4], nonce[4], vote[2];
+	unsigned char *branches[SIM_MAX_MERKLE];
+	uint32_t data[32], hash[8], target[8];
+	struct sim_job *job;
+	unsigned int seq;
+
+	if (!c->authorized)
+		return SIM_ERR_UNAUTHORIZED;
+	if (!id || sscanf(id, "%x", &seq) != 1)
+		return SIM_ERR_OTHER;
+	job = &jobs[seq % SIM_JOBS];
+	if (!seq || job->seq != seq)
+		return SIM_ERR_STALE;
+	if (job->block != block) {
+		if (job->block + 1 == block)
+			sim_add(&stats.stale_after, 1e3 * (now - block_time));
+		return SIM_ERR_STALE;
+	}
+
+	memcpy(coinbase, job->coinb1, SIM_COINB1);
+	be32enc(coinbase + SIM_COINB1, c->xnonce1);
+	memcpy(coinbase + SIM_COINB1 + 4 + SIM_XNONCE2, job->coinb2, SIM_COINB2);
+	memset(vote, 0, sizeof(vote));
+	if (!sim_hex_param(params, 2, coinbase + SIM_COINB1 + 4, SIM_XNONCE2) ||
+		!sim_hex_param(params, 3, ntime, 4) ||
+		!sim_hex_param(params, 4, nonce, 4) ||
+		(sim_algo->vote && !sim_hex_param(params, 5, vote, 2)))
+		return SIM_ERR_OTHER;
+
+	for (int i = 0; i < opt_sim_merkle; i++)
+		branches[i] = job->merkle[i];
+	algo_merkle_root(sim_algo->merkle, root, coinbase, sizeof(coinbase), branches, opt_sim_merkle);
+	// ntime und Nonce schickt der Miner als Woerter seines Headers
+	algo_stratum_header(sim_algo, data, &job->header, root, be16dec(vote));
+	data[17] = le32dec(ntime);
+	data[19] = le32dec(nonce);
+	algo_hash_data(sim_algo, hash, data);
+
+	diff_to_target(target, job->diff / sim_algo->diff_factor);
+	if (!fulltest(hash, target))
+		return SIM_ERR_LOW_DIFF;
+	if (sim_share_key(job, hash))
+		return SIM_ERR_DUPLICATE;
+
+	stats.work += 4294967296.0 * job->diff / sim_algo->diff_factor;
+	if (c->first_seq != seq) {
+		c->first_seq = seq;
+		sim_add(&stats.first_share, 1e3 * (now - job->sent));
+	}
+	return 0;
+}
+
+static void sim_count(int code)
+{
+	switch (code) {
+	case 0:			stats.accepted++; break;
+	case SIM_ERR_STALE:	stats.stale++; break;
+	case SIM_ERR_DUPLICATE:	stats.duplicate++; break;
+	case SIM_ERR_LOW_DIFF:	stats.low_diff++; break;
+	default:		stats.invalid++; break;
+	}
+}
+
+static void sim_submit(struct sim_client *c, json_t *id, json_t *params, double now)
+{
+	static const char *reasons[] = {
+		"Other/Unknown", "Job not found (=stale)", "Duplicate share",
+		"Low difficulty share", "Unauthorized worker"
+	};
+	int code = sim_check(c, params, now);
+
+	sim_count(code);
+	if (code)
+		c->rejected++;
+	else
+		c->accepted++;
+	if (opt_debug || (code && code != SIM_ERR_STALE))
+		applog(code ? LOG_WARNING : LOG_DEBUG, "pool sim: client %08x share %s%s%s", c->xnonce1,
+			code ? "rejected" : "accepted", code ? ", " : "", code ? reasons[code - SIM_ERR_OTHER] : "");
+	sim_reply(c, id, code ? json_false() : json_true(), code,
+		code ? reasons[code - SIM_ERR_OTHER] : NULL, now);
+}
+
+static void sim_request(struct sim_client *c, const char *line, double now)
+{
+	json_error_t err;
+	json_t *req = JSON_LOADS(line, &err);
+	json_t *id, *params;
+	const char *method;
+
+	if (opt_protocol)
+		applog(LOG_DEBUG, "pool < %s", line);
+	if (!req) {
+		applog(LOG_WARNING, "pool sim: client %08x sent invalid JSON", c->xnonce1);
+		return;
+	}
+	id = json_object_get(req, "id");
+	params = json_object_get(req, "params");
+	method = json_string_value(json_object_get(req, "method"));
+	// Antworten auf client.get_version u.ae. interessieren nicht
+	if (!method || !id || json_is_null(id)) {
+		json_decref(req);
+		return;
+	}
+
+	if (!strcmp(method, "mining.subscribe")) {
+		json_t *result = json_array(), *subs = json_array(), *sub;
+		char xnonce1[16];
+
+		sprintf(xnonce1, "%08x", c->xnonce1);
+		sub = json_array();
+		json_array_append_new(sub, json_string("mining.set_difficulty"));
+		json_array_append_new(sub, json_string(xnonce1));
+		json_array_append_new(subs, sub);
+		sub = json_array();
+		json_array_append_new(sub, json_string("mining.notify"));
+		json_array_append_new(sub, json_string(xnonce1));
+		json_array_append_new(subs, sub);
+		json_array_append_new(result, subs);
+		json_array_append_new(result, json_string(xnonce1));
+		json_array_append_new(result, json_integer(SIM_XNONCE2));
+		c->subscribed = true;
+		sim_reply(c, id, result, 0, NULL, now);
+	} else if (!strcmp(method, "mining.authorize")) {
+		sim_reply(c, id, json_true(), 0, NULL, now);
+		if (!c->authorized) {
+			c->authorized = true;
+			sim_send_job(c, &jobs[job_seq % SIM_JOBS], true, now);
+		}
+	} else if (!strcmp(method, "mining.submit") && json_is_array(params))
+		sim_submit(c, id, params, now);
+	else
+		sim_reply(c, id, json_null(), SIM_ERR_OTHER, "Method not supported", now);
+	json_decref(req);
+}
+
+// prueft eine getwork Share, 0 wenn sie gilt, sonst der Fehlercode; der
+// Job ist der leichteste des Blocks, aus dem der Header stammt
+static int sim_getwork_check(const char *hex, double now)
+{
+	uint32_t data[32], hash[8], target[8];
+	struct sim_job *job = NULL;
+
+	if (!hex || strlen(hex) != 2 * sizeof(data) || !hex2bin((unsigned char *)data, hex, sizeof(data)))
+		return SIM_ERR_OTHER;
+	for (int i = 0; i < 32; i++)
+		data[i] = le32dec(&data[i]);
+	for (int i = 0; i < SIM_JOBS; i++)
+		if (jobs[i].seq && !memcmp(&data[1], &jobs[i].data[1], 32) && (!job || jobs[i].diff < job->diff))
+			job = &jobs[i];
+	if (!job)
+		return SIM_ERR_STALE;
+	if (job->block != block) {
+		if (job->block + 1 == block)
+			sim_add(&stats.stale_after, 1e3 * (now - block_time));
+		return SIM_ERR_STALE;
+	}
+
+	algo_hash_data(sim_algo, hash, data);
+	diff_to_target(target, job->diff / sim_algo->diff_factor);
+	if (!fulltest(hash, target))
+		return SIM_ERR_LOW_DIFF;
+	if (sim_share_key(job, hash))
+		return SIM_ERR_DUPLICATE;
+	stats.work += 4294967296.0 * job->diff / sim_algo->diff_factor;
+	return 0;
+}
+
+static void sim_http_request(struct sim_client *c, const char *path, const char *body, double now)
+{
+	// X-Reject-Reason wie bei bitcoind (BIP 22)
+	static const char *reasons[] = {
+		"bad-data", "stale-prevblk", "duplicate", "high-hash", "bad-data"
+	};
+	json_error_t err;
+	json_t *req = JSON_LOADS(body, &err);
+	json_t *id, *params;
+	const char *method;
+
+	if (opt_protocol)
+		applog(LOG_DEBUG, "pool < %s %s", path, body);
+	id = req ? json_object_get(req, "id") : NULL;
+	params = req ? json_object_get(req, "params") : NULL;
+	method = req ? json_string_value(json_object_get(req, "method")) : NULL;
+	if (!id)
+		id = json_null();
+
+	if (!method || strcmp(method, "getwork")) {
+		json_t *error = json_object();
+		json_object_set_new(error, "code", json_integer(-32601));
+		json_object_set_new(error, "message", json_string("Method not found"));
+		sim_http_reply(c, id, json_null(), error, NULL, now);
+	} else if (!strcmp(path, SIM_LP_PATH))
+		c->longpoll = true;
+	else if (!json_array_size(params))
+		sim_http_reply(c, id, sim_getwork(&jobs[job_seq % SIM_JOBS]), NULL, NULL, now);
+	else {
+		int code = sim_getwork_check(json_string_value(json_array_get(params, 0)), now);
+
+		sim_count(code);
+		stats.submits++;
+		sim_http_reply(c, id, code ? json_false() : json_true(), NULL,
+			code ? reasons[code - SIM_ERR_OTHER] : NULL, now);
+	}
+	if (req)
+		json_decref(req);
+}
+
+// alle vollstaendigen Anfragen im Puffer, mit Keep-Alive auch mehrere
+static void sim_http_read(struct sim_client *c, double now)
+{
+	char *start = c->in;
+
+	while (1)
+	{
+		char *body = strstr(start, "\r\n\r\n"), *line, path[256], saved;
+		int len = 0;
+
+		if (!body)
+			break;
+		body += 4;
+		for (line = start; line < body; line = strstr(line, "\r\n") + 2)
+			if (!strncasecmp(line, "Content-Length:", 15))
+				len = atoi(line + 15);
+		// mehr als der Puffer kommt nie an, negativ liefe rueckwaerts
+		if (len < 0 || len > SIM_LINE) {
+			applog(LOG_WARNING, "pool sim: client %08x sent Content-Length %d", c->xnonce1, len);
+			sim_drop(c);
+			return;
+		}
+		if (c->in + c->in_len - body < len)
+			break;
+		if (sscanf(start, "%*s %255s", path) != 1)
+			strcpy(path, "/");
+
+		saved = body[len];
+		body[len] = '\0';
+		sim_http_request(c, path, body, now);
+		body[len] = saved;
+		start = body + len;
+	}
+	c->in_len -= (int)(start - c->in);
+	memmove(c->in, start, c->in_len);
+	c->in[c->in_len] = '\0';
+}
+
+static void sim_read(struct sim_client *c, double now)
+{
+	int n = recv(c->sock, c->in + c->in_len, SIM_LINE - 1 - c->in_len, 0);
+	char *line, *end;
+
+	if (n <= 0) {
+		if (n < 0 && socket_blocks())
+			return;
+		sim_drop(c);
+		return;
+	}
+	c->in_len += n;
+	c->in[c->in_len] = '\0';
+
+	if (c->http) {
+		sim_http_read(c, now);
+		if (c->sock == CURL_SOCKET_BAD)
+			return;
+	} else {
+		line = c->in;
+		while ((end = strchr(line, '\n')) != NULL)
+		{
+			*end = '\0';
+			if (end > line && end[-1] == '\r')
+				end[-1] = '\0';
+			if (*line)
+				sim_request(c, line, now);
+			if (c->sock == CURL_SOCKET_BAD)
+				return;
+			line = end + 1;
+		}
+		c->in_len -= (int)(line - c->in);
+		memmove(c->in, line, c->in_len);
+	}
+	if (c->in_len == SIM_LINE - 1) {
+		applog(LOG_WARNING, "pool sim: client %08x sent an overlong request", c->xnonce1);
+		sim_drop(c);
+	}
+}
+
+static void sim_accept(const struct sim_listener *l)
+{
+	static unsigned int xnonce1;
+	curl_socket_t sock = accept(l->sock, NULL, NULL);
+	int i, on = 1;
+
+	if (sock == CURL_SOCKET_BAD)
+		return;
+	for (i = 0; i < SIM_MAX_CLIENTS && clients[i].sock != CURL_SOCKET_BAD; i++)
+		;
+	if (i == SIM_MAX_CLIENTS) {
+		sim_close(sock);
+		return;
+	}
+	sim_nonblocking(sock);
+	// Kopf und Koerper der HTTP Antwort sind zwei send(), ohne NODELAY
+	// wartet der zweite auf das verzoegerte ACK des Miners
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&on, sizeof(on));
+	clients[i].sock = sock;
+	clients[i].xnonce1 = ++xnonce1;
+	clients[i].http = (l == &http_listener);
+	stats.connections++;
+	// curl oeffnet und schliesst HTTP Verbindungen nach Belieben
+	if (!clients[i].http)
+		applog(LOG_INFO, "pool sim: client %08x connected", xnonce1);
+}
+
+// client.reconnect auf denselben Pool, die Miner bauen die Verbindung neu auf
+static void sim_reconnect(double now)
+{
+	json_t *params = json_array();
+
+	json_array_append_new(params, json_string(sim_addr(&stratum_listener)));
+	json_array_append_new(params, json_integer(stratum_listener.port));
+	json_array_append_new(params, json_integer(0));
+	for (int i = 0; i < SIM_MAX_CLIENTS; i++)
+		if (clients[i].sock != CURL_SOCKET_BAD && clients[i].authorized) {
+			sim_method(&clients[i], "client.reconnect", params, now);
+			stats.reconnects++;
+		}
+	json_decref(params);
+}
+
+static double sim_stale_rate(void)
+{
+	unsigned long total = stats.accepted + stats.stale + stats.low_diff + stats.duplicate + stats.invalid;
+
+	return total ? (double)stats.stale / total : 0.0;
+}
+
+static void sim_log(double elapsed)
+{
+	applog(LOG_NOTICE, "pool sim: %lu jobs, %lu accepted, %lu stale (%.2f%%), %lu rejected, %.2f khash/s",
+		stats.jobs, stats.accepted, stats.stale, 100.0 * sim_stale_rate(),
+		stats.low_diff + stats.duplicate + stats.invalid, elapsed > 0 ? 1e-3 * stats.work / elapsed : 0.0);
+	if (http_listener.sock != CURL_SOCKET_BAD)
+		applog(LOG_NOTICE, "pool sim: %lu getwork, %lu submits, %lu longpolls",
+			stats.getworks, stats.submits, stats.longpolls);
+}
+
+static json_t *sim_report(const char *version, double elapsed)
+{
+	json_t *report = json_object(), *settings = json_object(), *shares = json_object();
+	json_t *latency = json_object(), *list = json_array();
+
+	json_object_set_new(report, "ccminer", json_string(version));
+	json_object_set_new(report, "mode", json_string("pool-sim"));
+	json_object_set_new(report, "time", json_integer((int)time(NULL)));
+	json_object_set_new(report, "algo", json_string(sim_algo->name));
+	json_object_set_new(report, "seconds", json_real(elapsed));
+
+	json_object_set_new(settings, "job_interval", json_real(opt_sim_job_interval));
+	json_object_set_new(settings, "clean", json_integer(opt_sim_clean));
+	for (int i = 0; i < n_diffs; i++)
+		json_array_append_new(list, json_real(diffs[i]));
+	json_object_set_new(settings, "diff", list);
+	json_object_set_new(settings, "merkle", json_integer(opt_sim_merkle));
+	json_object_set_new(settings, "latency_ms", json_integer(opt_sim_latency));
+	json_object_set_new(settings, "reconnect", json_real(opt_sim_reconnect));
+	json_object_set_new(report, "settings", settings);
+
+	json_object_set_new(report, "connections", json_integer((int)stats.connections));
+	json_object_set_new(report, "reconnects", json_integer((int)stats.reconnects));
+	json_object_set_new(report, "jobs", json_integer((int)stats.jobs));
+	json_object_set_new(report, "blocks", json_integer((int)stats.blocks));
+	json_object_set_new(shares, "accepted", json_integer((int)stats.accepted));
+	json_object_set_new(shares, "stale", json_integer((int)stats.stale));
+	json_object_set_new(shares, "low_diff", json_integer((int)stats.low_diff));
+	json_object_set_new(shares, "duplicate", json_integer((int)stats.duplicate));
+	json_object_set_new(shares, "invalid", json_integer((int)stats.invalid));
+	json_object_set_new(report, "shares", shares);
+	json_object_set_new(report, "stale_rate", json_real(sim_stale_rate()));
+	json_object_set_new(report, "hashrate", json_real(elapsed > 0 ? stats.work / elapsed : 0.0));
+	json_object_set_new(latency, "first_share_ms", sim_summary(&stats.first_share));
+	json_object_set_new(latency, "stale_after_block_ms", sim_summary(&stats.stale_after));
+	json_object_set_new(report, "latency", latency);
+	if (http_listener.sock != CURL_SOCKET_BAD) {
+		json_t *getwork = json_object();
+		json_object_set_new(getwork, "requests", json_integer((int)stats.getworks));
+		json_object_set_new(getwork, "submits", json_integer((int)stats.submits));
+		json_object_set_new(getwork, "longpolls", json_integer((int)stats.longpolls));
+		json_object_set_new(report, "getwork", getwork);
+	}
+	return report;
+}
+
+static bool sim_listen(struct sim_listener *l, const char *bind_addr)
+{
+	struct sockaddr_in addr;
+	const char *colon = strrchr(bind_addr, ':');
+	int on = 1;
+
+	strcpy(l->host, SIM_DEFAULT_ADDR);
+	if (colon) {
+		snprintf(l->host, sizeof(l->host), "%.*s", (int)(colon - bind_addr), bind_addr);
+		l->port = atoi(colon + 1);
+	} else
+		l->port = atoi(bind_addr);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((unsigned short)l->port);
+	addr.sin_addr.s_addr = inet_addr(l->host);
+	if (l->port <= 0 || l->port > 65535 || addr.sin_addr.s_addr == INADDR_NONE) {
+		applog(LOG_ERR, "invalid pool sim address %s", bind_addr);
+		return false;
+	}
+
+	l->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (l->sock == CURL_SOCKET_BAD)
+		return false;
+	setsockopt(l->sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+	if (bind(l->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(l->sock, 16) < 0) {
+		applog(LOG_ERR, "pool sim can not listen on %s:%d", l->host, l->port);
+		sim_close(l->sock);
+		l->sock = CURL_SOCKET_BAD;
+		return false;
+	}
+	sim_nonblocking(l->sock);
+	applog(LOG_NOTICE, "pool sim: %s on %s:%d", l == &http_listener ? "getwork" : "stratum", l->host, l->port);
+	return true;
+}
+
+static bool sim_parse_diffs(void)
+{
+	char *list = strdup(opt_sim_diff ? opt_sim_diff : "1");
+	char *tok;
+
+	n_diffs = 0;
+	for (tok = strtok(list, ","); tok && n_diffs < SIM_MAX_DIFFS; tok = strtok(NULL, ","))
+	{
+		diffs[n_diffs] = atof(tok);
+		if (diffs[n_diffs] <= 0.0) {
+			applog(LOG_ERR, "pool sim: invalid difficulty %s", tok);
+			free(list);
+			return false;
+		}
+		n_diffs++;
+	}
+	free(list);
+	return n_diffs > 0;
+}
+
+extern "C" int pool_sim_run(const struct algo_traits *algo, const char *version)
+{
+	double start, next_job, next_reconnect, next_log, now;
+#ifdef WIN32
+	WSADATA wsa;
+
+	WSAStartup(MAKEWORD(2, 2), &wsa);
+#else
+	// Miner, die mitten im Senden gehen, beenden sonst den Pool
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	sim_algo = algo;
+	if (opt_sim_merkle > SIM_MAX_MERKLE)
+		opt_sim_merkle = SIM_MAX_MERKLE;
+	if (!sim_parse_diffs() ||
+		(opt_pool_sim && !sim_listen(&stratum_listener, opt_pool_sim)) ||
+		(opt_getwork_sim && !sim_listen(&http_listener, opt_getwork_sim)))
+		return 1;
+	for (int i = 0; i < SIM_MAX_CLIENTS; i++)
+		clients[i].sock = CURL_SOCKET_BAD;
+	srand((unsigned int)time(NULL));
+
+	start = now = sim_now();
+	sim_new_job(now);
+	next_job = now + opt_sim_job_interval;
+	next_reconnect = (opt_pool_sim && opt_sim_reconnect > 0.0) ? now + opt_sim_reconnect : 0.0;
+	next_log = now + SIM_LOG_S;
+	applog(LOG_NOTICE, "pool sim: %s, job every %g s, every %d clean, %d ms latency",
+		algo->name, opt_sim_job_interval, opt_sim_clean, opt_sim_latency);
+
+	while (opt_sim_time <= 0.0 || now < start + opt_sim_time)
+	{
+		double wake = next_job;
+		struct timeval tv;
+		fd_set rd, wr;
+		curl_socket_t top = 0;
+
+		FD_ZERO(&rd);
+		FD_ZERO(&wr);
+		if (stratum_listener.sock != CURL_SOCKET_BAD) {
+			FD_SET(stratum_listener.sock, &rd);
+			top = stratum_listener.sock;
+		}
+		if (http_listener.sock != CURL_SOCKET_BAD) {
+			FD_SET(http_listener.sock, &rd);
+			if (http_listener.sock > top)
+				top = http_listener.sock;
+		}
+		for (int i = 0; i < SIM_MAX_CLIENTS; i++)
+		{
+			struct sim_client *c = &clients[i];
+
+			if (c->sock == CURL_SOCKET_BAD)
+				continue;
+			FD_SET(c->sock, &rd);
+			if (c->out && c->out->due <= now)
+				FD_SET(c->sock, &wr);
+			else if (c->out && c->out->due < wake)
+				wake = c->out->due;
+			if (c->sock > top)
+				top = c->sock;
+		}
+		if (next_reconnect > 0.0 && next_reconnect < wake)
+			wake = next_reconnect;
+		if (wake > now + 1.0)
+			wake = now + 1.0;
+		wake = wake > now ? wake - now : 0.0;
+		tv.tv_sec = (long)wake;
+		tv.tv_usec = (long)(1e6 * (wake - tv.tv_sec));
+		if (select((int)top + 1, &rd, &wr, NULL, &tv) < 0)
+			continue;
+
+		now = sim_now();
+		for (int i = 0; i < SIM_MAX_CLIENTS; i++)
+		{
+			struct sim_client *c = &clients[i];
+
+			if (c->sock != CURL_SOCKET_BAD && FD_ISSET(c->sock, &rd))
+				sim_read(c, now);
+			if (c->sock != CURL_SOCKET_BAD && c->out)
+				sim_flush(c, now);
+		}
+		if (stratum_listener.sock != CURL_SOCKET_BAD && FD_ISSET(stratum_listener.sock, &rd))
+			sim_accept(&stratum_listener);
+		if (http_listener.sock != CURL_SOCKET_BAD && FD_ISSET(http_listener.sock, &rd))
+			sim_accept(&http_listener);
+
+		if (now >= next_job) {
+			sim_new_job(now);
+			next_job += opt_sim_job_interval;
+			if (next_job < now)
+				next_job = now + opt_sim_job_interval;
+		}
+		if (next_reconnect > 0.0 && now >= next_reconnect) {
+			sim_reconnect(now);
+			next_reconnect = now + opt_sim_reconnect;
+		}
+		if (now >= next_log) {
+			sim_log(now - start);
+			next_log = now + SIM_LOG_S;
+		}
+	}
+
+	sim_log(now - start);
+	for (int i = 0; i < SIM_MAX_CLIENTS; i++)
+		if (clients[i].sock != CURL_SOCKET_BAD)
+			sim_drop(&clients[i]);
+	if (stratum_listener.sock != CURL_SOCKET_BAD)
+		sim_close(stratum_listener.sock);
+	if (http_listener.sock != CURL_SOCKET_BAD)
+		sim_close(http_listener.sock);
+	return bench_write(sim_report(version, now - start)) ? 0 : 1;
+}
@@ -0,0 +1,41 @@
+#ifndef __POOLSIM_H__
+#define __POOLSIM_H__
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct algo_traits;
+
+/* [IP:]PORT the simulated stratum pool listens on, NULL = off */
+extern char *opt_pool_sim;
+/* [IP:]PORT of the simulated getwork/longpoll server, NULL = off; with
+ * opt_pool_sim too, X-Stratum points the miners there */
+extern char *opt_getwork_sim;
+/* s between two jobs (mining.notify, longpoll answer) */
+extern double opt_sim_job_interval;
+/* every n-th job starts a new block (clean_jobs), 1 = every job */
+extern int opt_sim_clean;
+/* comma separated share difficulties, one per job in turn, NULL = 1 */
+extern char *opt_sim_diff;
+/* Merkle branches per job */
+extern int opt_sim_merkle;
+/* ms every line of the pool waits before it is sent */
+extern int opt_sim_latency;
+/* s between two client.reconnect, 0 = never */
+extern double opt_sim_reconnect;
+/* s until the report is written and the pool exits, 0 = run forever */
+extern double opt_sim_time;
+
+/* runs the simulated pool (stratum, getwork or both on one job stream)
+ * on the calling thread, validates the shares with the CPU hash of algo
+ * and writes the report like --bench-json; returns the exit code */
+extern int pool_sim_run(const struct algo_traits *algo, const char *version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POOLSIM_H__ */
@@ -0,0 +1,150 @@
+//
+// Zeitmessung der Hash-Stufen (--profile)
+//
+// Die Backends messen jede Stufe eines Batches (der CUDA Backend mit Events
+// um den Kernel) und melden sie hier mit ihrem order Index. Pro Device und
+// Stufe werden min/avg/p99 und die Nonces vor und nach jeder Compaction
+// gesammelt. Mit --profile-trace landen die ersten PROFILE_TRACE_EVENTS
+// Stufen aller Devices zusaetzlich als Chrome Trace (chrome://tracing) in
+// einer Datei.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+#include "miner.h"
+#include "profile.h"
+
+bool opt_profile = false;
+char *opt_profile_trace = NULL;
+
+#define PROFILE_REPORT 60
+#define PROFILE_TRACE_EVENTS 20000
+
+// gemeinsamer Trace aller Devices, NULL wenn keiner (mehr) gesammelt wird
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static json_t *trace_events = NULL;
+static bool trace_done = false;
+
+void profile_start(struct device_ctx *ctx, const char *algo)
+{
+	if (!opt_profile)
+		return;
+
+	if (!ctx->profile)
+		ctx->profile = (struct device_profile *)calloc(1, sizeof(struct device_profile));
+	if (!ctx->profile)
+		return;
+	memset(ctx->profile, 0, sizeof(struct device_profile));
+	ctx->profile->algo = algo;
+	ctx->profile->last_report = (long)time(NULL);
+}
+
+static void profile_trace_add(struct device_ctx *ctx, int order, const char *name, int slot,
+	double ts, double dur, int nonces)
+{
+	json_t *ev, *args;
+
+	pthread_mutex_lock(&trace_lock);
+	if (trace_done) {
+		pthread_mutex_unlock(&trace_lock);
+		return;
+	}
+	if (!trace_events)
+		trace_events = json_array();
+
+	// Chrome Trace: ein Prozess pro Device, ein Thread pro Pipeline-Slot, Zeiten in us
+	ev = json_object();
+	args = json_object();
+	json_object_set_new(ev, "name", json_string(name));
+	json_object_set_new(ev, "cat", json_string(ctx->profile->algo));
+	json_object_set_new(ev, "ph", json_string("X"));
+	json_object_set_new(ev, "pid", json_integer(ctx->thr_id));
+	json_object_set_new(ev, "tid", json_integer(slot));
+	json_object_set_new(ev, "ts", json_real(1e3 * ts));
+	json_object_set_new(ev, "dur", json_real(1e3 * dur));
+	json_object_set_new(args, "order", json_integer(order));
+	json_object_set_new(args, "nonces", json_integer(nonces));
+	json_object_set_new(ev, "args", args);
+	json_array_append_new(trace_events, ev);
+
+	if (json_array_size(trace_events) >= PROFILE_TRACE_EVENTS) {
+		json_t *root = json_object();
+
+		json_object_set_new(root, "traceEvents", trace_events);
+		json_object_set_new(root, "displayTimeUnit", json_string("ms"));
+		if (json_dump_file(root, opt_profile_trace, JSON_INDENT(1)) < 0)
+			applog(LOG_ERR, "failed to write the stage trace %s", opt_profile_trace);
+		else
+			applog(LOG_INFO, "wrote %d stage events to %s", PROFILE_TRACE_EVENTS, opt_profile_trace);
+		json_decref(root);
+		trace_events = NULL;
+		trace_done = true;
+	}
+	pthread_mutex_unlock(&trace_lock);
+}
+
+void profile_add(struct device_ctx *ctx, int order, const char *name, int slot,
+	double ts, double dur, int nonces, long out1, long out2)
+{
+	struct device_profile *prof = ctx->profile;
+	struct stage_profile *st;
+
+	if (!prof)
+		return;
+
+	st = &prof->stage[(order < PROFILE_STAGES) ? order : PROFILE_STAGES - 1];
+	if (!st->count || dur < st->min)
+		st->min = dur;
+	if (!st->count || dur > st->max)
+		st->max = dur;
+	st->recent[st->count % PROFILE_RECENT] = (float)dur;
+	st->sum += dur;
+	st->count++;
+	st->name = name;
+	st->nonces += nonces;
+	if (out1 >= 0)
+		st->out[0] += out1;
+	if (out2 >= 0)
+		st->out[1] += out2;
+
+	if (opt_profile_trace)
+		profile_trace_add(ctx, order, name, slot, ts, dur, nonces);
+}
+
+static double profile_p99(const struct stage_profile *st)
+{
+	float recent[PROFILE_RECENT];
+	int n = (st->count < PROFILE_RECENT) ? (int)st->count : PROFILE_RECENT;
+	int k = (99 * n) / 100;
+
+	memcpy(recent, st->recent, n * sizeof(float));
+	std::nth_element(recent, recent + k, recent + n);
+	return recent[k];
+}
+
+void profile_report(struct device_ctx *ctx)
+{
+	struct device_profile *prof = ctx->profile;
+	long now = (long)time(NULL);
+
+	if (!prof || now < prof->last_report + PROFILE_REPORT)
+		return;
+	prof->last_report = now;
+
+	for (int i = 0; i < PROFILE_STAGES; i++)
+	{
+		const struct stage_profile *st = &prof->stage[i];
+		char out[64] = "";
+
+		if (!st->count)
+			continue;
+		if (st->out[0] > 0.0 || st->out[1] > 0.0)
+			sprintf(out, " -> %.0f + %.0f", st->out[0] / st->count, st->out[1] / st->count);
+		applog(LOG_INFO, "GPU #%d: %s %2d %-16s %.3f/%.3f/%.3f ms min/avg/p99, %.0f nonces%s",
+			ctx->device_id, prof->algo, i, st->name, st->min, st->sum / st->count, profile_p99(st),
+			st->nonces / st->count, out);
+	}
+}
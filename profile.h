@@ -0,0 +1,52 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdbool.h>
+
+#include "device.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* stage orders with their own statistics, higher ones share the last */
+#define PROFILE_STAGES 32
+/* recent times per stage kept for the p99 */
+#define PROFILE_RECENT 256
+
+struct stage_profile {
+	const char *name;	/* stage of the last sample at this order */
+	unsigned long count;
+	double min, max, sum;	/* ms */
+	float recent[PROFILE_RECENT];
+	double nonces;		/* nonces entering the stage, summed */
+	double out[2];		/* compactions: nonces of the true/false branch */
+};
+
+/* per stage timing of one device with --profile, filled by the backend */
+struct device_profile {
+	const char *algo;
+	struct stage_profile stage[PROFILE_STAGES];
+	long last_report;
+};
+
+extern bool opt_profile;
+extern char *opt_profile_trace;
+
+/* allocates ctx->profile for the algorithm, no-op without --profile */
+extern void profile_start(struct device_ctx *ctx, const char *algo);
+
+/* one stage of one batch: ts and dur in ms from a per-device zero, slot is
+ * the pipeline slot (trace row); out1/out2 < 0 for stages that are no
+ * compaction */
+extern void profile_add(struct device_ctx *ctx, int order, const char *name, int slot,
+	double ts, double dur, int nonces, long out1, long out2);
+
+/* min/avg/p99 and survivors per stage, printed every PROFILE_REPORT s */
+extern void profile_report(struct device_ctx *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PROFILE_H__ */
@@ -133,8 +133,11 @@ public:
 } uint64_t;
 #endif
 
+#include "device.h"
+
 // aus heavy.cu
 extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
+extern cudaStream_t gpustream[MAX_GPUS];
 
 // die Message it Padding zur Berechnung auf der GPU
 __constant__ uint64_t c_PaddedMessage80[16]; // padded message (80 bytes + padding)
@@ -447,8 +450,8 @@ __host__ void quark_bmw512_cpu_hash_64(int thr_id, int threads, uint32_t startNo
     // Gre des dynamischen Shared Memory Bereichs
     size_t shared_size = 0;
 
-    quark_bmw512_gpu_hash_64<<<grid, block, shared_size>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector);
-    MyStreamSynchronize(NULL, order, thr_id);
+    quark_bmw512_gpu_hash_64<<<grid, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector);
+    MyStreamSynchronize(gpustream[thr_id], order, thr_id);
 }
 
 __host__ void quark_bmw512_cpu_hash_80(int thr_id, int threads, uint32_t startNounce, uint32_t *d_hash, int order)
@@ -462,8 +465,8 @@ __host__ void quark_bmw512_cpu_hash_80(int thr_id, int threads, uint32_t startNo
     // Gre des dynamischen Shared Memory Bereichs
     size_t shared_size = 0;
 
-    quark_bmw512_gpu_hash_80<<<grid, block, shared_size>>>(threads, startNounce, (uint64_t*)d_hash);
-    MyStreamSynchronize(NULL, order, thr_id);
+    quark_bmw512_gpu_hash_80<<<grid, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, (uint64_t*)d_hash);
+    MyStreamSynchronize(gpustream[thr_id], order, thr_id);
 }
 
 #endif
@@ -1,7 +1,10 @@
 #include <stdint.h>
 
+#include "device.h"
+
 // aus heavy.cu
 extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
+extern cudaStream_t gpustream[MAX_GPUS];
 
 typedef struct {
     uint32_t x[8][4];                     /*the 1024-bit state, ( x[i][0] || x[i][1] || x[i][2] || x[i][3] ) is the ith row of the state in the pseudocode*/
@@ -350,7 +353,7 @@ __host__ void quark_jh512_cpu_hash_64(int thr_id, int threads, uint32_t startNou
     // Gre des dynamischen Shared Memory Bereichs
     size_t shared_size = 0;
 
-    quark_jh512_gpu_hash_64<<<grid, block, shared_size>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector);
-    MyStreamSynchronize(NULL, order, thr_id);
+    quark_jh512_gpu_hash_64<<<grid, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector);
+    MyStreamSynchronize(gpustream[thr_id], order, thr_id);
 }
 
@@ -12,8 +12,11 @@ typedef unsigned char uint8_t;
 typedef unsigned int uint32_t;
 typedef unsigned long long uint64_t;
 
+#include "device.h"
+
 // aus heavy.cu
 extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
+extern cudaStream_t gpustream[MAX_GPUS];
 
 // die Message it Padding zur Berechnung auf der GPU
 __constant__ uint64_t c_PaddedMessage80[16]; // padded message (80 bytes + padding)
@@ -406,10 +409,10 @@ __host__ void quark_blake512_cpu_hash_64(int thr_id, int threads, uint32_t start
 	// Gre des dynamischen Shared Memory Bereichs
 	size_t shared_size = 0;
 
-	quark_blake512_gpu_hash_64<<<grid, block, shared_size>>>(threads, startNounce, d_nonceVector, (uint64_t*)d_outputHash);
+	quark_blake512_gpu_hash_64<<<grid, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, d_nonceVector, (uint64_t*)d_outputHash);
 
 	// Strategisches Sleep Kommando zur Senkung der CPU Last
-	MyStreamSynchronize(NULL, order, thr_id);
+	MyStreamSynchronize(gpustream[thr_id], order, thr_id);
 }
 
 __host__ void quark_blake512_cpu_hash_80(int thr_id, int threads, uint32_t startNounce, uint32_t *d_outputHash, int order)
@@ -423,8 +426,8 @@ __host__ void quark_blake512_cpu_hash_80(int thr_id, int threads, uint32_t start
 	// Gre des dynamischen Shared Memory Bereichs
 	size_t shared_size = 0;
 
-	quark_blake512_gpu_hash_80<<<grid, block, shared_size>>>(threads, startNounce, d_outputHash);
+	quark_blake512_gpu_hash_80<<<grid, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, d_outputHash);
 
 	// Strategisches Sleep Kommando zur Senkung der CPU Last
-	MyStreamSynchronize(NULL, order, thr_id);
+	MyStreamSynchronize(gpustream[thr_id], order, thr_id);
 }
@@ -5,19 +5,25 @@
 #include <stdio.h>
 #include <memory.h>
 
+#include "device.h"
+
 // Folgende Definitionen spter durch header ersetzen
 typedef unsigned char uint8_t;
 typedef unsigned int uint32_t;
 typedef unsigned long long uint64_t;
 
+#include "cuda_candidates.h"
+
 // das Hash Target gegen das wir testen sollen
 __constant__ uint32_t pTarget[8];
 
-uint32_t *d_resNounce[8];
-uint32_t *h_resNounce[8];
+// ein Kandidatenpuffer je Pipeline-Slot, die synchrone Variante nutzt Slot 0
+uint32_t *d_resNounce[DEVICE_SLOTS][MAX_GPUS];
+uint32_t *h_resNounce[DEVICE_SLOTS][MAX_GPUS];
 
 // aus heavy.cu
 extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
+extern cudaStream_t gpustream[MAX_GPUS];
 
 __global__ void quark_check_gpu_hash_64(int threads, uint32_t startNounce, uint32_t *g_nonceVector, uint32_t *g_hash, uint32_t *resNounce)
 {
@@ -56,16 +62,32 @@ __global__ void quark_check_gpu_hash_64(int threads, uint32_t startNounce, uint3
 		}
 
 		if(rc == true)
-			if(resNounce[0] > nounce)
-				resNounce[0] = nounce;
+			candidate_append(resNounce, nounce);
 	}
 }
 
 // Setup-Funktionen
+__host__ void quark_check_cpu_free(int thr_id)
+{
+    for (int slot = 0; slot < DEVICE_SLOTS; slot++)
+    {
+        cudaFreeHost(h_resNounce[slot][thr_id]);
+        cudaFree(d_resNounce[slot][thr_id]);
+        h_resNounce[slot][thr_id] = NULL;
+        d_resNounce[slot][thr_id] = NULL;
+    }
+}
+
 __host__ void quark_check_cpu_init(int thr_id, int threads)
 {
-    cudaMallocHost(&h_resNounce[thr_id], 1*sizeof(uint32_t));
-    cudaMalloc(&d_resNounce[thr_id], 1*sizeof(uint32_t));
+    // die Puffer haengen nicht am Batch, ein zweites Init behaelt sie
+    if (d_resNounce[0][thr_id])
+        return;
+    for (int slot = 0; slot < DEVICE_SLOTS; slot++)
+    {
+        cudaMallocHost(&h_resNounce[slot][thr_id], CANDIDATE_WORDS*sizeof(uint32_t));
+        cudaMalloc(&d_resNounce[slot][thr_id], CANDIDATE_WORDS*sizeof(uint32_t));
+    }
 }
 
 // Target Difficulty setzen
@@ -75,10 +97,10 @@ __host__ void quark_check_cpu_setTarget(const void *ptarget)
 	cudaMemcpyToSymbol( pTarget, ptarget, 8*sizeof(uint32_t), 0, cudaMemcpyHostToDevice);
 }
 
-__host__ uint32_t quark_check_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_inputHash, int order)
+// liefert die Zahl der Treffer, die ersten DEVICE_CANDIDATES Nonces stehen in nonces
+__host__ int quark_check_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_inputHash, uint32_t *nonces, int order)
 {
-	uint32_t result = 0xffffffff;
-	cudaMemset(d_resNounce[thr_id], 0xff, sizeof(uint32_t));
+	cudaMemset(d_resNounce[0][thr_id], 0, sizeof(uint32_t));
 
 	const int threadsperblock = 256;
 
@@ -89,17 +111,37 @@ __host__ uint32_t quark_check_cpu_hash_64(int thr_id, int threads, uint32_t star
 	// Gre des dynamischen Shared Memory Bereichs
 	size_t shared_size = 0;
 
-	quark_check_gpu_hash_64<<<grid, block, shared_size>>>(threads, startNounce, d_nonceVector, d_inputHash, d_resNounce[thr_id]);
+	quark_check_gpu_hash_64<<<grid, block, shared_size>>>(threads, startNounce, d_nonceVector, d_inputHash, d_resNounce[0][thr_id]);
 
 	// Strategisches Sleep Kommando zur Senkung der CPU Last
 	MyStreamSynchronize(NULL, order, thr_id);
 
 	// Ergebnis zum Host kopieren (in page locked memory, damits schneller geht)
-	cudaMemcpy(h_resNounce[thr_id], d_resNounce[thr_id], sizeof(uint32_t), cudaMemcpyDeviceToHost);
+	cudaMemcpy(h_resNounce[0][thr_id], d_resNounce[0][thr_id], CANDIDATE_WORDS*sizeof(uint32_t), cudaMemcpyDeviceToHost);
 
 	// cudaMemcpy() ist asynchron!
 	cudaThreadSynchronize();
-	result = *h_resNounce[thr_id];
 
-	return result;
+	return candidate_read(h_resNounce[0][thr_id], nonces);
+}
+
+// Pipeline-Variante: Test und Readback landen auf dem Stream des Slots, kein Sync.
+// Das Ergebnis steht in h_resNounce, sobald der Stream bis hierher gelaufen ist.
+__host__ void quark_check_cpu_hash_64_async(int thr_id, int slot, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_inputHash, int order)
+{
+	cudaMemsetAsync(d_resNounce[slot][thr_id], 0, sizeof(uint32_t), gpustream[thr_id]);
+
+	const int threadsperblock = 256;
+
+	dim3 grid((threads + threadsperblock-1)/threadsperblock);
+	dim3 block(threadsperblock);
+
+	quark_check_gpu_hash_64<<<grid, block, 0, gpustream[thr_id]>>>(threads, startNounce, d_nonceVector, d_inputHash, d_resNounce[slot][thr_id]);
+
+	cudaMemcpyAsync(h_resNounce[slot][thr_id], d_resNounce[slot][thr_id], CANDIDATE_WORDS*sizeof(uint32_t), cudaMemcpyDeviceToHost, gpustream[thr_id]);
+}
+
+__host__ int quark_check_cpu_result(int thr_id, int slot, uint32_t *nonces)
+{
+	return candidate_read(h_resNounce[slot][thr_id], nonces);
 }
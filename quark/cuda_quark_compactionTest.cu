@@ -4,360 +4,239 @@
 #include "sm_30_intrinsics.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <memory.h>
 #include <stdint.h>
+#include <time.h>
 
-// aus cpu-miner.c
-extern int device_map[8];
-
-// diese Struktur wird in der Init Funktion angefordert
-static cudaDeviceProp props[8];
-
-static uint32_t *d_tempBranch1Nonces[8];
-static uint32_t *d_numValid[8];
-static uint32_t *h_numValid[8];
-
-static uint32_t *d_partSum[2][8]; // fr bis zu vier partielle Summen
+#include "device.h"
+#include "cuda_compaction.h"
 
 // aus heavy.cu
-extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
+extern cudaStream_t gpustream[MAX_GPUS];
 
-// True/False tester
-typedef uint32_t(*cuda_compactTestFunction_t)(uint32_t *inpHash);
+// Zwischenpuffer der Compaction, Quark und Jackpot teilen sich einen Satz pro Thread
+static struct compaction_buffers d_compaction[MAX_GPUS];
 
-__device__ uint32_t QuarkTrueTest(uint32_t *inpHash)
+// Setup-Funktionen
+__host__ void quark_compactTest_cpu_init(int thr_id, int threads)
 {
-	return ((inpHash[0] & 0x08) == 0x08);
+	compaction_alloc(&d_compaction[thr_id], threads);
 }
 
-__device__ uint32_t QuarkFalseTest(uint32_t *inpHash)
+__host__ void jackpot_compactTest_cpu_init(int thr_id, int threads)
 {
-	return ((inpHash[0] & 0x08) == 0);
+	compaction_alloc(&d_compaction[thr_id], threads);
 }
 
-__device__ cuda_compactTestFunction_t d_QuarkTrueFunction = QuarkTrueTest, d_QuarkFalseFunction = QuarkFalseTest;
-cuda_compactTestFunction_t h_QuarkTrueFunction[8], h_QuarkFalseFunction[8];
-
-// Setup-Funktionen
-__host__ void quark_compactTest_cpu_init(int thr_id, int threads)
+__host__ void quark_compactTest_cpu_free(int thr_id)
 {
-	cudaGetDeviceProperties(&props[thr_id], device_map[thr_id]);
-
-	cudaMemcpyFromSymbol(&h_QuarkTrueFunction[thr_id], d_QuarkTrueFunction, sizeof(cuda_compactTestFunction_t));
-	cudaMemcpyFromSymbol(&h_QuarkFalseFunction[thr_id], d_QuarkFalseFunction, sizeof(cuda_compactTestFunction_t));
-
-	// wir brauchen auch Speicherplatz auf dem Device
-	cudaMalloc(&d_tempBranch1Nonces[thr_id], sizeof(uint32_t) * threads * 2);	
-	cudaMalloc(&d_numValid[thr_id], 2*sizeof(uint32_t));
-	cudaMallocHost(&h_numValid[thr_id], 2*sizeof(uint32_t));
-
-	uint32_t s1;
-	s1 = (threads / 256) * 2;
-
-	cudaMalloc(&d_partSum[0][thr_id], sizeof(uint32_t) * s1); // BLOCKSIZE (Threads/Block)
-	cudaMalloc(&d_partSum[1][thr_id], sizeof(uint32_t) * s1); // BLOCKSIZE (Threads/Block)
+	compaction_free(&d_compaction[thr_id]);
 }
 
-// Die Summenfunktion (vom NVIDIA SDK)
-__global__ void quark_compactTest_gpu_SCAN(uint32_t *data, int width, uint32_t *partial_sums=NULL, cuda_compactTestFunction_t testFunc=NULL, int threads=0, uint32_t startNounce=0, uint32_t *inpHashes=NULL, uint32_t *d_validNonceTable=NULL)
+// Wenn validNonceTable genutzt wird, dann werden auch nur die Nonces betrachtet, die dort enthalten sind
+// "threads" ist in diesem Fall auf die Lnge dieses Array's zu setzen!
+__host__ void quark_compactTest_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *inpHashes, uint32_t *d_validNonceTable,
+											uint32_t *d_nonces1, size_t *nrm1,
+											uint32_t *d_nonces2, size_t *nrm2,
+											int order)
 {
-	extern __shared__ uint32_t sums[];
-	int id = ((blockIdx.x * blockDim.x) + threadIdx.x);
-	//int lane_id = id % warpSize;
-	int lane_id = id % width;
-	// determine a warp_id within a block
-	 //int warp_id = threadIdx.x / warpSize;
-	int warp_id = threadIdx.x / width;
-
-	sums[lane_id] = 0;
-
-	// Below is the basic structure of using a shfl instruction
-	// for a scan.
-	// Record "value" as a variable - we accumulate it along the way
-	uint32_t value;
-	if(testFunc != NULL)
-	{
-		if (id < threads)
-		{
-			uint32_t *inpHash;
-			if(d_validNonceTable == NULL)
-			{
-				// keine Nonce-Liste
-				inpHash = &inpHashes[id<<4];
-			}else
-			{
-				// Nonce-Liste verfgbar
-				int nonce = d_validNonceTable[id] - startNounce;
-				inpHash = &inpHashes[nonce<<4];
-			}			
-			value = (*testFunc)(inpHash);
-		}else
-		{
-			value = 0;
-		}
-	}else
-	{
-		value = data[id];
-	}
+	uint32_t n1, n2;
 
-	__syncthreads();
-
-	// Now accumulate in log steps up the chain
-	// compute sums, with another thread's value who is
-	// distance delta away (i).  Note
-	// those threads where the thread 'i' away would have
-	// been out of bounds of the warp are unaffected.  This
-	// creates the scan sum.
-#pragma unroll
-
-	for (int i=1; i<=width; i*=2)
-	{
-		uint32_t n = __shfl_up((int)value, i, width);
-
-		if (lane_id >= i) value += n;
-	}
-
-	// value now holds the scan value for the individual thread
-	// next sum the largest values for each warp
-
-	// write the sum of the warp to smem
-	//if (threadIdx.x % warpSize == warpSize-1)
-	if (threadIdx.x % width == width-1)
-	{
-		sums[warp_id] = value;
-	}
-
-	__syncthreads();
-
-	//
-	// scan sum the warp sums
-	// the same shfl scan operation, but performed on warp sums
-	//
-	if (warp_id == 0)
-	{
-		uint32_t warp_sum = sums[lane_id];
-
-		for (int i=1; i<=width; i*=2)
-		{
-			uint32_t n = __shfl_up((int)warp_sum, i, width);
-
-		if (lane_id >= i) warp_sum += n;
-		}
+	compaction_dual(&d_compaction[thr_id], gpustream[thr_id], compaction_test_quark(), threads, startNounce,
+		inpHashes, d_validNonceTable, d_nonces1, &n1, d_nonces2, &n2);
+	*nrm1 = (size_t)n1;
+	*nrm2 = (size_t)n2;
+}
 
-		sums[lane_id] = warp_sum;
-	}
+__host__ void quark_compactTest_single_false_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *inpHashes, uint32_t *d_validNonceTable,
+											uint32_t *d_nonces1, size_t *nrm1,
+											int order)
+{
+	*nrm1 = (size_t)compaction_single(&d_compaction[thr_id], gpustream[thr_id], compaction_not<compaction_test_quark>(),
+		threads, startNounce, inpHashes, d_validNonceTable, d_nonces1);
+}
 
-	__syncthreads();
+__host__ void jackpot_compactTest_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *inpHashes, uint32_t *d_validNonceTable,
+											uint32_t *d_nonces1, size_t *nrm1,
+											uint32_t *d_nonces2, size_t *nrm2,
+											int order)
+{
+	uint32_t n1, n2;
 
-	// perform a uniform add across warps in the block
-	// read neighbouring warp's sum and add it to threads value
-	uint32_t blockSum = 0;
+	compaction_dual(&d_compaction[thr_id], gpustream[thr_id], compaction_test_jackpot(), threads, startNounce,
+		inpHashes, d_validNonceTable, d_nonces1, &n1, d_nonces2, &n2);
+	*nrm1 = (size_t)n1;
+	*nrm2 = (size_t)n2;
+}
 
-	if (warp_id > 0)
-	{
-		blockSum = sums[warp_id-1];
-	}
+// --compaction-test: GPU Compaction gegen die Host-Referenz prfen und messen
 
-	value += blockSum;
+#define SELFTEST_MAX_THREADS (1024 * 1024)
 
-	// Now write out our result
-	data[id] = value;
+struct compaction_selftest_buffers {
+	uint32_t *h_hashes, *d_hashes;	// 16 Worte pro Index
+	uint32_t *h_table, *d_table;	// zufllige Nonce-Liste, auch mit Duplikaten
+	uint32_t *h_out[2], *d_out[2];
+	uint32_t *ref[2];
+};
 
-	// last thread has sum, write write out the block's sum
-	if (partial_sums != NULL && threadIdx.x == blockDim.x-1)
-	{
-		partial_sums[blockIdx.x] = value;
-	}
+static uint32_t compaction_selftest_rand(uint32_t *state)
+{
+	// xorshift32, reproduzierbar ber alle Lufe
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
 }
 
-// Uniform add: add partial sums array
-__global__ void quark_compactTest_gpu_ADD(uint32_t *data, uint32_t *partial_sums, int len)
+template <class Test>
+static bool compaction_selftest_case(struct compaction_buffers *buf, struct compaction_selftest_buffers *b,
+	const Test &test, int threads, uint32_t startNounce, bool table)
 {
-	__shared__ uint32_t buf;
-	int id = ((blockIdx.x * blockDim.x) + threadIdx.x);
-
-	if (id > len) return;
-
-	if (threadIdx.x == 0)
-	{
-		buf = partial_sums[blockIdx.x];
-	}
-
-	__syncthreads();
-	data[id] += buf;
+	const uint32_t *d_table = table ? b->d_table : NULL;
+	const uint32_t *h_table = table ? b->h_table : NULL;
+	uint32_t n1, n2, r1, r2;
+
+	compaction_dual(buf, NULL, test, threads, startNounce, b->d_hashes, d_table, b->d_out[0], &n1, b->d_out[1], &n2);
+	compaction_dual_ref(test, threads, startNounce, b->h_hashes, h_table, b->ref[0], &r1, b->ref[1], &r2);
+	if (n1 != r1 || n2 != r2)
+		return false;
+
+	cudaMemcpy(b->h_out[0], b->d_out[0], n1 * sizeof(uint32_t), cudaMemcpyDeviceToHost);
+	cudaMemcpy(b->h_out[1], b->d_out[1], n2 * sizeof(uint32_t), cudaMemcpyDeviceToHost);
+	if (memcmp(b->h_out[0], b->ref[0], n1 * sizeof(uint32_t)) || memcmp(b->h_out[1], b->ref[1], n2 * sizeof(uint32_t)))
+		return false;
+
+	// single mit umgekehrtem Test muss die false-Liste liefern
+	n2 = compaction_single(buf, NULL, compaction_not<Test>(), threads, startNounce, b->d_hashes, d_table, b->d_out[1]);
+	if (n2 != r2)
+		return false;
+	cudaMemcpy(b->h_out[1], b->d_out[1], n2 * sizeof(uint32_t), cudaMemcpyDeviceToHost);
+	return memcmp(b->h_out[1], b->ref[1], n2 * sizeof(uint32_t)) == 0;
 }
 
-// Der Scatter
-__global__ void quark_compactTest_gpu_SCATTER(uint32_t *sum, uint32_t *outp, cuda_compactTestFunction_t testFunc, int threads=0, uint32_t startNounce=0, uint32_t *inpHashes=NULL, uint32_t *d_validNonceTable=NULL)
+// Durchsatz der dualen Compaction in Mio. Nonces/s, GPU und Host-Referenz
+static void compaction_selftest_bench(struct compaction_buffers *buf, struct compaction_selftest_buffers *b,
+	int threads, uint32_t startNounce, bool table, double *gpu, double *host)
 {
-	int id = ((blockIdx.x * blockDim.x) + threadIdx.x);
-	uint32_t actNounce = id;
-	uint32_t value;
-	if (id < threads)
-	{
-//		uint32_t nounce = startNounce + id;
-		uint32_t *inpHash;
-		if(d_validNonceTable == NULL)
-		{
-			// keine Nonce-Liste
-			inpHash = &inpHashes[id<<4];
-		}else
-		{
-			// Nonce-Liste verfgbar
-			int nonce = d_validNonceTable[id] - startNounce;
-			actNounce = nonce;
-			inpHash = &inpHashes[nonce<<4];
-		}
+	const int loops = 20;
+	const uint32_t *d_table = table ? b->d_table : NULL;
+	const uint32_t *h_table = table ? b->h_table : NULL;
+	cudaEvent_t start, stop;
+	float ms = 0.0f;
+	uint32_t n1, n2;
+
+	cudaEventCreate(&start);
+	cudaEventCreate(&stop);
+	cudaEventRecord(start, NULL);
+	for (int i = 0; i < loops; i++)
+		compaction_dual(buf, NULL, compaction_test_quark(), threads, startNounce, b->d_hashes, d_table,
+			b->d_out[0], &n1, b->d_out[1], &n2);
+	cudaEventRecord(stop, NULL);
+	cudaEventSynchronize(stop);
+	cudaEventElapsedTime(&ms, start, stop);
+	cudaEventDestroy(start);
+	cudaEventDestroy(stop);
+	*gpu = (ms > 0.0f) ? (double)threads * loops / (ms * 1e3) : 0.0;
+
+	clock_t c = clock();
+	for (int i = 0; i < loops; i++)
+		compaction_dual_ref(compaction_test_quark(), threads, startNounce, b->h_hashes, h_table,
+			b->ref[0], &n1, b->ref[1], &n2);
+	c = clock() - c;
+	*host = (c > 0) ? (double)threads * loops / ((double)c / CLOCKS_PER_SEC * 1e6) : 0.0;
+}
 
-		value = (*testFunc)(inpHash);
-	}else
-	{
-		value = 0;
+extern "C" int compaction_selftest(int device)
+{
+	static const int sizes[] = {
+		1, 31, 32, 255, 256, 257, 1000, 4096, 65535, 65536, 65537, 300007, SELFTEST_MAX_THREADS
+	};
+	const int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+	const uint32_t startNounce = 0x10000000;
+	struct compaction_selftest_buffers b;
+	struct compaction_buffers buf;
+	uint32_t seed = 0x12345678;
+	bool ok = true;
+	int failed = 0;
+
+	memset(&b, 0, sizeof(b));
+	memset(&buf, 0, sizeof(buf));
+
+	if (cudaSetDevice(device) != cudaSuccess) {
+		fprintf(stderr, "compaction test: cannot select CUDA device %d\n", device);
+		return 1;
 	}
 
-	if( value )
-	{
-		int idx = sum[id];
-		if(idx > 0)
-			outp[idx-1] = startNounce + actNounce;
+	b.h_hashes = (uint32_t *)malloc(16 * sizeof(uint32_t) * SELFTEST_MAX_THREADS);
+	b.h_table = (uint32_t *)malloc(sizeof(uint32_t) * SELFTEST_MAX_THREADS);
+	for (int k = 0; k < 2; k++) {
+		b.h_out[k] = (uint32_t *)malloc(sizeof(uint32_t) * SELFTEST_MAX_THREADS);
+		b.ref[k] = (uint32_t *)malloc(sizeof(uint32_t) * SELFTEST_MAX_THREADS);
+		ok = ok && b.h_out[k] && b.ref[k];
+		ok = ok && cudaMalloc(&b.d_out[k], sizeof(uint32_t) * SELFTEST_MAX_THREADS) == cudaSuccess;
+	}
+	ok = ok && b.h_hashes && b.h_table;
+	ok = ok && cudaMalloc(&b.d_hashes, 16 * sizeof(uint32_t) * SELFTEST_MAX_THREADS) == cudaSuccess;
+	ok = ok && cudaMalloc(&b.d_table, sizeof(uint32_t) * SELFTEST_MAX_THREADS) == cudaSuccess;
+	ok = ok && compaction_alloc(&buf, SELFTEST_MAX_THREADS);
+	if (!ok) {
+		fprintf(stderr, "compaction test: out of memory\n");
+		failed = 1;
+		goto out;
 	}
-}
 
-__host__ static uint32_t quark_compactTest_roundUpExp(uint32_t val)
-{
-	if(val == 0)
-		return 0;
+	printf("Compaction test on CUDA device %d\n", device);
+	printf("%-8s %-6s %9s  %s\n", "test", "list", "nonces", "result");
+	for (int s = 0; s < nsizes; s++)
+	{
+		int threads = sizes[s];
 
-	uint32_t mask = 0x80000000;
-	while( (val & mask) == 0 ) mask = mask >> 1;
+		// Hashes fr alle Indizes, die Liste zeigt zufllig in denselben Bereich
+		for (int i = 0; i < 16 * threads; i++)
+			b.h_hashes[i] = compaction_selftest_rand(&seed);
+		for (int i = 0; i < threads; i++)
+			b.h_table[i] = startNounce + compaction_selftest_rand(&seed) % threads;
+		cudaMemcpy(b.d_hashes, b.h_hashes, 16 * sizeof(uint32_t) * threads, cudaMemcpyHostToDevice);
+		cudaMemcpy(b.d_table, b.h_table, sizeof(uint32_t) * threads, cudaMemcpyHostToDevice);
 
-	if( (val & (~mask)) != 0 )
-		return mask << 1;
+		for (int table = 0; table < 2; table++)
+		{
+			bool q = compaction_selftest_case(&buf, &b, compaction_test_quark(), threads, startNounce, table != 0);
+			bool j = compaction_selftest_case(&buf, &b, compaction_test_jackpot(), threads, startNounce, table != 0);
 
-	return mask;
-}
+			printf("%-8s %-6s %9d  %s\n", "quark", table ? "yes" : "no", threads, q ? "ok" : "FAILED");
+			printf("%-8s %-6s %9d  %s\n", "jackpot", table ? "yes" : "no", threads, j ? "ok" : "FAILED");
+			failed += !q + !j;
+		}
+	}
 
-__host__ void quark_compactTest_cpu_singleCompaction(int thr_id, int threads, uint32_t *nrm,
-														uint32_t *d_nonces1, cuda_compactTestFunction_t function,
-														uint32_t startNounce, uint32_t *inpHashes, uint32_t *d_validNonceTable)
-{
-	int orgThreads = threads;
-	threads = (int)quark_compactTest_roundUpExp((uint32_t)threads);
-	// threadsPerBlock ausrechnen
-	int blockSize = 256;
-	int nSummen = threads / blockSize;
-
-	int thr1 = (threads+blockSize-1) / blockSize;
-	int thr2 = threads / (blockSize*blockSize);
-	int blockSize2 = (nSummen < blockSize) ? nSummen : blockSize;
-	int thr3 = (nSummen + blockSize2-1) / blockSize2;
-
-	bool callThrid = (thr2 > 0) ? true : false;
-
-	// Erster Initialscan
-	quark_compactTest_gpu_SCAN<<<thr1,blockSize, 32*sizeof(uint32_t)>>>(
-		d_tempBranch1Nonces[thr_id], 32, d_partSum[0][thr_id], function, orgThreads, startNounce, inpHashes, d_validNonceTable);	
-
-	// weitere Scans
-	if(callThrid)
-	{		
-		quark_compactTest_gpu_SCAN<<<thr2,blockSize, 32*sizeof(uint32_t)>>>(d_partSum[0][thr_id], 32, d_partSum[1][thr_id]);
-		quark_compactTest_gpu_SCAN<<<1, thr2, 32*sizeof(uint32_t)>>>(d_partSum[1][thr_id], (thr2>32) ? 32 : thr2);
-	}else
+	for (int table = 0; table < 2; table++)
 	{
-		quark_compactTest_gpu_SCAN<<<thr3,blockSize2, 32*sizeof(uint32_t)>>>(d_partSum[0][thr_id], (blockSize2>32) ? 32 : blockSize2);
+		double gpu, host;
+		compaction_selftest_bench(&buf, &b, SELFTEST_MAX_THREADS, startNounce, table != 0, &gpu, &host);
+		printf("dual compaction, %d nonces, list %s: GPU %.1f Mnonce/s, host %.1f Mnonce/s\n",
+			SELFTEST_MAX_THREADS, table ? "yes" : "no", gpu, host);
 	}
 
-	// Sync + Anzahl merken
-	cudaStreamSynchronize(NULL);
-
-	if(callThrid)
-		cudaMemcpy(nrm, &(d_partSum[1][thr_id])[thr2-1], sizeof(uint32_t), cudaMemcpyDeviceToHost);
+	if (failed)
+		printf("%d compaction checks FAILED\n", failed);
 	else
-		cudaMemcpy(nrm, &(d_partSum[0][thr_id])[nSummen-1], sizeof(uint32_t), cudaMemcpyDeviceToHost);
-
-	
-	// Addieren
-	if(callThrid)
-	{
-		quark_compactTest_gpu_ADD<<<thr2-1, blockSize>>>(d_partSum[0][thr_id]+blockSize, d_partSum[1][thr_id], blockSize*thr2);
+		printf("all compaction checks passed\n");
+
+out:
+	compaction_free(&buf);
+	for (int k = 0; k < 2; k++) {
+		cudaFree(b.d_out[k]);
+		free(b.h_out[k]);
+		free(b.ref[k]);
 	}
-	quark_compactTest_gpu_ADD<<<thr1-1, blockSize>>>(d_tempBranch1Nonces[thr_id]+blockSize, d_partSum[0][thr_id], threads);
-	
-	// Scatter
-	quark_compactTest_gpu_SCATTER<<<thr1,blockSize,0>>>(d_tempBranch1Nonces[thr_id], d_nonces1, 
-		function, orgThreads, startNounce, inpHashes, d_validNonceTable);
-
-	// Sync
-	cudaStreamSynchronize(NULL);
-}
-
-////// ACHTUNG: Diese funktion geht aktuell nur mit threads > 65536 (Am besten 256 * 1024 oder 256*2048)
-__host__ void quark_compactTest_cpu_dualCompaction(int thr_id, int threads, uint32_t *nrm,
-													 uint32_t *d_nonces1, uint32_t *d_nonces2,
-													 uint32_t startNounce, uint32_t *inpHashes, uint32_t *d_validNonceTable)
-{
-	quark_compactTest_cpu_singleCompaction(thr_id, threads, &nrm[0], d_nonces1, h_QuarkTrueFunction[thr_id], startNounce, inpHashes, d_validNonceTable);
-	quark_compactTest_cpu_singleCompaction(thr_id, threads, &nrm[1], d_nonces2, h_QuarkFalseFunction[thr_id], startNounce, inpHashes, d_validNonceTable);
-
-	/*
-	// threadsPerBlock ausrechnen
-	int blockSize = 256;
-	int thr1 = threads / blockSize;
-	int thr2 = threads / (blockSize*blockSize);
-
-	// 1
-	quark_compactTest_gpu_SCAN<<<thr1,blockSize, 32*sizeof(uint32_t)>>>(d_tempBranch1Nonces[thr_id], 32, d_partSum1[thr_id], h_QuarkTrueFunction[thr_id], threads, startNounce, inpHashes);
-	quark_compactTest_gpu_SCAN<<<thr2,blockSize, 32*sizeof(uint32_t)>>>(d_partSum1[thr_id], 32, d_partSum2[thr_id]);
-	quark_compactTest_gpu_SCAN<<<1, thr2, 32*sizeof(uint32_t)>>>(d_partSum2[thr_id], (thr2>32) ? 32 : thr2);
-	cudaStreamSynchronize(NULL);
-	cudaMemcpy(&nrm[0], &(d_partSum2[thr_id])[thr2-1], sizeof(uint32_t), cudaMemcpyDeviceToHost);
-	quark_compactTest_gpu_ADD<<<thr2-1, blockSize>>>(d_partSum1[thr_id]+blockSize, d_partSum2[thr_id], blockSize*thr2);
-	quark_compactTest_gpu_ADD<<<thr1-1, blockSize>>>(d_tempBranch1Nonces[thr_id]+blockSize, d_partSum1[thr_id], threads);
-
-	// 2
-	quark_compactTest_gpu_SCAN<<<thr1,blockSize, 32*sizeof(uint32_t)>>>(d_tempBranch2Nonces[thr_id], 32, d_partSum1[thr_id], h_QuarkFalseFunction[thr_id], threads, startNounce, inpHashes);
-	quark_compactTest_gpu_SCAN<<<thr2,blockSize, 32*sizeof(uint32_t)>>>(d_partSum1[thr_id], 32, d_partSum2[thr_id]);
-	quark_compactTest_gpu_SCAN<<<1, thr2, 32*sizeof(uint32_t)>>>(d_partSum2[thr_id], (thr2>32) ? 32 : thr2);
-	cudaStreamSynchronize(NULL);
-	cudaMemcpy(&nrm[1], &(d_partSum2[thr_id])[thr2-1], sizeof(uint32_t), cudaMemcpyDeviceToHost);	
-	quark_compactTest_gpu_ADD<<<thr2-1, blockSize>>>(d_partSum1[thr_id]+blockSize, d_partSum2[thr_id], blockSize*thr2);
-	quark_compactTest_gpu_ADD<<<thr1-1, blockSize>>>(d_tempBranch2Nonces[thr_id]+blockSize, d_partSum1[thr_id], threads);
-	
-	// Hier ist noch eine Besonderheit: in d_tempBranch1Nonces sind die element von 1...nrm1 die Interessanten
-	// Schritt 3: Scatter
-	quark_compactTest_gpu_SCATTER<<<thr1,blockSize,0>>>(d_tempBranch1Nonces[thr_id], d_nonces1, h_QuarkTrueFunction[thr_id], threads, startNounce, inpHashes);
-	quark_compactTest_gpu_SCATTER<<<thr1,blockSize,0>>>(d_tempBranch2Nonces[thr_id], d_nonces2, h_QuarkFalseFunction[thr_id], threads, startNounce, inpHashes);
-	cudaStreamSynchronize(NULL);
-	*/
-}
-
-__host__ void quark_compactTest_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *inpHashes, uint32_t *d_validNonceTable,
-											uint32_t *d_nonces1, size_t *nrm1,
-											uint32_t *d_nonces2, size_t *nrm2,
-											int order)
-{
-	// Wenn validNonceTable genutzt wird, dann werden auch nur die Nonces betrachtet, die dort enthalten sind
-	// "threads" ist in diesem Fall auf die Lnge dieses Array's zu setzen!
-	
-	quark_compactTest_cpu_dualCompaction(thr_id, threads,
-		h_numValid[thr_id], d_nonces1, d_nonces2,
-		startNounce, inpHashes, d_validNonceTable);
-
-	cudaStreamSynchronize(NULL); // Das original braucht zwar etwas CPU-Last, ist an dieser Stelle aber evtl besser
-	*nrm1 = (size_t)h_numValid[thr_id][0];
-	*nrm2 = (size_t)h_numValid[thr_id][1];
-}
-
-__host__ void quark_compactTest_single_false_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *inpHashes, uint32_t *d_validNonceTable,
-											uint32_t *d_nonces1, size_t *nrm1,
-											int order)
-{
-	// Wenn validNonceTable genutzt wird, dann werden auch nur die Nonces betrachtet, die dort enthalten sind
-	// "threads" ist in diesem Fall auf die Lnge dieses Array's zu setzen!
-
-	quark_compactTest_cpu_singleCompaction(thr_id, threads, h_numValid[thr_id], d_nonces1, h_QuarkFalseFunction[thr_id], startNounce, inpHashes, d_validNonceTable);
-
-	cudaStreamSynchronize(NULL); // Das original braucht zwar etwas CPU-Last, ist an dieser Stelle aber evtl besser
-	*nrm1 = (size_t)h_numValid[thr_id][0];
+	cudaFree(b.d_hashes);
+	cudaFree(b.d_table);
+	free(b.h_hashes);
+	free(b.h_table);
+	return failed ? 1 : 0;
 }
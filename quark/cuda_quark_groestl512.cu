@@ -7,11 +7,14 @@
 #include <stdio.h>
 #include <memory.h>
 
+#include "device.h"
+
 // aus cpu-miner.c
-extern int device_map[8];
+extern int device_map[MAX_GPUS];
 
 // aus heavy.cu
 extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
+extern cudaStream_t gpustream[MAX_GPUS];
 
 // Folgende Definitionen spter durch header ersetzen
 typedef unsigned char uint8_t;
@@ -19,7 +22,7 @@ typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
 
 // diese Struktur wird in der Init Funktion angefordert
-static cudaDeviceProp props[8];
+static cudaDeviceProp props[MAX_GPUS];
 
 // 64 Register Variante fr Compute 3.0
 #include "groestl_functions_quad.cu"
@@ -145,10 +148,10 @@ __host__ void quark_groestl512_cpu_hash_64(int thr_id, int threads, uint32_t sta
     // Gre des dynamischen Shared Memory Bereichs
     size_t shared_size = 0;
 
-    quark_groestl512_gpu_hash_64_quad<<<grid, block, shared_size>>>(threads, startNounce, d_hash, d_nonceVector);
+    quark_groestl512_gpu_hash_64_quad<<<grid, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, d_hash, d_nonceVector);
 
     // Strategisches Sleep Kommando zur Senkung der CPU Last
-    MyStreamSynchronize(NULL, order, thr_id);
+    MyStreamSynchronize(gpustream[thr_id], order, thr_id);
 }
 
 __host__ void quark_doublegroestl512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order)
@@ -166,8 +169,8 @@ __host__ void quark_doublegroestl512_cpu_hash_64(int thr_id, int threads, uint32
     // Gre des dynamischen Shared Memory Bereichs
     size_t shared_size = 0;
 
-    quark_doublegroestl512_gpu_hash_64_quad<<<grid, block, shared_size>>>(threads, startNounce, d_hash, d_nonceVector);
+    quark_doublegroestl512_gpu_hash_64_quad<<<grid, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, d_hash, d_nonceVector);
 
     // Strategisches Sleep Kommando zur Senkung der CPU Last
-    MyStreamSynchronize(NULL, order, thr_id);
+    MyStreamSynchronize(gpustream[thr_id], order, thr_id);
 }
@@ -10,8 +10,11 @@ typedef unsigned char uint8_t;
 typedef unsigned int uint32_t;
 typedef unsigned long long uint64_t;
 
+#include "device.h"
+
 // aus heavy.cu
 extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
+extern cudaStream_t gpustream[MAX_GPUS];
 
 #include "cuda_helper.h"
 
@@ -175,6 +178,6 @@ __host__ void quark_keccak512_cpu_hash_64(int thr_id, int threads, uint32_t star
     // Gre des dynamischen Shared Memory Bereichs
     size_t shared_size = 0;
 
-    quark_keccak512_gpu_hash_64<<<grid, block, shared_size>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector);
-    MyStreamSynchronize(NULL, order, thr_id);
+    quark_keccak512_gpu_hash_64<<<grid, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector);
+    MyStreamSynchronize(gpustream[thr_id], order, thr_id);
 }
@@ -5,6 +5,8 @@
 #include <stdio.h>
 #include <memory.h>
 
+#include "device.h"
+
 // Folgende Definitionen spter durch header ersetzen
 typedef unsigned char uint8_t;
 typedef unsigned int uint32_t;
@@ -13,9 +15,10 @@ typedef unsigned long long uint64_t;
 #define SPH_C64(x)    ((uint64_t)(x ## ULL))
 
 // aus cpu-miner.c
-extern "C" extern int device_map[8];
+extern "C" extern int device_map[MAX_GPUS];
 // aus heavy.cu
 extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
+extern cudaStream_t gpustream[MAX_GPUS];
 
 // Take a look at: https://www.schneier.com/skein1.3.pdf
 
@@ -442,8 +445,8 @@ __host__ void quark_skein512_cpu_hash_64(int thr_id, int threads, uint32_t start
 	// Gre des dynamischen Shared Memory Bereichs
 	size_t shared_size = 0;
 
-	quark_skein512_gpu_hash_64<<<grid, block, shared_size>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector);
+	quark_skein512_gpu_hash_64<<<grid, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector);
 
 	// Strategisches Sleep Kommando zur Senkung der CPU Last
-	MyStreamSynchronize(NULL, order, thr_id);
+	MyStreamSynchronize(gpustream[thr_id], order, thr_id);
 }
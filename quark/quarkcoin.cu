@@ -12,54 +12,11 @@ extern "C"
 
 #include <stdint.h>
 
-// aus cpu-miner.c
-extern int device_map[8];
-
-// Speicher fr Input/Output der verketteten Hashfunktionen
-static uint32_t *d_hash[8];
-
-// Speicher zur Generierung der Noncevektoren fr die bedingten Hashes
-static uint32_t *d_quarkNonces[8];
-static uint32_t *d_branch1Nonces[8];
-static uint32_t *d_branch2Nonces[8];
-static uint32_t *d_branch3Nonces[8];
-
-extern void quark_blake512_cpu_init(int thr_id, int threads);
-extern void quark_blake512_cpu_setBlock_80(void *pdata);
-extern void quark_blake512_cpu_hash_80(int thr_id, int threads, uint32_t startNounce, uint32_t *d_hash, int order);
-extern void quark_blake512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_bmw512_cpu_init(int thr_id, int threads);
-extern void quark_bmw512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_groestl512_cpu_init(int thr_id, int threads);
-extern void quark_groestl512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-extern void quark_doublegroestl512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_skein512_cpu_init(int thr_id, int threads);
-extern void quark_skein512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_keccak512_cpu_init(int thr_id, int threads);
-extern void quark_keccak512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_jh512_cpu_init(int thr_id, int threads);
-extern void quark_jh512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_check_cpu_init(int thr_id, int threads);
-extern void quark_check_cpu_setTarget(const void *ptarget);
-extern uint32_t quark_check_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_inputHash, int order);
-
-extern void quark_compactTest_cpu_init(int thr_id, int threads);
-extern void quark_compactTest_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *inpHashes, uint32_t *d_validNonceTable,
-											uint32_t *d_nonces1, size_t *nrm1,
-											uint32_t *d_nonces2, size_t *nrm2,
-											int order);
-extern void quark_compactTest_single_false_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *inpHashes, uint32_t *d_validNonceTable,
-											uint32_t *d_nonces1, size_t *nrm1,
-											int order);
+#include "device_backend.h"
+#include "thermal.h"
 
 // Original Quarkhash Funktion aus einem miner Quelltext
-inline void quarkhash(void *state, const void *input)
+extern "C" void quarkhash(void *state, const void *input)
 {
     sph_blake512_context ctx_blake;
     sph_bmw512_context ctx_bmw;
@@ -151,123 +108,147 @@ inline void quarkhash(void *state, const void *input)
 
 extern bool opt_benchmark;
 
-extern "C" int scanhash_quark(int thr_id, uint32_t *pdata,
+extern "C" int scanhash_quark(struct device_ctx *ctx, uint32_t *pdata,
     const uint32_t *ptarget, uint32_t max_nonce,
     unsigned long *hashes_done)
 {
+	const int thr_id = ctx->thr_id;
+	const struct device_backend *dev = ctx->backend;
 	const uint32_t first_nonce = pdata[19];
+	int found = 0;
 
 	if (opt_benchmark)
 		((uint32_t*)ptarget)[7] = 0x0000ff;
 
-	const uint32_t Htarg = ptarget[7];
+	const int throughput = device_throughput(ctx, 256*4096); // 100;
 
-	const int throughput = 256*4096; // 100;
-
-	static bool init[8] = {0,0,0,0,0,0,0,0};
-	if (!init[thr_id])
+	if (!ctx->init)
 	{
-		cudaSetDevice(device_map[thr_id]);
-
-		// Konstanten kopieren, Speicher belegen
-		cudaMalloc(&d_hash[thr_id], 16 * sizeof(uint32_t) * throughput);
-		quark_blake512_cpu_init(thr_id, throughput);
-		quark_groestl512_cpu_init(thr_id, throughput);
-		quark_skein512_cpu_init(thr_id, throughput);
-		quark_bmw512_cpu_init(thr_id, throughput);
-		quark_keccak512_cpu_init(thr_id, throughput);
-		quark_jh512_cpu_init(thr_id, throughput);
-		quark_check_cpu_init(thr_id, throughput);
-		quark_compactTest_cpu_init(thr_id, throughput);
-		cudaMalloc(&d_quarkNonces[thr_id], sizeof(uint32_t)*throughput);
-		cudaMalloc(&d_branch1Nonces[thr_id], sizeof(uint32_t)*throughput);
-		cudaMalloc(&d_branch2Nonces[thr_id], sizeof(uint32_t)*throughput);
-		cudaMalloc(&d_branch3Nonces[thr_id], sizeof(uint32_t)*throughput);
-		init[thr_id] = true;
+		static const enum hash_stage stages[] = {
+			STAGE_BLAKE512_80, STAGE_BLAKE512, STAGE_BMW512, STAGE_GROESTL512,
+			STAGE_SKEIN512, STAGE_JH512, STAGE_KECCAK512, STAGE_CHECK,
+			STAGE_COMPACT_QUARK
+		};
+
+		const size_t hashBytes = 16 * sizeof(uint32_t) * throughput;
+		const size_t nonceBytes = sizeof(uint32_t) * throughput;
+
+		// Konstanten kopieren, Speicher einmal im Arena-Block belegen
+		if (!dev->init(ctx, throughput, stages, sizeof(stages) / sizeof(stages[0])) ||
+			!device_arena_reserve(ctx, DEVICE_SLOTS * device_arena_size(hashBytes) + 4 * device_arena_size(nonceBytes), 0))
+			return 0;
+		for (int slot = 0; slot < DEVICE_SLOTS; slot++)
+			ctx->d_hash[slot] = (uint32_t *)device_arena_alloc(ctx, ARENA_DEVICE, hashBytes);
+		for (int i = 0; i < 4; i++)
+			ctx->d_nonces[i] = (uint32_t *)device_arena_alloc(ctx, ARENA_DEVICE, nonceBytes);
+		ctx->throughput = throughput;
+		ctx->init = true;
 	}
 
+	// die Nonce-Listen teilen sich die Slots, deren Batches laufen auf der GPU nacheinander
+	uint32_t *d_branch1Nonces = ctx->d_nonces[1];
+	uint32_t *d_branch2Nonces = ctx->d_nonces[2];
+	uint32_t *d_branch3Nonces = ctx->d_nonces[3];
+
 	uint32_t endiandata[20];
 	for (int k=0; k < 20; k++)
 		be32enc(&endiandata[k], ((uint32_t*)pdata)[k]);
 
-	quark_blake512_cpu_setBlock_80((void*)endiandata);
-	quark_check_cpu_setTarget(ptarget);
+	dev->set_block(ctx, STAGE_BLAKE512_80, endiandata, 80);
+	dev->set_target(ctx, ptarget);
+
+	// Doppelpuffer: Batch N+1 wird eingereiht, waehrend Batch N noch rechnet
+	// und sein Ergebnis asynchron zurueckkommt
+	int slot = 0, pending = -1;
+	uint32_t nonces[DEVICE_CANDIDATES];
 
 	do {
 		int order = 0;
+		uint32_t *d_hash = ctx->d_hash[slot];
 		size_t nrm1=0, nrm2=0, nrm3=0;
 
+		// gedrosselt ohne Batch in der Pipeline pausieren, wie in x11.cu
+		if (pending >= 0 && thermal_throttling(ctx))
+		{
+			int count = dev->check_wait(ctx, pending, nonces);
+			found += submit_candidates(ctx, nonces, count);
+			pending = -1;
+		}
+
+		dev->select(ctx, slot);
+
 		// erstes Blake512 Hash mit CUDA
-		quark_blake512_cpu_hash_80(thr_id, throughput, pdata[19], d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_BLAKE512_80, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr BMW512
-		quark_bmw512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_BMW512, throughput, pdata[19], NULL, d_hash, order++);
 
-		quark_compactTest_single_false_cpu_hash_64(thr_id, throughput, pdata[19], d_hash[thr_id], NULL,
-				d_branch3Nonces[thr_id], &nrm3,
+		dev->compact(ctx, BRANCH_QUARK, throughput, pdata[19], d_hash, NULL,
+				NULL, NULL,
+				d_branch3Nonces, &nrm3,
 				order++);
 		
 		// nur den Skein Branch weiterverfolgen
-		quark_skein512_cpu_hash_64(thr_id, nrm3, pdata[19], d_branch3Nonces[thr_id], d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_SKEIN512, nrm3, pdata[19], d_branch3Nonces, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Groestl512
-		quark_groestl512_cpu_hash_64(thr_id, nrm3, pdata[19], d_branch3Nonces[thr_id], d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_GROESTL512, nrm3, pdata[19], d_branch3Nonces, d_hash, order++);
 
 		// das ist der unbedingte Branch fr JH512
-		quark_jh512_cpu_hash_64(thr_id, nrm3, pdata[19], d_branch3Nonces[thr_id], d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_JH512, nrm3, pdata[19], d_branch3Nonces, d_hash, order++);
 
 		// quarkNonces in branch1 und branch2 aufsplitten gemss if (hash[0] & 0x8)
-		quark_compactTest_cpu_hash_64(thr_id, nrm3, pdata[19], d_hash[thr_id], d_branch3Nonces[thr_id],
-			d_branch1Nonces[thr_id], &nrm1,
-			d_branch2Nonces[thr_id], &nrm2,
+		dev->compact(ctx, BRANCH_QUARK, nrm3, pdata[19], d_hash, d_branch3Nonces,
+			d_branch1Nonces, &nrm1,
+			d_branch2Nonces, &nrm2,
 			order++);
 
 		// das ist der bedingte Branch fr Blake512
-		quark_blake512_cpu_hash_64(thr_id, nrm1, pdata[19], d_branch1Nonces[thr_id], d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_BLAKE512, nrm1, pdata[19], d_branch1Nonces, d_hash, order++);
 
 		// das ist der bedingte Branch fr Bmw512
-		quark_bmw512_cpu_hash_64(thr_id, nrm2, pdata[19], d_branch2Nonces[thr_id], d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_BMW512, nrm2, pdata[19], d_branch2Nonces, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Keccak512
-		quark_keccak512_cpu_hash_64(thr_id, nrm3, pdata[19], d_branch3Nonces[thr_id], d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_KECCAK512, nrm3, pdata[19], d_branch3Nonces, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Skein512
-		quark_skein512_cpu_hash_64(thr_id, nrm3, pdata[19], d_branch3Nonces[thr_id], d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_SKEIN512, nrm3, pdata[19], d_branch3Nonces, d_hash, order++);
 
 		// quarkNonces in branch1 und branch2 aufsplitten gemss if (hash[0] & 0x8)
-		quark_compactTest_cpu_hash_64(thr_id, nrm3, pdata[19], d_hash[thr_id], d_branch3Nonces[thr_id],
-			d_branch1Nonces[thr_id], &nrm1,
-			d_branch2Nonces[thr_id], &nrm2,
+		dev->compact(ctx, BRANCH_QUARK, nrm3, pdata[19], d_hash, d_branch3Nonces,
+			d_branch1Nonces, &nrm1,
+			d_branch2Nonces, &nrm2,
 			order++);
 
 		// das ist der bedingte Branch fr Keccak512
-		quark_keccak512_cpu_hash_64(thr_id, nrm1, pdata[19], d_branch1Nonces[thr_id], d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_KECCAK512, nrm1, pdata[19], d_branch1Nonces, d_hash, order++);
 
 		// das ist der bedingte Branch fr JH512
-		quark_jh512_cpu_hash_64(thr_id, nrm2, pdata[19], d_branch2Nonces[thr_id], d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_JH512, nrm2, pdata[19], d_branch2Nonces, d_hash, order++);
 
-		// Scan nach Gewinner Hashes auf der GPU
-		uint32_t foundNonce = quark_check_cpu_hash_64(thr_id, nrm3, pdata[19], d_branch3Nonces[thr_id], d_hash[thr_id], order++);
-		if  (foundNonce != 0xffffffff)
+		// Scan nach Gewinner Hashes auf der GPU, Readback ohne Sync
+		dev->check_async(ctx, slot, nrm3, pdata[19], d_branch3Nonces, d_hash, order++);
+
+		// Ergebnis des vorigen Batches abholen, der aktuelle laeuft dabei weiter
+		if (pending >= 0)
 		{
-			uint32_t vhash64[8];
-			be32enc(&endiandata[19], foundNonce);
-			quarkhash(vhash64, endiandata);
-
-			if ((vhash64[7]<=Htarg) && fulltest(vhash64, ptarget)) {
-
-				pdata[19] = foundNonce;
-				*hashes_done = (foundNonce - first_nonce + 1)/2;
-				return 1;
-			} else {
-				applog(LOG_INFO, "GPU #%d: result for nonce $%08X does not validate on CPU!", thr_id, foundNonce);
-			}
+			// Verifikation und Submit laufen asynchron im CPU Verify-Pool
+			int count = dev->check_wait(ctx, pending, nonces);
+			found += submit_candidates(ctx, nonces, count);
 		}
+		pending = slot;
+		slot = (slot + 1) % DEVICE_SLOTS;
 
 		pdata[19] += throughput;
 
 	} while (pdata[19] < max_nonce && !work_restart[thr_id].restart);
 
+	// letzten Batch abholen, danach wieder synchron auf dem Default-Stream
+	int count = dev->check_wait(ctx, pending, nonces);
+	found += submit_candidates(ctx, nonces, count);
+	dev->select(ctx, -1);
+
 	*hashes_done = (pdata[19] - first_nonce + 1)/2;
-	return 0;
+	return found;
 }
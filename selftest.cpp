@@ -0,0 +1,244 @@
+//
+// Selbsttest (--selftest)
+//
+// Bekannte Antworten: der CPU Hash jedes Algorithmus aus algo_table und
+// sha256d ueber vier feste Header, verglichen mit aufgezeichneten
+// Digests. Header 3 ist der Genesis-Block von Dash, dessen X11 Hash
+// oeffentlich bekannt ist, die uebrigen Digests wurden mit den CPU
+// Referenzfunktionen dieses Stands aufgezeichnet. Wer an sph oder einer Kette etwas
+// aendert und hier einen Fehler sieht, hat das Ergebnis veraendert.
+//
+// Differentiell: die Batch-Pfade aus cpu_batch.cpp (maskiert und mit
+// Compaction) rechnen auf zufaelligen Headern dieselben Nonces wie der
+// einfache CPU Hash. Der Seed steht im Log, mit --selftest-seed laesst sich
+// ein Fehler wiederholen.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "miner.h"
+#include "algos.h"
+#include "cpu_batch.h"
+#include "selftest.h"
+
+// zufaellige Header pro Batch-Pfad und Nonces pro Header
+#define SELFTEST_ROUNDS 16
+#define SELFTEST_BATCH 64
+#define SELFTEST_HEADERS 4
+// laengster Header, heavy hasht 84 Byte
+#define SELFTEST_HEADER_LEN 84
+
+unsigned int opt_selftest_seed = 0;
+
+// Algorithmus, Header, Digest wie ihn der CPU Hash in den Speicher schreibt
+static const struct {
+	const char *algo;
+	int header;
+	const char *digest;
+} selftest_vectors[] = {
+	{ "heavy", 0, "f2668b99b08850fd27ffe6d280ef552fce3ec364c3193bcbeb81e9a0e9cf9926" },
+	{ "heavy", 1, "b47dcf948e77a9de5e95ff4b457deb78596f49dceaca1a326cc0c35be6969f32" },
+	{ "heavy", 2, "a95d2620bc71528fd880dafa310f12f45bbf864ee61f9fce4ce5910cda81605b" },
+	{ "heavy", 3, "d021226e8b4d6ef7c175d210a3b1cc586539cf78110bbbdcbb49c1dfcdfecce1" },
+	{ "mjollnir", 0, "bb3d93e2e445c531b9c31e2795bfb6329edbbd3024312422ad7e717196772ee0" },
+	{ "mjollnir", 1, "96d60aa0eb89ec54c6b8e9b11a7309530375b07f5b2c1c6d7b50c7cd3a3701b3" },
+	{ "mjollnir", 2, "c065c5c7f20551e65283fff7c7ab25e1835196759d3e06557ec3120ab5ee8a00" },
+	{ "mjollnir", 3, "11846c3ec8a018849e87bcab93c3d90e620ea3caac93852b662de8a60aa6824d" },
+	{ "fugue256", 0, "2dafcedba13fc43f9f386338c8d05eb2cd821724f7137a197c98ceea9e2e6150" },
+	{ "fugue256", 1, "f5804f35a88c6050ac6acb717a1743d0c87f124250773b6e5c72b0b76d5c2a23" },
+	{ "fugue256", 2, "f82a5b6b344fd02bd6395b326c9dbf70e9dfb763738ba9f7b1d19d3d73b1d71d" },
+	{ "fugue256", 3, "f4da241c91cece9037218f401d672c6a631bd074a86fb279da54910df1ecf7c8" },
+	{ "groestl", 0, "8703946c1f2630a61cc8e78f93a030b3835a6b624812fb990a243cae6dd8ce36" },
+	{ "groestl", 1, "e0682d8b796dbe7e8228dc952af823463a8f305b7c9f57150d4e8a5adde28b94" },
+	{ "groestl", 2, "e273974c11312120ced9b3f366ac07f991fc79c87325309de3a28926c48e9165" },
+	{ "groestl", 3, "335e5b38303e0bab796eda171db4032ffe588f5a87e322add7bad48cf8cc227c" },
+	{ "myr-gr", 0, "b060aa776bc2fc23fd991ada252aba20a42a3595fd335278664e875cf8e540cf" },
+	{ "myr-gr", 1, "cd666945c0dff339de817cac6924a8e458e73cb229a5b36cffa19ced066d4586" },
+	{ "myr-gr", 2, "f28596c452bcec2325350f94e909ef885404430394681803ac167499fd717416" },
+	{ "myr-gr", 3, "a00b9fe298b99338b7d6aecce8f830e4cee342094534c410fcb64df313c190db" },
+	{ "jackpot", 0, "4ab7d01fe293d0a47647910b151b5f7eb492be6c27f8f300bdf769e45a34d4ad" },
+	{ "jackpot", 1, "13c605fe1fd0f5836c9a4860d12220e02dfa64555682c671e26e6de706a9423d" },
+	{ "jackpot", 2, "1df9b366aaea1fc19159867b6ef96bccd49e797ed4854a141eb1f26c6d93e52b" },
+	{ "jackpot", 3, "75baef847787af007bc9eed9adc4c3df233b1893414ac847ea3d951bd999ec57" },
+	{ "quark", 0, "633d8255a00e3a1ae1ee58d7d3a56387fb85f1068a6bb4ebf5a20315e57f0602" },
+	{ "quark", 1, "eb1f9eb0aabc4ff20188afcdb9f6b8076fc66ad616c3d34773180a3a3a0c529c" },
+	{ "quark", 2, "ae69759081f8ffa2913284f985c25eab7af8aaa39670419b03ac68afb3c75ece" },
+	{ "quark", 3, "c608e6eefa3b298cfa864de5f71e0dc40d2ae8009d95b9c0a3d889c2a1d21a2b" },
+	{ "anime", 0, "88afe0157aacba2c1d57842b6ba4a007ef83fecb5d76eb67a34a91a64743f74a" },
+	{ "anime", 1, "502f34177bdda01b081920f253a7eb694550c7a764df007f9d69bc6fc74436f0" },
+	{ "anime", 2, "17263b57e6e2bb93b78027c88b8cc02d5296c278c7dc9f8a6d3b1d55a7824a21" },
+	{ "anime", 3, "7a67583a977888ffeb9851700066b2feef3627c91403be493d10eab3eef46d7f" },
+	{ "nist5", 0, "f793aee4ec7c83ad3fb06661fc514201ea8865a222eb7cc550fb0fcb7644435d" },
+	{ "nist5", 1, "d23ffd56e5fc6d43f62c5811138ed2064d645bbe6e6082e23eb0bd6a19da2b2c" },
+	{ "nist5", 2, "613f61e8346b89ae0429f1d49108b588f3ad050de7f0ad13589bf75840e6e3d3" },
+	{ "nist5", 3, "400c8d0a16d2cdd25e0597c7c9a479d3d72158871face7dd18cf6d1b270a3f23" },
+	{ "x11", 0, "8328846180965bce56f61e015db62af562a611d85e5e721d854c8d97e47a3ea3" },
+	{ "x11", 1, "10010e7429f657a5c57a603398149ef22791c3c11c5aa8b0a93203ba22e3f170" },
+	{ "x11", 2, "412e767aa9a39ee210ea9ce424de4ff5ee35e61a8c27506bc2365ff7d4e3ecce" },
+	{ "x11", 3, "b67a40f3cd5804437a108f105533739c37e6229bc1adcab385140b59fd0f0000" },
+	{ "x13", 0, "8196fc09df2b001113d4ef910a8b0919fbc7bab8df2a58e1bfe6be6eeb6546c0" },
+	{ "x13", 1, "5dcc6fa527bc716a77c39e6d873abdec5943c7448721fef8bc0fe9882a50b954" },
+	{ "x13", 2, "44e39c878aa74badd072b531b2fdf181051431053f486fc36435b347e3986dac" },
+	{ "x13", 3, "bd7b68f858fceb974434d3147b27a05c4a4b8fad4cf1683c624acb3aff467564" },
+	{ "dmd-gr", 0, "8703946c1f2630a61cc8e78f93a030b3835a6b624812fb990a243cae6dd8ce36" },
+	{ "dmd-gr", 1, "e0682d8b796dbe7e8228dc952af823463a8f305b7c9f57150d4e8a5adde28b94" },
+	{ "dmd-gr", 2, "e273974c11312120ced9b3f366ac07f991fc79c87325309de3a28926c48e9165" },
+	{ "dmd-gr", 3, "335e5b38303e0bab796eda171db4032ffe588f5a87e322add7bad48cf8cc227c" },
+	{ "sha256d", 0, "4be7570e8f70eb093640c8468274ba759745a7aa2b7d25ab1e0421b259845014" },
+	{ "sha256d", 1, "fac2edaf510e93e097b8526a8a014201cf96ead9a0fced1a92591e6edcaa8e5c" },
+	{ "sha256d", 2, "852c98044fb00507122ff63bda7b529566348fc204f72b00dff1afd7b40501e4" },
+	{ "sha256d", 3, "a4b09ec60478ce10b2bda154b349e5222e3b9a5fa8fdd9700fdd6eb044c49f08" },
+};
+
+#define SELFTEST_VECTORS (int)(sizeof(selftest_vectors) / sizeof(selftest_vectors[0]))
+
+typedef bool (*cpu_batch_fn)(const uint32_t *endiandata, uint32_t startNounce, int count,
+	uint32_t *outputHashes, bool compact, struct cpu_batch_stats *stats);
+
+static const struct {
+	const char *algo;
+	cpu_batch_fn batch;
+} selftest_batch[] = {
+	{ "quark", quark_cpu_batch_hash },
+	{ "anime", anime_cpu_batch_hash },
+	{ "jackpot", jackpot_cpu_batch_hash },
+};
+
+#define SELFTEST_PATHS (int)(sizeof(selftest_batch) / sizeof(selftest_batch[0]))
+
+// 0: Nullen, 1: die 0x55 der Benchmark-Arbeit, 2: 0, 1, 2, ...,
+// 3: Dash Genesis (Version 1, Zeit 1390095618, Bits 1e0ffff0, Nonce 28917698)
+static void selftest_header(int k, unsigned char *hdr)
+{
+	static const char *dash_merkle = "e0028eb9648db56b1ac77cf090b99048a8007e2bb64b68f092c03c7f56a662c7";
+	unsigned char merkle[32];
+
+	memset(hdr, 0, SELFTEST_HEADER_LEN);
+	switch (k) {
+	case 1:
+		memset(hdr, 0x55, 76);
+		break;
+	case 2:
+		for (int i = 0; i < SELFTEST_HEADER_LEN; i++)
+			hdr[i] = (unsigned char)i;
+		break;
+	case 3:
+		le32enc(hdr, 1);
+		hex2bin(merkle, dash_merkle, 32);
+		for (int i = 0; i < 32; i++)
+			hdr[36 + i] = merkle[31 - i];
+		le32enc(hdr + 68, 1390095618);
+		le32enc(hdr + 72, 0x1e0ffff0);
+		le32enc(hdr + 76, 28917698);
+		break;
+	}
+}
+
+static int selftest_known_answers(void)
+{
+	unsigned char hdr[SELFTEST_HEADERS][SELFTEST_HEADER_LEN];
+	int failures = 0;
+
+	for (int k = 0; k < SELFTEST_HEADERS; k++)
+		selftest_header(k, hdr[k]);
+
+	for (int i = 0; i < SELFTEST_VECTORS; i++)
+	{
+		const char *name = selftest_vectors[i].algo;
+		unsigned char expect[32], hash[64];
+		sha256_algos algo = algo_by_name(name);
+
+		memset(hash, 0, sizeof(hash));
+		if (!strcmp(name, "sha256d"))
+			sha256d(hash, hdr[selftest_vectors[i].header], 80);
+		else if (algo < ALGO_COUNT)
+			algo_table[algo].hash(hash, hdr[selftest_vectors[i].header]);
+		else {
+			applog(LOG_ERR, "selftest: no hash '%s'", name);
+			failures++;
+			continue;
+		}
+
+		hex2bin(expect, selftest_vectors[i].digest, 32);
+		if (memcmp(hash, expect, 32)) {
+			char *got = bin2hex(hash, 32);
+
+			applog(LOG_ERR, "selftest: %s header %d: %s, expected %s", name,
+				selftest_vectors[i].header, got ? got : "", selftest_vectors[i].digest);
+			free(got);
+			failures++;
+		}
+	}
+	return failures;
+}
+
+static uint32_t selftest_random(uint32_t *state)
+{
+	// xorshift32, reicht fuer Testdaten
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static int selftest_differential(uint32_t seed)
+{
+	static uint32_t masked[16 * SELFTEST_BATCH], compacted[16 * SELFTEST_BATCH];
+	uint32_t state = seed ? seed : 1;
+	int failures = 0;
+
+	for (int p = 0; p < SELFTEST_PATHS; p++)
+	{
+		const struct algo_traits *algo = &algo_table[algo_by_name(selftest_batch[p].algo)];
+
+		for (int r = 0; r < SELFTEST_ROUNDS; r++)
+		{
+			struct cpu_batch_stats stats = { 0, 0 };
+			uint32_t data[20], start;
+
+			for (int k = 0; k < 20; k++)
+				data[k] = selftest_random(&state);
+			start = selftest_random(&state);
+			if (!selftest_batch[p].batch(data, start, SELFTEST_BATCH, masked, false, &stats) ||
+				!selftest_batch[p].batch(data, start, SELFTEST_BATCH, compacted, true, &stats)) {
+				applog(LOG_ERR, "selftest: %s batch out of memory", algo->name);
+				return failures + 1;
+			}
+
+			for (int i = 0; i < SELFTEST_BATCH; i++)
+			{
+				uint32_t hash[16];
+
+				// wie im Batch: Nonce big endian im letzten Wort
+				be32enc(&data[19], start + i);
+				algo->hash(hash, data);
+				if (memcmp(hash, &masked[16 * i], 32) || memcmp(hash, &compacted[16 * i], 32)) {
+					applog(LOG_ERR, "selftest: %s batch differs from the CPU hash at nonce %08x (%s)",
+						algo->name, start + i, memcmp(hash, &masked[16 * i], 32) ? "masked" : "compacted");
+					failures++;
+					break;
+				}
+			}
+		}
+	}
+	return failures;
+}
+
+extern "C" int selftest_run(void)
+{
+	uint32_t seed = opt_selftest_seed ? opt_selftest_seed : (uint32_t)time(NULL);
+	int known, diff;
+
+	known = selftest_known_answers();
+	diff = selftest_differential(seed);
+	if (known || diff)
+		applog(LOG_ERR, "selftest: %d of %d known answers and %d of %d batch runs failed (seed %u)",
+			known, SELFTEST_VECTORS, diff, SELFTEST_PATHS * SELFTEST_ROUNDS, seed);
+	else
+		applog(LOG_NOTICE, "selftest: %d known answers and %d batch runs passed (seed %u)",
+			SELFTEST_VECTORS, SELFTEST_PATHS * SELFTEST_ROUNDS, seed);
+	return known + diff;
+}
@@ -0,0 +1,20 @@
+#ifndef __SELFTEST_H__
+#define __SELFTEST_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* seed of the random headers, 0 = from the clock */
+extern unsigned int opt_selftest_seed;
+
+/* checks the CPU hash of every algorithm and sha256d against recorded
+ * digests, and the CPU batch paths against the plain hashes on random
+ * headers; returns the number of failures, each one is logged */
+extern int selftest_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SELFTEST_H__ */
@@ -0,0 +1,37 @@
+#ifndef __SEQLOCK_H__
+#define __SEQLOCK_H__
+
+#include <atomic>
+
+/* one writer publishes a value, any number of readers copy it without
+ * blocking the writer; readers retry while a write is in progress */
+template <typename T>
+struct seqlock {
+	std::atomic<unsigned int> seq;	/* odd while the writer copies */
+	T value;
+
+	void write(const T &v)
+	{
+		unsigned int s = seq.load(std::memory_order_relaxed);
+
+		seq.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		value = v;
+		seq.store(s + 2, std::memory_order_release);
+	}
+
+	void read(T &v) const
+	{
+		unsigned int s;
+
+		do {
+			s = seq.load(std::memory_order_acquire);
+			if (s & 1)
+				continue;
+			v = value;
+			std::atomic_thread_fence(std::memory_order_acquire);
+		} while ((s & 1) || seq.load(std::memory_order_relaxed) != s);
+	}
+};
+
+#endif /* __SEQLOCK_H__ */
@@ -0,0 +1,108 @@
+//
+// Hardware-Telemetrie
+//
+// Ein eigener Thread fragt die Sensoren jedes Devices alle
+// opt_telemetry_interval ms beim hwmon Provider ab (hwmon.cpp). Die Aufrufe
+// blockieren, im Miner-Thread hielten sie den naechsten Batch auf.
+// Miner-Threads und Anzeige lesen nur den letzten Stand ueber
+// telemetry_read().
+//
+// Pro Device gibt es einen Seqlock (seqlock.h): der Sampler ist der einzige
+// Schreiber, keiner wartet auf den anderen.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "miner.h"
+#include "hwmon.h"
+#include "seqlock.h"
+#include "telemetry.h"
+
+int opt_telemetry_interval = 1000;
+
+// Werte ab hier sind Fehler der Abfrage
+#define TELEMETRY_ABNORMAL 1000000
+
+static struct seqlock<struct telemetry_sample> slots[MAX_GPUS];
+static int telemetry_gpu[MAX_GPUS];	// Index beim Provider, -1 ohne Sensoren
+static int telemetry_count;
+
+static unsigned long telemetry_value(unsigned long v)
+{
+	return (v < TELEMETRY_ABNORMAL) ? v : 0;
+}
+
+// ein sample_all() pro Device, ausserhalb des Seqlocks
+static bool telemetry_query(int thr_id, struct telemetry_sample *s)
+{
+	if (!hwmon->sample_all(telemetry_gpu[thr_id], s))
+		return false;
+
+	if (s->temp < 0 || s->temp >= TELEMETRY_ABNORMAL)
+		s->temp = 0;
+	if (s->temp_max < s->temp)
+		s->temp_max = s->temp;
+	s->fan_rpm = telemetry_value(s->fan_rpm);
+	s->fan = telemetry_value(s->fan);
+	s->clock = telemetry_value(s->clock);
+	s->load = telemetry_value(s->load);
+	s->clock_mem = telemetry_value(s->clock_mem);
+	s->load_mem = telemetry_value(s->load_mem);
+	s->mem_used = telemetry_value(s->mem_used);
+	s->mem_prc = telemetry_value(s->mem_prc);
+	s->power = telemetry_value(s->power);
+	s->time = (long)time(NULL);
+	s->seq++;
+	return true;
+}
+
+static void *telemetry_thread(void *userdata)
+{
+	// Stand des Samplers, temp_max laeuft hier weiter
+	static struct telemetry_sample cur[MAX_GPUS];
+
+	while (1)
+	{
+		for (int i = 0; i < telemetry_count; i++)
+		{
+			// ohne Antwort bleibt der letzte Stand stehen
+			if (telemetry_gpu[i] >= 0 && telemetry_query(i, &cur[i]))
+				slots[i].write(cur[i]);
+		}
+		usleep((useconds_t)opt_telemetry_interval * 1000);
+	}
+	return NULL;
+}
+
+extern "C" bool telemetry_start(const int *pci_bus, int n)
+{
+	pthread_t pth;
+	bool any = false;
+
+	if (!hwmon)
+		return true;
+	telemetry_count = (n < MAX_GPUS) ? n : MAX_GPUS;
+	for (int i = 0; i < telemetry_count; i++)
+	{
+		telemetry_gpu[i] = hwmon->find(i, pci_bus[i]);
+		if (telemetry_gpu[i] < 0)
+			applog(LOG_WARNING, "GPU #%d: no %s sensors on PCI bus %d", i, hwmon->name, pci_bus[i]);
+		else
+			any = true;
+	}
+	if (!any)
+		return true;
+	if (pthread_create(&pth, NULL, telemetry_thread, NULL))
+		return false;
+	pthread_detach(pth);
+	return true;
+}
+
+extern "C" bool telemetry_read(int thr_id, struct telemetry_sample *sample)
+{
+	slots[thr_id].read(*sample);
+	return sample->time != 0;
+}
@@ -0,0 +1,41 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* sensors of one device at the last sample, 0 where the query failed */
+struct telemetry_sample {
+	long time;			/* 0 = not sampled yet */
+	unsigned long seq;		/* samples so far, steps finer than time */
+	int temp, temp_max;		/* C, max since start */
+	unsigned long fan_rpm;
+	unsigned long fan;		/* % */
+	unsigned long clock;		/* MHz */
+	unsigned long load;		/* % */
+	unsigned long clock_mem;	/* MHz */
+	unsigned long load_mem;		/* % controller */
+	unsigned long mem_used;		/* MB */
+	unsigned long mem_prc;		/* % used */
+	unsigned long power;		/* W board power */
+};
+
+/* ms between two samples of the same device */
+extern int opt_telemetry_interval;
+
+/* starts the sampler thread for the n devices of the miner threads on the
+ * hwmon provider, pci_bus[] locates each; no thread without sensors */
+extern bool telemetry_start(const int *pci_bus, int n);
+
+/* copies the last sample of the miner thread's device, never waits for
+ * the sampler; false if there is none yet */
+extern bool telemetry_read(int thr_id, struct telemetry_sample *sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TELEMETRY_H__ */
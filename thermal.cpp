@@ -0,0 +1,182 @@
+//
+// Temperatur- und Leistungsregelung (--temp-target, --power-limit)
+//
+// Ein PI-Regler pro Device haelt die GPU unter dem Ziel, bevor der Treiber
+// drosselt: der drosselt den Takt hart und kostet mehr Hashrate als ein
+// paar Prozent Pause. Die Batchgroesse liegt mit der Arena beim Init des
+// Algorithmus fest, geregelt wird deshalb das Tastverhaeltnis: nach jedem
+// Batch ruht der Miner-Thread fuer den Anteil (1 - duty) / duty der Zeit,
+// die der Batch gebraucht hat. Die Scanhash-Schleifen mit zwei Slots
+// (x11, quark, nist5) laufen dabei ohne Pipeline, sonst fuellte der schon
+// eingereihte Batch die Pause (thermal_throttling()).
+//
+// Regelgroesse ist die relative Ueberschreitung der knapperen Grenze,
+// (temp - ziel) / ziel bzw. (power - limit) / limit. Der Regler rechnet nur,
+// wenn die Telemetrie einen neuen Stand hat, und integriert nicht weiter,
+// solange duty an einer Grenze anliegt (kein Windup). Zustand und Schlaf
+// gehoeren allein dem Miner-Thread, gelesen wird ueber einen Seqlock.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "miner.h"
+#include "seqlock.h"
+#include "telemetry.h"
+#include "thermal.h"
+
+// Verstaerkung pro relativer Ueberschreitung, 1 C ueber 75 C sind 0.013
+#define THERMAL_KP 3.0
+#define THERMAL_KI 0.2		// pro s
+#define THERMAL_MIN_DUTY 0.1
+// Pause am Stueck, dazwischen wird work_restart geprueft
+#define THERMAL_SLEEP_MS 10
+// laengste Pause nach einem Batch
+#define THERMAL_MAX_IDLE_MS 2000
+// Aenderung von duty in %, ab der sie geloggt wird; die Sensoren liefern
+// ganze Grad, jedes Grad bewegt duty um einige %
+#define THERMAL_LOG_STEP 10
+// beim Drosseln wenigstens so oft eine Zeile
+#define THERMAL_LOG_S 60
+
+int opt_temp_target = 0;
+int opt_power_limit = 0;
+
+struct thermal_ctl {
+	unsigned long sample_seq;	// Sample der Telemetrie beim letzten Schritt
+	double integral;
+	double last_step;	// s
+	double busy_start;	// s, Ende der letzten Pause
+	int logged;		// zuletzt geloggtes duty in %
+	double logged_time;	// s
+	struct thermal_state state;
+};
+
+static struct thermal_ctl controllers[MAX_GPUS];
+static struct seqlock<struct thermal_state> published[MAX_GPUS];
+
+static double thermal_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+// relative Ueberschreitung der knapperen Grenze, -1 ohne Messwert
+static double thermal_error(const struct telemetry_sample *hw)
+{
+	double e = -1.0;
+
+	if (opt_temp_target && hw->temp > 0)
+		e = (double)(hw->temp - opt_temp_target) / opt_temp_target;
+	if (opt_power_limit && hw->power > 0) {
+		double p = ((double)hw->power - opt_power_limit) / opt_power_limit;
+		if (p > e)
+			e = p;
+	}
+	return e;
+}
+
+static void thermal_step(struct thermal_ctl *c, const struct telemetry_sample *hw, double now)
+{
+	double dt = c->last_step ? now - c->last_step : 0.0;
+	double e = thermal_error(hw);
+	double integral, duty;
+
+	if (dt > 10.0)
+		dt = 10.0;
+	c->last_step = now;
+
+	integral = c->integral + e * dt;
+	duty = 1.0 - (THERMAL_KP * e + THERMAL_KI * integral);
+
+	// an der Grenze nur integrieren, wenn es von ihr weg fuehrt
+	if (duty >= 1.0) {
+		duty = 1.0;
+		if (e < 0.0)
+			integral = c->integral;
+	} else if (duty <= THERMAL_MIN_DUTY) {
+		duty = THERMAL_MIN_DUTY;
+		if (e > 0.0)
+			integral = c->integral;
+	}
+	if (integral < 0.0)
+		integral = 0.0;
+	c->integral = integral;
+	c->state.duty = duty;
+	c->state.error = e;
+}
+
+static void thermal_log(int device_id, struct thermal_ctl *c, const struct telemetry_sample *hw, double now)
+{
+	int duty = (int)(100.0 * c->state.duty + 0.5);
+
+	// Beginn und Ende immer, dazwischen grosse Schritte und ab und zu den Stand
+	if ((duty == 100) == (c->logged == 100) && abs(duty - c->logged) < THERMAL_LOG_STEP &&
+		(duty == 100 || now - c->logged_time < THERMAL_LOG_S))
+		return;
+	if (duty == 100)
+		applog(LOG_INFO, "GPU #%d: %d C, %lu W, below the limit, throttling ends", device_id, hw->temp, hw->power);
+	else
+		applog(LOG_INFO, "GPU #%d: %d C, %lu W, duty %d%%", device_id, hw->temp, hw->power, duty);
+	c->logged = duty;
+	c->logged_time = now;
+}
+
+extern "C" void thermal_batch(struct device_ctx *ctx)
+{
+	struct thermal_ctl *c = &controllers[ctx->thr_id];
+	struct telemetry_sample hw;
+	double now, idle;
+
+	if ((!opt_temp_target && !opt_power_limit) || !telemetry_read(ctx->thr_id, &hw))
+		return;
+
+	now = thermal_now();
+	if (!c->busy_start) {
+		c->busy_start = now;
+		c->state.duty = 1.0;
+		c->logged = 100;
+		return;
+	}
+
+	// ueber die Nummer, time hat nur Sekunden und --telemetry-interval
+	// darf kuerzer sein
+	if (hw.seq != c->sample_seq) {
+		c->sample_seq = hw.seq;
+		thermal_step(c, &hw, now);
+		thermal_log(ctx->device_id, c, &hw, now);
+	}
+
+	idle = (c->state.duty < 1.0) ? (now - c->busy_start) * (1.0 - c->state.duty) / c->state.duty : 0.0;
+	if (idle > 1e-3 * THERMAL_MAX_IDLE_MS)
+		idle = 1e-3 * THERMAL_MAX_IDLE_MS;
+
+	// in Stuecken, ein neuer Block wartet nicht auf die Pause
+	for (double slept = 0.0; slept < idle && !work_restart[ctx->thr_id].restart; )
+	{
+		double ms = 1e3 * (idle - slept);
+
+		usleep((useconds_t)(1000 * (ms < THERMAL_SLEEP_MS ? ms : THERMAL_SLEEP_MS)));
+		slept = thermal_now() - now;
+	}
+
+	c->busy_start = idle > 0.0 ? thermal_now() : now;
+	c->state.throttled += c->busy_start - now;
+	published[ctx->thr_id].write(c->state);
+}
+
+extern "C" bool thermal_throttling(const struct device_ctx *ctx)
+{
+	const struct thermal_ctl *c = &controllers[ctx->thr_id];
+
+	return c->busy_start && c->state.duty < 1.0;
+}
+
+extern "C" bool thermal_read(int thr_id, struct thermal_state *state)
+{
+	published[thr_id].read(*state);
+	return state->duty > 0.0;
+}
@@ -0,0 +1,43 @@
+#ifndef __THERMAL_H__
+#define __THERMAL_H__
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct device_ctx;
+
+/* GPU temperature in C and board power in W the controller holds,
+ * 0 = no limit */
+extern int opt_temp_target;
+extern int opt_power_limit;
+
+/* the controller's last decision for one device */
+struct thermal_state {
+	double duty;		/* share of the time spent hashing, 1 = not throttled */
+	double error;		/* relative overshoot of the tighter limit, < 0 below */
+	double throttled;	/* s the miner thread idled for the controller */
+};
+
+/* called by the owning miner thread after each batch: a new telemetry
+ * sample updates the PI controller, then the thread idles for the
+ * controller's share of the batch time; returns at once without limits
+ * or sensors and cuts the idle time short on a work restart */
+extern void thermal_batch(struct device_ctx *ctx);
+
+/* true while the controller idles the thread after each batch; the
+ * pipelined scanhash loops then collect the batch in flight first, so
+ * the GPU really stands still during the pause */
+extern bool thermal_throttling(const struct device_ctx *ctx);
+
+/* last decision of a miner thread, false without a limit or before the
+ * first batch with sensors */
+extern bool thermal_read(int thr_id, struct thermal_state *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMAL_H__ */
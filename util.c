@@ -37,6 +37,8 @@
 #include "compat.h"
 #include "miner.h"
 #include "elist.h"
+#include "logring.h"
+#include "metrics.h"
 
 struct data_buffer {
 	void		*buf;
@@ -69,60 +71,13 @@ struct thread_q {
 	pthread_cond_t		cond;
 };
 
-extern WINDOW *info_screen, *out_screen;
-
+/* queued for the log thread, see logring.cpp */
 void applog(int prio, const char *fmt, ...)
 {
 	va_list ap;
 
 	va_start(ap, fmt);
-
-#ifdef HAVE_SYSLOG_H
-	if (use_syslog) {
-		va_list ap2;
-		char *buf;
-		int len;
-		
-		va_copy(ap2, ap);
-		len = vsnprintf(NULL, 0, fmt, ap2) + 1;
-		va_end(ap2);
-		buf = alloca(len);
-		if (vsnprintf(buf, len, fmt, ap) >= 0)
-			syslog(prio, "%s", buf);
-	}
-#else
-	if (0) {}
-#endif
-	else {
-		char *f;
-		int len;
-		time_t now;
-		struct tm tm, *tm_p;
-
-		time(&now);
-
-		pthread_mutex_lock(&applog_lock);
-		tm_p = localtime(&now);
-		memcpy(&tm, tm_p, sizeof(tm));
-		pthread_mutex_unlock(&applog_lock);
-
-		len = (int)(40 + strlen(fmt) + 2);
-		f = (char*)alloca(len);
-		
-		sprintf(f, "[%d-%02d-%02d %02d:%02d:%02d] %s\n",
-			tm.tm_year + 1900,
-			tm.tm_mon + 1,
-			tm.tm_mday,
-			tm.tm_hour,
-			tm.tm_min,
-			tm.tm_sec,
-			fmt);
-		pthread_mutex_lock(&applog_lock);
-		//vfprintf(stderr, f, ap);	/* atomic write to stderr */
-		vwprintw(out_screen, fmt, ap);
-		//fflush(stderr);
-		pthread_mutex_unlock(&applog_lock);
-	}
+	logring_vpush(prio, fmt, ap);
 	va_end(ap);
 }
 
@@ -440,7 +395,12 @@ json_t *json_rpc_call(CURL *curl, const char *url,
 
 	if (hi.reason)
 		json_object_set_new(val, "reject-reason", json_string(hi.reason));
+	if (hi.lp_path)
+		json_object_set_new(val, "longpoll-path", json_string(hi.lp_path));
 
+	free(hi.lp_path);
+	free(hi.reason);
+	free(hi.stratum_url);
 	databuf_free(&all_data);
 	curl_slist_free_all(headers);
 	curl_easy_reset(curl);
@@ -523,6 +483,26 @@ int timeval_subtract(struct timeval *result, struct timeval *x,
 	return x->tv_sec < y->tv_sec;
 }
 
+double thread_cpu_time(void)
+{
+#ifdef WIN32
+	FILETIME creation, exit, kernel, user;
+
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+		return 0.0;
+	return 1e-7 * ((((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) +
+		(((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime));
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+		return 0.0;
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+#else
+	return 0.0;
+#endif
+}
+
 bool fulltest(const uint32_t *hash, const uint32_t *target)
 {
 	int i;
@@ -1065,6 +1045,8 @@ static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
 			hex2bin(sctx->job.nreward, nreward, 2);
 	}
 	sctx->job.clean = clean;
+	if (clean)
+		metrics_notify();
 
 	sctx->job.diff = sctx->next_diff;
 
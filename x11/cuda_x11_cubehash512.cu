@@ -1,5 +1,8 @@
+#include "device.h"
+
 // aus heavy.cu
 extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
+extern cudaStream_t gpustream[MAX_GPUS];
 
 typedef unsigned char BitSequence;
 typedef unsigned long long DataLength;
@@ -307,7 +310,7 @@ __host__ void x11_cubehash512_cpu_hash_64(int thr_id, int threads, uint32_t star
     // Gre des dynamischen Shared Memory Bereichs
     size_t shared_size = 0;
 
-    x11_cubehash512_gpu_hash_64<<<grid, block, shared_size>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector);
-    MyStreamSynchronize(NULL, order, thr_id);
+    x11_cubehash512_gpu_hash_64<<<grid, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector);
+    MyStreamSynchronize(gpustream[thr_id], order, thr_id);
 }
 
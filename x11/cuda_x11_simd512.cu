@@ -9,12 +9,15 @@
 
 // aus heavy.cu
 extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int thr_id);
+extern cudaStream_t gpustream[MAX_GPUS];
 
 typedef unsigned int uint32_t;
 typedef unsigned long long uint64_t;
 
-int *d_state[8];
-uint4 *d_temp4[8];
+#include "device.h"
+
+int *d_state[MAX_GPUS];
+uint4 *d_temp4[MAX_GPUS];
 
 // texture bound to d_temp4[thr_id], for read access in Compaction kernel
 texture<uint4, 1, cudaReadModeElementType> texRef1D_128;
@@ -637,8 +640,18 @@ x11_simd512_gpu_final_64(int threads, uint32_t startNounce, uint64_t *g_hash, ui
 }
 
 // Setup-Funktionen
+__host__ void x11_simd512_cpu_free(int thr_id)
+{
+    cudaFree(d_state[thr_id]);
+    cudaFree(d_temp4[thr_id]);
+    d_state[thr_id] = NULL;
+    d_temp4[thr_id] = NULL;
+}
+
 __host__ void x11_simd512_cpu_init(int thr_id, int threads)
 {
+    // ein zweites Init (anderer Batch) ersetzt die Puffer
+    x11_simd512_cpu_free(thr_id);
     cudaMalloc( &d_state[thr_id], 32*sizeof(int)*threads );
     cudaMalloc( &d_temp4[thr_id], 64*sizeof(uint4)*threads );
 
@@ -677,15 +690,15 @@ __host__ void x11_simd512_cpu_hash_64(int thr_id, int threads, uint32_t startNou
     dim3 block(threadsperblock);
 
     dim3 grid8(((threads + threadsperblock-1)/threadsperblock)*8);
-    x11_simd512_gpu_expand_64<<<grid8, block, shared_size>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector, d_temp4[thr_id]);
+    x11_simd512_gpu_expand_64<<<grid8, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector, d_temp4[thr_id]);
 
     dim3 grid((threads + threadsperblock-1)/threadsperblock);
 
     // knstlich die Occupancy limitieren, um das totale Erschpfen des Texture Cache zu vermeiden
-    x11_simd512_gpu_compress1_64<<<grid, block, shared_size>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector, d_temp4[thr_id], d_state[thr_id]);
-    x11_simd512_gpu_compress2_64<<<grid, block, shared_size>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector, d_temp4[thr_id], d_state[thr_id]);
+    x11_simd512_gpu_compress1_64<<<grid, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector, d_temp4[thr_id], d_state[thr_id]);
+    x11_simd512_gpu_compress2_64<<<grid, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector, d_temp4[thr_id], d_state[thr_id]);
 
-    x11_simd512_gpu_final_64<<<grid, block, shared_size>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector, d_temp4[thr_id], d_state[thr_id]);
+    x11_simd512_gpu_final_64<<<grid, block, shared_size, gpustream[thr_id]>>>(threads, startNounce, (uint64_t*)d_hash, d_nonceVector, d_temp4[thr_id], d_state[thr_id]);
 
-    MyStreamSynchronize(NULL, order, thr_id);
+    MyStreamSynchronize(gpustream[thr_id], order, thr_id);
 }
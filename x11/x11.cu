@@ -19,59 +19,11 @@ extern "C"
 
 #include <stdint.h>
 
-// aus cpu-miner.c
-extern int device_map[8];
-
-// Speicher fr Input/Output der verketteten Hashfunktionen
-static uint32_t *d_hash[8];
-
-extern void quark_blake512_cpu_init(int thr_id, int threads);
-extern void quark_blake512_cpu_setBlock_80(void *pdata);
-extern void quark_blake512_cpu_hash_80(int thr_id, int threads, uint32_t startNounce, uint32_t *d_hash, int order);
-extern void quark_blake512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_bmw512_cpu_init(int thr_id, int threads);
-extern void quark_bmw512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_groestl512_cpu_init(int thr_id, int threads);
-extern void quark_groestl512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-extern void quark_doublegroestl512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_skein512_cpu_init(int thr_id, int threads);
-extern void quark_skein512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_keccak512_cpu_init(int thr_id, int threads);
-extern void quark_keccak512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_jh512_cpu_init(int thr_id, int threads);
-extern void quark_jh512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void x11_luffa512_cpu_init(int thr_id, int threads);
-extern void x11_luffa512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void x11_cubehash512_cpu_init(int thr_id, int threads);
-extern void x11_cubehash512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void x11_shavite512_cpu_init(int thr_id, int threads);
-extern void x11_shavite512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void x11_simd512_cpu_init(int thr_id, int threads);
-extern void x11_simd512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void x11_echo512_cpu_init(int thr_id, int threads);
-extern void x11_echo512_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
-
-extern void quark_check_cpu_init(int thr_id, int threads);
-extern void quark_check_cpu_setTarget(const void *ptarget);
-extern uint32_t quark_check_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_inputHash, int order);
-
-extern void quark_compactTest_cpu_init(int thr_id, int threads);
-extern void quark_compactTest_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *inpHashes, 
-											uint32_t *d_noncesTrue, size_t *nrmTrue, uint32_t *d_noncesFalse, size_t *nrmFalse,
-											int order);
+#include "device_backend.h"
+#include "thermal.h"
 
 // X11 Hashfunktion
-inline void x11hash(void *state, const void *input)
+extern "C" void x11hash(void *state, const void *input)
 {
     // blake1-bmw2-grs3-skein4-jh5-keccak6-luffa7-cubehash8-shavite9-simd10-echo11
 
@@ -156,106 +108,122 @@ inline void x11hash(void *state, const void *input)
 
 extern bool opt_benchmark;
 
-extern "C" int scanhash_x11(int thr_id, uint32_t *pdata,
+extern "C" int scanhash_x11(struct device_ctx *ctx, uint32_t *pdata,
     const uint32_t *ptarget, uint32_t max_nonce,
     unsigned long *hashes_done)
 {
+	const int thr_id = ctx->thr_id;
+	const struct device_backend *dev = ctx->backend;
 	const uint32_t first_nonce = pdata[19];
+	int found = 0;
 
 	if (opt_benchmark)
 		((uint32_t*)ptarget)[7] = 0x0000ff;
 
-	const uint32_t Htarg = ptarget[7];
+	const int throughput = device_throughput(ctx, 256*256*8);
 
-	const int throughput = 256*256*8;
-
-	static bool init[8] = {0,0,0,0,0,0,0,0};
-	if (!init[thr_id])
+	if (!ctx->init)
 	{
-		cudaSetDevice(device_map[thr_id]);
-
-		// Konstanten kopieren, Speicher belegen
-		cudaMalloc(&d_hash[thr_id], 16 * sizeof(uint32_t) * throughput);
-		quark_blake512_cpu_init(thr_id, throughput);
-		quark_groestl512_cpu_init(thr_id, throughput);
-		quark_skein512_cpu_init(thr_id, throughput);
-		quark_bmw512_cpu_init(thr_id, throughput);
-		quark_keccak512_cpu_init(thr_id, throughput);
-		quark_jh512_cpu_init(thr_id, throughput);
-		x11_luffa512_cpu_init(thr_id, throughput);
-		x11_cubehash512_cpu_init(thr_id, throughput);
-		x11_shavite512_cpu_init(thr_id, throughput);
-		x11_simd512_cpu_init(thr_id, throughput);
-		x11_echo512_cpu_init(thr_id, throughput);
-		quark_check_cpu_init(thr_id, throughput);
-		init[thr_id] = true;
+		static const enum hash_stage stages[] = {
+			STAGE_BLAKE512_80, STAGE_BMW512, STAGE_GROESTL512, STAGE_SKEIN512,
+			STAGE_JH512, STAGE_KECCAK512, STAGE_LUFFA512, STAGE_CUBEHASH512,
+			STAGE_SHAVITE512, STAGE_SIMD512, STAGE_ECHO512, STAGE_CHECK
+		};
+
+		const size_t hashBytes = 16 * sizeof(uint32_t) * throughput;
+
+		// Konstanten kopieren, Speicher einmal im Arena-Block belegen
+		if (!dev->init(ctx, throughput, stages, sizeof(stages) / sizeof(stages[0])) ||
+			!device_arena_reserve(ctx, DEVICE_SLOTS * device_arena_size(hashBytes), 0))
+			return 0;
+		for (int slot = 0; slot < DEVICE_SLOTS; slot++)
+			ctx->d_hash[slot] = (uint32_t *)device_arena_alloc(ctx, ARENA_DEVICE, hashBytes);
+		ctx->throughput = throughput;
+		ctx->init = true;
 	}
 
 	uint32_t endiandata[20];
 	for (int k=0; k < 20; k++)
 		be32enc(&endiandata[k], ((uint32_t*)pdata)[k]);
 
-	quark_blake512_cpu_setBlock_80((void*)endiandata);
-	quark_check_cpu_setTarget(ptarget);
+	dev->set_block(ctx, STAGE_BLAKE512_80, endiandata, 80);
+	dev->set_target(ctx, ptarget);
+
+	// Doppelpuffer: Batch N+1 wird eingereiht, waehrend Batch N noch rechnet
+	// und sein Ergebnis asynchron zurueckkommt
+	int slot = 0, pending = -1;
+	uint32_t nonces[DEVICE_CANDIDATES];
 
 	do {
 		int order = 0;
+		uint32_t *d_hash = ctx->d_hash[slot];
+
+		// gedrosselt: den laufenden Batch erst abholen, sonst rechnet die GPU
+		// die Pause in thermal_batch() mit der eingereihten Arbeit durch
+		if (pending >= 0 && thermal_throttling(ctx))
+		{
+			int count = dev->check_wait(ctx, pending, nonces);
+			found += submit_candidates(ctx, nonces, count);
+			pending = -1;
+		}
+
+		dev->select(ctx, slot);
 
 		// erstes Blake512 Hash mit CUDA
-		quark_blake512_cpu_hash_80(thr_id, throughput, pdata[19], d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_BLAKE512_80, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr BMW512
-		quark_bmw512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_BMW512, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Groestl512
-		quark_groestl512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_GROESTL512, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Skein512
-		quark_skein512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_SKEIN512, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr JH512
-		quark_jh512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_JH512, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Keccak512
-		quark_keccak512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_KECCAK512, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Luffa512
-		x11_luffa512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_LUFFA512, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Cubehash512
-		x11_cubehash512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_CUBEHASH512, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Shavite512
-		x11_shavite512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_SHAVITE512, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr SIMD512
-		x11_simd512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_SIMD512, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr ECHO512
-		x11_echo512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		dev->hash(ctx, STAGE_ECHO512, throughput, pdata[19], NULL, d_hash, order++);
 
-		// Scan nach Gewinner Hashes auf der GPU
-		uint32_t foundNonce = quark_check_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
-		if  (foundNonce != 0xffffffff)
+		// Scan nach Gewinner Hashes auf der GPU, Readback ohne Sync
+		dev->check_async(ctx, slot, throughput, pdata[19], NULL, d_hash, order++);
+
+		// Ergebnis des vorigen Batches abholen, der aktuelle laeuft dabei weiter
+		if (pending >= 0)
 		{
-			uint32_t vhash64[8];
-			be32enc(&endiandata[19], foundNonce);
-			x11hash(vhash64, endiandata);
-
-			if ((vhash64[7]<=Htarg) && fulltest(vhash64, ptarget)) {
-
-				pdata[19] = foundNonce;
-				*hashes_done = foundNonce - first_nonce + 1;
-				return 1;
-			} else {
-				applog(LOG_INFO, "GPU #%d: result for nonce $%08X does not validate on CPU!", thr_id, foundNonce);
-			}
+			// Verifikation und Submit laufen asynchron im CPU Verify-Pool
+			int count = dev->check_wait(ctx, pending, nonces);
+			found += submit_candidates(ctx, nonces, count);
 		}
+		pending = slot;
+		slot = (slot + 1) % DEVICE_SLOTS;
 
 		pdata[19] += throughput;
 
 	} while (pdata[19] < max_nonce && !work_restart[thr_id].restart);
 
+	// letzten Batch abholen, danach wieder synchron auf dem Default-Stream
+	int count = dev->check_wait(ctx, pending, nonces);
+	found += submit_candidates(ctx, nonces, count);
+	dev->select(ctx, -1);
+
 	*hashes_done = pdata[19] - first_nonce + 1;
-	return 0;
+	return found;
 }
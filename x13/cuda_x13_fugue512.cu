@@ -42,6 +42,8 @@ extern cudaError_t MyStreamSynchronize(cudaStream_t stream, int situation, int t
 
 #include <stdint.h>
 
+#include "device.h"
+
 #define SPH_C64(x)    ((uint64_t)(x ## ULL))
 #define SPH_C32(x)    ((uint32_t)(x ## U))
 #define SPH_T32(x)    ((x) & SPH_C32(0xFFFFFFFF))
@@ -675,15 +677,17 @@ __global__ void x13_fugue512_gpu_hash_64(int threads, uint32_t startNounce, uint
     }
 }
 
+// wie in cuda_fugue256.cu, die Tabellen nur beim ersten Init kopieren
 #define texDef(texname, texmem, texsource, texsize) \
-	unsigned int *texmem; \
-	cudaMalloc(&texmem, texsize); \
-	cudaMemcpy(texmem, texsource, texsize, cudaMemcpyHostToDevice); \
+	static unsigned int *texmem[MAX_GPUS]; \
+	if (!texmem[thr_id]) { \
+	  cudaMalloc(&texmem[thr_id], texsize); \
+	  cudaMemcpy(texmem[thr_id], texsource, texsize, cudaMemcpyHostToDevice); } \
 	texname.normalized = 0; \
 	texname.filterMode = cudaFilterModePoint; \
 	texname.addressMode[0] = cudaAddressModeClamp; \
 	{ cudaChannelFormatDesc channelDesc = cudaCreateChannelDesc<unsigned int>(); \
-	  cudaBindTexture(NULL, &texname, texmem, &channelDesc, texsize ); }
+	  cudaBindTexture(NULL, &texname, texmem[thr_id], &channelDesc, texsize ); }
 
 __host__ void x13_fugue512_cpu_init(int thr_id, int threads)
 {
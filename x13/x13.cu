@@ -24,11 +24,7 @@ extern "C"
 #include "miner.h"
 }
 
-// aus cpu-miner.c
-extern int device_map[8];
-
-// Speicher fr Input/Output der verketteten Hashfunktionen
-static uint32_t *d_hash[8];
+#include "device_backend.h"
 
 extern void quark_blake512_cpu_init(int thr_id, int threads);
 extern void quark_blake512_cpu_setBlock_80(void *pdata);
@@ -74,7 +70,7 @@ extern void x13_fugue512_cpu_hash_64(int thr_id, int threads, uint32_t startNoun
 
 extern void quark_check_cpu_init(int thr_id, int threads);
 extern void quark_check_cpu_setTarget(const void *ptarget);
-extern uint32_t quark_check_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_inputHash, int order);
+extern int quark_check_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_inputHash, uint32_t *nonces, int order);
 
 extern void quark_compactTest_cpu_init(int thr_id, int threads);
 extern void quark_compactTest_cpu_hash_64(int thr_id, int threads, uint32_t startNounce, uint32_t *inpHashes, 
@@ -82,7 +78,7 @@ extern void quark_compactTest_cpu_hash_64(int thr_id, int threads, uint32_t star
 											int order);
 
 // X13 Hashfunktion
-inline void x13hash(void *state, const void *input)
+extern "C" void x13hash(void *state, const void *input)
 {
     // blake1-bmw2-grs3-skein4-jh5-keccak6-luffa7-cubehash8-shavite9-simd10-echo11-hamsi12-fugue13
 
@@ -171,26 +167,29 @@ inline void x13hash(void *state, const void *input)
 
 extern bool opt_benchmark;
 
-extern "C" int scanhash_x13(int thr_id, uint32_t *pdata,
+extern "C" int scanhash_x13(struct device_ctx *ctx, uint32_t *pdata,
     const uint32_t *ptarget, uint32_t max_nonce,
     unsigned long *hashes_done)
 {
+	const int thr_id = ctx->thr_id;
 	const uint32_t first_nonce = pdata[19];
+	int found = 0;
 
 	if (opt_benchmark)
 		((uint32_t*)ptarget)[7] = 0x0000ff;
 
-	const uint32_t Htarg = ptarget[7];
-
-	const int throughput = 256*256*8;
+	const int throughput = device_throughput(ctx, 256*256*8);
 
-	static bool init[8] = {0,0,0,0,0,0,0,0};
-	if (!init[thr_id])
+	if (!ctx->init)
 	{
-		cudaSetDevice(device_map[thr_id]);
+		cudaSetDevice(ctx->device_id);
+
+		const size_t hashBytes = 16 * sizeof(uint32_t) * throughput;
 
-		// Konstanten kopieren, Speicher belegen
-		cudaMalloc(&d_hash[thr_id], 16 * sizeof(uint32_t) * throughput);
+		// Konstanten kopieren, Speicher einmal im Arena-Block belegen
+		if (!device_arena_reserve(ctx, device_arena_size(hashBytes), 0))
+			return 0;
+		ctx->d_hash[0] = (uint32_t *)device_arena_alloc(ctx, ARENA_DEVICE, hashBytes);
 		quark_blake512_cpu_init(thr_id, throughput);
 		quark_groestl512_cpu_init(thr_id, throughput);
 		quark_skein512_cpu_init(thr_id, throughput);
@@ -205,80 +204,75 @@ extern "C" int scanhash_x13(int thr_id, uint32_t *pdata,
 		x13_hamsi512_cpu_init(thr_id, throughput);
 		x13_fugue512_cpu_init(thr_id, throughput);
 		quark_check_cpu_init(thr_id, throughput);
-		init[thr_id] = true;
+		ctx->throughput = throughput;
+		ctx->init = true;
 	}
 
+	uint32_t *d_hash = ctx->d_hash[0];
+
 	//unsigned char echobefore[64], echoafter[64];
 
     uint32_t endiandata[20];
 	for (int k=0; k < 20; k++)
 		be32enc(&endiandata[k], ((uint32_t*)pdata)[k]);
 
-	quark_blake512_cpu_setBlock_80((void*)endiandata);
-	quark_check_cpu_setTarget(ptarget);
+	// nur neu laden, wenn sich Header oder Target geaendert haben
+	if (device_upload_needed(ctx, UPLOAD_BLOCK, endiandata, 80))
+		quark_blake512_cpu_setBlock_80((void*)endiandata);
+	if (device_upload_needed(ctx, UPLOAD_TARGET, ptarget, 32))
+		quark_check_cpu_setTarget(ptarget);
 
 	do {
 		int order = 0;
 
         // erstes Blake512 Hash mit CUDA
-		quark_blake512_cpu_hash_80(thr_id, throughput, pdata[19], d_hash[thr_id], order++);
+		quark_blake512_cpu_hash_80(thr_id, throughput, pdata[19], d_hash, order++);
 
 		// das ist der unbedingte Branch fr BMW512
-		quark_bmw512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		quark_bmw512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Groestl512
-		quark_groestl512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		quark_groestl512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Skein512
-		quark_skein512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		quark_skein512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr JH512
-		quark_jh512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		quark_jh512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Keccak512
-		quark_keccak512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		quark_keccak512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Luffa512
-		x11_luffa512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		x11_luffa512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Cubehash512
-		x11_cubehash512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		x11_cubehash512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr Shavite512
-		x11_shavite512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		x11_shavite512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr SIMD512
-		x11_simd512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		x11_simd512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash, order++);
 
 		// das ist der unbedingte Branch fr ECHO512
-		x11_echo512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		x11_echo512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash, order++);
 
-		x13_hamsi512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+		x13_hamsi512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash, order++);
 
-        x13_fugue512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
+        x13_fugue512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash, order++);
 
 		// Scan nach Gewinner Hashes auf der GPU
-		uint32_t foundNonce = quark_check_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash[thr_id], order++);
-		if  (foundNonce != 0xffffffff)
-		{
-			uint32_t vhash64[8];
-			be32enc(&endiandata[19], foundNonce);
-			x13hash(vhash64, endiandata);
-
-			if( (vhash64[7]<=Htarg) && fulltest(vhash64, ptarget) ) {
-                
-                pdata[19] = foundNonce;
-                *hashes_done = foundNonce - first_nonce + 1;
-                return 1;
-			} else {
-				applog(LOG_INFO, "GPU #%d: result for nonce $%08X does not validate on CPU!", thr_id, foundNonce);
-			}
-		}
+		uint32_t nonces[DEVICE_CANDIDATES];
+		int count = quark_check_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash, nonces, order++);
+
+		// Verifikation und Submit laufen asynchron im CPU Verify-Pool
+		found += submit_candidates(ctx, nonces, count);
 
 		pdata[19] += throughput;
 
 	} while (pdata[19] < max_nonce && !work_restart[thr_id].restart);
 
 	*hashes_done = pdata[19] - first_nonce + 1;
-	return 0;
+	return found;
 }